@@ -9,13 +9,16 @@
  // Arguments:
  // - cchRowWidth - the length of the default text attribute
  // - attr - the default text attribute
+ // - palette - the intern table for the attributes of this row's buffer. Must outlive the row.
  // Return Value:
  // - constructed object
  // Note: will throw exception if unable to allocate memory for text attribute storage
-ATTR_ROW::ATTR_ROW(const UINT cchRowWidth, const TextAttribute attr)
+ATTR_ROW::ATTR_ROW(const UINT cchRowWidth, const TextAttribute attr, TextAttributePalette& palette) :
+    _palette{ &palette }
 {
-    _list.push_back(TextAttributeRun(cchRowWidth, attr));
+    _list.push_back(TextAttributeIdRun(cchRowWidth, _palette->Intern(attr)));
     _cchRowWidth = cchRowWidth;
+    _UpdateRunEnds();
 }
 
 // Routine Description:
@@ -24,8 +27,10 @@ ATTR_ROW::ATTR_ROW(const UINT cchRowWidth, const TextAttribute attr)
 // - attr - The default text attributes to use on text in this row.
 void ATTR_ROW::Reset(const TextAttribute attr)
 {
+    const auto id = _palette->Intern(attr);
     _list.clear();
-    _list.push_back(TextAttributeRun(_cchRowWidth, attr));
+    _list.push_back(TextAttributeIdRun(_cchRowWidth, id));
+    _UpdateRunEnds();
 }
 
 // Routine Description:
@@ -79,6 +84,8 @@ void ATTR_ROW::Resize(const size_t newWidth)
         // in memory. We're not going to waste time redimensioning the array in the heap. We're just noting that the useful
         // portions of it have changed.
     }
+
+    _UpdateRunEnds();
 }
 
 // Routine Description:
@@ -108,7 +115,7 @@ TextAttribute ATTR_ROW::GetAttrByColumn(const size_t column,
 {
     THROW_HR_IF(E_INVALIDARG, column >= _cchRowWidth);
     const auto runPos = FindAttrIndex(column, pApplies);
-    return _list[runPos].GetAttributes();
+    return _palette->Get(_list[runPos].GetAttributeId());
 }
 
 // Routine Description:
@@ -122,6 +129,7 @@ size_t ATTR_ROW::GetNumberOfRuns() const noexcept
 
 // Routine Description:
 // - This routine finds the nth attribute in this ATTR_ROW.
+// - The runs are binary searched by their end columns, so this is O(log n) in the number of runs.
 // Arguments:
 // - index - which attribute to find
 // - applies - on output, contains corrected length of indexed attr.
@@ -137,20 +145,33 @@ size_t ATTR_ROW::FindAttrIndex(const size_t index, size_t* const pApplies) const
 
     FAIL_FAST_IF(!(_list.size() > 0)); // There should be a non-zero and positive number of items in the array.
 
-    // Scan through the internal array from position 0 adding up the lengths that each attribute applies to
     auto runPos = _list.cbegin();
-    do
+    if (_HasRunEnds())
     {
-        cTotalLength += runPos->GetLength();
-
-        if (cTotalLength > index)
+        // The first run that ends past the requested index is the one that covers it.
+        const auto runEnd = std::upper_bound(_runEnds.cbegin(), _runEnds.cend(), index);
+        runPos += runEnd - _runEnds.cbegin();
+        if (runEnd < _runEnds.cend())
         {
-            // If we've just passed up the requested index with the length we added, break early
-            break;
+            cTotalLength = *runEnd;
         }
+    }
+    else
+    {
+        // Scan through the internal array from position 0 adding up the lengths that each attribute applies to
+        do
+        {
+            cTotalLength += runPos->GetLength();
 
-        runPos++;
-    } while (runPos < _list.cend());
+            if (cTotalLength > index)
+            {
+                // If we've just passed up the requested index with the length we added, break early
+                break;
+            }
+
+            runPos++;
+        } while (runPos < _list.cend());
+    }
 
     // we should have broken before falling out the while case.
     // if we didn't break, then this ATTR_ROW wasn't filled with enough attributes for the entire row of characters
@@ -186,20 +207,21 @@ bool ATTR_ROW::SetAttrToEnd(const UINT iStart, const TextAttribute attr)
 {
     size_t const length = _cchRowWidth - iStart;
 
-    const TextAttributeRun run(length, attr);
-    return SUCCEEDED(InsertAttrRuns({ &run, 1 }, iStart, _cchRowWidth - 1, _cchRowWidth));
+    const TextAttributeIdRun run(length, _palette->Intern(attr));
+    return SUCCEEDED(_InsertIdRuns({ &run, 1 }, iStart, _cchRowWidth - 1, _cchRowWidth));
 }
 
 // Routine Description:
 // - Replaces all runs in the row with the given wToBeReplacedAttr with the new
 //      attribute wReplaceWith. This method is used for replacing specifically
 //      legacy attributes.
+// - To replace an attribute in every row of a buffer, use TextBuffer::ReplaceLegacyAttrs instead.
 // Arguments:
 // - wToBeReplacedAttr - the legacy attribute to replace in this row.
 // - wReplaceWith - the new value for the matching runs' attributes.
 // Return Value:
 // <none>
-void ATTR_ROW::ReplaceLegacyAttrs(_In_ WORD wToBeReplacedAttr, _In_ WORD wReplaceWith) noexcept
+void ATTR_ROW::ReplaceLegacyAttrs(_In_ WORD wToBeReplacedAttr, _In_ WORD wReplaceWith)
 {
     TextAttribute ToBeReplaced;
     ToBeReplaced.SetFromLegacy(wToBeReplacedAttr);
@@ -214,22 +236,95 @@ void ATTR_ROW::ReplaceLegacyAttrs(_In_ WORD wToBeReplacedAttr, _In_ WORD wReplac
 // Method Description:
 // - Replaces all runs in the row with the given toBeReplacedAttr with the new
 //      attribute replaceWith.
+// - To replace an attribute in every row of a buffer, use TextBuffer::ReplaceAttrs instead.
+//      It only has to change the buffer's palette, rather than walk every run.
 // Arguments:
 // - toBeReplacedAttr - the attribute to replace in this row.
 // - replaceWith - the new value for the matching runs' attributes.
 // Return Value:
 // - <none>
-void ATTR_ROW::ReplaceAttrs(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith) noexcept
+void ATTR_ROW::ReplaceAttrs(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith)
 {
+    const auto replaceWithId = _palette->Intern(replaceWith);
     for (auto& run : _list)
     {
-        if (run.GetAttributes() == toBeReplacedAttr)
+        // Compare the attributes rather than the ids: after a palette replacement,
+        // more than one id can stand for the same attribute.
+        if (_palette->Get(run.GetAttributeId()) == toBeReplacedAttr)
         {
-            run.SetAttributes(replaceWith);
+            run.SetAttributeId(replaceWithId);
         }
     }
 }
 
+// Routine Description:
+// - Flags every palette id used by this row, so that the palette can be compacted.
+// Arguments:
+// - used - one flag for each id in the palette. Must be at least as long as the palette.
+// Return Value:
+// - <none>
+void ATTR_ROW::MarkUsedAttributeIds(std::vector<bool>& used) const
+{
+    for (const auto& run : _list)
+    {
+        used.at(run.GetAttributeId()) = true;
+    }
+}
+
+// Routine Description:
+// - Renumbers the ids of every run after the palette has been compacted.
+// Arguments:
+// - remap - the table from old ids to new ones that TextAttributePalette::Compact returned.
+// Return Value:
+// - <none>
+void ATTR_ROW::RemapAttributeIds(const std::vector<TextAttributePalette::id_type>& remap) noexcept
+{
+    for (auto& run : _list)
+    {
+        run.SetAttributeId(remap[run.GetAttributeId()]);
+    }
+}
+
+// Routine Description:
+// - returns the palette id of the attribute at the specified column. Rows of the same
+//   buffer share a palette, so the id can be copied to another of them as it is.
+// Arguments:
+// - column - the column to get the attribute id for
+// - pApplies - if given, fills how long this attribute will apply for
+// Return Value:
+// - the palette id of the text attribute at column
+// Note:
+// - will throw on error
+TextAttributePalette::id_type ATTR_ROW::GetAttrIdByColumn(const size_t column,
+                                                          size_t* const pApplies) const
+{
+    THROW_HR_IF(E_INVALIDARG, column >= _cchRowWidth);
+    const auto runPos = FindAttrIndex(column, pApplies);
+    return _list[runPos].GetAttributeId();
+}
+
+// Routine Description:
+// - Replaces every run of the row with the given ones, whose ids must come from this row's palette.
+// - Nothing is looked up in the palette, so different rows of the same buffer can do this at the same time.
+// Arguments:
+// - runs - the new runs. They must cover the row exactly.
+// Return Value:
+// - <none>
+// Note: will throw exception if the runs don't cover the row. Nothing is changed if so.
+void ATTR_ROW::SetAttrIdRuns(std::vector<TextAttributeIdRun> runs)
+{
+    size_t cchTotal = 0;
+    for (const auto& run : runs)
+    {
+        THROW_HR_IF(E_INVALIDARG, run.GetLength() == 0);
+        cchTotal += run.GetLength();
+    }
+    THROW_HR_IF(E_INVALIDARG, cchTotal != _cchRowWidth);
+
+    _list.swap(runs);
+    _UpdateRunEnds();
+}
+
 
 // Routine Description:
 // - Takes a array of attribute runs, and inserts them into this row from startIndex to endIndex.
@@ -250,6 +345,38 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
                                  const size_t iStart,
                                  const size_t iEnd,
                                  const size_t cBufferWidth)
+{
+    // Cell-by-cell writes insert a single run at a time, so don't allocate for that case.
+    if (newAttrs.size() == 1)
+    {
+        const TextAttributeIdRun run(newAttrs.front().GetLength(), _palette->Intern(newAttrs.front().GetAttributes()));
+        return _InsertIdRuns({ &run, 1 }, iStart, iEnd, cBufferWidth);
+    }
+
+    std::vector<TextAttributeIdRun> runs;
+    runs.reserve(newAttrs.size());
+    for (const auto& run : newAttrs)
+    {
+        runs.emplace_back(run.GetLength(), _palette->Intern(run.GetAttributes()));
+    }
+    return _InsertIdRuns({ runs.data(), runs.size() }, iStart, iEnd, cBufferWidth);
+}
+
+// Routine Description:
+// - Does the work for InsertAttrRuns, once the attributes to insert have been interned.
+// - Since attributes are interned, runs can be compared by their ids.
+// Arguments:
+// - newAttrs - The runs to merge into this row.
+// - iStart - The index in the row to place the array of runs.
+// - iEnd - the final index of the merge runs
+// - BufferWidth - the width of the row.
+// Return Value:
+// - S_OK if we were successful.
+[[nodiscard]]
+HRESULT ATTR_ROW::_InsertIdRuns(const std::basic_string_view<TextAttributeIdRun> newAttrs,
+                                const size_t iStart,
+                                const size_t iEnd,
+                                const size_t cBufferWidth)
 {
     // Definitions:
     // Existing Run = The run length encoded color array we're already storing in memory before this was called.
@@ -273,11 +400,11 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
     if (newAttrs.size() == 1)
     {
         // Get the new color attribute we're trying to apply
-        const TextAttribute NewAttr = newAttrs.at(0).GetAttributes();
+        const auto NewAttr = newAttrs.at(0).GetAttributeId();
 
         // If the existing run was only 1 element...
         // ...and the new color is the same as the old, we don't have to do anything and can exit quick.
-        if (_list.size() == 1 && _list.at(0).GetAttributes() == NewAttr)
+        if (_list.size() == 1 && _list.at(0).GetAttributeId() == NewAttr)
         {
             return S_OK;
         }
@@ -294,7 +421,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
         else if (_list.size() == 2 && newAttrs.at(0).GetLength() == 1)
         {
             auto left = _list.begin();
-            if (iStart == left->GetLength() && NewAttr == left->GetAttributes())
+            if (iStart == left->GetLength() && NewAttr == left->GetAttributeId())
             {
                 auto right = left + 1;
                 left->IncrementLength();
@@ -305,6 +432,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
                 {
                     _list.erase(right);
                 }
+                _UpdateRunEnds();
                 return S_OK;
             }
         }
@@ -315,6 +443,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
     {
         // Just dump what we're given over what we have and call it a day.
         _list.assign(newAttrs.cbegin(), newAttrs.cend());
+        _UpdateRunEnds();
 
         return S_OK;
     }
@@ -327,7 +456,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
     // The original run was 3 long. The insertion run was 1 long. We need 1 more for the
     // fact that an existing piece of the run was split in half (to hold the latter half).
     const size_t cNewRun = _list.size() + newAttrs.size() + 1;
-    std::vector<TextAttributeRun> newRun;
+    std::vector<TextAttributeIdRun> newRun;
     newRun.resize(cNewRun);
 
     // We will start analyzing from the beginning of our existing run.
@@ -392,7 +521,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
         // Now we're still on that "last cell copied" into the new run.
         // If the color of that existing copied cell matches the color of the first segment
         // of the run we're about to insert, we can just increment the length to extend the coverage.
-        if (pNewRunPos->GetAttributes() == pInsertRunPos->GetAttributes())
+        if (pNewRunPos->GetAttributeId() == pInsertRunPos->GetAttributeId())
         {
             length += pInsertRunPos->GetLength();
 
@@ -457,7 +586,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
             // This case is slightly off from the example above. This case is for if the B2 above was actually Y2.
             // That Y2 from the existing run is the same color as the Y2 we just filled a few columns left in the final run
             // so we can just adjust the final run's column count instead of adding another segment here.
-            if (pNewRunPos->GetAttributes() == pExistingRunPos->GetAttributes())
+            if (pNewRunPos->GetAttributeId() == pExistingRunPos->GetAttributeId())
             {
                 size_t length = pNewRunPos->GetLength();
                 length += (iExistingRunCoverage - (iEnd + 1));
@@ -472,7 +601,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
                 pNewRunPos++;
 
                 // Copy the existing run's color information to the new run
-                pNewRunPos->SetAttributes(pExistingRunPos->GetAttributes());
+                pNewRunPos->SetAttributeId(pExistingRunPos->GetAttributeId());
 
                 // Adjust the length of that copied color to cover only the reduced number of columns needed
                 // now that some have been replaced by the insert run.
@@ -494,7 +623,7 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
         // New Run desired when done = R3 -> B7
         // Existing run pointer is on B2.
         // We want to merge the 2 from the B2 into the B5 so we get B7.
-        else if (pNewRunPos->GetAttributes() == pExistingRunPos->GetAttributes())
+        else if (pNewRunPos->GetAttributeId() == pExistingRunPos->GetAttributeId())
         {
             // Add the value from the existing run into the current new run position.
             size_t length = pNewRunPos->GetLength();
@@ -523,10 +652,68 @@ HRESULT ATTR_ROW::InsertAttrRuns(const std::basic_string_view<TextAttributeRun>
 
     newRun.erase(pNewRunPos, newRun.end());
     _list.swap(newRun);
+    _UpdateRunEnds();
 
     return S_OK;
 }
 
+// Routine Description:
+// - Recalculates the end column of every run. Must be called whenever the runs change.
+// - If there isn't enough memory for it, lookups fall back to walking the runs until the next time.
+void ATTR_ROW::_UpdateRunEnds() noexcept
+{
+    try
+    {
+        _runEnds.resize(_list.size());
+    }
+    catch (...)
+    {
+        LOG_CAUGHT_EXCEPTION();
+        _runEnds.clear();
+        return;
+    }
+
+    size_t end = 0;
+    for (size_t i = 0; i < _list.size(); ++i)
+    {
+        end += _list[i].GetLength();
+        _runEnds[i] = gsl::narrow_cast<unsigned int>(end);
+    }
+}
+
+// Routine Description:
+// - Checks whether _runEnds can be used to find runs.
+bool ATTR_ROW::_HasRunEnds() const noexcept
+{
+    return !_runEnds.empty() && _runEnds.size() == _list.size();
+}
+
+// Routine Description:
+// - Gets the first column covered by the given run.
+// Arguments:
+// - runIndex - the index of the run in _list. May be one past the end, for the width of the row.
+// Return Value:
+// - the column the run starts at.
+size_t ATTR_ROW::_GetRunStart(const size_t runIndex) const noexcept
+{
+    if (runIndex == 0)
+    {
+        return 0;
+    }
+
+    if (_HasRunEnds())
+    {
+        return _runEnds[runIndex - 1];
+    }
+
+    size_t start = 0;
+    for (size_t i = 0; i < runIndex; ++i)
+    {
+        start += _list[i].GetLength();
+    }
+    return start;
+}
+
 // Routine Description:
 // - packs a vector of TextAttribute into a vector of TextAttrbuteRun
 // Arguments:
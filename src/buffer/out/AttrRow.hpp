@@ -21,6 +21,7 @@ Revision History:
 #pragma once
 
 #include "TextAttributeRun.hpp"
+#include "TextAttributePalette.hpp"
 #include "AttrRowIterator.hpp"
 
 class ATTR_ROW final
@@ -28,7 +29,7 @@ class ATTR_ROW final
 public:
     using const_iterator = typename AttrRowIterator;
 
-    ATTR_ROW(const UINT cchRowWidth, const TextAttribute attr);
+    ATTR_ROW(const UINT cchRowWidth, const TextAttribute attr, TextAttributePalette& palette);
 
     void Reset(const TextAttribute attr);
 
@@ -42,8 +43,15 @@ public:
                          size_t* const pApplies) const;
 
     bool SetAttrToEnd(const UINT iStart, const TextAttribute attr);
-    void ReplaceLegacyAttrs(const WORD wToBeReplacedAttr, const WORD wReplaceWith) noexcept;
-    void ReplaceAttrs(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith) noexcept;
+    void ReplaceLegacyAttrs(const WORD wToBeReplacedAttr, const WORD wReplaceWith);
+    void ReplaceAttrs(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith);
+
+    void MarkUsedAttributeIds(std::vector<bool>& used) const;
+    void RemapAttributeIds(const std::vector<TextAttributePalette::id_type>& remap) noexcept;
+
+    TextAttributePalette::id_type GetAttrIdByColumn(const size_t column,
+                                                    size_t* const pApplies) const;
+    void SetAttrIdRuns(std::vector<TextAttributeIdRun> runs);
 
     void Resize(const size_t newWidth);
 
@@ -66,8 +74,24 @@ public:
 
 private:
 
-    std::vector<TextAttributeRun> _list;
+    [[nodiscard]]
+    HRESULT _InsertIdRuns(const std::basic_string_view<TextAttributeIdRun> newAttrs,
+                          const size_t iStart,
+                          const size_t iEnd,
+                          const size_t cBufferWidth);
+
+    void _UpdateRunEnds() noexcept;
+    bool _HasRunEnds() const noexcept;
+    size_t _GetRunStart(const size_t runIndex) const noexcept;
+
+    std::vector<TextAttributeIdRun> _list;
+
+    // The column just past the end of each run in _list, so a column's run can be binary searched.
+    // If it couldn't be kept up to date, it's left empty and lookups fall back to walking _list.
+    std::vector<unsigned int> _runEnds;
+
     size_t _cchRowWidth;
+    TextAttributePalette* _palette;
 
 #ifdef UNIT_TESTING
     friend class AttrRowTests;
@@ -84,22 +84,30 @@ AttrRowIterator AttrRowIterator::operator--(int)
 
 const TextAttribute* AttrRowIterator::operator->() const
 {
-    return &_run->GetAttributes();
+    return &_pAttrRow->_palette->Get(_run->GetAttributeId());
 }
 
 const TextAttribute& AttrRowIterator::operator*() const
 {
-    return _run->GetAttributes();
+    return _pAttrRow->_palette->Get(_run->GetAttributeId());
 }
 
 // Routine Description:
 // - increments the index the iterator points to
+// - Moving within the current run or into the next one is O(1), so walking a row one
+//   column at a time is too. Anything further is found with a binary search on the row.
 // Arguments:
 // - count - the amount to increment by
 void AttrRowIterator::_increment(size_t count)
 {
-    while (count > 0)
+    for (auto steps = 0; count > 0; ++steps)
     {
+        if (steps == 2)
+        {
+            _setToColumn(_getColumn() + count);
+            return;
+        }
+
         const size_t runLength = _run->GetLength();
         if (count + _currentAttributeIndex < runLength)
         {
@@ -117,12 +125,19 @@ void AttrRowIterator::_increment(size_t count)
 
 // Routine Description:
 // - decrements the index the iterator points to
+// - Like _increment, only moves past the previous run need a search.
 // Arguments:
 // - count - the amount to decrement by
 void AttrRowIterator::_decrement(size_t count)
 {
-    while (count > 0)
+    for (auto steps = 0; count > 0; ++steps)
     {
+        if (steps == 2)
+        {
+            _setToColumn(_getColumn() - count);
+            return;
+        }
+
         if (count <= _currentAttributeIndex)
         {
             _currentAttributeIndex -= count;
@@ -133,10 +148,36 @@ void AttrRowIterator::_decrement(size_t count)
             count -= _currentAttributeIndex;
             --_run;
             _currentAttributeIndex = _run->GetLength() - 1;
+            count--;
         }
     }
 }
 
+// Routine Description:
+// - gets the column of the row the iterator points to
+size_t AttrRowIterator::_getColumn() const noexcept
+{
+    const size_t runIndex = _run - _pAttrRow->_list.cbegin();
+    return _pAttrRow->_GetRunStart(runIndex) + _currentAttributeIndex;
+}
+
+// Routine Description:
+// - points the iterator at the given column of the row
+// Arguments:
+// - column - the column to move to. The width of the row moves to the end() state.
+void AttrRowIterator::_setToColumn(const size_t column)
+{
+    if (column >= _pAttrRow->_cchRowWidth)
+    {
+        _setToEnd();
+        return;
+    }
+
+    size_t applies = 0;
+    _run = _pAttrRow->_list.cbegin() + _pAttrRow->FindAttrIndex(column, &applies);
+    _currentAttributeIndex = _run->GetLength() - applies;
+}
+
 // Routine Description:
 // - sets fields on the iterator to describe the end() state of the ATTR_ROW
 void AttrRowIterator::_setToEnd()
@@ -8,6 +8,8 @@ Module Name:
 Abstract:
 - iterator for ATTR_ROW to walk the TextAttributes of the run
 - read only iterator
+- keeps its place in the runs, so it doubles as a cursor for reading a row's
+    attributes column by column without searching for each one
 
 Author(s):
 - Austin Diviness (AustDi) 04-Jun-2018
@@ -17,7 +19,7 @@ Author(s):
 #pragma once
 
 #include "TextAttribute.hpp"
-#include "TextAttributeRun.hpp"
+#include "TextAttributePalette.hpp"
 
 class ATTR_ROW;
 
@@ -52,11 +54,13 @@ public:
     const TextAttribute& operator*() const;
 
 private:
-    std::vector<TextAttributeRun>::const_iterator _run;
+    std::vector<TextAttributeIdRun>::const_iterator _run;
     const ATTR_ROW* _pAttrRow;
-    size_t _currentAttributeIndex; // index of TextAttribute within the current TextAttributeRun
+    size_t _currentAttributeIndex; // index of TextAttribute within the current run
     
     void _increment(size_t count);
     void _decrement(size_t count);
     void _setToEnd();
+    size_t _getColumn() const noexcept;
+    void _setToColumn(const size_t column);
 };
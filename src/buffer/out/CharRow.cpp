@@ -5,21 +5,89 @@
 
 #include "CharRow.hpp"
 #include "unicode.hpp"
-#include "Row.hpp"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// Routine Description:
+// - Finds the first character in a range that isn't a space.
+// Arguments:
+// - pwch - the characters to scan
+// - cch - how many characters to scan
+// Return Value:
+// - the index of the first non-space character, or cch if they're all spaces.
+static size_t s_FindFirstNonSpace(const wchar_t* const pwch, const size_t cch) noexcept
+{
+    size_t i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i spaces = _mm_set1_epi16(UNICODE_SPACE);
+    for (; i + 8 <= cch; i += 8)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pwch + i));
+        const int spaceMask = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, spaces));
+        if (spaceMask != 0xFFFF)
+        {
+            unsigned long bit;
+            _BitScanForward(&bit, ~spaceMask & 0xFFFF);
+            return i + bit / 2;
+        }
+    }
+#endif
+    while (i < cch && pwch[i] == UNICODE_SPACE)
+    {
+        ++i;
+    }
+    return i;
+}
+
+// Routine Description:
+// - Finds the end of the last character in a range that isn't a space.
+// Arguments:
+// - pwch - the characters to scan
+// - cch - how many characters to scan
+// Return Value:
+// - one past the index of the last non-space character, or 0 if they're all spaces.
+static size_t s_FindEndOfLastNonSpace(const wchar_t* const pwch, const size_t cch) noexcept
+{
+    size_t i = cch;
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i spaces = _mm_set1_epi16(UNICODE_SPACE);
+    for (; i >= 8; i -= 8)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pwch + i - 8));
+        const int spaceMask = _mm_movemask_epi8(_mm_cmpeq_epi16(chunk, spaces));
+        if (spaceMask != 0xFFFF)
+        {
+            unsigned long bit;
+            _BitScanReverse(&bit, ~spaceMask & 0xFFFF);
+            return i - 8 + bit / 2 + 1;
+        }
+    }
+#endif
+    while (i > 0 && pwch[i - 1] == UNICODE_SPACE)
+    {
+        --i;
+    }
+    return i;
+}
 
 // Routine Description:
 // - constructor
 // Arguments:
+// - chars - the storage for the characters of the row, rowWidth long. Owned by the text buffer.
+// - attrs - the storage for the dbcs attributes of the row, rowWidth long. Owned by the text buffer.
 // - rowWidth - the size (in wchar_t) of the char and attribute rows
-// - pParent - the parent ROW
 // Return Value:
 // - instantiated object
-// Note: will through if unable to allocate char/attribute buffers
-CharRow::CharRow(size_t rowWidth, ROW* const pParent) :
+// Note: the storage is used as it is. The text buffer hands out storage that's already cleared.
+CharRow::CharRow(wchar_t* const chars, DbcsAttribute* const attrs, size_t rowWidth) noexcept :
     _wrapForced{ false },
     _doubleBytePadded{ false },
-    _data(rowWidth, value_type()),
-    _pParent{ FAIL_FAST_IF_NULL(pParent) }
+    _chars{ chars },
+    _attrs{ attrs },
+    _size{ rowWidth },
+    _glyphs{}
 {
 }
 
@@ -75,7 +143,7 @@ bool CharRow::WasDoubleBytePadded() const noexcept
 // - the size of the row
 size_t CharRow::size() const noexcept
 {
-    return _data.size();
+    return _size;
 }
 
 // Routine Description:
@@ -86,52 +154,35 @@ size_t CharRow::size() const noexcept
 // - <none>
 void CharRow::Reset()
 {
-    for (auto& cell : _data)
-    {
-        cell.Reset();
-    }
+    std::fill_n(_chars, _size, UNICODE_SPACE);
+    std::fill_n(_attrs, _size, DbcsAttribute{});
+    _glyphs.Clear();
 
     _wrapForced = false;
     _doubleBytePadded = false;
 }
 
 // Routine Description:
-// - resizes the width of the CharRowBase
+// - resizes the width of the CharRowBase by moving it into new storage. As much of
+// the row as fits is copied over, and any new cells on the right are cleared.
 // Arguments:
+// - chars - the new storage for the characters of the row, newSize long
+// - attrs - the new storage for the dbcs attributes of the row, newSize long
 // - newSize - the new width of the character and attributes rows
 // Return Value:
-// - S_OK on success, otherwise relevant error code
-[[nodiscard]]
-HRESULT CharRow::Resize(const size_t newSize) noexcept
-{
-    try
-    {
-        const value_type insertVals;
-        _data.resize(newSize, insertVals);
-    }
-    CATCH_RETURN();
-
-    return S_OK;
-}
-
-typename CharRow::iterator CharRow::begin() noexcept
-{
-    return _data.begin();
-}
-
-typename CharRow::const_iterator CharRow::cbegin() const noexcept
-{
-    return _data.cbegin();
-}
-
-typename CharRow::iterator CharRow::end() noexcept
-{
-    return _data.end();
-}
-
-typename CharRow::const_iterator CharRow::cend() const noexcept
+// - <none>
+void CharRow::Resize(wchar_t* const chars, DbcsAttribute* const attrs, const size_t newSize) noexcept
 {
-    return _data.cend();
+    const size_t keep = std::min(_size, newSize);
+    std::copy_n(_chars, keep, chars);
+    std::copy_n(_attrs, keep, attrs);
+    std::fill_n(chars + keep, newSize - keep, UNICODE_SPACE);
+    std::fill_n(attrs + keep, newSize - keep, DbcsAttribute{});
+
+    _chars = chars;
+    _attrs = attrs;
+    _size = newSize;
+    _glyphs.Truncate(newSize);
 }
 
 // Routine Description:
@@ -142,12 +193,7 @@ typename CharRow::const_iterator CharRow::cend() const noexcept
 // - The calculated left boundary of the internal string.
 size_t CharRow::MeasureLeft() const
 {
-    std::vector<value_type>::const_iterator it = _data.cbegin();
-    while (it != _data.cend() && it->IsSpace())
-    {
-        ++it;
-    }
-    return it - _data.cbegin();
+    return s_FindFirstNonSpace(_chars, _size);
 }
 
 // Routine Description:
@@ -158,17 +204,15 @@ size_t CharRow::MeasureLeft() const
 // - The calculated right boundary of the internal string.
 size_t CharRow::MeasureRight() const noexcept
 {
-    std::vector<value_type>::const_reverse_iterator it = _data.crbegin();
-    while (it != _data.crend() && it->IsSpace())
-    {
-        ++it;
-    }
-    return _data.crend() - it;
+    return s_FindEndOfLastNonSpace(_chars, _size);
 }
 
 void CharRow::ClearCell(const size_t column)
 {
-    _data.at(column).Reset();
+    THROW_HR_IF(E_INVALIDARG, column >= _size);
+    _chars[column] = UNICODE_SPACE;
+    _attrs[column].Reset();
+    _glyphs.Erase(column);
 }
 
 // Routine Description:
@@ -179,14 +223,7 @@ void CharRow::ClearCell(const size_t column)
 // - True if there is valid text in this row. False otherwise.
 bool CharRow::ContainsText() const noexcept
 {
-    for (const value_type& cell : _data)
-    {
-        if (!cell.IsSpace())
-        {
-            return true;
-        }
-    }
-    return false;
+    return s_FindFirstNonSpace(_chars, _size) != _size;
 }
 
 // Routine Description:
@@ -198,7 +235,8 @@ bool CharRow::ContainsText() const noexcept
 // Note: will throw exception if column is out of bounds
 const DbcsAttribute& CharRow::DbcsAttrAt(const size_t column) const
 {
-    return _data.at(column).DbcsAttr();
+    THROW_HR_IF(E_INVALIDARG, column >= _size);
+    return _attrs[column];
 }
 
 // Routine Description:
@@ -222,7 +260,10 @@ DbcsAttribute& CharRow::DbcsAttrAt(const size_t column)
 // Note: will throw exception if column is out of bounds
 void CharRow::ClearGlyph(const size_t column)
 {
-    _data.at(column).EraseChars();
+    THROW_HR_IF(E_INVALIDARG, column >= _size);
+    _attrs[column].SetGlyphStored(false);
+    _chars[column] = UNICODE_SPACE;
+    _glyphs.Erase(column);
 }
 
 // Routine Description:
@@ -234,7 +275,7 @@ void CharRow::ClearGlyph(const size_t column)
 // - Note: will throw exception if column is out of bounds
 const CharRow::reference CharRow::GlyphAt(const size_t column) const
 {
-    THROW_HR_IF(E_INVALIDARG, column >= _data.size());
+    THROW_HR_IF(E_INVALIDARG, column >= _size);
     return { const_cast<CharRow&>(*this), column };
 }
 
@@ -247,7 +288,7 @@ const CharRow::reference CharRow::GlyphAt(const size_t column) const
 // - Note: will throw exception if column is out of bounds
 CharRow::reference CharRow::GlyphAt(const size_t column)
 {
-    THROW_HR_IF(E_INVALIDARG, column >= _data.size());
+    THROW_HR_IF(E_INVALIDARG, column >= _size);
     return { *this, column };
 }
 
@@ -261,64 +302,64 @@ CharRow::reference CharRow::GlyphAt(const size_t column)
 // - Note: will throw exception if out of memory
 std::wstring CharRow::GetTextRaw() const
 {
-    std::wstring wstr;
-    wstr.reserve(_data.size());
-    for (size_t i = 0;  i < _data.size(); ++i)
-    {
-        auto glyph = GlyphAt(i);
-        for (auto it = glyph.begin(); it != glyph.end(); ++it)
-        {
-            wstr.push_back(*it);
-        }
-    }
-    return wstr;
+    return _GetText(false);
 }
 
+// Routine Description:
+// - returns string containing the text of the row, with each double byte
+// character appearing once.
+// Arguments:
+// - none
+// Return Value:
+// - text stored in char row
+// - Note: will throw exception if out of memory
 std::wstring CharRow::GetText() const
+{
+    return _GetText(true);
+}
+
+// Routine Description:
+// - copies the text out of the row. Runs of cells that just hold their character
+// are copied in one go; only cells with a stored glyph (and trailing cells, if
+// they're being skipped) need looking at individually.
+// Arguments:
+// - skipTrailing - true to leave out the trailing half of double byte characters
+// Return Value:
+// - text stored in char row
+// - Note: will throw exception if out of memory
+std::wstring CharRow::_GetText(const bool skipTrailing) const
 {
     std::wstring wstr;
-    wstr.reserve(_data.size());
+    wstr.reserve(_size);
 
-    for (size_t i = 0;  i < _data.size(); ++i)
+    size_t runStart = 0;
+    for (size_t i = 0; i < _size; ++i)
     {
-        auto glyph = GlyphAt(i);
-        if (!DbcsAttrAt(i).IsTrailing())
+        const auto attr = _attrs[i];
+        const bool skip = skipTrailing && attr.IsTrailing();
+        if (skip || attr.IsGlyphStored())
         {
-            for (auto it = glyph.begin(); it != glyph.end(); ++it)
+            wstr.append(_chars + runStart, i - runStart);
+            runStart = i + 1;
+
+            if (!skip)
             {
-                wstr.push_back(*it);
+                const std::wstring_view glyph = GlyphAt(i);
+                wstr.append(glyph.data(), glyph.size());
             }
         }
     }
-    return wstr;
-}
+    wstr.append(_chars + runStart, _size - runStart);
 
-UnicodeStorage& CharRow::GetUnicodeStorage()
-{
-    return _pParent->GetUnicodeStorage();
-}
-
-const UnicodeStorage& CharRow::GetUnicodeStorage() const
-{
-    return _pParent->GetUnicodeStorage();
+    return wstr;
 }
 
-// Routine Description:
-// - calculates the key used by the given column of the char row to store glyph data in UnicodeStorage
-// Arguments:
-// - column - the column to generate the key for
-// Return Value:
-// - the COORD key for data access from UnicodeStorage for the column
-COORD CharRow::GetStorageKey(const size_t column) const
+UnicodeStorage& CharRow::GetUnicodeStorage() noexcept
 {
-    return { gsl::narrow<SHORT>(column), _pParent->GetId() };
+    return _glyphs;
 }
 
-// Routine Description:
-// - Updates the pointer to the parent row (which might change if we shuffle the rows around)
-// Arguments:
-// - pParent - Pointer to the parent row
-void CharRow::UpdateParent(ROW* const pParent) noexcept
+const UnicodeStorage& CharRow::GetUnicodeStorage() const noexcept
 {
-    _pParent = FAIL_FAST_IF_NULL(pParent);
+    return _glyphs;
 }
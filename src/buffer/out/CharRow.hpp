@@ -22,11 +22,8 @@ Revision History:
 
 #include "DbcsAttribute.hpp"
 #include "CharRowCellReference.hpp"
-#include "CharRowCell.hpp"
 #include "UnicodeStorage.hpp"
 
-class ROW;
-
 // the characters of one row of screen buffer
 // we keep the following values so that we don't write
 // more pixels to the screen than we have to:
@@ -37,16 +34,24 @@ class ROW;
 //       ^    ^                  ^                     ^
 //       |    |                  |                     |
 //     Chars Left               Right                end of Chars buffer
+//
+// the glyphs and their dbcs attributes are kept in two separate arrays, so that
+// measuring, clearing and copying a row works on one contiguous block of memory.
+// the arrays aren't owned by the row: they're slices of the cell storage of the
+// whole text buffer, which hands them out when it creates or resizes its rows.
 class CharRow final
 {
 public:
     using glyph_type = typename wchar_t;
-    using value_type = typename CharRowCell;
-    using iterator = typename std::vector<value_type>::iterator;
-    using const_iterator = typename std::vector<value_type>::const_iterator;
     using reference = typename CharRowCellReference;
 
-    CharRow(size_t rowWidth, ROW* const pParent);
+    CharRow(wchar_t* const chars, DbcsAttribute* const attrs, size_t rowWidth) noexcept;
+
+    // a copy would share the original's storage. moving is fine, the storage moves with it.
+    CharRow(const CharRow&) = delete;
+    CharRow& operator=(const CharRow&) = delete;
+    CharRow(CharRow&&) = default;
+    CharRow& operator=(CharRow&&) = default;
 
     void SetWrapForced(const bool wrap) noexcept;
     bool WasWrapForced() const noexcept;
@@ -54,8 +59,7 @@ public:
     bool WasDoubleBytePadded() const noexcept;
     size_t size() const noexcept;
     void Reset();
-    [[nodiscard]]
-    HRESULT Resize(const size_t newSize) noexcept;
+    void Resize(wchar_t* const chars, DbcsAttribute* const attrs, const size_t newSize) noexcept;
     size_t MeasureLeft() const;
     size_t MeasureRight() const noexcept;
     void ClearCell(const size_t column);
@@ -72,52 +76,68 @@ public:
     const reference GlyphAt(const size_t column) const;
     reference GlyphAt(const size_t column);
 
-    // iterators
-    iterator begin() noexcept;
-    const_iterator cbegin() const noexcept;
-
-    iterator end() noexcept;
-    const_iterator cend() const noexcept;
-
-    UnicodeStorage& GetUnicodeStorage();
-    const UnicodeStorage& GetUnicodeStorage() const;
-    COORD GetStorageKey(const size_t column) const;
+    template<typename InputIt1, typename InputIt2>
+    void OverwriteColumns(InputIt1 startChars, InputIt1 endChars, InputIt2 startAttrs, const size_t column);
 
-    void UpdateParent(ROW* const pParent) noexcept;
+    UnicodeStorage& GetUnicodeStorage() noexcept;
+    const UnicodeStorage& GetUnicodeStorage() const noexcept;
 
     friend CharRowCellReference;
-    friend constexpr bool operator==(const CharRow& a, const CharRow& b) noexcept;
+    friend bool operator==(const CharRow& a, const CharRow& b) noexcept;
 
 protected:
+    // Cells whose glyph is kept in _glyphs hold this (U+FFFD) in _chars instead, so
+    // that a space in _chars always means the cell is empty. That's what lets the row be
+    // measured by scanning _chars alone.
+    static constexpr wchar_t s_glyphStoredMarker = 0xFFFD;
+
+    std::wstring _GetText(const bool skipTrailing) const;
+
     // Occurs when the user runs out of text in a given row and we're forced to wrap the cursor to the next line
     bool _wrapForced;
 
     // Occurs when the user runs out of text to support a double byte character and we're forced to the next line
     bool _doubleBytePadded;
 
-    // storage for glyph data and dbcs attributes
-    std::vector<value_type> _data;
+    // storage for glyph data, one wchar_t per cell. cells with a glyph in _glyphs hold a placeholder.
+    wchar_t* _chars;
+
+    // storage for dbcs attributes, one per cell
+    DbcsAttribute* _attrs;
 
-    // ROW that this CharRow belongs to
-    ROW* _pParent;
+    // number of cells in the row
+    size_t _size;
+
+    // the glyphs that don't fit in a single wchar_t, by column. unlike _chars, these are owned by the row.
+    UnicodeStorage _glyphs;
 };
 
-constexpr bool operator==(const CharRow& a, const CharRow& b) noexcept
+inline bool operator==(const CharRow& a, const CharRow& b) noexcept
 {
     return (a._wrapForced == b._wrapForced &&
             a._doubleBytePadded == b._doubleBytePadded &&
-            a._data == b._data);
+            a._size == b._size &&
+            std::equal(a._chars, a._chars + a._size, b._chars) &&
+            std::equal(a._attrs, a._attrs + a._size, b._attrs));
 }
 
+// Routine Description:
+// - copies characters and their dbcs attributes straight into the row, starting at the given column.
+// the characters are copied as they are; nothing is stored in UnicodeStorage.
+// Arguments:
+// - startChars - the start of the characters to copy
+// - endChars - the end of the characters to copy
+// - startAttrs - the start of the dbcs attributes to copy, one per character
+// - column - the column to start copying to
+// Return Value:
+// - <none>
+// Note: will throw exception if the characters don't fit in the row
 template<typename InputIt1, typename InputIt2>
-void OverwriteColumns(InputIt1 startChars, InputIt1 endChars, InputIt2 startAttrs, CharRow::iterator outIt)
+void CharRow::OverwriteColumns(InputIt1 startChars, InputIt1 endChars, InputIt2 startAttrs, const size_t column)
 {
-    std::transform(startChars,
-                   endChars,
-                   startAttrs,
-                   outIt,
-                   [](const wchar_t wch, const DbcsAttribute attr)
-    {
-        return CharRow::value_type{ wch, attr };
-    });
+    const size_t count = std::distance(startChars, endChars);
+    THROW_HR_IF(E_INVALIDARG, column > _size || count > _size - column);
+
+    std::copy(startChars, endChars, _chars + column);
+    std::copy_n(startAttrs, count, _attrs + column);
 }
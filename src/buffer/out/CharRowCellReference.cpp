@@ -15,15 +15,15 @@ void CharRowCellReference::operator=(const std::wstring_view chars)
     THROW_HR_IF(E_INVALIDARG, chars.empty());
     if (chars.size() == 1)
     {
-        _cellData().Char() = chars.front();
-        _cellData().DbcsAttr().SetGlyphStored(false);
+        _charData() = chars.front();
+        _dbcsAttr().SetGlyphStored(false);
+        _parent.GetUnicodeStorage().Erase(_index);
     }
     else
     {
-        auto& storage = _parent.GetUnicodeStorage();
-        const auto key = _parent.GetStorageKey(_index);
-        storage.StoreGlyph(key, { chars.cbegin(), chars.cend() });
-        _cellData().DbcsAttr().SetGlyphStored(true);
+        _parent.GetUnicodeStorage().StoreGlyph(_index, chars);
+        _charData() = CharRow::s_glyphStoredMarker;
+        _dbcsAttr().SetGlyphStored(true);
     }
 }
 
@@ -37,21 +37,39 @@ CharRowCellReference::operator std::wstring_view() const
 }
 
 // Routine Description:
-// - The CharRowCell this object "references"
+// - The character this object "references"
 // Return Value:
-// - ref to the CharRowCell
-CharRowCell& CharRowCellReference::_cellData()
+// - ref to the character in the parent CharRow
+wchar_t& CharRowCellReference::_charData()
 {
-    return _parent._data.at(_index);
+    return _parent._chars[_index];
 }
 
 // Routine Description:
-// - The CharRowCell this object "references"
+// - The character this object "references"
 // Return Value:
-// - ref to the CharRowCell
-const CharRowCell& CharRowCellReference::_cellData() const
+// - ref to the character in the parent CharRow
+const wchar_t& CharRowCellReference::_charData() const
 {
-    return _parent._data.at(_index);
+    return _parent._chars[_index];
+}
+
+// Routine Description:
+// - The DbcsAttribute of the cell this object "references"
+// Return Value:
+// - ref to the DbcsAttribute in the parent CharRow
+DbcsAttribute& CharRowCellReference::_dbcsAttr()
+{
+    return _parent._attrs[_index];
+}
+
+// Routine Description:
+// - The DbcsAttribute of the cell this object "references"
+// Return Value:
+// - ref to the DbcsAttribute in the parent CharRow
+const DbcsAttribute& CharRowCellReference::_dbcsAttr() const
+{
+    return _parent._attrs[_index];
 }
 
 // Routine Description:
@@ -60,15 +78,13 @@ const CharRowCell& CharRowCellReference::_cellData() const
 // - the glyph data
 std::wstring_view CharRowCellReference::_glyphData() const
 {
-    if (_cellData().DbcsAttr().IsGlyphStored())
+    if (_dbcsAttr().IsGlyphStored())
     {
-        const auto& text = _parent.GetUnicodeStorage().GetText(_parent.GetStorageKey(_index));
-
-        return { text.data(), text.size() };
+        return _parent.GetUnicodeStorage().GetText(_index);
     }
     else
     {
-        return { &_cellData().Char(), 1 };
+        return { &_charData(), 1 };
     }
 }
 
@@ -78,13 +94,13 @@ std::wstring_view CharRowCellReference::_glyphData() const
 // - iterator of the glyph data
 CharRowCellReference::const_iterator CharRowCellReference::begin() const
 {
-    if (_cellData().DbcsAttr().IsGlyphStored())
+    if (_dbcsAttr().IsGlyphStored())
     {
-        return _parent.GetUnicodeStorage().GetText(_parent.GetStorageKey(_index)).data();
+        return _parent.GetUnicodeStorage().GetText(_index).data();
     }
     else
     {
-        return &_cellData().Char();
+        return &_charData();
     }
 }
 
@@ -94,21 +110,20 @@ CharRowCellReference::const_iterator CharRowCellReference::begin() const
 // - end iterator of the glyph data
 CharRowCellReference::const_iterator CharRowCellReference::end() const
 {
-    if (_cellData().DbcsAttr().IsGlyphStored())
+    if (_dbcsAttr().IsGlyphStored())
     {
-
-        const auto& chars = _parent.GetUnicodeStorage().GetText(_parent.GetStorageKey(_index));
+        const auto chars = _parent.GetUnicodeStorage().GetText(_index);
         return chars.data() + chars.size();
     }
     else
     {
-        return &_cellData().Char() + 1;
+        return &_charData() + 1;
     }
 }
 
 bool operator==(const CharRowCellReference& ref, const std::vector<wchar_t>& glyph)
 {
-    const DbcsAttribute& dbcsAttr = ref._cellData().DbcsAttr();
+    const DbcsAttribute& dbcsAttr = ref._dbcsAttr();
     if (glyph.size() == 1 && dbcsAttr.IsGlyphStored())
     {
         return false;
@@ -119,12 +134,12 @@ bool operator==(const CharRowCellReference& ref, const std::vector<wchar_t>& gly
     }
     else if (glyph.size() == 1 && !dbcsAttr.IsGlyphStored())
     {
-        return ref._cellData().Char() == glyph.front();
+        return ref._charData() == glyph.front();
     }
     else
     {
-        const auto& chars = ref._parent.GetUnicodeStorage().GetText(ref._parent.GetStorageKey(ref._index));
-        return chars == glyph;
+        const auto chars = ref._parent.GetUnicodeStorage().GetText(ref._index);
+        return std::equal(chars.cbegin(), chars.cend(), glyph.cbegin(), glyph.cend());
     }
 }
 
@@ -15,7 +15,6 @@ Author(s):
 #pragma once
 
 #include "DbcsAttribute.hpp"
-#include "CharRowCell.hpp"
 #include <utility>
 
 class CharRow;
@@ -55,8 +54,11 @@ private:
     // the index of the cell in the parent char row
     const size_t _index;
 
-    CharRowCell& _cellData();
-    const CharRowCell& _cellData() const;
+    wchar_t& _charData();
+    const wchar_t& _charData() const;
+
+    DbcsAttribute& _dbcsAttr();
+    const DbcsAttribute& _dbcsAttr() const;
 
     std::wstring_view _glyphData() const;
 };
@@ -11,16 +11,23 @@
 // - constructor
 // Arguments:
 // - rowId - the row index in the text buffer
+// - chars - the text buffer's storage for the characters of this row
+// - dbcsAttrs - the text buffer's storage for the dbcs attributes of this row
 // - rowWidth - the width of the row, cell elements
 // - fillAttribute - the default text attribute
 // - pParent - the text buffer that this row belongs to
 // Return Value:
 // - constructed object
-ROW::ROW(const SHORT rowId, const short rowWidth, const TextAttribute fillAttribute, TextBuffer* const pParent) :
+ROW::ROW(const SHORT rowId,
+         wchar_t* const chars,
+         DbcsAttribute* const dbcsAttrs,
+         const short rowWidth,
+         const TextAttribute fillAttribute,
+         TextBuffer* const pParent) :
     _id{ rowId },
     _rowWidth{ gsl::narrow<size_t>(rowWidth) },
-    _charRow{ gsl::narrow<size_t>(rowWidth), this },
-    _attrRow{ gsl::narrow<UINT>(rowWidth), fillAttribute },
+    _charRow{ chars, dbcsAttrs, gsl::narrow<size_t>(rowWidth) },
+    _attrRow{ gsl::narrow<UINT>(rowWidth), fillAttribute, pParent->GetAttributePalette() },
     _pParent{ pParent }
 {
 }
@@ -82,24 +89,19 @@ bool ROW::Reset(const TextAttribute Attr)
 }
 
 // Routine Description:
-// - resizes ROW to new width
+// - resizes ROW to new width by moving its characters into new storage of that width
+// - the attribute row has to be resized separately, beforehand. That's the part that
+//   can fail, and the text buffer does it for every row before moving any of them.
 // Arguments:
+// - chars - the text buffer's new storage for the characters of this row
+// - dbcsAttrs - the text buffer's new storage for the dbcs attributes of this row
 // - width - the new width, in cells
 // Return Value:
-// - S_OK if successful, otherwise relevant error
-[[nodiscard]]
-HRESULT ROW::Resize(const size_t width)
+// - <none>
+void ROW::Resize(wchar_t* const chars, DbcsAttribute* const dbcsAttrs, const size_t width) noexcept
 {
-    RETURN_IF_FAILED(_charRow.Resize(width));
-    try
-    {
-        _attrRow.Resize(width);
-    }
-    CATCH_RETURN();
-
+    _charRow.Resize(chars, dbcsAttrs, width);
     _rowWidth = width;
-
-    return S_OK;
 }
 
 // Routine Description:
@@ -133,14 +135,14 @@ RowCellIterator ROW::AsCellIter(const size_t startIndex, const size_t count) con
     return RowCellIterator(*this, startIndex, count);
 }
 
-UnicodeStorage& ROW::GetUnicodeStorage()
+UnicodeStorage& ROW::GetUnicodeStorage() noexcept
 {
-    return _pParent->GetUnicodeStorage();
+    return _charRow.GetUnicodeStorage();
 }
 
-const UnicodeStorage& ROW::GetUnicodeStorage() const
+const UnicodeStorage& ROW::GetUnicodeStorage() const noexcept
 {
-    return _pParent->GetUnicodeStorage();
+    return _charRow.GetUnicodeStorage();
 }
 
 // Routine Description:
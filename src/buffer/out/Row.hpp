@@ -32,7 +32,12 @@ class TextBuffer;
 class ROW final
 {
 public:
-    ROW(const SHORT rowId, const short rowWidth, const TextAttribute fillAttribute, TextBuffer* const pParent);
+    ROW(const SHORT rowId,
+        wchar_t* const chars,
+        DbcsAttribute* const dbcsAttrs,
+        const short rowWidth,
+        const TextAttribute fillAttribute,
+        TextBuffer* const pParent);
 
     size_t size() const noexcept;
 
@@ -46,8 +51,7 @@ public:
     void SetId(const SHORT id) noexcept;
 
     bool Reset(const TextAttribute Attr);
-    [[nodiscard]]
-    HRESULT Resize(const size_t width);
+    void Resize(wchar_t* const chars, DbcsAttribute* const dbcsAttrs, const size_t width) noexcept;
 
     void ClearColumn(const size_t column);
     std::wstring GetText() const;
@@ -55,8 +59,8 @@ public:
     RowCellIterator AsCellIter(const size_t startIndex) const;
     RowCellIterator AsCellIter(const size_t startIndex, const size_t count) const;
 
-    UnicodeStorage& GetUnicodeStorage();
-    const UnicodeStorage& GetUnicodeStorage() const;
+    UnicodeStorage& GetUnicodeStorage() noexcept;
+    const UnicodeStorage& GetUnicodeStorage() const noexcept;
 
     OutputCellIterator WriteCells(OutputCellIterator it, const size_t index, const bool setWrap, std::optional<size_t> limitRight = std::nullopt);
 
@@ -161,6 +161,8 @@ private:
     TextColor _background;
     bool _isBold;
 
+    friend struct std::hash<TextAttribute>;
+
 #ifdef UNIT_TESTING
     friend class TextBufferTests;
     friend class TextAttributeTests;
@@ -208,6 +210,30 @@ constexpr bool operator!=(const WORD& legacyAttr, const TextAttribute& attr) noe
     return !(attr == legacyAttr);
 }
 
+// std::unordered_map needs help to know how to hash a TextAttribute
+namespace std
+{
+    template <>
+    struct hash<TextAttribute>
+    {
+        // Routine Description:
+        // - hashes an attribute from its legacy flags, boldness and both colors
+        // Arguments:
+        // - attr - the attribute to hash
+        // Return Value:
+        // - the hashed attribute
+        size_t operator()(const TextAttribute& attr) const noexcept
+        {
+            const std::hash<TextColor> colorHash;
+            size_t hash = colorHash(attr._foreground);
+            hash = hash * 31 + colorHash(attr._background);
+            hash = hash * 31 + attr._wAttrLegacy;
+            hash = hash * 31 + (attr._isBold ? 1 : 0);
+            return hash;
+        }
+    };
+}
+
 #ifdef UNIT_TESTING
 
 #define LOG_ATTR(attr) (Log::Comment(NoThrowString().Format(\
@@ -0,0 +1,194 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "TextAttributePalette.hpp"
+
+// Routine Description:
+// - constructor. The palette starts out with just the default attribute in it.
+TextAttributePalette::TextAttributePalette() :
+    _entries{},
+    _ids{},
+    _aliases{},
+    _lastId{ 0 },
+    _compactAt{ s_minCompactAt }
+{
+    Intern(TextAttribute{});
+}
+
+// Routine Description:
+// - Finds the id of the given attribute, adding it to the palette if it isn't in there yet.
+// Arguments:
+// - attr - the attribute to look up
+// Return Value:
+// - the id of the attribute
+// Note:
+// - will throw exception if unable to allocate memory for a new entry
+TextAttributePalette::id_type TextAttributePalette::Intern(const TextAttribute& attr)
+{
+    if (_entries[_lastId] == attr)
+    {
+        return _lastId;
+    }
+
+    const auto found = _ids.find(attr);
+    if (found != _ids.end())
+    {
+        _lastId = found->second;
+        return _lastId;
+    }
+
+    const auto id = gsl::narrow<id_type>(_entries.size());
+    _entries.push_back(attr);
+    try
+    {
+        _ids.emplace(attr, id);
+    }
+    catch (...)
+    {
+        _entries.pop_back();
+        throw;
+    }
+
+    _lastId = id;
+    return id;
+}
+
+// Routine Description:
+// - Gets the attribute that an id stands for.
+// Arguments:
+// - id - an id handed out by Intern
+// Return Value:
+// - the attribute. The reference stays valid until the palette is compacted.
+const TextAttribute& TextAttributePalette::Get(const id_type id) const noexcept
+{
+    return _entries[id];
+}
+
+// Routine Description:
+// - Replaces an attribute with another one, for every run that uses it.
+// - This only changes the entry for the attribute, no matter how many rows refer to it.
+//   If replaceWith was already in the palette, the two ids both stand for it
+//   afterwards. Runs using them just won't be merged together until they're rewritten.
+// Arguments:
+// - toBeReplacedAttr - the attribute to replace.
+// - replaceWith - the new value for it.
+// Return Value:
+// - true if the attribute was in the palette and was replaced.
+// Note:
+// - will throw exception if unable to allocate memory. The palette is left unchanged if so.
+bool TextAttributePalette::Replace(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith)
+{
+    const auto found = _ids.find(toBeReplacedAttr);
+    if (found == _ids.end() || toBeReplacedAttr == replaceWith)
+    {
+        return false;
+    }
+
+    const auto id = found->second;
+    const auto existing = _ids.find(replaceWith);
+    const bool merging = existing != _ids.end();
+
+    // Get everything that can fail out of the way first, so a failure leaves the palette as it was.
+    if (merging)
+    {
+        // The entry (and any aliases of it) become aliases of the existing one.
+        auto& into = _aliases[existing->second];
+        const auto aliases = _aliases.find(id);
+        into.reserve(into.size() + 1 + (aliases == _aliases.end() ? 0 : aliases->second.size()));
+        into.push_back(id);
+        if (aliases != _aliases.end())
+        {
+            into.insert(into.end(), aliases->second.cbegin(), aliases->second.cend());
+        }
+    }
+    else
+    {
+        _ids.emplace(replaceWith, id);
+    }
+
+    // Drop the old key before touching the entries, in case it refers to one of them.
+    _ids.erase(toBeReplacedAttr);
+
+    _entries[id] = replaceWith;
+    const auto aliases = _aliases.find(id);
+    if (aliases != _aliases.end())
+    {
+        for (const auto alias : aliases->second)
+        {
+            _entries[alias] = replaceWith;
+        }
+
+        if (merging)
+        {
+            _aliases.erase(aliases);
+        }
+    }
+
+    return true;
+}
+
+// Routine Description:
+// - Gets the number of entries in the palette, including ones that are no longer used.
+size_t TextAttributePalette::Size() const noexcept
+{
+    return _entries.size();
+}
+
+// Routine Description:
+// - Checks whether the palette has grown enough since it was last compacted
+//   that it's worth dropping the entries nobody uses anymore.
+bool TextAttributePalette::NeedsCompaction() const noexcept
+{
+    return _entries.size() >= _compactAt;
+}
+
+// Routine Description:
+// - Drops every entry that isn't marked as used, and renumbers the rest.
+// - The caller is responsible for renumbering every run that refers to this palette
+//   with the returned table. Any references from Get are invalidated.
+// Arguments:
+// - used - one flag for each id, set if some run still refers to it.
+// Return Value:
+// - a table from each old id to its new one. Unused ids map to the default attribute.
+// Note:
+// - will throw exception if unable to allocate memory. The palette is left unchanged if so.
+std::vector<TextAttributePalette::id_type> TextAttributePalette::Compact(const std::vector<bool>& used)
+{
+    std::vector<id_type> remap(_entries.size(), 0);
+
+    // Interning every used entry again also folds any aliases back together.
+    std::deque<TextAttribute> entries;
+    std::unordered_map<TextAttribute, id_type> ids;
+
+    // Keep the default attribute as the first entry, so that it stays the cheapest one to find.
+    entries.push_back(TextAttribute{});
+    ids.emplace(TextAttribute{}, 0);
+
+    for (size_t oldId = 0; oldId < _entries.size(); ++oldId)
+    {
+        if (oldId >= used.size() || !used[oldId])
+        {
+            continue;
+        }
+
+        const auto& attr = _entries[oldId];
+        const auto inserted = ids.emplace(attr, gsl::narrow<id_type>(entries.size()));
+        if (inserted.second)
+        {
+            entries.push_back(attr);
+        }
+        remap[oldId] = inserted.first->second;
+    }
+
+    _entries.swap(entries);
+    _ids.swap(ids);
+    _aliases.clear();
+    _lastId = 0;
+
+    // Don't bother again until the palette has doubled, so that a buffer with a lot
+    // of attributes in use doesn't end up compacting on every row.
+    _compactAt = std::max(s_minCompactAt, _entries.size() * 2);
+
+    return remap;
+}
@@ -0,0 +1,114 @@
+/*++
+Copyright (c) Microsoft Corporation
+Licensed under the MIT license.
+
+Module Name:
+- TextAttributePalette.hpp
+
+Abstract:
+- Intern table for the TextAttributes used by one text buffer.
+- Each distinct attribute is stored once and handed out as a small integer id.
+    The rows of the buffer store those ids in their runs instead of whole
+    TextAttributes, which makes the runs smaller and lets them be compared
+    with a single integer compare.
+- Because every row of the buffer refers to the same entries, replacing an
+    attribute across the whole buffer is just a change to one entry.
+--*/
+
+#pragma once
+
+#include "TextAttribute.hpp"
+
+#include <deque>
+#include <unordered_map>
+
+class TextAttributePalette final
+{
+public:
+    using id_type = unsigned int;
+
+    TextAttributePalette();
+
+    // Rows keep a pointer to their palette, so it can't be copied out from under them.
+    TextAttributePalette(const TextAttributePalette&) = delete;
+    TextAttributePalette& operator=(const TextAttributePalette&) = delete;
+
+    id_type Intern(const TextAttribute& attr);
+    const TextAttribute& Get(const id_type id) const noexcept;
+
+    bool Replace(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith);
+
+    size_t Size() const noexcept;
+
+    bool NeedsCompaction() const noexcept;
+    std::vector<id_type> Compact(const std::vector<bool>& used);
+
+private:
+    // A deque, so that references to entries stay valid while the palette grows.
+    std::deque<TextAttribute> _entries;
+    std::unordered_map<TextAttribute, id_type> _ids;
+
+    // Replacing an attribute with one that's already in the palette leaves more than one
+    // entry for it. _ids only knows one of them, so the others are listed under it here.
+    std::unordered_map<id_type, std::vector<id_type>> _aliases;
+
+    // Writes tend to come in long stretches of the same attribute,
+    // so remember the last one we interned to skip the hash lookup.
+    id_type _lastId;
+
+    size_t _compactAt;
+
+    static constexpr size_t s_minCompactAt = 4096;
+};
+
+// One run of an ATTR_ROW: how many columns it covers, and the palette id of their attribute.
+class TextAttributeIdRun final
+{
+public:
+    constexpr TextAttributeIdRun() noexcept :
+        _cchLength{ 0 },
+        _id{ 0 }
+    {
+    }
+
+    constexpr TextAttributeIdRun(const size_t cchLength, const TextAttributePalette::id_type id) noexcept :
+        _cchLength{ static_cast<unsigned int>(cchLength) },
+        _id{ id }
+    {
+    }
+
+    constexpr size_t GetLength() const noexcept
+    {
+        return _cchLength;
+    }
+
+    constexpr void SetLength(const size_t cchLength) noexcept
+    {
+        _cchLength = static_cast<unsigned int>(cchLength);
+    }
+
+    constexpr void IncrementLength() noexcept
+    {
+        _cchLength++;
+    }
+
+    constexpr void DecrementLength() noexcept
+    {
+        _cchLength--;
+    }
+
+    constexpr TextAttributePalette::id_type GetAttributeId() const noexcept
+    {
+        return _id;
+    }
+
+    constexpr void SetAttributeId(const TextAttributePalette::id_type id) noexcept
+    {
+        _id = id;
+    }
+
+private:
+    // Rows are at most a SHORT wide, so the length always fits.
+    unsigned int _cchLength;
+    TextAttributePalette::id_type _id;
+};
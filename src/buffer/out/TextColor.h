@@ -117,6 +117,8 @@ private:
 
     COLORREF _GetRGB() const;
 
+    friend struct std::hash<TextColor>;
+
 #ifdef UNIT_TESTING
     friend class TextBufferTests;
     template<typename TextColor> friend class WEX::TestExecution::VerifyOutputTraits;
@@ -138,6 +140,28 @@ bool constexpr operator!=(const TextColor& a, const TextColor& b) noexcept
     return !(a == b);
 }
 
+namespace std
+{
+    template <>
+    struct hash<TextColor>
+    {
+        // Routine Description:
+        // - hashes a color. Every field is packed into its own byte, so no two
+        //   different colors hash the same.
+        // Arguments:
+        // - color - the color to hash
+        // Return Value:
+        // - the hashed color
+        constexpr size_t operator()(const TextColor& color) const noexcept
+        {
+            return (static_cast<size_t>(color._meta) << 24) |
+                   (static_cast<size_t>(color._red) << 16) |
+                   (static_cast<size_t>(color._green) << 8) |
+                   static_cast<size_t>(color._blue);
+        }
+    };
+}
+
 #ifdef UNIT_TESTING
 
 namespace WEX {
@@ -4,95 +4,173 @@
 #include "precomp.h"
 #include "UnicodeStorage.hpp"
 
-UnicodeStorage::UnicodeStorage() :
-    _map{}
+// The arena isn't compacted until it's at least this big, so small rows never bother.
+static constexpr size_t s_minCompactSize = 64;
+
+UnicodeStorage::UnicodeStorage() noexcept :
+    _slots{},
+    _arena{},
+    _count{ 0 },
+    _cchStored{ 0 }
 {
 }
 
 // Routine Description:
-// - fetches the text associated with key
+// - fetches the text stored for a column
 // Arguments:
-// - key - the key into the storage
+// - column - the column to fetch the glyph of
 // Return Value:
-// - the glyph data associated with key
-// Note: will throw exception if key is not stored yet
-const UnicodeStorage::mapped_type& UnicodeStorage::GetText(const key_type key) const
+// - the glyph data stored for the column. it's only valid until the next glyph is stored.
+// Note: will throw exception if no glyph is stored for the column
+UnicodeStorage::mapped_type UnicodeStorage::GetText(const key_type column) const
 {
-    return _map.at(key);
+    THROW_HR_IF(E_INVALIDARG, column >= _slots.size() || _slots[column].length == 0);
+    const auto slot = _slots[column];
+    return { _arena.data() + slot.offset, slot.length };
 }
 
 // Routine Description:
-// - stores glyph data associated with key.
+// - stores glyph data for a column, replacing whatever was stored for it before.
+// - a glyph that's no longer than the one it replaces is written over it in place.
 // Arguments:
-// - key - the key into the storage
-// - glyph - the glyph data to store
-void UnicodeStorage::StoreGlyph(const key_type key, const mapped_type& glyph)
+// - column - the column to store the glyph for
+// - glyph - the glyph data to store. it may be a glyph of this same storage.
+// Return Value:
+// - <none>
+// Note: will throw exception if the glyph is empty or out of memory. Nothing is changed if so.
+void UnicodeStorage::StoreGlyph(const key_type column, const mapped_type glyph)
 {
-    _map.insert_or_assign(key, glyph);
+    THROW_HR_IF(E_INVALIDARG, glyph.empty());
+    const auto length = gsl::narrow<uint16_t>(glyph.size());
+
+    // The glyph may point into our own arena, which moves when it grows. Copy it out first.
+    std::wstring copy;
+    auto source = glyph;
+    if (glyph.data() >= _arena.data() && glyph.data() < _arena.data() + _arena.size())
+    {
+        copy.assign(glyph);
+        source = copy;
+    }
+
+    if (column >= _slots.size())
+    {
+        _slots.resize(column + 1, Slot{ 0, 0 });
+    }
+
+    auto& slot = _slots[column];
+    if (slot.length >= length)
+    {
+        std::copy(source.cbegin(), source.cend(), _arena.begin() + slot.offset);
+        _cchStored -= slot.length - length;
+        slot.length = length;
+        return;
+    }
+
+    // The old glyph (if any) is left behind. Once the arena is mostly garbage, it's
+    // cheaper to pack the live glyphs together than to keep growing it.
+    if (_arena.size() >= s_minCompactSize && _arena.size() - _cchStored > _cchStored)
+    {
+        _Compact();
+    }
+
+    const auto offset = gsl::narrow<uint32_t>(_arena.size());
+    _arena.insert(_arena.end(), source.cbegin(), source.cend());
+
+    if (slot.length == 0)
+    {
+        _count++;
+    }
+    _cchStored += length - slot.length;
+    slot = { offset, length };
 }
 
 // Routine Description:
-// - erases key and it's associated data from the storage
+// - erases the glyph stored for a column, if there is one
 // Arguments:
-// - key - the key to remove
-void UnicodeStorage::Erase(const key_type key) noexcept
+// - column - the column to remove the glyph of
+// Return Value:
+// - <none>
+void UnicodeStorage::Erase(const key_type column) noexcept
 {
-    _map.erase(key);
+    if (column < _slots.size() && _slots[column].length != 0)
+    {
+        _cchStored -= _slots[column].length;
+        _slots[column] = { 0, 0 };
+        _count--;
+        if (_count == 0)
+        {
+            Clear();
+        }
+    }
 }
 
 // Routine Description:
-// - Remaps all of the stored items to new coordinate positions
-//   based on a bulk rearrangement of row IDs and potential row width resize.
+// - erases every stored glyph. the memory is kept so that a row that's reused doesn't reallocate.
 // Arguments:
-// - rowMap - A map of the old row IDs to the new row IDs.
-// - width - The width of the new row. Remove any items that are beyond the row width.
-//         - Use nullopt if we're not resizing the width of the row, just renumbering the rows.
-void UnicodeStorage::Remap(const std::map<SHORT, SHORT>& rowMap, const std::optional<SHORT> width)
+// - <none>
+// Return Value:
+// - <none>
+void UnicodeStorage::Clear() noexcept
 {
-    // Make a temporary map to hold all the new row positioning
-    std::unordered_map<key_type, mapped_type> newMap;
+    _slots.clear();
+    _arena.clear();
+    _count = 0;
+    _cchStored = 0;
+}
 
-    // Walk through every stored item.
-    for (const auto& pair : _map)
+// Routine Description:
+// - erases the glyphs of any columns at or beyond the given width, for when the row is narrowed.
+// Arguments:
+// - width - the new width of the row
+// Return Value:
+// - <none>
+void UnicodeStorage::Truncate(const size_t width) noexcept
+{
+    for (size_t column = width; column < _slots.size(); ++column)
     {
-        // Extract the old coordinate position
-        const auto oldCoord = pair.first;
+        Erase(column);
+    }
 
-        // Only try to short-circuit based on width if we were told it changed
-        // by being given a new width value.
-        if (width.has_value())
-        {
-            // Get the column ID
-            const auto oldColId = oldCoord.X;
-
-            // If the column index is at/beyond the row width, don't bother copying it to the new map.
-            if (oldColId >= width.value())
-            {
-                continue;
-            }
-        }
+    // Erasing the last glyph clears the slots as well.
+    if (_slots.size() > width)
+    {
+        _slots.resize(width);
+    }
+}
 
-        // Get the row ID from the position as that's what we need to remap
-        const auto oldRowId = oldCoord.Y;
+// Routine Description:
+// - gets the number of glyphs stored
+// Arguments:
+// - <none>
+// Return Value:
+// - the number of columns with a stored glyph
+size_t UnicodeStorage::Size() const noexcept
+{
+    return _count;
+}
 
-        // Use the mapping given to convert the old row ID to the new row ID
-        const auto mapIter = rowMap.find(oldRowId);
+// Routine Description:
+// - packs the stored glyphs together at the front of the arena, dropping the
+//   ones that have been replaced.
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+// Note: will throw exception if out of memory. Nothing is changed if so.
+void UnicodeStorage::_Compact()
+{
+    std::vector<wchar_t> arena;
+    arena.reserve(_cchStored);
 
-        // If there's no mapping to a new row, don't bother copying it to the new map. The row is gone.
-        if (mapIter == rowMap.end())
+    // With the space reserved, nothing below can throw.
+    for (auto& slot : _slots)
+    {
+        if (slot.length != 0)
         {
-            continue;
+            const auto offset = gsl::narrow_cast<uint32_t>(arena.size());
+            arena.insert(arena.end(), _arena.cbegin() + slot.offset, _arena.cbegin() + slot.offset + slot.length);
+            slot.offset = offset;
         }
-
-        const auto newRowId = mapIter->second;
-
-        // Generate a new coordinate with the same X as the old one, but a new Y value.
-        const auto newCoord = COORD{ oldCoord.X, newRowId };
-
-        // Put the adjusted coordinate into the map with the original value.
-        newMap.emplace(newCoord, pair.second);
     }
-
-    // Swap into the stored map, free the temporary when we exit.
-    _map.swap(newMap);
+    _arena.swap(arena);
 }
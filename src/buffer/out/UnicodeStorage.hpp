@@ -7,6 +7,10 @@ Module Name:
 
 Abstract:
 - dynamic storage location for glyphs that can't normally fit in the output buffer
+- every row owns one, so it's indexed by column alone. Rotating, scrolling or
+  renumbering rows moves the storage along with the row and never has to touch it.
+- the glyphs themselves are kept back to back in a small arena, with one slot per
+  column pointing into it. a row with no such glyphs doesn't allocate anything.
 
 Author(s):
 - Austin Diviness (AustDi) 02-May-2018
@@ -15,54 +19,49 @@ Author(s):
 #pragma once
 
 #include <vector>
-#include <unordered_map>
-#include <climits>
-
-// std::unordered_map needs help to know how to hash a COORD
-namespace std
-{
-    template <>
-    struct hash<COORD>
-    {
-
-        // Routine Description:
-        // - hashes a coord. coord will be hashed by storing the x and y values consecutively in the lower
-        // bits of a size_t.
-        // Arguments:
-        // - coord - the coord to hash
-        // Return Value:
-        // - the hashed coord
-        constexpr size_t operator()(const COORD& coord) const noexcept
-        {
-            size_t retVal = coord.Y;
-            const size_t xCoord = coord.X;
-            retVal |= xCoord << (sizeof(coord.Y) * CHAR_BIT);
-            return retVal;
-        }
-    };
-}
 
 class UnicodeStorage final
 {
 public:
-    using key_type = typename COORD;
-    using mapped_type = typename std::vector<wchar_t>;
+    using key_type = typename size_t;
+    using mapped_type = typename std::wstring_view;
+
+    UnicodeStorage() noexcept;
+
+    mapped_type GetText(const key_type column) const;
 
-    UnicodeStorage();
+    void StoreGlyph(const key_type column, const mapped_type glyph);
 
-    const mapped_type& GetText(const key_type key) const;
+    void Erase(const key_type column) noexcept;
 
-    void StoreGlyph(const key_type key, const mapped_type& glyph);
+    void Clear() noexcept;
 
-    void Erase(const key_type key) noexcept;
+    void Truncate(const size_t width) noexcept;
 
-    void Remap(const std::map<SHORT, SHORT>& rowMap, const std::optional<SHORT> width);
+    size_t Size() const noexcept;
 
 private:
-    std::unordered_map<key_type, mapped_type> _map;
+    // Where a column's glyph sits in the arena. A length of 0 means the column has no glyph.
+    struct Slot
+    {
+        uint32_t offset;
+        uint16_t length;
+    };
+
+    void _Compact();
+
+    // One slot per column, up to the last column that ever had a glyph stored.
+    std::vector<Slot> _slots;
+
+    // The glyphs. Overwritten glyphs that no longer fit in place are left behind
+    // until _Compact reclaims them.
+    std::vector<wchar_t> _arena;
+
+    // The number of glyphs stored, and how much of the arena they use.
+    size_t _count;
+    size_t _cchStored;
 
 #ifdef UNIT_TESTING
     friend class UnicodeStorageTests;
-    friend class TextBufferTests;
 #endif
 };
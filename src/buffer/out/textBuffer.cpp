@@ -3,6 +3,8 @@
 
 #include "precomp.h"
 
+#include <execution>
+
 #include "textBuffer.hpp"
 #include "CharRow.hpp"
 
@@ -26,17 +28,24 @@ TextBuffer::TextBuffer(const COORD screenBufferSize,
                        const TextAttribute defaultAttributes,
                        const UINT cursorSize,
                        Microsoft::Console::Render::IRenderTarget& renderTarget) :
+    _cells{ _AllocateCells(screenBufferSize) },
+    _attributePalette{},
     _firstRow{ 0 },
     _currentAttributes{ defaultAttributes },
     _cursor{ cursorSize, *this },
     _storage{},
-    _unicodeStorage{},
     _renderTarget{ renderTarget }
 {
     // initialize ROWs
+    _storage.reserve(screenBufferSize.Y);
     for (size_t i = 0; i < static_cast<size_t>(screenBufferSize.Y); ++i)
     {
-        _storage.emplace_back(static_cast<SHORT>(i), screenBufferSize.X, _currentAttributes, this);
+        _storage.emplace_back(static_cast<SHORT>(i),
+                              _GetRowChars(_cells.get(), screenBufferSize, i),
+                              _GetRowDbcsAttrs(_cells.get(), screenBufferSize, i),
+                              screenBufferSize.X,
+                              _currentAttributes,
+                              this);
     }
 }
 
@@ -364,6 +373,10 @@ OutputCellIterator TextBuffer::WriteLine(const OutputCellIterator givenIt,
     ROW& row = GetRowByOffset(target.Y);
     const auto newIt = row.WriteCells(givenIt, target.X, setWrap, limitRight);
 
+    // An app redrawing the screen in place never circles the buffer, so the
+    //      attributes it overwrites have to be dropped from here too.
+    _CompactAttributePaletteIfNeeded();
+
     // Take the cell distance written and notify that it needs to be repainted.
     const auto written = newIt.GetCellDistance(givenIt);
     const Viewport paint = Viewport::FromDimensions(target, { gsl::narrow<SHORT>(written), 1 });
@@ -416,6 +429,8 @@ bool TextBuffer::InsertCharacter(const std::wstring_view chars,
         fSuccess = Row.GetAttrRow().SetAttrToEnd(iCol, attr);
         if (fSuccess)
         {
+            _CompactAttributePaletteIfNeeded();
+
             // Advance the cursor
             fSuccess = IncrementCursor();
         }
@@ -543,6 +558,9 @@ bool TextBuffer::IncrementCircularBuffer()
     bool fSuccess = _storage.at(_firstRow).Reset(_currentAttributes);
     if (fSuccess)
     {
+        // Attributes stop being used as rows are cleaned out, so this is one time to drop them from the palette.
+        _CompactAttributePaletteIfNeeded();
+
         // Now proceed to increment.
         // Incrementing it will cause the next line down to become the new "top" of the window (the new "0" in logical coordinates)
         _firstRow++;
@@ -627,6 +645,7 @@ const SHORT TextBuffer::GetFirstRowIndex() const
 {
     return _firstRow;
 }
+
 const Viewport TextBuffer::GetSize() const
 {
     return Viewport::FromDimensions({ 0, 0 }, { gsl::narrow<SHORT>(_storage.at(0).size()), gsl::narrow<SHORT>(_storage.size()) });
@@ -645,42 +664,33 @@ void TextBuffer::ScrollRows(const SHORT firstRow, const SHORT size, const SHORT
         return;
     }
 
-    // OK. We're about to play games by moving rows around within the deque to
+    // OK. We're about to play games by moving rows around within the circular buffer to
     // scroll a massive region in a faster way than copying things.
-    // To make this easier, first correct the circular buffer to have the first row be 0 again.
-    if (_firstRow != 0)
-    {
-        // Rotate the buffer to put the first row at the front.
-        std::rotate(_storage.begin(), _storage.begin() + _firstRow, _storage.end());
-
-        // The first row is now at the top.
-        _firstRow = 0;
-    }
-
-    // Rotate just the subsection specified
+    // The rows are rotated where they are, so only the region and the rows it slides
+    // over are touched, no matter how tall the buffer is or where its first row sits.
     if (delta < 0)
     {
         // The layout is like this:
         // delta is -2, size is 3, firstRow is 5
         // We want 3 rows from 5 (5, 6, and 7) to move up 2 spots.
-        // --- (storage) ----
-        // | 0 begin
+        // --- (rows by offset from the first row) ----
+        // | 0 top
         // | 1
         // | 2
-        // | 3 A. begin + firstRow + delta (because delta is negative)
+        // | 3 A. firstRow + delta (because delta is negative)
         // | 4
-        // | 5 B. begin + firstRow
+        // | 5 B. firstRow
         // | 6
         // | 7
-        // | 8 C. begin + firstRow + size
+        // | 8 C. firstRow + size
         // | 9
         // | 10
         // | 11
-        // - end
+        // - bottom
         // We want B to slide up to A (the negative delta) and everything from [B,C) to slide up with it.
         // So the final layout will be
-        // --- (storage) ----
-        // | 0 begin
+        // --- (rows by offset from the first row) ----
+        // | 0 top
         // | 1
         // | 2
         // | 5
@@ -692,32 +702,32 @@ void TextBuffer::ScrollRows(const SHORT firstRow, const SHORT size, const SHORT
         // | 9
         // | 10
         // | 11
-        // - end
-        std::rotate(_storage.begin() + firstRow + delta, _storage.begin() + firstRow, _storage.begin() + firstRow + size);
+        // - bottom
+        _RotateRows(gsl::narrow<size_t>(firstRow + delta), gsl::narrow<size_t>(firstRow), gsl::narrow<size_t>(firstRow + size));
     }
     else
     {
         // The layout is like this:
         // delta is 2, size is 3, firstRow is 5
         // We want 3 rows from 5 (5, 6, and 7) to move down 2 spots.
-        // --- (storage) ----
-        // | 0 begin
+        // --- (rows by offset from the first row) ----
+        // | 0 top
         // | 1
         // | 2
         // | 3
         // | 4
-        // | 5 A. begin + firstRow
+        // | 5 A. firstRow
         // | 6
         // | 7
-        // | 8 B. begin + firstRow + size
+        // | 8 B. firstRow + size
         // | 9
-        // | 10 C. begin + firstRow + size + delta
+        // | 10 C. firstRow + size + delta
         // | 11
-        // - end
+        // - bottom
         // We want B-1 to slide down to C-1 (the positive delta) and everything from [A, B) to slide down with it.
         // So the final layout will be
-        // --- (storage) ----
-        // | 0 begin
+        // --- (rows by offset from the first row) ----
+        // | 0 top
         // | 1
         // | 2
         // | 3
@@ -729,13 +739,9 @@ void TextBuffer::ScrollRows(const SHORT firstRow, const SHORT size, const SHORT
         // | 7
         // | 10
         // | 11
-        // - end
-        std::rotate(_storage.begin() + firstRow, _storage.begin() + firstRow + size, _storage.begin() + firstRow + size + delta);
+        // - bottom
+        _RotateRows(gsl::narrow<size_t>(firstRow), gsl::narrow<size_t>(firstRow + size), gsl::narrow<size_t>(firstRow + size + delta));
     }
-
-    // Renumber the IDs now that we've rearranged where the rows sit within the buffer.
-    // Refreshing should also delegate to the UnicodeStorage to re-key all the stored unicode sequences (where applicable).
-    _RefreshRowIDs(std::nullopt);
 }
 
 Cursor& TextBuffer::GetCursor()
@@ -759,6 +765,51 @@ void TextBuffer::SetCurrentAttributes(const TextAttribute currentAttributes) noe
     _currentAttributes = currentAttributes;
 }
 
+// Routine Description:
+// - Replaces an attribute with another one everywhere in the buffer.
+// - Every row refers to the buffer's palette for its attributes, so this only
+//   has to change one entry of the palette, however many rows use it.
+// Arguments:
+// - toBeReplacedAttr - the attribute to replace.
+// - replaceWith - the new value for it.
+// Return Value:
+// - <none>
+void TextBuffer::ReplaceAttrs(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith)
+{
+    if (_attributePalette.Replace(toBeReplacedAttr, replaceWith))
+    {
+        _NotifyPaint(GetSize());
+    }
+}
+
+// Routine Description:
+// - Replaces a legacy attribute with another one everywhere in the buffer.
+// Arguments:
+// - wToBeReplacedAttr - the legacy attribute to replace.
+// - wReplaceWith - the new value for it.
+// Return Value:
+// - <none>
+void TextBuffer::ReplaceLegacyAttrs(const WORD wToBeReplacedAttr, const WORD wReplaceWith)
+{
+    TextAttribute toBeReplaced;
+    toBeReplaced.SetFromLegacy(wToBeReplacedAttr);
+
+    TextAttribute replaceWith;
+    replaceWith.SetFromLegacy(wReplaceWith);
+
+    ReplaceAttrs(toBeReplaced, replaceWith);
+}
+
+const TextAttributePalette& TextBuffer::GetAttributePalette() const noexcept
+{
+    return _attributePalette;
+}
+
+TextAttributePalette& TextBuffer::GetAttributePalette() noexcept
+{
+    return _attributePalette;
+}
+
 // Routine Description:
 // - Resets the text contents of this buffer with the default character
 //   and the default current color attributes
@@ -771,6 +822,8 @@ void TextBuffer::Reset()
         row.GetCharRow().Reset();
         row.GetAttrRow().Reset(attr);
     }
+
+    _CompactAttributePaletteIfNeeded();
 }
 
 // Routine Description:
@@ -794,85 +847,533 @@ NTSTATUS TextBuffer::ResizeTraditional(const COORD newSize) noexcept
     }
     const SHORT TopRowIndex = (GetFirstRowIndex() + TopRow) % currentSize.Y;
 
-    // rotate rows until the top row is at index 0
     try
     {
-        const ROW& newTopRow = _storage[TopRowIndex];
-        while (&newTopRow != &_storage.front())
+        // Get everything that can fail out of the way first, without touching
+        //      the buffer, so a failure leaves it just as it was.
+        auto newCells = _AllocateCells(newSize);
+        std::vector<ROW> newStorage;
+        newStorage.reserve(newSize.Y);
+
+        const size_t keptRows = std::min(_storage.size(), static_cast<size_t>(newSize.Y));
+
+        // The attribute rows can fail to resize, so resize copies of the ones we keep.
+        std::vector<ATTR_ROW> newAttrRows;
+        if (newSize.X != currentSize.X)
+        {
+            newAttrRows.reserve(keptRows);
+            for (size_t i = 0; i < keptRows; ++i)
+            {
+                newAttrRows.push_back(_storage.at((TopRowIndex + i) % _storage.size()).GetAttrRow());
+                newAttrRows.back().Resize(newSize.X);
+            }
+        }
+
+        // Build the rows we're adding if we're growing.
+        std::vector<ROW> newRows;
+        newRows.reserve(newSize.Y - keptRows);
+        for (size_t i = keptRows; i < static_cast<size_t>(newSize.Y); ++i)
         {
-            _storage.push_back(std::move(_storage.front()));
-            _storage.pop_front();
+            newRows.emplace_back(static_cast<SHORT>(i),
+                                 _GetRowChars(newCells.get(), newSize, i),
+                                 _GetRowDbcsAttrs(newCells.get(), newSize, i),
+                                 newSize.X,
+                                 attributes,
+                                 this);
         }
 
-        _SetFirstRowIndex(0);
+        // Nothing from here on can fail. Moving rows doesn't allocate, and newStorage
+        //      already has room for all of them.
 
-        // realloc in the Y direction
-        // remove rows if we're shrinking
-        while (_storage.size() > static_cast<size_t>(newSize.Y))
+        // Move the rows we keep over, starting with the new top row, into the new cells.
+        for (size_t i = 0; i < keptRows; ++i)
         {
-            _storage.pop_back();
+            auto& row = _storage[(TopRowIndex + i) % _storage.size()];
+            if (!newAttrRows.empty())
+            {
+                row.GetAttrRow() = std::move(newAttrRows[i]);
+            }
+            row.Resize(_GetRowChars(newCells.get(), newSize, i),
+                       _GetRowDbcsAttrs(newCells.get(), newSize, i),
+                       newSize.X);
+            newStorage.push_back(std::move(row));
         }
+
         // add rows if we're growing
-        while (_storage.size() < static_cast<size_t>(newSize.Y))
-        {
-            _storage.emplace_back(static_cast<short>(_storage.size()), newSize.X, attributes, this);
-        }
+        std::move(newRows.begin(), newRows.end(), std::back_inserter(newStorage));
 
-        // Now that we've tampered with the row placement, refresh all the row IDs.
-        // Also take advantage of the row ID refresh loop to resize the rows in the X dimension
-        // and cleanup the UnicodeStorage characters that might fall outside the resized buffer.
-        _RefreshRowIDs(newSize.X);
+        _cells.swap(newCells);
+        _storage.swap(newStorage);
+        _SetFirstRowIndex(0);
 
+        // Now that we've tampered with the row placement, refresh all the row IDs.
+        // Rows resizing themselves already dropped the stored glyphs that fell outside of them.
+        _RefreshRowIDs();
     }
     CATCH_RETURN();
 
     return S_OK;
 }
 
-const UnicodeStorage& TextBuffer::GetUnicodeStorage() const
+// Reflow rewraps this many rows at a time, at least. A chunk only ends at the end of a line.
+static constexpr size_t s_reflowChunkRows = 512;
+
+// Routine Description:
+// - Resizes the buffer, rewrapping the lines of text in it to the new width. Rows that
+//   were wrapped because they ran out of space are joined back up or split differently,
+//   the same way that writing the text out again one character at a time would.
+// - The lines are split into chunks that are rewrapped in parallel. The rows of the new
+//   buffer are all built before any of them replace the old ones, so the buffer is left
+//   as it was if anything fails.
+// - The cursor stays on the same character. If the text no longer fits, the oldest rows
+//   fall off the top, the same as when the buffer circles.
+// Arguments:
+// - newSize - new size of the buffer, in cells
+// Return Value:
+// - Success if successful. Invalid parameter if the new size is empty. No memory if allocation failed.
+[[nodiscard]]
+HRESULT TextBuffer::Reflow(const COORD newSize) noexcept
 {
-    return _unicodeStorage;
+    RETURN_HR_IF(E_INVALIDARG, newSize.X <= 0 || newSize.Y <= 0);
+
+    try
+    {
+        const size_t oldWidth = GetSize().Width();
+        const size_t newWidth = newSize.X;
+        const size_t newHeight = newSize.Y;
+        const auto oldCursor = GetCursor().GetPosition();
+        const auto oldLastChar = GetLastNonSpaceCharacter();
+        const size_t lastRow = oldLastChar.Y;
+        const bool oldLastRowWrapped = GetRowByOffset(lastRow).GetCharRow().WasWrapForced();
+
+        // Split the rows into chunks at the ends of lines, so that each chunk can be rewrapped
+        // without knowing where the one before it left off.
+        std::vector<ReflowChunk> chunks;
+        size_t chunkStart = 0;
+        for (size_t row = 0; row <= lastRow; ++row)
+        {
+            const CharRow& charRow = GetRowByOffset(row).GetCharRow();
+            const bool endsLine = !charRow.WasWrapForced() && charRow.MeasureRight() < oldWidth;
+            if ((endsLine && row + 1 - chunkStart >= s_reflowChunkRows) || row == lastRow)
+            {
+                chunks.push_back({ chunkStart, row + 1, 0, 0, 0, std::nullopt, S_OK });
+                chunkStart = row + 1;
+            }
+        }
+
+        const auto reflowChunks = [&](std::vector<ROW>* const newStorage, const size_t droppedRows) {
+            std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](ReflowChunk& chunk) noexcept {
+                try
+                {
+                    _ReflowChunk(chunk, lastRow, newWidth, newStorage, droppedRows);
+                }
+                catch (...)
+                {
+                    chunk.hr = wil::ResultFromCaughtException();
+                }
+            });
+
+            for (const auto& chunk : chunks)
+            {
+                THROW_IF_FAILED(chunk.hr);
+            }
+        };
+
+        // First find out how many rows every chunk takes at the new width, and from that
+        // where each of them starts.
+        reflowChunks(nullptr, 0);
+        size_t outputRow = 0;
+        for (auto& chunk : chunks)
+        {
+            chunk.firstOutputRow = outputRow;
+            outputRow += chunk.outputRows;
+        }
+
+        // The cursor ends up on the last of the rows. If there are more of them than the new
+        // buffer has room for, the ones at the top are dropped.
+        const size_t cursorRow = std::min(outputRow, newHeight - 1);
+        const size_t droppedRows = outputRow - cursorRow;
+
+        // Then write the chunks out into fresh rows.
+        auto newCells = _AllocateCells(newSize);
+        std::vector<ROW> newStorage;
+        newStorage.reserve(newHeight);
+        for (size_t i = 0; i < newHeight; ++i)
+        {
+            newStorage.emplace_back(static_cast<SHORT>(i),
+                                    _GetRowChars(newCells.get(), newSize, i),
+                                    _GetRowDbcsAttrs(newCells.get(), newSize, i),
+                                    newSize.X,
+                                    _currentAttributes,
+                                    this);
+        }
+        reflowChunks(&newStorage, droppedRows);
+
+        // Nothing can fail from here on, so the new rows can take over.
+        _cursor.StartDeferDrawing();
+        _cells.swap(newCells);
+        _storage.swap(newStorage);
+        _SetFirstRowIndex(0);
+        _cursor.ResetDelayEOLWrap();
+
+        const auto foundCursor = std::find_if(chunks.cbegin(), chunks.cend(), [](const ReflowChunk& chunk) {
+            return chunk.cursor.has_value();
+        });
+        if (foundCursor != chunks.cend())
+        {
+            // The cursor was on a character (or at the end of a line), so put it back there.
+            const auto [column, row] = foundCursor->cursor.value();
+            _cursor.SetPosition({ gsl::narrow_cast<SHORT>(column),
+                                  gsl::narrow_cast<SHORT>(row >= droppedRows ? row - droppedRows : 0) });
+        }
+        else
+        {
+            // The cursor was past the end of the text. Start from the end of the rewrapped text
+            // and move the cursor as many newlines and spaces past it as it was before.
+            _cursor.SetPosition({ gsl::narrow_cast<SHORT>(chunks.back().endColumn), gsl::narrow_cast<SHORT>(cursorRow) });
+
+            int iNewlines = oldCursor.Y - oldLastChar.Y;
+            const int iIncrements = oldCursor.X - oldLastChar.X;
+            const COORD newLastChar = GetLastNonSpaceCharacter();
+
+            // If the last row of the text wrapped, in either buffer, the cursor is already on the next line.
+            if (GetRowByOffset(newLastChar.Y).GetCharRow().WasWrapForced() || oldLastRowWrapped)
+            {
+                iNewlines = std::max(iNewlines - 1, 0);
+            }
+
+            // The text has already been moved, so failing to move the cursor isn't worth failing the resize over.
+            bool fSuccess = true;
+            for (int r = 0; r < iNewlines && fSuccess; r++)
+            {
+                fSuccess = NewlineCursor();
+            }
+            for (int c = 0; c < iIncrements - 1 && fSuccess; c++)
+            {
+                fSuccess = IncrementCursor();
+            }
+            LOG_HR_IF(E_OUTOFMEMORY, !fSuccess);
+        }
+        _cursor.EndDeferDrawing();
+    }
+    CATCH_RETURN();
+
+    return S_OK;
 }
 
-UnicodeStorage& TextBuffer::GetUnicodeStorage()
+// Routine Description:
+// - Rewraps the lines in one chunk of rows to a new width, the same way that writing
+//   them out again with InsertCharacter and NewlineCursor would.
+// - Given no rows to write to, it only measures how many rows the chunk takes. Different
+//   chunks never write to the same rows, so they can be rewrapped at the same time.
+// Arguments:
+// - chunk - the rows to rewrap. The rest of its fields are filled in with where they went.
+// - lastRow - the last row of text in the buffer. The cursor is left at the end of it, instead of on the next line.
+// - newWidth - the width to rewrap the lines to
+// - newStorage - the rows of the new buffer, or nullptr to only measure the chunk
+// - droppedRows - how many rows of the rewrapped text fall off the top of the new buffer
+// Return Value:
+// - <none>
+// Note: will throw exception if out of memory
+void TextBuffer::_ReflowChunk(ReflowChunk& chunk,
+                              const size_t lastRow,
+                              const size_t newWidth,
+                              std::vector<ROW>* const newStorage,
+                              const size_t droppedRows) const
 {
-    return _unicodeStorage;
+    const size_t oldWidth = GetSize().Width();
+    const auto oldCursor = GetCursor().GetPosition();
+
+    // Where the next character would be written, as if by a cursor walking the new buffer.
+    size_t x = 0;
+    size_t y = chunk.firstOutputRow;
+
+    // The state of the row being written.
+    size_t cchWritten = 0;
+    bool doubleBytePadded = false;
+    bool leadingBeforeCursor = false;
+    bool previousRowWrapped = false;
+    std::vector<TextAttributeIdRun> runs;
+
+    // The row the cursor is on, unless it's only being measured or it's dropped.
+    const auto outputRow = [&]() noexcept -> ROW* {
+        return newStorage && y >= droppedRows ? &(*newStorage)[y - droppedRows] : nullptr;
+    };
+
+    // Stores the flags and attributes of the row the cursor is on.
+    const auto finishRow = [&](const bool wrapForced) {
+        if (const auto row = outputRow())
+        {
+            row->GetCharRow().SetWrapForced(wrapForced);
+            row->GetCharRow().SetDoubleBytePadded(doubleBytePadded);
+            if (!runs.empty())
+            {
+                // Every character sets its attribute to the end of the row, so the last one covers the rest of it.
+                runs.back().SetLength(runs.back().GetLength() + newWidth - cchWritten);
+                row->GetAttrRow().SetAttrIdRuns(runs);
+            }
+        }
+    };
+
+    // Like NewlineCursor. Finishes the row and moves on to the start of the next one.
+    const auto newline = [&](const bool wrapForced) {
+        finishRow(wrapForced);
+        runs.clear();
+        cchWritten = 0;
+        doubleBytePadded = false;
+        leadingBeforeCursor = false;
+        previousRowWrapped = wrapForced;
+        x = 0;
+        y++;
+    };
+
+    // Like InsertCharacter. Writes a character at the cursor and moves past it.
+    const auto insert = [&](const std::wstring_view glyph, const DbcsAttribute dbcsAttr, const TextAttributePalette::id_type id) {
+        // A leading byte on the last column is pushed onto the next row, so it isn't split from its trailing byte.
+        if (dbcsAttr.IsLeading() && x == newWidth - 1 && newWidth > 1)
+        {
+            doubleBytePadded = true;
+            newline(true);
+        }
+
+        if (const auto row = outputRow())
+        {
+            CharRow& charRow = row->GetCharRow();
+
+            // A leading byte that lost its trailing byte is erased.
+            if (leadingBeforeCursor && !dbcsAttr.IsTrailing())
+            {
+                charRow.ClearCell(x - 1);
+            }
+
+            charRow.GlyphAt(x) = glyph;
+            charRow.DbcsAttrAt(x) = dbcsAttr;
+
+            if (!runs.empty() && runs.back().GetAttributeId() == id)
+            {
+                runs.back().IncrementLength();
+            }
+            else
+            {
+                runs.emplace_back(1, id);
+            }
+        }
+
+        leadingBeforeCursor = dbcsAttr.IsLeading();
+        cchWritten = ++x;
+        if (x == newWidth)
+        {
+            newline(true);
+        }
+    };
+
+    for (size_t iRow = chunk.firstRow; iRow < chunk.endRow; ++iRow)
+    {
+        const ROW& row = GetRowByOffset(iRow);
+        const CharRow& charRow = row.GetCharRow();
+        const ATTR_ROW& attrRow = row.GetAttrRow();
+        const bool isCursorRow = iRow == static_cast<size_t>(oldCursor.Y);
+
+        // A row that was wrapped ends in text, even if it's spaces. The padding that pushed
+        // a leading byte onto the next row is left out, though. It'll be added again if it's needed.
+        size_t iRight = charRow.MeasureRight();
+        if (charRow.WasWrapForced())
+        {
+            iRight = charRow.WasDoubleBytePadded() ? oldWidth - 1 : oldWidth;
+        }
+
+        size_t cchApplies = 0;
+        TextAttributePalette::id_type id = 0;
+        for (size_t iCol = 0; iCol < iRight; ++iCol)
+        {
+            if (cchApplies == 0)
+            {
+                id = attrRow.GetAttrIdByColumn(iCol, &cchApplies);
+            }
+            cchApplies--;
+
+            if (isCursorRow && iCol == static_cast<size_t>(oldCursor.X))
+            {
+                chunk.cursor = std::make_pair(x, y);
+            }
+
+            insert(charRow.GlyphAt(iCol), charRow.DbcsAttrAt(iCol), id);
+        }
+
+        // A row that ends before running out of space is the end of a line.
+        if (iRight < oldWidth && !charRow.WasWrapForced())
+        {
+            if (isCursorRow && iRight == static_cast<size_t>(oldCursor.X))
+            {
+                chunk.cursor = std::make_pair(x, y);
+            }
+
+            if (iRow < lastRow)
+            {
+                newline(false);
+            }
+            else if (x == 0 && previousRowWrapped)
+            {
+                // The last line just filled its final row, so the cursor wrapped onto the next one.
+                // Add the newline anyway, so that the line still ends if the buffer is widened again.
+                newline(false);
+            }
+        }
+    }
+
+    // The last chunk ends part of the way through a row, instead of at the start of one.
+    if (cchWritten > 0)
+    {
+        finishRow(false);
+    }
+
+    chunk.outputRows = y - chunk.firstOutputRow;
+    chunk.endColumn = x;
 }
 
 // Routine Description:
 // - Method to help refresh all the Row IDs after manipulating the row
 //   by shuffling pointers around.
-// - This will also update parent pointers that are stored in depth within the buffer
-//   (e.g. it will update CharRow parents pointing at Rows that might have been moved around)
-// - Optionally takes a new row width if we're resizing to perform a resize operation and cleanup
-//   any high unicode (UnicodeStorage) runs while we're already looping through the rows.
 // Arguments:
-// - newRowWidth - Optional new value for the row width.
-void TextBuffer::_RefreshRowIDs(std::optional<SHORT> newRowWidth)
+// - <none>
+void TextBuffer::_RefreshRowIDs()
 {
-    std::map<SHORT, SHORT> rowMap;
     SHORT i = 0;
     for (auto& it : _storage)
     {
-        // Build a map so we can update Unicode Storage
-        rowMap.emplace(it.GetId(), i);
-
         // Update the IDs
         it.SetId(i++);
+    }
+}
+
+// Routine Description:
+// - Rotates a range of rows, like std::rotate, so that the row at middle becomes the row at first.
+// - The range is given in offsets from the first row, and may wrap around the end of the
+//   circular buffer. Only the rows in the range are moved and renumbered.
+// Arguments:
+// - first - offset of the first row of the range
+// - middle - offset of the row that should end up first
+// - last - offset one past the last row of the range
+// Return Value:
+// - <none>
+// Note: will throw exception if the range doesn't fit in the buffer. Nothing is moved if so.
+void TextBuffer::_RotateRows(const size_t first, const size_t middle, const size_t last)
+{
+    const size_t totalRows = _storage.size();
+    THROW_HR_IF(E_INVALIDARG, !(first <= middle && middle <= last && last <= totalRows));
+
+    const auto physicalIndex = [&](const size_t offset) noexcept {
+        return (_firstRow + offset) % totalRows;
+    };
+
+    const size_t physicalFirst = physicalIndex(first);
+    if (physicalFirst + (last - first) <= totalRows)
+    {
+        // The range doesn't wrap, so the rows are contiguous and can be rotated directly.
+        const auto begin = _storage.begin() + physicalFirst;
+        std::rotate(begin, begin + (middle - first), begin + (last - first));
+    }
+    else
+    {
+        // Rotating is reversing both halves of the range and then the whole of it.
+        const auto reverse = [&](size_t lo, size_t hi) {
+            while (hi - lo > 1)
+            {
+                --hi;
+                std::swap(_storage[physicalIndex(lo)], _storage[physicalIndex(hi)]);
+                ++lo;
+            }
+        };
+        reverse(first, middle);
+        reverse(middle, last);
+        reverse(first, last);
+    }
 
-        // Also update the char row parent pointers as they can get shuffled up in the rotates.
-        it.GetCharRow().UpdateParent(&it);
+    for (size_t offset = first; offset < last; ++offset)
+    {
+        _storage[physicalIndex(offset)].SetId(static_cast<SHORT>(physicalIndex(offset)));
+    }
+}
 
-        // Resize the rows in the X dimension if we have a new width
-        if (newRowWidth.has_value())
+// Routine Description:
+// - Compacts the palette if it's grown enough since last time to be worth it. Called
+//   after anything that can add attributes to it or stop rows from using them.
+// - A failure is only logged. The palette just stays bigger than it needs to be.
+void TextBuffer::_CompactAttributePaletteIfNeeded() noexcept
+{
+    if (_attributePalette.NeedsCompaction())
+    {
+        try
         {
-            // Realloc in the X direction
-            THROW_IF_FAILED(it.Resize(newRowWidth.value()));
+            _CompactAttributePalette();
         }
+        CATCH_LOG();
+    }
+}
+
+// Routine Description:
+// - Drops the attributes no row uses anymore from the palette, and renumbers the runs of every row to match.
+// Note: may throw exception. Nothing is changed if so.
+void TextBuffer::_CompactAttributePalette()
+{
+    std::vector<bool> used(_attributePalette.Size(), false);
+    for (const auto& row : _storage)
+    {
+        row.GetAttrRow().MarkUsedAttributeIds(used);
     }
 
-    // Give the new mapping to Unicode Storage
-    _unicodeStorage.Remap(rowMap, newRowWidth);
+    const auto remap = _attributePalette.Compact(used);
+
+    for (auto& row : _storage)
+    {
+        row.GetAttrRow().RemapAttributeIds(remap);
+    }
+}
+
+// Routine Description:
+// - Allocates the cells for a buffer of the given size in a single block, all cleared.
+//   The characters of every row come first, followed by the dbcs attributes of every row.
+// Arguments:
+// - size - The dimensions of the buffer
+// Return Value:
+// - The block of cells. Use _GetRowChars and _GetRowDbcsAttrs to find a row in it.
+// Note: may throw exception
+std::unique_ptr<BYTE[]> TextBuffer::_AllocateCells(const COORD size)
+{
+    const size_t cellCount = static_cast<size_t>(size.X) * static_cast<size_t>(size.Y);
+    auto cells = std::make_unique<BYTE[]>(cellCount * (sizeof(wchar_t) + sizeof(DbcsAttribute)));
+
+    std::uninitialized_fill_n(_GetRowChars(cells.get(), size, 0), cellCount, UNICODE_SPACE);
+    std::uninitialized_fill_n(_GetRowDbcsAttrs(cells.get(), size, 0), cellCount, DbcsAttribute{});
+
+    return cells;
+}
+
+// Routine Description:
+// - Finds the characters of a row in a block of cells made by _AllocateCells.
+// Arguments:
+// - cells - The block of cells
+// - size - The dimensions of the buffer the block was allocated for
+// - row - The index of the row's slot in the block
+// Return Value:
+// - The first of the row's size.X characters
+wchar_t* TextBuffer::_GetRowChars(BYTE* const cells, const COORD size, const size_t row) noexcept
+{
+    return reinterpret_cast<wchar_t*>(cells) + row * size.X;
+}
+
+// Routine Description:
+// - Finds the dbcs attributes of a row in a block of cells made by _AllocateCells.
+// Arguments:
+// - cells - The block of cells
+// - size - The dimensions of the buffer the block was allocated for
+// - row - The index of the row's slot in the block
+// Return Value:
+// - The first of the row's size.X dbcs attributes
+DbcsAttribute* TextBuffer::_GetRowDbcsAttrs(BYTE* const cells, const COORD size, const size_t row) noexcept
+{
+    const size_t cellCount = static_cast<size_t>(size.X) * static_cast<size_t>(size.Y);
+    return reinterpret_cast<DbcsAttribute*>(cells + cellCount * sizeof(wchar_t)) + row * size.X;
 }
 
 void TextBuffer::_NotifyPaint(const Viewport& viewport) const
@@ -52,7 +52,7 @@ filling in the last row, and updating the screen.
 #include "cursor.h"
 #include "Row.hpp"
 #include "TextAttribute.hpp"
-#include "UnicodeStorage.hpp"
+#include "TextAttributePalette.hpp"
 #include "../types/inc/Viewport.hpp"
 
 #include "../buffer/out/textBufferCellIterator.hpp"
@@ -122,13 +122,19 @@ public:
 
     void SetCurrentAttributes(const TextAttribute currentAttributes) noexcept;
 
+    void ReplaceAttrs(const TextAttribute& toBeReplacedAttr, const TextAttribute& replaceWith);
+    void ReplaceLegacyAttrs(const WORD wToBeReplacedAttr, const WORD wReplaceWith);
+
+    const TextAttributePalette& GetAttributePalette() const noexcept;
+    TextAttributePalette& GetAttributePalette() noexcept;
+
     void Reset();
 
     [[nodiscard]]
     HRESULT ResizeTraditional(const COORD newSize) noexcept;
 
-    const UnicodeStorage& GetUnicodeStorage() const;
-    UnicodeStorage& GetUnicodeStorage();
+    [[nodiscard]]
+    HRESULT Reflow(const COORD newSize) noexcept;
 
     Microsoft::Console::Render::IRenderTarget& GetRenderTarget();
 
@@ -148,17 +154,49 @@ public:
 
 private:
 
-    std::deque<ROW> _storage;
+    // All the cells of the buffer live in this one allocation: first the characters of
+    // every row, then their dbcs attributes. Each ROW's CharRow is a view of its slice.
+    // Must come before _storage so that it outlives the rows.
+    std::unique_ptr<BYTE[]> _cells;
+
+    // The attribute runs of every row refer to their attributes by an id in here.
+    // Must come before _storage so that it outlives the rows.
+    TextAttributePalette _attributePalette;
+
+    std::vector<ROW> _storage;
     Cursor _cursor;
 
     SHORT _firstRow; // indexes top row (not necessarily 0)
 
     TextAttribute _currentAttributes;
 
-    // storage location for glyphs that can't fit into the buffer normally
-    UnicodeStorage _unicodeStorage;
+    void _RefreshRowIDs();
+    void _RotateRows(const size_t first, const size_t middle, const size_t last);
+
+    // A run of rows that Reflow rewraps on its own. It always starts at the beginning of a line.
+    struct ReflowChunk
+    {
+        size_t firstRow; // the rows of this buffer it covers, by offset
+        size_t endRow;
+        size_t firstOutputRow; // where it starts among all the rows the rewrapped text takes
+        size_t outputRows; // how many rows it moves the cursor down by
+        size_t endColumn; // where it leaves the cursor on the last of them
+        std::optional<std::pair<size_t, size_t>> cursor; // where the old cursor's cell went, as column and output row
+        HRESULT hr;
+    };
+
+    void _ReflowChunk(ReflowChunk& chunk,
+                      const size_t lastRow,
+                      const size_t newWidth,
+                      std::vector<ROW>* const newStorage,
+                      const size_t droppedRows) const;
+
+    void _CompactAttributePalette();
+    void _CompactAttributePaletteIfNeeded() noexcept;
 
-    void _RefreshRowIDs(std::optional<SHORT> newRowWidth);
+    static std::unique_ptr<BYTE[]> _AllocateCells(const COORD size);
+    static wchar_t* _GetRowChars(BYTE* const cells, const COORD size, const size_t row) noexcept;
+    static DbcsAttribute* _GetRowDbcsAttrs(BYTE* const cells, const COORD size, const size_t row) noexcept;
 
     Microsoft::Console::Render::IRenderTarget& _renderTarget;
 
@@ -0,0 +1,96 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "WexTestClass.h"
+#include "../../inc/consoletaeftemplates.hpp"
+
+#include "../TextAttributePalette.hpp"
+
+using namespace WEX::Common;
+using namespace WEX::Logging;
+using namespace WEX::TestExecution;
+
+class TextAttributePaletteTests
+{
+    TEST_CLASS(TextAttributePaletteTests);
+
+    TEST_METHOD(InternsEqualAttributesOnce)
+    {
+        TextAttributePalette palette;
+        const TextAttribute red{ FOREGROUND_RED };
+        const TextAttribute rgb{ RGB(1, 2, 3), RGB(4, 5, 6) };
+
+        // The default attribute is always in there.
+        VERIFY_ARE_EQUAL(1u, palette.Size());
+        VERIFY_ARE_EQUAL(0u, palette.Intern(TextAttribute{}));
+
+        const auto redId = palette.Intern(red);
+        const auto rgbId = palette.Intern(rgb);
+        VERIFY_ARE_NOT_EQUAL(redId, rgbId);
+        VERIFY_ARE_EQUAL(redId, palette.Intern(TextAttribute{ FOREGROUND_RED }));
+        VERIFY_ARE_EQUAL(rgbId, palette.Intern(rgb));
+        VERIFY_ARE_EQUAL(3u, palette.Size());
+
+        VERIFY_ARE_EQUAL(red, palette.Get(redId));
+        VERIFY_ARE_EQUAL(rgb, palette.Get(rgbId));
+    }
+
+    TEST_METHOD(ReplaceChangesOneEntry)
+    {
+        TextAttributePalette palette;
+        const TextAttribute red{ FOREGROUND_RED };
+        const TextAttribute green{ FOREGROUND_GREEN };
+        const TextAttribute blue{ FOREGROUND_BLUE };
+
+        const auto redId = palette.Intern(red);
+        VERIFY_IS_FALSE(palette.Replace(blue, green), L"Attributes that aren't in the palette can't be replaced.");
+
+        VERIFY_IS_TRUE(palette.Replace(red, green));
+        VERIFY_ARE_EQUAL(green, palette.Get(redId));
+        VERIFY_ARE_EQUAL(redId, palette.Intern(green));
+
+        // The old attribute gets a new entry if it comes back.
+        const auto newRedId = palette.Intern(red);
+        VERIFY_ARE_NOT_EQUAL(redId, newRedId);
+        VERIFY_ARE_EQUAL(red, palette.Get(newRedId));
+
+        // Replacing with an attribute that's already in there leaves two ids for it.
+        VERIFY_IS_TRUE(palette.Replace(red, green));
+        VERIFY_ARE_EQUAL(green, palette.Get(newRedId));
+        VERIFY_ARE_EQUAL(green, palette.Get(redId));
+    }
+
+    TEST_METHOD(CompactDropsUnusedEntries)
+    {
+        TextAttributePalette palette;
+        std::vector<TextAttributePalette::id_type> ids;
+        for (BYTE i = 0; i < 16; i++)
+        {
+            ids.push_back(palette.Intern(TextAttribute{ RGB(i, 0, 0), RGB(0, 0, 0) }));
+        }
+        VERIFY_ARE_EQUAL(17u, palette.Size());
+        VERIFY_IS_FALSE(palette.NeedsCompaction());
+
+        // Keep only the odd ones.
+        std::vector<bool> used(palette.Size(), false);
+        for (size_t i = 1; i < ids.size(); i += 2)
+        {
+            used[ids[i]] = true;
+        }
+
+        const auto remap = palette.Compact(used);
+        VERIFY_ARE_EQUAL(9u, palette.Size());
+        for (size_t i = 1; i < ids.size(); i += 2)
+        {
+            VERIFY_ARE_EQUAL((TextAttribute{ RGB(static_cast<BYTE>(i), 0, 0), RGB(0, 0, 0) }), palette.Get(remap[ids[i]]));
+        }
+
+        // Two ids that stood for the same attribute become one.
+        palette.Replace(palette.Get(remap[ids[1]]), palette.Get(remap[ids[3]]));
+        const std::vector<bool> all(palette.Size(), true);
+        const auto merged = palette.Compact(all);
+        VERIFY_ARE_EQUAL(8u, palette.Size());
+        VERIFY_ARE_EQUAL(merged[remap[ids[1]]], merged[remap[ids[3]]]);
+    }
+};
@@ -19,34 +19,89 @@ class UnicodeStorageTests
     TEST_METHOD(CanOverwriteEmoji)
     {
         UnicodeStorage storage;
-        const COORD coord{ 1, 3 };
-        const std::vector<wchar_t> newMoon{ 0xD83C, 0xDF11 };
-        const std::vector<wchar_t> fullMoon{ 0xD83C, 0xDF15 };
+        const size_t column = 3;
+        const std::wstring_view newMoon{ L"\xD83C\xDF11" };
+        const std::wstring_view fullMoon{ L"\xD83C\xDF15" };
 
         // store initial glyph
-        storage.StoreGlyph(coord, newMoon);
+        storage.StoreGlyph(column, newMoon);
 
         // verify it was stored
-        auto findIt = storage._map.find(coord);
-        VERIFY_ARE_NOT_EQUAL(findIt, storage._map.end());
-        const std::vector<wchar_t>& newMoonGlyph = findIt->second;
-        VERIFY_ARE_EQUAL(newMoonGlyph.size(), newMoon.size());
-        for (size_t i = 0; i < newMoon.size(); ++i)
+        VERIFY_ARE_EQUAL(1u, storage.Size());
+        VERIFY_ARE_EQUAL(String(newMoon.data(), 2), String(storage.GetText(column).data(), gsl::narrow<int>(storage.GetText(column).size())));
+
+        // overwrite it
+        storage.StoreGlyph(column, fullMoon);
+
+        // verify the glyph was overwritten, in place since it's the same length
+        VERIFY_ARE_EQUAL(1u, storage.Size());
+        VERIFY_ARE_EQUAL(String(fullMoon.data(), 2), String(storage.GetText(column).data(), gsl::narrow<int>(storage.GetText(column).size())));
+        VERIFY_ARE_EQUAL(2u, storage._arena.size());
+    }
+
+    TEST_METHOD(CanEraseAndTruncate)
+    {
+        UnicodeStorage storage;
+        const std::wstring_view newMoon{ L"\xD83C\xDF11" };
+
+        storage.StoreGlyph(7, newMoon);
+        storage.StoreGlyph(70, newMoon);
+        VERIFY_ARE_EQUAL(2u, storage.Size());
+
+        // Narrow the row so the second glyph falls off the end.
+        storage.Truncate(40);
+        VERIFY_ARE_EQUAL(1u, storage.Size());
+        VERIFY_ARE_EQUAL(2u, storage.GetText(7).size());
+        VERIFY_THROWS_SPECIFIC(storage.GetText(70), wil::ResultException, [](wil::ResultException& e) { return e.GetErrorCode() == E_INVALIDARG; });
+
+        // Erasing the last glyph gives back the arena for the next one.
+        storage.Erase(7);
+        VERIFY_ARE_EQUAL(0u, storage.Size());
+        VERIFY_IS_TRUE(storage._arena.empty());
+        VERIFY_IS_TRUE(storage._slots.empty());
+        VERIFY_THROWS_SPECIFIC(storage.GetText(7), wil::ResultException, [](wil::ResultException& e) { return e.GetErrorCode() == E_INVALIDARG; });
+    }
+
+    TEST_METHOD(ReplacedGlyphsAreCompacted)
+    {
+        UnicodeStorage storage;
+        const std::wstring_view family{ L"\xD83D\xDC68\x200D\xD83D\xDC69\x200D\xD83D\xDC67" };
+
+        // Alternate between a short and a long glyph, so the long one never fits in place.
+        for (size_t i = 0; i < 1000; ++i)
         {
-            VERIFY_ARE_EQUAL(newMoonGlyph.at(i), newMoon.at(i));
+            for (size_t column = 0; column < 4; ++column)
+            {
+                storage.StoreGlyph(column, family.substr(0, 2));
+                storage.StoreGlyph(column, family);
+            }
         }
 
-        // overwrite it
-        storage.StoreGlyph(coord, fullMoon);
-
-        // verify the glyph was overwritten
-        findIt = storage._map.find(coord);
-        VERIFY_ARE_NOT_EQUAL(findIt, storage._map.end());
-        const std::vector<wchar_t>& fullMoonGlyph = findIt->second;
-        VERIFY_ARE_EQUAL(fullMoonGlyph.size(), fullMoon.size());
-        for (size_t i = 0; i < fullMoon.size(); ++i)
+        VERIFY_ARE_EQUAL(4u, storage.Size());
+        for (size_t column = 0; column < 4; ++column)
+        {
+            const auto text = storage.GetText(column);
+            VERIFY_ARE_EQUAL(String(family.data(), gsl::narrow<int>(family.size())), String(text.data(), gsl::narrow<int>(text.size())));
+        }
+        VERIFY_IS_LESS_THAN_OR_EQUAL(storage._arena.size(), 2 * 4 * family.size() + 64);
+    }
+
+    TEST_METHOD(CanStoreGlyphFromItself)
+    {
+        UnicodeStorage storage;
+        const std::wstring_view newMoon{ L"\xD83C\xDF11" };
+        storage.StoreGlyph(0, newMoon);
+
+        // Copy the glyph to enough other columns that the arena has to grow underneath it.
+        for (size_t column = 1; column < 100; ++column)
+        {
+            storage.StoreGlyph(column, storage.GetText(0));
+        }
+
+        for (size_t column = 0; column < 100; ++column)
         {
-            VERIFY_ARE_EQUAL(fullMoonGlyph.at(i), fullMoon.at(i));
+            const auto text = storage.GetText(column);
+            VERIFY_ARE_EQUAL(String(newMoon.data(), 2), String(text.data(), gsl::narrow<int>(text.size())));
         }
     }
 };
@@ -47,7 +47,12 @@ Terminal::Terminal() :
     _selectionAnchor{ 0, 0 },
     _endSelectionPosition { 0, 0 }
 {
-    _stateMachine = std::make_unique<StateMachine>(new OutputStateMachineEngine(new TerminalDispatch(*this)));
+    auto engine = std::make_unique<OutputStateMachineEngine>(new TerminalDispatch(*this));
+    // Write holds the write lock across the whole string, so nobody can observe
+    //      the buffer between two of its sequences. Let the parser hand us
+    //      everything from a string at once instead of one call per sequence.
+    engine->SetDispatchInBatches(true);
+    _stateMachine = std::make_unique<StateMachine>(engine.release());
 
     auto passAlongInput = [&](std::deque<std::unique_ptr<IInputEvent>>& inEventsToWrite)
     {
@@ -136,7 +141,9 @@ void Terminal::UpdateSettings(winrt::Microsoft::Terminal::Settings::ICoreSetting
 }
 
 // Method Description:
-// - Resize the terminal as the result of some user interaction.
+// - Resize the terminal as the result of some user interaction. The lines in
+//   the buffer are rewrapped to the new width, and the viewport is moved so
+//   that the cursor stays the same distance from the top of it.
 // Arguments:
 // - viewportSize: the new size of the viewport, in chars
 // Return Value:
@@ -154,11 +161,17 @@ HRESULT Terminal::UserResize(const COORD viewportSize) noexcept
 
     const auto oldTop = _mutableViewport.Top();
 
+    // Remember how far down the viewport the cursor was, so it can be put back
+    // there after the lines have moved.
+    const auto oldCursorY = _buffer->GetCursor().GetPosition().Y;
+    const auto cursorHeightInViewport = std::clamp(oldCursorY - oldTop, 0, viewportSize.Y - 1);
+
     const short newBufferHeight = viewportSize.Y + _scrollbackLines;
     COORD bufferSize{ viewportSize.X, newBufferHeight };
-    RETURN_IF_FAILED(_buffer->ResizeTraditional(bufferSize));
+    RETURN_IF_FAILED(_buffer->Reflow(bufferSize));
 
-    auto proposedTop = oldTop;
+    const auto newCursorY = _buffer->GetCursor().GetPosition().Y;
+    auto proposedTop = gsl::narrow<short>(std::max(newCursorY - cursorHeightInViewport, 0));
     const auto newView = Viewport::FromDimensions({ 0, proposedTop }, viewportSize);
     const auto proposedBottom = newView.BottomExclusive();
     // If the new bottom would be below the bottom of the buffer, then slide the
@@ -182,6 +195,21 @@ void Terminal::Write(std::wstring_view stringView)
     _stateMachine->ProcessString(stringView.data(), stringView.size());
 }
 
+// Method Description:
+// - Writes UTF-8 output, straight from a connection, through the parser. Only
+//   the printable text gets converted to UTF-16, so there's no need to convert
+//   the whole thing to a wstring before calling Write.
+//   A character split between two writes is held by the parser until the rest
+//   of it arrives.
+// Arguments:
+// - stringView: The UTF-8 encoded output.
+void Terminal::WriteUtf8(std::string_view stringView)
+{
+    auto lock = LockForWriting();
+
+    _stateMachine->ProcessUtf8(stringView.data(), stringView.size());
+}
+
 // Method Description:
 // - Send this particular key event to the terminal. The terminal will translate
 //   the key and the modifiers pressed into the appropriate VT sequence for that
@@ -296,8 +324,14 @@ Viewport Terminal::_GetVisibleViewport() const noexcept
                                     _mutableViewport.Dimensions());
 }
 
+// The control characters _WriteBuffer handles itself. Everything else is printed.
+static constexpr wchar_t s_controlChars[] = { UNICODE_LINEFEED, UNICODE_CARRIAGERETURN, UNICODE_BACKSPACE };
+
 // Writes a string of text to the buffer, then moves the cursor (and viewport)
 //      in accordance with the written text.
+// Printable text is written a whole run at a time: each run is measured and
+//      written into the current row in one call, and wraps onto the next row
+//      (circling the buffer if needed) when the row fills up.
 // This method is our proverbial `WriteCharsLegacy`, and great care should be made to
 //      keep it minimal and orderly, lest it become WriteCharsLegacy2ElectricBoogaloo
 // TODO: MSFT 21006766
@@ -308,25 +342,38 @@ void Terminal::_WriteBuffer(const std::wstring_view& stringView)
 {
     auto& cursor = _buffer->GetCursor();
     const Viewport bufferSize = _buffer->GetSize();
+    const TextAttribute attributes = _buffer->GetCurrentAttributes();
+
+    // Track the cursor locally and only move the real one once we're done.
+    // Likewise, if anything scrolled, only tell the renderer and the scrollbar once.
+    COORD proposedCursorPosition = cursor.GetPosition();
+    bool notifyScroll = false;
 
-    for (size_t i = 0; i < stringView.size(); i++)
+    size_t i = 0;
+    while (i < stringView.size())
     {
-        wchar_t wch = stringView[i];
-        const COORD cursorPosBefore = cursor.GetPosition();
-        COORD proposedCursorPosition = cursorPosBefore;
-        bool notifyScroll = false;
+        const wchar_t wch = stringView[i];
+
+        // A cursor left just past the right edge by a full row is really on the last
+        // column. Only printing more text wraps it onto the next row.
+        if (wch == UNICODE_LINEFEED || wch == UNICODE_BACKSPACE)
+        {
+            proposedCursorPosition.X = std::min(proposedCursorPosition.X, bufferSize.RightInclusive());
+        }
 
         if (wch == UNICODE_LINEFEED)
         {
             proposedCursorPosition.Y++;
+            i++;
         }
         else if (wch == UNICODE_CARRIAGERETURN)
         {
             proposedCursorPosition.X = 0;
+            i++;
         }
         else if (wch == UNICODE_BACKSPACE)
         {
-            if (cursorPosBefore.X == 0)
+            if (proposedCursorPosition.X == 0)
             {
                 proposedCursorPosition.X = bufferSize.Width() - 1;
                 proposedCursorPosition.Y--;
@@ -335,61 +382,102 @@ void Terminal::_WriteBuffer(const std::wstring_view& stringView)
             {
                 proposedCursorPosition.X--;
             }
+            i++;
         }
         else
         {
-            // TODO: MSFT 21006766
-            // This is not great but I need it demoable. Fix by making a buffer stream writer.
-            if (wch >= 0xD800 && wch <= 0xDFFF)
-            {
-                OutputCellIterator it{ stringView.substr(i, 2) , _buffer->GetCurrentAttributes() };
-                const auto end = _buffer->Write(it);
-                const auto cellDistance = end.GetCellDistance(it);
-                i += cellDistance - 1;
-                proposedCursorPosition.X += gsl::narrow<SHORT>(cellDistance);
-            }
-            else
+            // Everything up to the next control character we handle is one printable run.
+            const auto runEnd = std::min(stringView.find_first_of(s_controlChars, i, std::size(s_controlChars)), stringView.size());
+
+            // If the last run filled the row right up to the edge, it's time to wrap.
+            if (proposedCursorPosition.X > bufferSize.RightInclusive())
             {
-                OutputCellIterator it{ stringView.substr(i, 1) , _buffer->GetCurrentAttributes() };
-                const auto end = _buffer->Write(it);
-                const auto cellDistance = end.GetCellDistance(it);
-                proposedCursorPosition.X += gsl::narrow<SHORT>(cellDistance);
+                _buffer->GetRowByOffset(proposedCursorPosition.Y).GetCharRow().SetWrapForced(true);
+                proposedCursorPosition.X = 0;
+                proposedCursorPosition.Y++;
+                _AdvanceToCursorRow(proposedCursorPosition, notifyScroll);
             }
-        }
 
-        // If we're about to scroll past the bottom of the buffer, instead cycle the buffer.
-        const auto newRows = proposedCursorPosition.Y - bufferSize.Height() + 1;
-        if (newRows > 0)
-        {
-            for(auto dy = 0; dy < newRows; dy++)
+            // Write as much of the run as fits in the rest of this row in one go.
+            // The iterator measures the glyphs as it goes, so it stops exactly at the edge.
+            const OutputCellIterator it{ stringView.substr(i, runEnd - i), attributes };
+            const auto end = _buffer->WriteLine(it, proposedCursorPosition, false);
+            const auto consumed = gsl::narrow<size_t>(end.GetInputDistance(it));
+            proposedCursorPosition.X += gsl::narrow<SHORT>(end.GetCellDistance(it));
+            i += consumed;
+
+            if (i < runEnd)
             {
-                _buffer->IncrementCircularBuffer();
-                proposedCursorPosition.Y--;
+                // The row is full. If not even one glyph fit on an empty row (a
+                // wide glyph in a one column buffer), drop it rather than wrapping forever.
+                if (consumed == 0 && proposedCursorPosition.X == 0)
+                {
+                    const bool isSurrogatePair = i + 1 < runEnd && stringView[i + 1] >= 0xDC00 && stringView[i + 1] <= 0xDFFF;
+                    i += isSurrogatePair ? 2 : 1;
+                    continue;
+                }
+
+                // The rest of the run continues on the next row. If it stopped short of
+                // the edge, a wide glyph didn't fit in the last column, which stays empty.
+                auto& charRow = _buffer->GetRowByOffset(proposedCursorPosition.Y).GetCharRow();
+                charRow.SetWrapForced(true);
+                if (proposedCursorPosition.X <= bufferSize.RightInclusive())
+                {
+                    charRow.SetDoubleBytePadded(true);
+                }
+                proposedCursorPosition.X = 0;
+                proposedCursorPosition.Y++;
             }
-            notifyScroll = true;
         }
 
-        // This section is essentially equivalent to `AdjustCursorPosition`
-        // Update Cursor Position
-        cursor.SetPosition(proposedCursorPosition);
+        _AdvanceToCursorRow(proposedCursorPosition, notifyScroll);
+    }
+
+    // This section is essentially equivalent to `AdjustCursorPosition`
+    // Update Cursor Position
+    cursor.SetPosition(proposedCursorPosition);
+
+    if (notifyScroll)
+    {
+        _buffer->GetRenderTarget().TriggerRedrawAll();
+        _NotifyScrollEvent();
+    }
+}
 
-        const COORD cursorPosAfter = cursor.GetPosition();
+// Method Description:
+// - Makes sure the row the cursor is about to move to exists, circling the
+//   buffer if the cursor is about to move past the bottom of it, then moves
+//   the viewport down if the cursor moved below it.
+// Arguments:
+// - proposedCursorPosition: The position the cursor is about to move to. Moved
+//   up by one row for every row the buffer circled.
+// - notifyScroll: Set to true if the buffer circled or the viewport moved.
+// Return Value:
+// - <none>
+void Terminal::_AdvanceToCursorRow(COORD& proposedCursorPosition, bool& notifyScroll)
+{
+    const Viewport bufferSize = _buffer->GetSize();
 
-        // Move the viewport down if the cursor moved below the viewport.
-        if (cursorPosAfter.Y > _mutableViewport.BottomInclusive())
+    // If we're about to scroll past the bottom of the buffer, instead cycle the buffer.
+    const auto newRows = proposedCursorPosition.Y - bufferSize.Height() + 1;
+    if (newRows > 0)
+    {
+        for (auto dy = 0; dy < newRows; dy++)
         {
-            const auto newViewTop = std::max(0, cursorPosAfter.Y - (_mutableViewport.Height() - 1));
-            if (newViewTop != _mutableViewport.Top())
-            {
-                _mutableViewport = Viewport::FromDimensions({0, gsl::narrow<short>(newViewTop)}, _mutableViewport.Dimensions());
-                notifyScroll = true;
-            }
+            _buffer->IncrementCircularBuffer();
         }
+        proposedCursorPosition.Y -= gsl::narrow<SHORT>(newRows);
+        notifyScroll = true;
+    }
 
-        if (notifyScroll)
+    // Move the viewport down if the cursor moved below the viewport.
+    if (proposedCursorPosition.Y > _mutableViewport.BottomInclusive())
+    {
+        const auto newViewTop = std::max(0, proposedCursorPosition.Y - (_mutableViewport.Height() - 1));
+        if (newViewTop != _mutableViewport.Top())
         {
-            _buffer->GetRenderTarget().TriggerRedrawAll();
-            _NotifyScrollEvent();
+            _mutableViewport = Viewport::FromDimensions({0, gsl::narrow<short>(newViewTop)}, _mutableViewport.Dimensions());
+            notifyScroll = true;
         }
     }
 }
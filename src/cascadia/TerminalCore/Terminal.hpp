@@ -27,6 +27,11 @@ namespace Microsoft::Terminal::Core
     class Terminal;
 }
 
+namespace TerminalCoreUnitTests
+{
+    class TerminalApiTest;
+}
+
 class Microsoft::Terminal::Core::Terminal final :
     public Microsoft::Terminal::Core::ITerminalApi,
     public Microsoft::Terminal::Core::ITerminalInput,
@@ -47,6 +52,7 @@ public:
 
     // Write goes through the parser
     void Write(std::wstring_view stringView);
+    void WriteUtf8(std::string_view stringView);
 
     [[nodiscard]]
     std::shared_lock<std::shared_mutex> LockForReading();
@@ -180,9 +186,12 @@ public:
     void _InitializeColorTable();
 
     void _WriteBuffer(const std::wstring_view& stringView);
+    void _AdvanceToCursorRow(COORD& proposedCursorPosition, bool& notifyScroll);
 
     void _NotifyScrollEvent();
 
     std::vector<SMALL_RECT> _GetSelectionRects() const;
+
+    friend class TerminalCoreUnitTests::TerminalApiTest;
 };
 
@@ -0,0 +1,217 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include <WexTestClass.h>
+#include <chrono>
+
+#include "../cascadia/TerminalCore/Terminal.hpp"
+#include "../terminal/parser/OutputStateMachineEngine.hpp"
+#include "../renderer/inc/DummyRenderTarget.hpp"
+#include "consoletaeftemplates.hpp"
+#include "PerfTestHelper.hpp"
+
+using namespace WEX::Logging;
+using namespace WEX::TestExecution;
+using namespace WEX::Common;
+
+using namespace Microsoft::Terminal::Core;
+using namespace Microsoft::Console::Render;
+using namespace Microsoft::Console::VirtualTerminal;
+
+namespace TerminalCoreUnitTests
+{
+    class TerminalApiTest
+    {
+        TEST_CLASS(TerminalApiTest);
+
+        TEST_METHOD(PrintedTextWrapsAtTheRightEdge)
+        {
+            Terminal term;
+            DummyRenderTarget emptyRT;
+            term.Create({ 10, 5 }, 0, emptyRT);
+
+            term.Write(L"0123456789ABC");
+
+            const auto& buffer = term.GetTextBuffer();
+            VERIFY_ARE_EQUAL(std::wstring{ L"0123456789" }, buffer.GetRowByOffset(0).GetText());
+            VERIFY_ARE_EQUAL(std::wstring{ L"ABC" }, buffer.GetRowByOffset(1).GetText().substr(0, 3));
+
+            const auto cursorPos = buffer.GetCursor().GetPosition();
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(3), cursorPos.X);
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(1), cursorPos.Y);
+        }
+
+        TEST_METHOD(FillingTheRowDoesNotWrapUntilMoreTextArrives)
+        {
+            Terminal term;
+            DummyRenderTarget emptyRT;
+            term.Create({ 10, 5 }, 0, emptyRT);
+
+            // A line that exactly fills the row followed by a newline mustn't leave a blank row behind.
+            term.Write(L"0123456789\r\nA");
+
+            const auto& buffer = term.GetTextBuffer();
+            VERIFY_ARE_EQUAL(std::wstring{ L"0123456789" }, buffer.GetRowByOffset(0).GetText());
+            VERIFY_ARE_EQUAL(L'A', buffer.GetRowByOffset(1).GetText().at(0));
+
+            const auto cursorPos = buffer.GetCursor().GetPosition();
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(1), cursorPos.X);
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(1), cursorPos.Y);
+
+            // The newline ended the line, so the full row isn't wrapped onto the next one.
+            VERIFY_IS_FALSE(buffer.GetRowByOffset(0).GetCharRow().WasWrapForced());
+
+            // Only text that really continues past the edge wraps the row.
+            term.Write(L"\r\n0123456789A");
+            VERIFY_IS_TRUE(buffer.GetRowByOffset(2).GetCharRow().WasWrapForced());
+            VERIFY_ARE_EQUAL(L'A', buffer.GetRowByOffset(3).GetText().at(0));
+        }
+
+        TEST_METHOD(WritingPastTheBottomCirclesTheBuffer)
+        {
+            Terminal term;
+            DummyRenderTarget emptyRT;
+            term.Create({ 10, 3 }, 0, emptyRT);
+
+            // The last run wraps twice, circling the buffer once for each row it needs.
+            term.Write(L"a\r\nb\r\nc\r\n0123456789ABCDEFGHIJK");
+
+            const auto& buffer = term.GetTextBuffer();
+            VERIFY_ARE_EQUAL(std::wstring{ L"0123456789" }, buffer.GetRowByOffset(0).GetText());
+            VERIFY_ARE_EQUAL(std::wstring{ L"ABCDEFGHIJ" }, buffer.GetRowByOffset(1).GetText());
+            VERIFY_ARE_EQUAL(L'K', buffer.GetRowByOffset(2).GetText().at(0));
+
+            const auto cursorPos = buffer.GetCursor().GetPosition();
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(1), cursorPos.X);
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(2), cursorPos.Y);
+        }
+
+        TEST_METHOD(WideGlyphThatDoesNotFitPadsTheRow)
+        {
+            Terminal term;
+            DummyRenderTarget emptyRT;
+            term.Create({ 10, 5 }, 0, emptyRT);
+
+            // Nine narrow characters leave one column, too few for the wide one after them.
+            term.Write(L"012345678\x30ab");
+
+            const auto& buffer = term.GetTextBuffer();
+            const auto& firstRow = buffer.GetRowByOffset(0).GetCharRow();
+            VERIFY_IS_TRUE(firstRow.WasWrapForced());
+            VERIFY_IS_TRUE(firstRow.WasDoubleBytePadded());
+            VERIFY_ARE_EQUAL(std::wstring{ L"\x30ab" }, buffer.GetRowByOffset(1).GetText().substr(0, 1));
+
+            const auto cursorPos = buffer.GetCursor().GetPosition();
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(2), cursorPos.X);
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(1), cursorPos.Y);
+        }
+
+        TEST_METHOD(WriteUtf8HoldsSplitCharacters)
+        {
+            Terminal term;
+            DummyRenderTarget emptyRT;
+            term.Create({ 10, 5 }, 0, emptyRT);
+
+            // The sequence and the three byte character are both cut in half between the writes.
+            term.WriteUtf8("A\x1b[1");
+            term.WriteUtf8("mB\xe3\x82");
+            term.WriteUtf8("\xab");
+
+            const auto& buffer = term.GetTextBuffer();
+            VERIFY_ARE_EQUAL(std::wstring{ L"AB\x30ab" }, buffer.GetRowByOffset(0).GetText().substr(0, 3));
+
+            const auto cursorPos = buffer.GetCursor().GetPosition();
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(4), cursorPos.X);
+            VERIFY_ARE_EQUAL(static_cast<SHORT>(0), cursorPos.Y);
+        }
+
+        TEST_METHOD(WriteThroughput)
+        {
+            BEGIN_TEST_METHOD_PROPERTIES()
+                TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+            END_TEST_METHOD_PROPERTIES()
+
+            // Plain text with some lines longer than the row, so both newlines and wrapping get exercised.
+            std::wstring line;
+            std::wstring text;
+            while (text.size() < 16 * 1024 * 1024)
+            {
+                line.append(L"The quick brown fox jumps over the lazy dog. ");
+                if (line.size() > 200)
+                {
+                    line.clear();
+                }
+                text.append(line);
+                text.append(L"\r\n");
+            }
+
+            // Once one character at a time, the way the buffer used to be written, then in whole runs.
+            for (const bool fWholeRuns : { false, true })
+            {
+                Terminal term;
+                DummyRenderTarget emptyRT;
+                term.Create({ 120, 30 }, 1000, emptyRT);
+
+                const auto start = std::chrono::steady_clock::now();
+                if (fWholeRuns)
+                {
+                    term._WriteBuffer(text);
+                }
+                else
+                {
+                    for (const auto& wch : text)
+                    {
+                        term._WriteBuffer({ &wch, 1 });
+                    }
+                }
+                const auto delta = PerfTestHelper::Microseconds(start, std::chrono::steady_clock::now());
+
+                const auto megabytes = static_cast<double>(text.size() * sizeof(wchar_t)) / (1024 * 1024);
+                Log::Comment(NoThrowString().Format(L"%s: wrote %.1f MB of text in %lld us (%.1f MB/s).",
+                                                    fWholeRuns ? L"Whole runs" : L"One character at a time",
+                                                    megabytes,
+                                                    delta,
+                                                    megabytes * 1000000 / std::max<long long>(delta, 1)));
+            }
+        }
+
+        TEST_METHOD(BatchedDispatchThroughput)
+        {
+            BEGIN_TEST_METHOD_PROPERTIES()
+                TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+            END_TEST_METHOD_PROPERTIES()
+
+            // Colored build output: short runs of text between SGRs, so there are many actions in every write.
+            std::wstring text;
+            while (text.size() < 4 * 1024 * 1024)
+            {
+                text.append(L"\x1b[32m  OK  \x1b[m src\\host\\_stream.cpp \x1b[1;33mwarning\x1b[m C4244: conversion\r\n");
+            }
+
+            for (const bool fBatched : { false, true })
+            {
+                Terminal term;
+                DummyRenderTarget emptyRT;
+                term.Create({ 120, 30 }, 1000, emptyRT);
+                static_cast<OutputStateMachineEngine&>(term._stateMachine->Engine()).SetDispatchInBatches(fBatched);
+
+                // Written in pieces the size of a read from the pty's pipe.
+                const size_t cchChunk = 4096;
+                const auto start = std::chrono::steady_clock::now();
+                for (size_t pos = 0; pos < text.size(); pos += cchChunk)
+                {
+                    term.Write({ text.data() + pos, std::min(cchChunk, text.size() - pos) });
+                }
+                const auto delta = PerfTestHelper::Microseconds(start, std::chrono::steady_clock::now());
+
+                const auto megabytes = static_cast<double>(text.size() * sizeof(wchar_t)) / (1024 * 1024);
+                Log::Comment(NoThrowString().Format(L"%s: wrote %.1f MB of colored text in %lld us (%.1f MB/s).",
+                                                    fBatched ? L"Batched" : L"Dispatched one at a time",
+                                                    megabytes,
+                                                    delta,
+                                                    megabytes * 1000000 / std::max<long long>(delta, 1)));
+            }
+        }
+    };
+}
@@ -68,16 +68,22 @@ HRESULT VtInputThread::_HandleRunInput(_In_reads_(cch) const byte* const charBuf
 
     try
     {
-        std::unique_ptr<wchar_t[]> pwsSequence;
+        // The conversion buffer is kept between reads, so it's only ever grown, not reallocated every time.
+        const size_t cchNeeded = _utf8Parser.GetMaxConvertedLength(cch);
+        if (_convertedBuffer.size() < cchNeeded)
+        {
+            _convertedBuffer.resize(cchNeeded);
+        }
+
         unsigned int cchConsumed;
         unsigned int cchSequence;
-        auto hr = _utf8Parser.Parse(charBuffer, cch, cchConsumed, pwsSequence, cchSequence);
+        auto hr = _utf8Parser.Parse(charBuffer, cch, cchConsumed, _convertedBuffer.data(), _convertedBuffer.size(), cchSequence);
         // If we hit a parsing error, eat it. It's bad utf-8, we can't do anything with it.
         if (FAILED(hr))
         {
             return S_FALSE;
         }
-        _pInputStateMachine->ProcessString(pwsSequence.get(), cchSequence);
+        _pInputStateMachine->ProcessString(_convertedBuffer.data(), cchSequence);
     }
     CATCH_RETURN();
 
@@ -43,5 +43,6 @@ namespace Microsoft::Console
 
         std::unique_ptr<StateMachine> _pInputStateMachine;
         Utf8ToWideCharParser _utf8Parser;
+        std::vector<wchar_t> _convertedBuffer;
     };
 }
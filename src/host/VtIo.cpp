@@ -363,14 +363,23 @@ void VtIo::CloseOutput()
 
     Globals& g = ServiceLocator::LocateGlobals();
     // DON'T RemoveRenderEngine, as that requires the engine list lock, and this
-    // is usually being triggered on a paint operation, when the lock is already
+    // may be triggered during a paint operation, when the lock is already
     // owned by the paint.
     // Instead we're releasing the Engine here. A pointer to it has already been
     // given to the Renderer, so we don't want the unique_ptr to delete it. The
     // Renderer will own it's lifetime now.
     _pVtRenderEngine.release();
 
-    g.getConsoleInformation().GetActiveOutputBuffer().SetTerminalConnection(nullptr);
+    // This is called from the thread pool once the VT renderer's pipe writer
+    // sees the pipe break, so we don't hold the console lock. Only hold it
+    // while we touch the buffer - we mustn't hold it into _ShutdownIfNeeded,
+    // which waits for the paint thread.
+    {
+        CONSOLE_INFORMATION& gci = g.getConsoleInformation();
+        gci.LockConsole();
+        auto unlock = wil::scope_exit([&] { gci.UnlockConsole(); });
+        gci.GetActiveOutputBuffer().SetTerminalConnection(nullptr);
+    }
 
     _ShutdownIfNeeded();
 }
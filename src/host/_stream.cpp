@@ -1142,6 +1142,24 @@ HRESULT ApiRoutines::WriteConsoleAImpl(IConsoleOutputObject& context,
         parser.SetCodePage(gci.OutputCP);
 
         SCREEN_INFORMATION& ScreenInfo = context.GetActiveBuffer();
+
+        // UTF-8 written in VT mode doesn't need to be converted up front. The
+        //      state machine parses the sequences straight off the bytes, and
+        //      only converts the text it prints. It holds on to a character
+        //      split across two writes itself.
+        // If the write has to wait, or the parser is holding part of a
+        //      character from a write that wasn't in VT mode, go the long way.
+        if (codepage == CP_UTF8 &&
+            WI_IsFlagSet(ScreenInfo.OutputMode, ENABLE_VIRTUAL_TERMINAL_PROCESSING) &&
+            WI_IsFlagSet(ScreenInfo.OutputMode, ENABLE_PROCESSED_OUTPUT) &&
+            WI_AreAllFlagsClear(gci.Flags, (CONSOLE_SUSPENDED | CONSOLE_SELECTING | CONSOLE_SCROLLBAR_TRACKING)) &&
+            !parser.IsPartialSequencePending())
+        {
+            ScreenInfo.GetStateMachine().ProcessUtf8(buffer.data(), buffer.size());
+            read = buffer.size();
+            return S_OK;
+        }
+
         wchar_t* pwchBuffer;
         size_t cchBuffer;
         if (codepage == CP_UTF8)
@@ -26,7 +26,8 @@ Search::Search(const SCREEN_INFORMATION& screenInfo,
     _direction(direction),
     _sensitivity(sensitivity),
     _screenInfo(screenInfo),
-    _needle(s_CreateNeedleFromString(str)),
+    _needleText(str),
+    _needle(s_CreateNeedleFromString(_needleText)),
     _coordAnchor(s_GetInitialAnchor(screenInfo, direction))
 {
     _coordNext = _coordAnchor;
@@ -50,7 +51,8 @@ Search::Search(const SCREEN_INFORMATION& screenInfo,
     _direction(direction),
     _sensitivity(sensitivity),
     _screenInfo(screenInfo),
-    _needle(s_CreateNeedleFromString(str)),
+    _needleText(str),
+    _needle(s_CreateNeedleFromString(_needleText)),
     _coordAnchor(anchor)
 {
     _coordNext = _coordAnchor;
@@ -185,10 +187,8 @@ bool Search::_FindNeedleInHaystackAt(const COORD pos, COORD& start, COORD& end)
         // Haystack is the buffer. Needle is the string we were given.
         const auto hayIter = _screenInfo.GetTextDataAt(bufferPos);
         const auto hayChars = *hayIter;
-        const auto needleChars = std::wstring_view(needleCell.data(), needleCell.size());
-
         // If we didn't match at any point of the needle, return false.
-        if (!_CompareChars(hayChars, needleChars))
+        if (!_CompareChars(hayChars, needleCell))
         {
             return false;
         }
@@ -295,14 +295,14 @@ void Search::_UpdateNextPosition()
 // Arguments:
 // - wstr - String that will be our search term
 // Return Value:
-// - Structured text data for comparison to screen buffer text data.
-std::vector<std::vector<wchar_t>> Search::s_CreateNeedleFromString(const std::wstring& wstr)
+// - Structured text data for comparison to screen buffer text data. These are views
+//   into wstr, so it has to outlive them.
+std::vector<std::wstring_view> Search::s_CreateNeedleFromString(const std::wstring& wstr)
 {
-    const auto charData = Utf16Parser::Parse(wstr);
-    std::vector<std::vector<wchar_t>> cells;
-    for (const auto chars : charData)
+    std::vector<std::wstring_view> cells;
+    for (const auto chars : Utf16Parser::Parse(wstr))
     {
-        if (IsGlyphFullWidth(std::wstring_view{ chars.data(), chars.size() }))
+        if (IsGlyphFullWidth(chars))
         {
             cells.emplace_back(chars);
         }
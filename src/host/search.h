@@ -46,6 +46,10 @@ public:
            const Sensitivity sensitivity,
            const COORD anchor);
 
+    // _needle points into our own _needleText, so a copy would point into the original.
+    Search(const Search&) = delete;
+    Search& operator=(const Search&) = delete;
+
     bool FindNext();
     void Select() const;
     void Color(const TextAttribute attr) const;
@@ -63,7 +67,7 @@ private:
     void _DecrementCoord(COORD& coord) const;
 
     static COORD s_GetInitialAnchor(const SCREEN_INFORMATION& screenInfo, const Direction dir);
-    static std::vector<std::vector<wchar_t>> s_CreateNeedleFromString(const std::wstring& wstr);
+    static std::vector<std::wstring_view> s_CreateNeedleFromString(const std::wstring& wstr);
 
     bool _reachedEnd = false;
     COORD _coordNext = { 0 };
@@ -71,7 +75,8 @@ private:
     COORD _coordSelEnd = { 0 };
 
     const COORD _coordAnchor;
-    const std::vector<std::vector<wchar_t>> _needle;
+    const std::wstring _needleText;
+    const std::vector<std::wstring_view> _needle; // One view into _needleText per cell. Must come after _needleText.
     const Direction _direction;
     const Sensitivity _sensitivity;
     const SCREEN_INFORMATION& _screenInfo;
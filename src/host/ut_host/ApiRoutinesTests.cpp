@@ -416,6 +416,46 @@ class ApiRoutinesTests
         }
     }
 
+    TEST_METHOD(ApiWriteConsoleAUtf8InVtMode)
+    {
+        CONSOLE_INFORMATION& gci = ServiceLocator::LocateGlobals().getConsoleInformation();
+        SCREEN_INFORMATION& si = gci.GetActiveOutputBuffer();
+
+        gci.LockConsole();
+        auto Unlock = wil::scope_exit([&] { gci.UnlockConsole(); });
+
+        gci.OutputCP = CP_UTF8;
+        SetConsoleCPInfo(TRUE);
+
+        const auto originalMode = si.OutputMode;
+        WI_SetAllFlags(si.OutputMode, ENABLE_VIRTUAL_TERMINAL_PROCESSING | ENABLE_PROCESSED_OUTPUT);
+        auto restoreMode = wil::scope_exit([&] { si.OutputMode = originalMode; });
+
+        const COORD origin = si.GetTextBuffer().GetCursor().GetPosition();
+
+        Log::Comment(L"A sequence and a character are split across two writes, and all of both writes is consumed.");
+        const std::string_view first{ "A\x1b[1", 5 };
+        const std::string_view second{ "mB\xe3\x82", 4 };
+        const std::string_view third{ "\xab", 1 };
+        for (const auto text : { first, second, third })
+        {
+            size_t cchRead = 0;
+            std::unique_ptr<IWaitRoutine> waiter;
+            VERIFY_SUCCEEDED(_pApiRoutines->WriteConsoleAImpl(si, text, cchRead, waiter));
+            VERIFY_IS_NULL(waiter.get());
+            VERIFY_ARE_EQUAL(text.size(), cchRead);
+        }
+
+        Log::Comment(L"The sequence was run, not printed, and the character came out whole.");
+        auto it = si.GetCellDataAt(origin);
+        VERIFY_ARE_EQUAL(L"A", it->Chars());
+        it++;
+        VERIFY_ARE_EQUAL(L"B", it->Chars());
+        it++;
+        VERIFY_ARE_EQUAL(L"\x30ab", it->Chars());
+        VERIFY_ARE_EQUAL(COORD({ gsl::narrow<SHORT>(origin.X + 4), origin.Y }), si.GetTextBuffer().GetCursor().GetPosition());
+    }
+
     TEST_METHOD(ApiWriteConsoleW)
     {
         BEGIN_TEST_METHOD_PROPERTIES()
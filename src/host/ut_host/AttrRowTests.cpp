@@ -6,12 +6,15 @@
 #include "..\..\inc\consoletaeftemplates.hpp"
 
 #include "CommonState.hpp"
+#include "PerfTestHelper.hpp"
 
 #include "globals.h"
 #include "../buffer/out/textBuffer.hpp"
 
 #include "input.h"
 
+#include <chrono>
+
 using namespace WEX::Common;
 using namespace WEX::Logging;
 using namespace WEX::TestExecution;
@@ -62,6 +65,7 @@ namespace WEX {
 
 class AttrRowTests
 {
+    std::unique_ptr<TextAttributePalette> _palette;
     ATTR_ROW* pSingle;
     ATTR_ROW* pChain;
 
@@ -79,9 +83,23 @@ class AttrRowTests
 
     TEST_CLASS(AttrRowTests);
 
+    // Routine Description:
+    // - Unpacks the interned runs of a row back into runs with their attributes, for comparing against.
+    static std::vector<TextAttributeRun> _GetRuns(const ATTR_ROW& row)
+    {
+        std::vector<TextAttributeRun> runs;
+        for (const auto& run : row._list)
+        {
+            runs.emplace_back(run.GetLength(), row._palette->Get(run.GetAttributeId()));
+        }
+        return runs;
+    }
+
     TEST_METHOD_SETUP(MethodSetup)
     {
-        pSingle = new ATTR_ROW(_sDefaultLength, _DefaultAttr);
+        _palette = std::make_unique<TextAttributePalette>();
+
+        pSingle = new ATTR_ROW(_sDefaultLength, _DefaultAttr, *_palette);
 
         // Segment length is the expected length divided by the row length
         // E.g. row of 80, 4 segments, 20 segment length each
@@ -101,15 +119,15 @@ class AttrRowTests
         }
 
         // Create the chain
-        pChain = new ATTR_ROW(_sDefaultLength, _DefaultAttr);
+        pChain = new ATTR_ROW(_sDefaultLength, _DefaultAttr, *_palette);
         pChain->_list.resize(sChainSegmentsNeeded);
 
         // Attach all chain segments that are even multiples of the row length
         for (short iChain = 0; iChain < _sDefaultChainLength; iChain++)
         {
-            TextAttributeRun* pRun = &pChain->_list[iChain];
+            TextAttributeIdRun* pRun = &pChain->_list[iChain];
 
-            pRun->SetAttributesFromLegacy(iChain); // Just use the chain position as the value
+            pRun->SetAttributeId(_palette->Intern(TextAttribute(iChain))); // Just use the chain position as the value
             pRun->SetLength(sChainSegLength);
         }
 
@@ -117,11 +135,12 @@ class AttrRowTests
         {
             // If we had a leftover, then this chain is one longer than we expected (the default length)
             // So use it as the index (because indicies start at 0)
-            TextAttributeRun* pRun = &pChain->_list[_sDefaultChainLength];
+            TextAttributeIdRun* pRun = &pChain->_list[_sDefaultChainLength];
 
-            pRun->SetAttributes(_DefaultChainAttr);
+            pRun->SetAttributeId(_palette->Intern(_DefaultChainAttr));
             pRun->SetLength(sChainLeftover);
         }
+        pChain->_UpdateRunEnds();
 
         return true;
     }
@@ -132,6 +151,8 @@ class AttrRowTests
 
         delete pChain;
 
+        _palette.reset();
+
         return true;
     }
 
@@ -150,9 +171,10 @@ class AttrRowTests
 
             pUnderTest->Reset(attr);
 
-            VERIFY_ARE_EQUAL(pUnderTest->_list.size(), 1u);
-            VERIFY_ARE_EQUAL(pUnderTest->_list[0].GetAttributes(), attr);
-            VERIFY_ARE_EQUAL(pUnderTest->_list[0].GetLength(), (unsigned int)_sDefaultLength);
+            const auto runs = _GetRuns(*pUnderTest);
+            VERIFY_ARE_EQUAL(runs.size(), 1u);
+            VERIFY_ARE_EQUAL(runs[0].GetAttributes(), attr);
+            VERIFY_ARE_EQUAL(runs[0].GetLength(), (unsigned int)_sDefaultLength);
         }
     }
 
@@ -265,16 +287,18 @@ class AttrRowTests
 
         // Set up our "original row" that we are going to try to insert into.
         // This will represent a 10 column run of R3->B5->G2 that we will use for all tests.
-        ATTR_ROW originalRow{ static_cast<UINT>(_sDefaultLength), _DefaultAttr };
+        ATTR_ROW originalRow{ static_cast<UINT>(_sDefaultLength), _DefaultAttr, *_palette };
         originalRow._list.resize(3);
         originalRow._cchRowWidth = 10;
-        originalRow._list[0].SetAttributesFromLegacy('R');
+        originalRow._list[0].SetAttributeId(_palette->Intern(TextAttribute('R')));
         originalRow._list[0].SetLength(3);
-        originalRow._list[1].SetAttributesFromLegacy('B');
+        originalRow._list[1].SetAttributeId(_palette->Intern(TextAttribute('B')));
         originalRow._list[1].SetLength(5);
-        originalRow._list[2].SetAttributesFromLegacy('G');
+        originalRow._list[2].SetAttributeId(_palette->Intern(TextAttribute('G')));
         originalRow._list[2].SetLength(2);
-        LogChain(L"Original: ", originalRow._list);
+        originalRow._UpdateRunEnds();
+        auto originalRuns = _GetRuns(originalRow);
+        LogChain(L"Original: ", originalRuns);
 
         // Set up our "insertion run"
         size_t cInsertRow = 1;
@@ -347,17 +371,18 @@ class AttrRowTests
         VERIFY_SUCCEEDED(originalRow.InsertAttrRuns({ insertRow.data(), insertRow.size() }, uiStartPos, uiEndPos, (UINT)originalRow._cchRowWidth));
 
         // Compare and ensure that the expected and actual match.
-        VERIFY_ARE_EQUAL(cPackedRun, originalRow._list.size(), L"Ensure that number of array elements required for RLE are the same.");
+        auto actualRuns = _GetRuns(originalRow);
+        VERIFY_ARE_EQUAL(cPackedRun, actualRuns.size(), L"Ensure that number of array elements required for RLE are the same.");
 
         std::vector<TextAttributeRun> packedRunExpected;
         std::copy_n(packedRun.get(), cPackedRun, std::back_inserter(packedRunExpected));
 
         LogChain(L"Expected: ", packedRunExpected);
-        LogChain(L"Actual: ", originalRow._list);
+        LogChain(L"Actual: ", actualRuns);
 
         for (size_t testIndex = 0; testIndex < cPackedRun; testIndex++)
         {
-            VERIFY_ARE_EQUAL(packedRun[testIndex], originalRow._list[testIndex]);
+            VERIFY_ARE_EQUAL(packedRun[testIndex], actualRuns[testIndex]);
         }
     }
 
@@ -512,35 +537,37 @@ class AttrRowTests
         pSingle->SetAttrToEnd(iTestIndex, TestAttr);
 
         // Was 1 (single), should now have 2 segments
-        VERIFY_ARE_EQUAL(pSingle->_list.size(), 2u);
+        const auto singleRuns = _GetRuns(*pSingle);
+        VERIFY_ARE_EQUAL(singleRuns.size(), 2u);
 
-        VERIFY_ARE_EQUAL(pSingle->_list[0].GetAttributes(), _DefaultAttr);
-        VERIFY_ARE_EQUAL(pSingle->_list[0].GetLength(), (unsigned int)(_sDefaultLength - (_sDefaultLength - iTestIndex)));
+        VERIFY_ARE_EQUAL(singleRuns[0].GetAttributes(), _DefaultAttr);
+        VERIFY_ARE_EQUAL(singleRuns[0].GetLength(), (unsigned int)(_sDefaultLength - (_sDefaultLength - iTestIndex)));
 
-        VERIFY_ARE_EQUAL(pSingle->_list[1].GetAttributes(), TestAttr);
-        VERIFY_ARE_EQUAL(pSingle->_list[1].GetLength(), (unsigned int)(_sDefaultLength - iTestIndex));
+        VERIFY_ARE_EQUAL(singleRuns[1].GetAttributes(), TestAttr);
+        VERIFY_ARE_EQUAL(singleRuns[1].GetLength(), (unsigned int)(_sDefaultLength - iTestIndex));
 
         Log::Comment(L"SetAttrToEnd for existing chain of multiple colors.");
         pChain->SetAttrToEnd(iTestIndex, TestAttr);
 
         // From 7 segments down to 5.
-        VERIFY_ARE_EQUAL(pChain->_list.size(), 5u);
+        const auto chainRuns = _GetRuns(*pChain);
+        VERIFY_ARE_EQUAL(chainRuns.size(), 5u);
 
         // Verify chain colors and lengths
-        VERIFY_ARE_EQUAL(TextAttribute(0), pChain->_list[0].GetAttributes());
-        VERIFY_ARE_EQUAL(pChain->_list[0].GetLength(), (unsigned int)13);
+        VERIFY_ARE_EQUAL(TextAttribute(0), chainRuns[0].GetAttributes());
+        VERIFY_ARE_EQUAL(chainRuns[0].GetLength(), (unsigned int)13);
 
-        VERIFY_ARE_EQUAL(TextAttribute(1), pChain->_list[1].GetAttributes());
-        VERIFY_ARE_EQUAL(pChain->_list[1].GetLength(), (unsigned int)13);
+        VERIFY_ARE_EQUAL(TextAttribute(1), chainRuns[1].GetAttributes());
+        VERIFY_ARE_EQUAL(chainRuns[1].GetLength(), (unsigned int)13);
 
-        VERIFY_ARE_EQUAL(TextAttribute(2), pChain->_list[2].GetAttributes());
-        VERIFY_ARE_EQUAL(pChain->_list[2].GetLength(), (unsigned int)13);
+        VERIFY_ARE_EQUAL(TextAttribute(2), chainRuns[2].GetAttributes());
+        VERIFY_ARE_EQUAL(chainRuns[2].GetLength(), (unsigned int)13);
 
-        VERIFY_ARE_EQUAL(TextAttribute(3), pChain->_list[3].GetAttributes());
-        VERIFY_ARE_EQUAL(pChain->_list[3].GetLength(), (unsigned int)11);
+        VERIFY_ARE_EQUAL(TextAttribute(3), chainRuns[3].GetAttributes());
+        VERIFY_ARE_EQUAL(chainRuns[3].GetLength(), (unsigned int)11);
 
-        VERIFY_ARE_EQUAL(TestAttr, pChain->_list[4].GetAttributes());
-        VERIFY_ARE_EQUAL(pChain->_list[4].GetLength(), (unsigned int)30);
+        VERIFY_ARE_EQUAL(TestAttr, chainRuns[4].GetAttributes());
+        VERIFY_ARE_EQUAL(chainRuns[4].GetLength(), (unsigned int)30);
 
         Log::Comment(L"SECOND: Set index to 0 to test replacing anything with a single");
 
@@ -553,13 +580,14 @@ class AttrRowTests
             pUnderTest->SetAttrToEnd(0, TestAttr);
 
             // should be down to 1 attribute set from beginning to end of string
-            VERIFY_ARE_EQUAL(pUnderTest->_list.size(), 1u);
+            const auto runs = _GetRuns(*pUnderTest);
+            VERIFY_ARE_EQUAL(runs.size(), 1u);
 
             // singular pair should contain the color
-            VERIFY_ARE_EQUAL(pUnderTest->_list[0].GetAttributes(), TestAttr);
+            VERIFY_ARE_EQUAL(runs[0].GetAttributes(), TestAttr);
 
             // and its length should be the length of the whole string
-            VERIFY_ARE_EQUAL(pUnderTest->_list[0].GetLength(), (unsigned int)_sDefaultLength);
+            VERIFY_ARE_EQUAL(runs[0].GetLength(), (unsigned int)_sDefaultLength);
         }
     }
 
@@ -604,4 +632,100 @@ class AttrRowTests
         state.CleanupGlobalScreenBuffer();
         state.CleanupGlobalFont();
     }
+
+    // Routine Description:
+    // - Makes a row with a color change every few columns, like a syntax-highlighted line.
+    ATTR_ROW _MakeColorfulRow(const UINT width, std::vector<TextAttribute>& expected)
+    {
+        ATTR_ROW row{ width, _DefaultAttr, *_palette };
+        expected.assign(width, _DefaultAttr);
+
+        UINT column = 0;
+        for (WORD i = 0; column < width; i++)
+        {
+            const TextAttribute attr{ static_cast<WORD>(i % 16) };
+            const UINT length = std::min<UINT>(1 + (i % 3), width - column);
+            const TextAttributeRun run{ length, attr };
+            VERIFY_SUCCEEDED(row.InsertAttrRuns({ &run, 1 }, column, column + length - 1, width));
+            std::fill_n(expected.begin() + column, length, attr);
+            column += length;
+        }
+        return row;
+    }
+
+    TEST_METHOD(TestIteratorJumps)
+    {
+        const UINT width = 200;
+        std::vector<TextAttribute> expected;
+        const auto row = _MakeColorfulRow(width, expected);
+        VERIFY_IS_TRUE(row.GetNumberOfRuns() > 50);
+
+        for (UINT column = 0; column < width; column++)
+        {
+            VERIFY_ARE_EQUAL(expected[column], row.GetAttrByColumn(column));
+        }
+
+        Log::Comment(L"Stepping backwards across run boundaries lands on the previous column.");
+        auto it = row.cend();
+        for (UINT column = width; column > 0; column--)
+        {
+            --it;
+            VERIFY_ARE_EQUAL(expected[column - 1], *it);
+        }
+        VERIFY_IS_TRUE(row.cbegin() == it);
+
+        Log::Comment(L"Jumps in both directions land on the same column as walking there.");
+        const ptrdiff_t jumps[]{ 7, 50, -3, 90, -120, 1, 150, -80, -95 };
+        ptrdiff_t column = 0;
+        it = row.cbegin();
+        for (const auto jump : jumps)
+        {
+            it += jump;
+            column += jump;
+
+            auto walked = row.cbegin();
+            for (ptrdiff_t i = 0; i < column; i++)
+            {
+                ++walked;
+            }
+            VERIFY_IS_TRUE(walked == it);
+            VERIFY_ARE_EQUAL(expected[column], *it);
+        }
+
+        it += width - column;
+        VERIFY_IS_TRUE(row.cend() == it);
+    }
+
+    TEST_METHOD(TestColorfulRowLookupThroughput)
+    {
+        BEGIN_TEST_METHOD_PROPERTIES()
+            TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+        END_TEST_METHOD_PROPERTIES()
+
+        const UINT width = SHRT_MAX;
+        std::vector<TextAttribute> expected;
+        const auto row = _MakeColorfulRow(width, expected);
+
+        const auto start = std::chrono::steady_clock::now();
+        size_t mismatches = 0;
+        for (UINT column = 0; column < width; column++)
+        {
+            mismatches += row.GetAttrByColumn(column) != expected[column];
+        }
+        const auto looked = std::chrono::steady_clock::now();
+        auto it = row.cbegin();
+        for (UINT column = 0; column < width; column++, it++)
+        {
+            mismatches += *it != expected[column];
+        }
+        const auto walked = std::chrono::steady_clock::now();
+
+        VERIFY_ARE_EQUAL(0u, mismatches);
+
+        Log::Comment(NoThrowString().Format(L"%zu runs over %u columns: GetAttrByColumn %lld us, iterator %lld us.",
+                                            row.GetNumberOfRuns(),
+                                            width,
+                                            PerfTestHelper::Microseconds(start, looked),
+                                            PerfTestHelper::Microseconds(looked, walked)));
+    }
 };
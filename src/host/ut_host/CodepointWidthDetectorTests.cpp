@@ -34,32 +34,12 @@ class CodepointWidthDetectorTests
     TEST_CLASS(CodepointWidthDetectorTests);
 
 
-    TEST_METHOD(CodepointWidthDetectDefersMapPopulation)
-    {
-        CodepointWidthDetector widthDetector;
-        VERIFY_IS_TRUE(widthDetector._map.empty());
-        widthDetector.IsWide(UNICODE_SPACE);
-        VERIFY_IS_TRUE(widthDetector._map.empty());
-        // now force checking
-        widthDetector.GetWidth(emoji);
-        VERIFY_IS_FALSE(widthDetector._map.empty());
-    }
-
     TEST_METHOD(CanLookUpEmoji)
     {
         CodepointWidthDetector widthDetector;
         VERIFY_IS_TRUE(widthDetector.IsWide(emoji));
     }
 
-    TEST_METHOD(TestUnicodeRangeCompare)
-    {
-        CodepointWidthDetector::UnicodeRangeCompare compare;
-        // test comparing 2 search terms
-        CodepointWidthDetector::UnicodeRange a{ 0x10 };
-        CodepointWidthDetector::UnicodeRange b{ 0x15 };
-        VERIFY_IS_TRUE(static_cast<bool>(compare(a, b)));
-    }
-
     TEST_METHOD(CanExtractCodepoint)
     {
         CodepointWidthDetector widthDetector;
@@ -84,6 +64,43 @@ class CodepointWidthDetectorTests
         }
     }
 
+    TEST_METHOD(CanGetWidthsInBulk)
+    {
+        CodepointWidthDetector widthDetector;
+        std::vector<char32_t> codepoints;
+        for (const auto& data : testData)
+        {
+            codepoints.push_back(static_cast<char32_t>(std::get<0>(data)));
+        }
+
+        std::vector<CodepointWidth> widths(codepoints.size(), CodepointWidth::Invalid);
+        widthDetector.GetWidths(codepoints, widths);
+
+        for (size_t i = 0; i < testData.size(); i++)
+        {
+            VERIFY_ARE_EQUAL(std::get<2>(testData.at(i)), widths.at(i));
+        }
+
+        // There must be room for a width per codepoint.
+        widths.pop_back();
+        VERIFY_THROWS_SPECIFIC(widthDetector.GetWidths(codepoints, widths),
+                               wil::ResultException,
+                               [](wil::ResultException& e) { return e.GetErrorCode() == E_INVALIDARG; });
+    }
+
+    TEST_METHOD(CodepointsOutsideOfUnicodeAreInvalid)
+    {
+        const std::vector<char32_t> codepoints{ 0x10FFFF, 0x110000, 0xFFFFFFFF };
+        std::vector<CodepointWidth> widths(codepoints.size(), CodepointWidth::Narrow);
+
+        CodepointWidthDetector widthDetector;
+        widthDetector.GetWidths(codepoints, widths);
+
+        VERIFY_ARE_EQUAL(CodepointWidth::Invalid, widths.at(0)); // noncharacter, not in the spec
+        VERIFY_ARE_EQUAL(CodepointWidth::Invalid, widths.at(1));
+        VERIFY_ARE_EQUAL(CodepointWidth::Invalid, widths.at(2));
+    }
+
     static bool FallbackMethod(const std::wstring_view glyph)
     {
         if (glyph.size() < 1)
@@ -6,11 +6,15 @@
 #include "../inc/consoletaeftemplates.hpp"
 
 #include "CommonState.hpp"
+#include "PerfTestHelper.hpp"
 
 #include "globals.h"
 #include "../buffer/out/textBuffer.hpp"
 #include "../buffer/out/CharRow.hpp"
 
+#include <chrono>
+#include <psapi.h>
+
 #include "input.h"
 #include "_stream.h"
 
@@ -142,6 +146,23 @@ class TextBufferTests
 
     TEST_METHOD(TestBurrito);
 
+    TEST_METHOD(TestCharRowMeasuresStoredGlyphs);
+
+    TEST_METHOD(CharRowOperationThroughput);
+
+    TEST_METHOD(ResizeTraditionalMovesRowsIntoNewCells);
+    TEST_METHOD(BufferCreateAndResizeThroughput);
+
+    TEST_METHOD(ReplaceAttrsUpdatesEveryRow);
+    TEST_METHOD(AttributePaletteCompactsWhenCircling);
+    TEST_METHOD(AttributePaletteCompactsWhenRedrawingInPlace);
+
+    TEST_METHOD(ScrollRowsAcrossCircularWrap);
+    TEST_METHOD(ScrollRowsRegionThroughput);
+
+    TEST_METHOD(ReflowRewrapsLines);
+    TEST_METHOD(ReflowThroughput);
+
 };
 
 void TextBufferTests::TestBufferCreate()
@@ -1899,14 +1920,17 @@ void TextBufferTests::ResizeTraditionalHighUnicodeRowRemoval()
     const auto readBackText = *readBack;
     VERIFY_ARE_EQUAL(String(emoji), String(readBackText.data(), gsl::narrow<int>(readBackText.size())));
 
-    VERIFY_ARE_EQUAL(1u, _buffer->GetUnicodeStorage()._map.size(), L"There should be one item in the map.");
+    VERIFY_ARE_EQUAL(1u, _buffer->_storage[pos.Y].GetUnicodeStorage().Size(), L"The row should have one glyph stored.");
 
     // Perform resize to trim off the row of the buffer that included the emoji
     COORD trimmedBufferSize{ bufferSize.X, bufferSize.Y - 1 };
 
     VERIFY_NT_SUCCESS(_buffer->ResizeTraditional(trimmedBufferSize));
 
-    VERIFY_IS_TRUE(_buffer->GetUnicodeStorage()._map.empty(), L"The map should now be empty.");
+    for (const auto& row : _buffer->_storage)
+    {
+        VERIFY_ARE_EQUAL(0u, row.GetUnicodeStorage().Size(), L"No row should have a glyph stored now.");
+    }
 }
 
 // This tests that columns removed from the buffer while resizing traditionally will also drop the high unicode
@@ -1934,14 +1958,14 @@ void TextBufferTests::ResizeTraditionalHighUnicodeColumnRemoval()
     const auto readBackText = *readBack;
     VERIFY_ARE_EQUAL(String(emoji), String(readBackText.data(), gsl::narrow<int>(readBackText.size())));
 
-    VERIFY_ARE_EQUAL(1u, _buffer->GetUnicodeStorage()._map.size(), L"There should be one item in the map.");
+    VERIFY_ARE_EQUAL(1u, _buffer->_storage[pos.Y].GetUnicodeStorage().Size(), L"The row should have one glyph stored.");
 
     // Perform resize to trim off the column of the buffer that included the emoji
     COORD trimmedBufferSize{ bufferSize.X - 1, bufferSize.Y};
 
     VERIFY_NT_SUCCESS(_buffer->ResizeTraditional(trimmedBufferSize));
 
-    VERIFY_IS_TRUE(_buffer->GetUnicodeStorage()._map.empty(), L"The map should now be empty.");
+    VERIFY_ARE_EQUAL(0u, _buffer->_storage[pos.Y].GetUnicodeStorage().Size(), L"The row should have dropped the glyph.");
 }
 
 void TextBufferTests::TestBurrito()
@@ -1964,3 +1988,454 @@ void TextBufferTests::TestBurrito()
     _buffer->IncrementCursor();
     VERIFY_IS_FALSE(afterBurritoIter);
 }
+
+void TextBufferTests::TestCharRowMeasuresStoredGlyphs()
+{
+    COORD bufferSize{ 20, 1 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    CharRow& charRow = _buffer->GetRowByOffset(0).GetCharRow();
+    VERIFY_IS_FALSE(charRow.ContainsText());
+    VERIFY_ARE_EQUAL(20u, charRow.MeasureLeft());
+    VERIFY_ARE_EQUAL(0u, charRow.MeasureRight());
+
+    // A glyph that lives in UnicodeStorage is text, even if it starts with a space.
+    const std::wstring spaceWithAccent{ L" \x301" };
+    charRow.GlyphAt(3) = spaceWithAccent;
+    VERIFY_IS_TRUE(charRow.ContainsText());
+    VERIFY_ARE_EQUAL(3u, charRow.MeasureLeft());
+    VERIFY_ARE_EQUAL(4u, charRow.MeasureRight());
+
+    // The trailing half of a double byte character is only left out of GetText.
+    const wchar_t* const pwszText = L"\x304b\x304bZ";
+    std::vector<DbcsAttribute> attrs(3);
+    attrs[0].SetLeading();
+    attrs[1].SetTrailing();
+    charRow.OverwriteColumns(pwszText, pwszText + 3, attrs.cbegin(), 10);
+    VERIFY_ARE_EQUAL(13u, charRow.MeasureRight());
+
+    const std::wstring text = charRow.GetText();
+    VERIFY_ARE_EQUAL(String(L"    \x301      \x304bZ       "), String(text.c_str()));
+    const std::wstring rawText = charRow.GetTextRaw();
+    VERIFY_ARE_EQUAL(String(L"    \x301      \x304b\x304bZ       "), String(rawText.c_str()));
+
+    // Clearing the glyph makes it a space again.
+    charRow.ClearGlyph(3);
+    VERIFY_ARE_EQUAL(10u, charRow.MeasureLeft());
+
+    charRow.Reset();
+    VERIFY_IS_FALSE(charRow.ContainsText());
+}
+
+void TextBufferTests::CharRowOperationThroughput()
+{
+    BEGIN_TEST_METHOD_PROPERTIES()
+        TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+    END_TEST_METHOD_PROPERTIES()
+
+    COORD bufferSize{ 120, 9001 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // Fill the left half of every row, which is the typical shape of a line of shell output.
+    const std::wstring text(bufferSize.X / 2, L'A');
+    const std::vector<DbcsAttribute> attrs(text.size());
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t measured = 0;
+    for (SHORT i = 0; i < bufferSize.Y; i++)
+    {
+        CharRow& charRow = _buffer->GetRowByOffset(i).GetCharRow();
+        charRow.OverwriteColumns(text.cbegin(), text.cend(), attrs.cbegin(), 0);
+    }
+    const auto written = std::chrono::steady_clock::now();
+    for (SHORT i = 0; i < bufferSize.Y; i++)
+    {
+        const CharRow& charRow = _buffer->GetRowByOffset(i).GetCharRow();
+        measured += charRow.MeasureRight();
+        measured += charRow.ContainsText() ? 1 : 0;
+    }
+    const auto scanned = std::chrono::steady_clock::now();
+    size_t copied = 0;
+    for (SHORT i = 0; i < bufferSize.Y; i++)
+    {
+        copied += _buffer->GetRowByOffset(i).GetCharRow().GetText().size();
+    }
+    const auto read = std::chrono::steady_clock::now();
+    for (SHORT i = 0; i < bufferSize.Y; i++)
+    {
+        _buffer->GetRowByOffset(i).GetCharRow().Reset();
+    }
+    const auto cleared = std::chrono::steady_clock::now();
+
+    VERIFY_ARE_EQUAL(static_cast<size_t>(bufferSize.Y) * (text.size() + 1), measured);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(bufferSize.Y) * bufferSize.X, copied);
+
+    Log::Comment(NoThrowString().Format(L"%d rows: write %lld us, measure %lld us, GetText %lld us, clear %lld us.",
+                                        bufferSize.Y,
+                                        PerfTestHelper::Microseconds(start, written),
+                                        PerfTestHelper::Microseconds(written, scanned),
+                                        PerfTestHelper::Microseconds(scanned, read),
+                                        PerfTestHelper::Microseconds(read, cleared)));
+}
+
+void TextBufferTests::ResizeTraditionalMovesRowsIntoNewCells()
+{
+    COORD bufferSize{ 10, 4 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // Circle the buffer once so the rows have to be rotated back into place by the resize.
+    _buffer->IncrementCircularBuffer();
+
+    const std::wstring text{ L"0123456789" };
+    const std::vector<DbcsAttribute> attrs(text.size());
+    for (SHORT i = 0; i < bufferSize.Y; i++)
+    {
+        auto& charRow = _buffer->GetRowByOffset(i).GetCharRow();
+        charRow.OverwriteColumns(text.cbegin() + i, text.cend(), attrs.cbegin(), 0);
+    }
+
+    // Shrink in both directions, then grow past the original size.
+    VERIFY_NT_SUCCESS(_buffer->ResizeTraditional({ 6, 3 }));
+    VERIFY_ARE_EQUAL(String(L"012345"), String(_buffer->GetRowByOffset(0).GetCharRow().GetText().c_str()));
+    VERIFY_ARE_EQUAL(String(L"234567"), String(_buffer->GetRowByOffset(2).GetCharRow().GetText().c_str()));
+
+    VERIFY_NT_SUCCESS(_buffer->ResizeTraditional({ 12, 5 }));
+    VERIFY_ARE_EQUAL(String(L"123456      "), String(_buffer->GetRowByOffset(1).GetCharRow().GetText().c_str()));
+    for (SHORT i = 0; i < 5; i++)
+    {
+        const auto& row = _buffer->GetRowByOffset(i);
+        VERIFY_ARE_EQUAL(12u, row.size());
+        VERIFY_ARE_EQUAL(i, row.GetId());
+    }
+    VERIFY_IS_FALSE(_buffer->GetRowByOffset(3).GetCharRow().ContainsText());
+    VERIFY_IS_FALSE(_buffer->GetRowByOffset(4).GetCharRow().ContainsText());
+}
+
+void TextBufferTests::BufferCreateAndResizeThroughput()
+{
+    BEGIN_TEST_METHOD_PROPERTIES()
+        TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+    END_TEST_METHOD_PROPERTIES()
+
+    COORD bufferSize{ 120, 9001 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+
+    // The process' resident memory, in KB.
+    const auto workingSetKb = []() {
+        PROCESS_MEMORY_COUNTERS counters{};
+        VERIFY_WIN32_BOOL_SUCCEEDED(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)));
+        return static_cast<long long>(counters.WorkingSetSize / 1024);
+    };
+
+    const auto startKb = workingSetKb();
+    const auto start = std::chrono::steady_clock::now();
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+    const auto created = std::chrono::steady_clock::now();
+    const auto createdKb = workingSetKb();
+    VERIFY_NT_SUCCESS(_buffer->ResizeTraditional({ 80, 9001 }));
+    const auto shrunk = std::chrono::steady_clock::now();
+    const auto shrunkKb = workingSetKb();
+    VERIFY_NT_SUCCESS(_buffer->ResizeTraditional({ 200, 9001 }));
+    const auto grown = std::chrono::steady_clock::now();
+    const auto grownKb = workingSetKb();
+    _buffer.reset();
+    const auto destroyed = std::chrono::steady_clock::now();
+    const auto destroyedKb = workingSetKb();
+
+    const size_t cellBytes = static_cast<size_t>(bufferSize.X) * bufferSize.Y * (sizeof(wchar_t) + sizeof(DbcsAttribute));
+    Log::Comment(NoThrowString().Format(L"%dx%d buffer (%zu bytes of cells): create %lld us, shrink %lld us, grow %lld us, destroy %lld us.",
+                                        bufferSize.X,
+                                        bufferSize.Y,
+                                        cellBytes,
+                                        PerfTestHelper::Microseconds(start, created),
+                                        PerfTestHelper::Microseconds(created, shrunk),
+                                        PerfTestHelper::Microseconds(shrunk, grown),
+                                        PerfTestHelper::Microseconds(grown, destroyed)));
+    Log::Comment(NoThrowString().Format(L"Working set growth over the start: created %lld KB, shrunk %lld KB, grown %lld KB, destroyed %lld KB.",
+                                        createdKb - startKb,
+                                        shrunkKb - startKb,
+                                        grownKb - startKb,
+                                        destroyedKb - startKb));
+}
+
+void TextBufferTests::ReplaceAttrsUpdatesEveryRow()
+{
+    COORD bufferSize{ 10, 3 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    const TextAttribute red{ FOREGROUND_RED };
+    const TextAttribute green{ FOREGROUND_GREEN };
+    for (short i = 0; i < bufferSize.Y; i++)
+    {
+        _buffer->GetRowByOffset(i).GetAttrRow().SetAttrToEnd(i + 1, red);
+    }
+    const auto paletteSize = _buffer->GetAttributePalette().Size();
+
+    _buffer->ReplaceAttrs(red, green);
+
+    // Only the palette entry changed. The runs of every row are just as they were.
+    VERIFY_ARE_EQUAL(paletteSize, _buffer->GetAttributePalette().Size());
+    for (short i = 0; i < bufferSize.Y; i++)
+    {
+        const ATTR_ROW& attrRow = _buffer->GetRowByOffset(i).GetAttrRow();
+        VERIFY_ARE_EQUAL(2u, attrRow.GetNumberOfRuns());
+        VERIFY_ARE_EQUAL(attr, attrRow.GetAttrByColumn(i));
+        VERIFY_ARE_EQUAL(green, attrRow.GetAttrByColumn(i + 1));
+    }
+
+    // Writing the replacement again reuses the same entry.
+    _buffer->GetRowByOffset(0).GetAttrRow().SetAttrToEnd(0, green);
+    VERIFY_ARE_EQUAL(paletteSize, _buffer->GetAttributePalette().Size());
+
+    _buffer->ReplaceLegacyAttrs(0x7f, 0x1e);
+    VERIFY_ARE_EQUAL(TextAttribute{ 0x1e }, _buffer->GetRowByOffset(1).GetAttrRow().GetAttrByColumn(0));
+    VERIFY_ARE_EQUAL(green, _buffer->GetRowByOffset(1).GetAttrRow().GetAttrByColumn(2));
+}
+
+void TextBufferTests::AttributePaletteCompactsWhenCircling()
+{
+    COORD bufferSize{ 10, 3 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // Give every row a color of its own, the way an app drawing in RGB might.
+    const auto colorOf = [](const size_t i) {
+        return TextAttribute{ RGB(i & 0xff, (i >> 8) & 0xff, 0), RGB(0, 0, 0) };
+    };
+    const size_t rows = 10000;
+    for (size_t i = 0; i < rows; i++)
+    {
+        _buffer->GetRowByOffset(bufferSize.Y - 1).GetAttrRow().SetAttrToEnd(0, colorOf(i));
+        _buffer->IncrementCircularBuffer();
+    }
+
+    // The colors of rows that circled out were dropped along the way...
+    VERIFY_IS_LESS_THAN(_buffer->GetAttributePalette().Size(), rows / 2);
+
+    // ...but the rows still in the buffer kept theirs.
+    VERIFY_ARE_EQUAL(colorOf(rows - 2), _buffer->GetRowByOffset(0).GetAttrRow().GetAttrByColumn(0));
+    VERIFY_ARE_EQUAL(colorOf(rows - 1), _buffer->GetRowByOffset(1).GetAttrRow().GetAttrByColumn(9));
+    VERIFY_ARE_EQUAL(attr, _buffer->GetRowByOffset(2).GetAttrRow().GetAttrByColumn(0));
+}
+
+void TextBufferTests::AttributePaletteCompactsWhenRedrawingInPlace()
+{
+    COORD bufferSize{ 10, 3 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // Redraw the same cells in a new color every frame, without ever circling the buffer,
+    //      the way a full screen app drawing in RGB does.
+    const auto colorOf = [](const size_t i) {
+        return TextAttribute{ RGB(i & 0xff, (i >> 8) & 0xff, 0), RGB(0, 0, 0) };
+    };
+    const size_t frames = 10000;
+    for (size_t i = 0; i < frames; i++)
+    {
+        _buffer->WriteLine(OutputCellIterator(L"frame", colorOf(i)), { 0, 1 });
+    }
+
+    // The colors that were drawn over were dropped along the way...
+    VERIFY_IS_LESS_THAN(_buffer->GetAttributePalette().Size(), frames / 2);
+
+    // ...but the last frame kept its color.
+    VERIFY_ARE_EQUAL(colorOf(frames - 1), _buffer->GetRowByOffset(1).GetAttrRow().GetAttrByColumn(0));
+    VERIFY_ARE_EQUAL(colorOf(frames - 1), _buffer->GetRowByOffset(1).GetAttrRow().GetAttrByColumn(4));
+    VERIFY_ARE_EQUAL(attr, _buffer->GetRowByOffset(1).GetAttrRow().GetAttrByColumn(5));
+}
+
+void TextBufferTests::ScrollRowsAcrossCircularWrap()
+{
+    COORD bufferSize{ 10, 12 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // Put the top of the buffer near the end of its storage, so the regions below wrap around it.
+    for (int i = 0; i < 8; i++)
+    {
+        VERIFY_IS_TRUE(_buffer->IncrementCircularBuffer());
+    }
+    VERIFY_ARE_EQUAL(static_cast<SHORT>(8), _buffer->GetFirstRowIndex());
+
+    // Tag every row with a letter for where it started out.
+    for (short i = 0; i < bufferSize.Y; i++)
+    {
+        _buffer->GetRowByOffset(i).GetCharRow().GlyphAt(0) = std::wstring(1, static_cast<wchar_t>(L'A' + i));
+    }
+
+    const auto verifyRows = [&](const std::wstring_view expected) {
+        for (short i = 0; i < bufferSize.Y; i++)
+        {
+            const ROW& row = _buffer->GetRowByOffset(i);
+            const std::wstring_view glyph = row.GetCharRow().GlyphAt(0);
+            VERIFY_ARE_EQUAL(expected[i], glyph.front());
+            VERIFY_ARE_EQUAL(gsl::narrow<SHORT>((_buffer->GetFirstRowIndex() + i) % bufferSize.Y), row.GetId());
+        }
+    };
+
+    // Move rows 2, 3 and 4 down by 2. The rows they slide over sit on both sides of the wrap.
+    _buffer->ScrollRows(2, 3, 2);
+    verifyRows(L"ABFGCDEHIJKL");
+
+    // And move them back up.
+    _buffer->ScrollRows(4, 3, -2);
+    verifyRows(L"ABCDEFGHIJKL");
+
+    // The top of the buffer stays where it was.
+    VERIFY_ARE_EQUAL(static_cast<SHORT>(8), _buffer->GetFirstRowIndex());
+}
+
+void TextBufferTests::ScrollRowsRegionThroughput()
+{
+    BEGIN_TEST_METHOD_PROPERTIES()
+        TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+    END_TEST_METHOD_PROPERTIES()
+
+    COORD bufferSize{ 120, 30000 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // A buffer that has been scrolling for a while has its top somewhere in the middle.
+    _buffer->_SetFirstRowIndex(bufferSize.Y / 2);
+
+    // A pager scrolling a 20 line region at the bottom of the buffer up by one line at a time,
+    // the way it would inside a DECSTBM margin.
+    const SHORT regionTop = bufferSize.Y - 30;
+    const SHORT regionHeight = 20;
+    const size_t scrolls = 100000;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < scrolls; i++)
+    {
+        _buffer->ScrollRows(gsl::narrow<SHORT>(regionTop + 1), gsl::narrow<SHORT>(regionHeight - 1), -1);
+    }
+    const auto scrolled = std::chrono::steady_clock::now();
+
+    for (short i = regionTop; i < regionTop + regionHeight; i++)
+    {
+        VERIFY_ARE_EQUAL(gsl::narrow<SHORT>((_buffer->GetFirstRowIndex() + i) % bufferSize.Y), _buffer->GetRowByOffset(i).GetId());
+    }
+
+    Log::Comment(NoThrowString().Format(L"%zu scrolls of a %d row region in a %d row buffer: %lld us.",
+                                        scrolls,
+                                        regionHeight,
+                                        bufferSize.Y,
+                                        PerfTestHelper::Microseconds(start, scrolled)));
+}
+
+void TextBufferTests::ReflowRewrapsLines()
+{
+    COORD bufferSize{ 10, 6 };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    TextAttribute red{ FOREGROUND_RED };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // One line that wraps at the old width, then a short one in another color with the cursor at its end.
+    const DbcsAttribute dbcsAttr;
+    for (const auto wch : std::wstring_view{ L"abcdefghijklm" })
+    {
+        VERIFY_IS_TRUE(_buffer->InsertCharacter(wch, dbcsAttr, attr));
+    }
+    VERIFY_IS_TRUE(_buffer->NewlineCursor());
+    for (const auto wch : std::wstring_view{ L"xyz" })
+    {
+        VERIFY_IS_TRUE(_buffer->InsertCharacter(wch, dbcsAttr, red));
+    }
+
+    const auto verifyRow = [&](const short y, const std::wstring_view expected, const bool wrapped) {
+        const ROW& row = _buffer->GetRowByOffset(y);
+        for (size_t x = 0; x < expected.size(); x++)
+        {
+            const std::wstring_view glyph = row.GetCharRow().GlyphAt(x);
+            VERIFY_ARE_EQUAL(expected[x], glyph.front());
+        }
+        VERIFY_ARE_EQUAL(expected.size(), row.GetCharRow().MeasureRight());
+        VERIFY_ARE_EQUAL(wrapped, row.GetCharRow().WasWrapForced());
+    };
+
+    // Narrower, the first line takes another row, and the cursor follows the text down.
+    VERIFY_SUCCEEDED(_buffer->Reflow({ 5, 8 }));
+    VERIFY_ARE_EQUAL(COORD({ 5, 8 }), _buffer->GetSize().Dimensions());
+    verifyRow(0, L"abcde", true);
+    verifyRow(1, L"fghij", true);
+    verifyRow(2, L"klm", false);
+    verifyRow(3, L"xyz", false);
+    VERIFY_ARE_EQUAL(COORD({ 3, 3 }), _buffer->GetCursor().GetPosition());
+    VERIFY_ARE_EQUAL(attr, _buffer->GetRowByOffset(2).GetAttrRow().GetAttrByColumn(2));
+    VERIFY_ARE_EQUAL(red, _buffer->GetRowByOffset(3).GetAttrRow().GetAttrByColumn(0));
+    VERIFY_ARE_EQUAL(red, _buffer->GetRowByOffset(3).GetAttrRow().GetAttrByColumn(4));
+
+    // Wider again, the rows that were wrapped are joined back up.
+    VERIFY_SUCCEEDED(_buffer->Reflow({ 10, 6 }));
+    verifyRow(0, L"abcdefghij", true);
+    verifyRow(1, L"klm", false);
+    verifyRow(2, L"xyz", false);
+    VERIFY_ARE_EQUAL(COORD({ 3, 2 }), _buffer->GetCursor().GetPosition());
+    VERIFY_ARE_EQUAL(red, _buffer->GetRowByOffset(2).GetAttrRow().GetAttrByColumn(2));
+
+    // Too short to hold all of it, the oldest rows fall off the top.
+    VERIFY_SUCCEEDED(_buffer->Reflow({ 5, 3 }));
+    verifyRow(0, L"fghij", true);
+    verifyRow(1, L"klm", false);
+    verifyRow(2, L"xyz", false);
+    VERIFY_ARE_EQUAL(COORD({ 3, 2 }), _buffer->GetCursor().GetPosition());
+
+    VERIFY_ARE_EQUAL(E_INVALIDARG, _buffer->Reflow({ 0, 3 }));
+}
+
+void TextBufferTests::ReflowThroughput()
+{
+    BEGIN_TEST_METHOD_PROPERTIES()
+        TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+    END_TEST_METHOD_PROPERTIES()
+
+    // The tallest buffer there can be. Rows are addressed with a SHORT, so this is as close
+    // as the test can get to a history of 100K lines.
+    COORD bufferSize{ 120, SHORT_MAX };
+    UINT cursorSize = 12;
+    TextAttribute attr{ 0x7f };
+    auto _buffer = std::make_unique<TextBuffer>(bufferSize, attr, cursorSize, _renderTarget);
+
+    // A full history of lines that are a bit longer than the buffer is wide. Each takes two
+    // rows, and the last row is left for the cursor, so nothing circles out of the buffer.
+    const DbcsAttribute dbcsAttr;
+    const auto lines = gsl::narrow<short>((bufferSize.Y - 1) / 2);
+    for (short i = 0; i < lines; i++)
+    {
+        for (size_t j = 0; j < 150; j++)
+        {
+            VERIFY_IS_TRUE(_buffer->InsertCharacter(static_cast<wchar_t>(L'a' + j % 26), dbcsAttr, attr));
+        }
+        VERIFY_IS_TRUE(_buffer->NewlineCursor());
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    VERIFY_SUCCEEDED(_buffer->Reflow({ 80, bufferSize.Y }));
+    const auto narrowed = std::chrono::steady_clock::now();
+    VERIFY_SUCCEEDED(_buffer->Reflow(bufferSize));
+    const auto widened = std::chrono::steady_clock::now();
+
+    // Every line took two rows at either width, so the rows end up back where they started.
+    const auto rows = gsl::narrow<short>(lines * 2);
+    VERIFY_ARE_EQUAL(COORD({ 0, rows }), _buffer->GetCursor().GetPosition());
+    VERIFY_IS_TRUE(_buffer->GetRowByOffset(rows - 2).GetCharRow().WasWrapForced());
+    VERIFY_ARE_EQUAL(static_cast<size_t>(30), _buffer->GetRowByOffset(rows - 1).GetCharRow().MeasureRight());
+
+    Log::Comment(NoThrowString().Format(L"Reflowed %d lines to 80 columns in %lld us and back to 120 in %lld us.",
+                                        lines,
+                                        PerfTestHelper::Microseconds(start, narrowed),
+                                        PerfTestHelper::Microseconds(narrowed, widened)));
+}
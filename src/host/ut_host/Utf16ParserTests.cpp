@@ -4,9 +4,12 @@
 #include "precomp.h"
 #include "WexTestClass.h"
 #include "../../inc/consoletaeftemplates.hpp"
+#include "PerfTestHelper.hpp"
 
 #include "../../types/inc/Utf16Parser.hpp"
 
+#include <chrono>
+
 using namespace WEX::Common;
 using namespace WEX::Logging;
 using namespace WEX::TestExecution;
@@ -23,6 +26,17 @@ class Utf16ParserTests
 {
     TEST_CLASS(Utf16ParserTests);
 
+    static std::vector<std::wstring_view> _ParseAll(std::wstring_view wstr)
+    {
+        const auto glyphs = Utf16Parser::Parse(wstr);
+        return { glyphs.begin(), glyphs.end() };
+    }
+
+    static std::wstring_view _ToView(const std::vector<wchar_t>& charData)
+    {
+        return { charData.data(), charData.size() };
+    }
+
     TEST_METHOD(CanParseNonSurrogateText)
     {
         const std::vector<std::vector<wchar_t>> expected = { CyrillicChar, LatinChar, FullWidthChar, GaelicChar, HiraganaChar };
@@ -33,20 +47,20 @@ class Utf16ParserTests
             wstr.push_back(charData.at(0));
         }
 
-        const std::vector<std::vector<wchar_t>> result = Utf16Parser::Parse(wstr);
+        const std::vector<std::wstring_view> result = _ParseAll(wstr);
 
         VERIFY_ARE_EQUAL(expected.size(), result.size());
         for (size_t i = 0; i < result.size(); ++i)
         {
             const auto& sequence = result.at(i);
-            VERIFY_ARE_EQUAL(sequence, expected.at(i));
+            VERIFY_ARE_EQUAL(sequence, _ToView(expected.at(i)));
         }
     }
 
     TEST_METHOD(CanParseSurrogatePairs)
     {
         const std::wstring wstr{ SunglassesEmoji.begin(), SunglassesEmoji.end() };
-        const std::vector<std::vector<wchar_t>> result = Utf16Parser::Parse(wstr);
+        const std::vector<std::wstring_view> result = _ParseAll(wstr);
 
         VERIFY_ARE_EQUAL(result.size(), 1u);
         VERIFY_ARE_EQUAL(result.at(0).size(), SunglassesEmoji.size());
@@ -63,7 +77,7 @@ class Utf16ParserTests
         wstr += wstr;
         wstr.at(1) = SunglassesEmoji.at(0); // wstr contains 3 leading, 1 trailing surrogate sequence
 
-        std::vector<std::vector<wchar_t>> result = Utf16Parser::Parse(wstr);
+        std::vector<std::wstring_view> result = _ParseAll(wstr);
 
         VERIFY_ARE_EQUAL(result.size(), 1u);
         VERIFY_ARE_EQUAL(result.at(0).size(), SunglassesEmoji.size());
@@ -77,7 +91,7 @@ class Utf16ParserTests
         wstr += wstr;
         wstr.at(0) = SunglassesEmoji.at(1); // wstr contains 2 trailing, 1 leading, 1 trailing surrogate sequence
 
-        result = Utf16Parser::Parse(wstr);
+        result = _ParseAll(wstr);
 
         VERIFY_ARE_EQUAL(result.size(), 1u);
         VERIFY_ARE_EQUAL(result.at(0).size(), SunglassesEmoji.size());
@@ -86,4 +100,56 @@ class Utf16ParserTests
             VERIFY_ARE_EQUAL(result.at(0).at(i), SunglassesEmoji.at(i));
         }
     }
+
+    TEST_METHOD(GlyphsAreViewsIntoTheString)
+    {
+        std::wstring wstr{ LatinChar.begin(), LatinChar.end() };
+        wstr.append(SunglassesEmoji.begin(), SunglassesEmoji.end());
+        wstr.push_back(SunglassesEmoji.at(1)); // unpaired trailing surrogate
+        wstr.append(HiraganaChar.begin(), HiraganaChar.end());
+        wstr.push_back(SunglassesEmoji.at(0)); // unpaired leading surrogate at the end
+
+        const std::vector<std::wstring_view> result = _ParseAll(wstr);
+
+        VERIFY_ARE_EQUAL(result.size(), 3u);
+        VERIFY_ARE_EQUAL(static_cast<size_t>(result.at(0).data() - wstr.data()), static_cast<size_t>(0));
+        VERIFY_ARE_EQUAL(result.at(0), _ToView(LatinChar));
+        VERIFY_ARE_EQUAL(static_cast<size_t>(result.at(1).data() - wstr.data()), static_cast<size_t>(1));
+        VERIFY_ARE_EQUAL(result.at(1), _ToView(SunglassesEmoji));
+        VERIFY_ARE_EQUAL(static_cast<size_t>(result.at(2).data() - wstr.data()), static_cast<size_t>(4));
+        VERIFY_ARE_EQUAL(result.at(2), _ToView(HiraganaChar));
+
+        Log::Comment(L"A string of nothing but unpaired surrogates has no glyphs at all.");
+        const std::wstring surrogates{ SunglassesEmoji.rbegin(), SunglassesEmoji.rend() };
+        const auto glyphs = Utf16Parser::Parse(surrogates);
+        VERIFY_IS_TRUE(glyphs.begin() == glyphs.end());
+    }
+
+    TEST_METHOD(ParseThroughput)
+    {
+        BEGIN_TEST_METHOD_PROPERTIES()
+            TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+        END_TEST_METHOD_PROPERTIES()
+
+        std::wstring wstr;
+        while (wstr.size() < 4 * 1024 * 1024)
+        {
+            wstr.append(L"Search me \x3059\x3057 ");
+            wstr.append(SunglassesEmoji.begin(), SunglassesEmoji.end());
+        }
+
+        // Each glyph is a view into wstr, so walking them doesn't allocate at all.
+        size_t cGlyphs = 0;
+        size_t cchGlyphs = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto glyph : Utf16Parser::Parse(wstr))
+        {
+            cGlyphs++;
+            cchGlyphs += glyph.size();
+        }
+        const auto delta = PerfTestHelper::Microseconds(start, std::chrono::steady_clock::now());
+
+        VERIFY_ARE_EQUAL(wstr.size(), cchGlyphs);
+        Log::Comment(NoThrowString().Format(L"%zu glyphs took %lld us, with no allocations.", cGlyphs, delta));
+    }
 };
@@ -4,9 +4,13 @@
 #include "precomp.h"
 #include "WexTestClass.h"
 #include "../../inc/consoletaeftemplates.hpp"
+#include "PerfTestHelper.hpp"
 
 #include "utf8ToWideCharParser.hpp"
 
+#include <chrono>
+#include <random>
+
 #define IsBitSet WI_IsFlagSet
 
 using namespace WEX::Common;
@@ -350,4 +354,181 @@ class Utf8ToWideCharParserTests
         VERIFY_ARE_EQUAL(parser._Utf8SequenceSize(0xFF), (unsigned int)8);
     }
 
+    // Routine Description:
+    // - The parser as it was before it converted everything in a single pass:
+    // drop sequences that aren't well formed, save a partial sequence off
+    // the end, then hand what's left to MultiByteToWideChar, failing if it
+    // won't take it. The new parser has to produce exactly the same results.
+    // Arguments:
+    // - stored - The partial sequence saved from the last call. Updated.
+    // - input - The bytes to parse.
+    // - output - Receives the wide chars.
+    // Return Value:
+    // - S_OK or E_FAIL.
+    static HRESULT _ReferenceParse(std::vector<byte>& stored, const std::vector<byte>& input, std::wstring& output)
+    {
+        output.clear();
+        if (input.empty())
+        {
+            return S_OK;
+        }
+
+        auto parser = Utf8ToWideCharParser { utf8CodePage };
+        std::vector<byte> combined = stored;
+        combined.insert(combined.end(), input.cbegin(), input.cend());
+        stored.clear();
+
+        std::string valid;
+        size_t i = 0;
+        while (i < combined.size())
+        {
+            const byte ch = combined[i];
+            if (parser._IsAsciiByte(ch))
+            {
+                valid.push_back(ch);
+                ++i;
+            }
+            else if (parser._IsLeadByte(ch))
+            {
+                const size_t sequenceSize = parser._Utf8SequenceSize(ch);
+                size_t cContinuation = 0;
+                while (i + 1 + cContinuation < combined.size() &&
+                       cContinuation + 1 < sequenceSize &&
+                       parser._IsContinuationByte(combined[i + 1 + cContinuation]))
+                {
+                    ++cContinuation;
+                }
+
+                if (cContinuation + 1 == sequenceSize)
+                {
+                    valid.append(combined.cbegin() + i, combined.cbegin() + i + sequenceSize);
+                    i += sequenceSize;
+                }
+                else if (i + 1 + cContinuation == combined.size())
+                {
+                    stored.assign(combined.cbegin() + i, combined.cend());
+                    break;
+                }
+                else
+                {
+                    ++i;
+                }
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        if (valid.empty())
+        {
+            return stored.empty() ? E_FAIL : S_OK;
+        }
+
+        const int cch = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, valid.data(), static_cast<int>(valid.size()), nullptr, 0);
+        if (cch == 0)
+        {
+            stored.clear();
+            return E_FAIL;
+        }
+        output.resize(cch);
+        MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, valid.data(), static_cast<int>(valid.size()), output.data(), cch);
+        return S_OK;
+    }
+
+    TEST_METHOD(MatchesReferenceParserTest)
+    {
+        Log::Comment(L"Testing that random input, split at random points, parses the same as it did before the single pass conversion");
+        // Bytes that sit on the edges of what's valid UTF8, mixed in with plenty of ASCII.
+        const byte interesting[] = { 0x00, 0x1b, 0x7f, 0x80, 0x8f, 0x90, 0x9f, 0xa0, 0xbf, 0xc0, 0xc1, 0xc2, 0xdf,
+                                     0xe0, 0xe3, 0xed, 0xef, 0xf0, 0xf4, 0xf5, 0xf7, 0xf8, 0xff };
+        std::mt19937 engine(2019);
+        std::vector<wchar_t> buffer;
+
+        for (int session = 0; session < 5000; ++session)
+        {
+            auto parser = Utf8ToWideCharParser { utf8CodePage };
+            std::vector<byte> stored;
+            const size_t cChunks = 1 + engine() % 4;
+            for (size_t chunk = 0; chunk < cChunks; ++chunk)
+            {
+                std::vector<byte> input(engine() % 48);
+                for (auto& ch : input)
+                {
+                    ch = (engine() % 3 == 0) ? static_cast<byte>('a' + engine() % 26) : interesting[engine() % ARRAYSIZE(interesting)];
+                }
+
+                std::wstring expected;
+                const HRESULT expectedHr = _ReferenceParse(stored, input, expected);
+
+                const unsigned int count = static_cast<unsigned int>(input.size());
+                buffer.resize(parser.GetMaxConvertedLength(count));
+                unsigned int consumed = 0;
+                unsigned int generated = 0;
+                const HRESULT hr = parser.Parse(input.data(), count, consumed, buffer.data(), buffer.size(), generated);
+
+                VERIFY_ARE_EQUAL(expectedHr, hr);
+                VERIFY_ARE_EQUAL(SUCCEEDED(hr) ? count : 0u, consumed);
+                VERIFY_ARE_EQUAL(expected, std::wstring(buffer.data(), generated));
+                VERIFY_ARE_EQUAL(static_cast<unsigned int>(stored.size()), parser._bytesStored);
+                if (FAILED(hr))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(RejectsBufferThatIsTooSmallTest)
+    {
+        Log::Comment(L"Testing that a caller provided buffer has to have room for the whole conversion");
+        auto parser = Utf8ToWideCharParser { utf8CodePage };
+        const unsigned char hello[5] = { 0x48, 0x65, 0x6c, 0x6c, 0x6f };
+        wchar_t buffer[4];
+        unsigned int consumed = 0;
+        unsigned int generated = 0;
+        VERIFY_ARE_EQUAL(E_NOT_SUFFICIENT_BUFFER, parser.Parse(hello, ARRAYSIZE(hello), consumed, buffer, ARRAYSIZE(buffer), generated));
+        VERIFY_ARE_EQUAL(consumed, (unsigned int)0);
+        VERIFY_ARE_EQUAL(generated, (unsigned int)0);
+    }
+
+    TEST_METHOD(ParseThroughputTest)
+    {
+        BEGIN_TEST_METHOD_PROPERTIES()
+            TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+        END_TEST_METHOD_PROPERTIES()
+
+        std::string ascii;
+        std::string mixed;
+        while (ascii.size() < 4 * 1024 * 1024)
+        {
+            ascii.append("  utf8ToWideCharParser.cpp(120): note: see reference to function template instantiation\r\n");
+            // U+3059, U+3057 (hiragana sushi) and U+1F363 (sushi)
+            mixed.append("sushi \xe3\x81\x99\xe3\x81\x97 \xf0\x9f\x8d\xa3 \x1b[1;31mred\x1b[0m\r\n");
+        }
+
+        // The size of the reads the VT input thread does.
+        const unsigned int cbRead = 4096;
+        for (const auto& corpus : { ascii, mixed })
+        {
+            auto parser = Utf8ToWideCharParser { utf8CodePage };
+            std::vector<wchar_t> buffer(parser.GetMaxConvertedLength(cbRead) + 4);
+
+            HRESULT hr = S_OK;
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t pos = 0; SUCCEEDED(hr) && pos + cbRead <= corpus.size(); pos += cbRead)
+            {
+                unsigned int consumed = 0;
+                unsigned int generated = 0;
+                hr = parser.Parse(reinterpret_cast<const byte*>(corpus.data() + pos), cbRead, consumed, buffer.data(), buffer.size(), generated);
+            }
+            const auto delta = PerfTestHelper::Microseconds(start, std::chrono::steady_clock::now());
+            VERIFY_SUCCEEDED(hr);
+
+            Log::Comment(NoThrowString().Format(L"%zu bytes took %lld us. %.1f MB/s",
+                                                corpus.size(),
+                                                delta,
+                                                delta > 0 ? static_cast<double>(corpus.size()) / delta : 0.0));
+        }
+    }
 };
@@ -4,6 +4,7 @@
 #include "precomp.h"
 #include <wextestclass.h>
 #include "../../inc/consoletaeftemplates.hpp"
+#include "PerfTestHelper.hpp"
 #include "../../types/inc/Viewport.hpp"
 
 #include "../../renderer/vt/Xterm256Engine.hpp"
@@ -11,6 +12,8 @@
 #include "../../renderer/vt/WinTelnetEngine.hpp"
 #include "../Settings.hpp"
 
+#include <chrono>
+
 using namespace WEX::Common;
 using namespace WEX::Logging;
 using namespace WEX::TestExecution;
@@ -109,6 +112,20 @@ class Microsoft::Console::Render::VtRendererTest
 
     TEST_METHOD(TestResize);
 
+    TEST_METHOD(TestDirtyAreaRows);
+    TEST_METHOD(TestSparseUpdateBytesPerFrame);
+
+    TEST_METHOD(TestShadowSkipsUnchangedCells);
+
+    TEST_METHOD(TestSequenceFormattingThroughput);
+
+    TEST_METHOD(TestCoalescedGraphicsRendition);
+    TEST_METHOD(TestRainbowBrushesThroughput);
+
+    TEST_METHOD(TestPipeWriterMergesFrames);
+    TEST_METHOD(TestPipeWriterBrokenPipe);
+    TEST_METHOD(TestPipeWriterStalledTeardown);
+
     void Test16Colors(VtEngine* engine);
 
     std::deque<std::string> qExpectedInput;
@@ -247,6 +264,15 @@ void VtRendererTest::VtSequenceHelperTests()
 
     qExpectedInput.push_back("\x1b[10C");
     VERIFY_SUCCEEDED(engine->_CursorForward(10));
+
+    qExpectedInput.push_back("\x1b[120;32767H");
+    VERIFY_SUCCEEDED(engine->_CursorPosition({32766, 119}));
+
+    qExpectedInput.push_back("\x1b[97m");
+    VERIFY_SUCCEEDED(engine->_SetGraphicsRendition16Color(FOREGROUND_INTENSITY | FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE, true));
+
+    qExpectedInput.push_back("\x1b[40m");
+    VERIFY_SUCCEEDED(engine->_SetGraphicsRendition16Color(0, false));
 }
 
 void VtRendererTest::Xterm256TestInvalidate()
@@ -428,8 +454,7 @@ void VtRendererTest::Xterm256TestColors()
         L"Begin by setting some test values - FG,BG = (1,2,3), (4,5,6) to start"
         L"These values were picked for ease of formatting raw COLORREF values."
     ));
-    qExpectedInput.push_back("\x1b[38;2;1;2;3m");
-    qExpectedInput.push_back("\x1b[48;2;5;6;7m");
+    qExpectedInput.push_back("\x1b[38;2;1;2;3;48;2;5;6;7m");
     VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(0x00030201, 0x00070605, 0, false, false));
 
     TestPaint(*engine, [&]()
@@ -1338,3 +1363,558 @@ void VtRendererTest::TestResize()
 
 
 }
+
+void VtRendererTest::TestDirtyAreaRows()
+{
+    Viewport view = SetUpViewport();
+    wil::unique_hfile hFile = wil::unique_hfile(INVALID_HANDLE_VALUE);
+    auto engine = std::make_unique<Xterm256Engine>(std::move(hFile), p, view, g_ColorTable, static_cast<WORD>(COLOR_TABLE_SIZE));
+    engine->SetTestCallback([](const char* const, size_t const) { return true; });
+
+    // Get the first paint's clear out of the way.
+    TestPaint(*engine, [&]() {});
+
+    Log::Comment(NoThrowString().Format(
+        L"Changes in opposite corners only dirty the rows they're on."
+    ));
+    SMALL_RECT topLeft = { 0, 0, 1, 1 };
+    SMALL_RECT bottomRight = { 79, 31, 80, 32 };
+    VERIFY_SUCCEEDED(engine->Invalidate(&topLeft));
+    VERIFY_SUCCEEDED(engine->Invalidate(&bottomRight));
+    TestPaint(*engine, [&]()
+    {
+        // The bounds still cover both of them.
+        VERIFY_ARE_EQUAL(view, engine->_invalidRect);
+
+        const auto area = engine->GetDirtyArea();
+        VERIFY_ARE_EQUAL(static_cast<size_t>(2), area.size());
+        VERIFY_ARE_EQUAL(SMALL_RECT({ 0, 0, 0, 0 }), area.at(0));
+        VERIFY_ARE_EQUAL(SMALL_RECT({ 79, 31, 79, 31 }), area.at(1));
+    });
+
+    Log::Comment(NoThrowString().Format(
+        L"Rows right below each other with the same span share a rectangle, and spans on one row are joined."
+    ));
+    SMALL_RECT first = { 40, 7, 46, 8 };
+    SMALL_RECT second = { 40, 8, 46, 21 };
+    SMALL_RECT clock = { 70, 0, 74, 1 };
+    SMALL_RECT seconds = { 76, 0, 78, 1 };
+    VERIFY_SUCCEEDED(engine->Invalidate(&first));
+    VERIFY_SUCCEEDED(engine->Invalidate(&second));
+    VERIFY_SUCCEEDED(engine->Invalidate(&clock));
+    VERIFY_SUCCEEDED(engine->Invalidate(&seconds));
+    TestPaint(*engine, [&]()
+    {
+        const auto area = engine->GetDirtyArea();
+        VERIFY_ARE_EQUAL(static_cast<size_t>(2), area.size());
+        VERIFY_ARE_EQUAL(SMALL_RECT({ 70, 0, 77, 0 }), area.at(0));
+        VERIFY_ARE_EQUAL(SMALL_RECT({ 40, 7, 45, 20 }), area.at(1));
+    });
+
+    Log::Comment(NoThrowString().Format(
+        L"Scrolling moves each row's span along with the row."
+    ));
+    SMALL_RECT changed = { 10, 5, 20, 6 };
+    VERIFY_SUCCEEDED(engine->Invalidate(&changed));
+    COORD scrollDelta = { 0, 1 };
+    VERIFY_SUCCEEDED(engine->InvalidateScroll(&scrollDelta));
+    TestPaint(*engine, [&]()
+    {
+        const auto area = engine->GetDirtyArea();
+        VERIFY_ARE_EQUAL(static_cast<size_t>(2), area.size());
+        VERIFY_ARE_EQUAL(SMALL_RECT({ 0, 0, 79, 0 }), area.at(0));
+        VERIFY_ARE_EQUAL(SMALL_RECT({ 10, 5, 19, 6 }), area.at(1));
+    });
+
+    Log::Comment(NoThrowString().Format(
+        L"Invalidating everything is still one rectangle."
+    ));
+    VERIFY_SUCCEEDED(engine->InvalidateAll());
+    TestPaint(*engine, [&]()
+    {
+        const auto area = engine->GetDirtyArea();
+        VERIFY_ARE_EQUAL(static_cast<size_t>(1), area.size());
+        VERIFY_ARE_EQUAL(view.ToInclusive(), area.at(0));
+    });
+
+    Log::Comment(NoThrowString().Format(
+        L"Nothing is left dirty after the frame."
+    ));
+    VERIFY_IS_TRUE(engine->GetDirtyArea().empty());
+}
+
+void VtRendererTest::TestSparseUpdateBytesPerFrame()
+{
+    Viewport view = SetUpViewport();
+    wil::unique_hfile hFile = wil::unique_hfile(INVALID_HANDLE_VALUE);
+    auto engine = std::make_unique<Xterm256Engine>(std::move(hFile), p, view, g_ColorTable, static_cast<WORD>(COLOR_TABLE_SIZE));
+
+    size_t bytes = 0;
+    engine->SetTestCallback([&](const char* const, size_t const cch) {
+        bytes += cch;
+        return true;
+    });
+
+    // A screen full of text, the way top leaves it between updates.
+    std::vector<std::wstring> screen;
+    for (short row = 0; row < view.Height(); row++)
+    {
+        std::wstring line;
+        for (short col = 0; col < view.Width(); col++)
+        {
+            line.push_back(static_cast<wchar_t>(L'a' + (row + col) % 26));
+        }
+        screen.push_back(line);
+    }
+
+    // Paints the given areas of the screen the way the renderer does, a row at a time.
+    // The shadow is forgotten first, so this measures the cost of the paint
+    //      area itself, not what the terminal already happens to show.
+    const auto paintFrame = [&](const std::vector<SMALL_RECT>& area) {
+        engine->_ShadowForget();
+        for (const auto& rect : area)
+        {
+            for (short row = rect.Top; row <= rect.Bottom; row++)
+            {
+                std::vector<Cluster> clusters;
+                for (short col = rect.Left; col <= rect.Right; col++)
+                {
+                    clusters.emplace_back(std::wstring_view{ &screen.at(row).at(col), 1 }, static_cast<size_t>(1));
+                }
+                VERIFY_SUCCEEDED(engine->PaintBufferLine({ clusters.data(), clusters.size() }, { rect.Left, row }, false));
+            }
+        }
+    };
+
+    // Each update changes the clock in the top right, and the CPU column of the process list.
+    const auto invalidateUpdate = [&]() {
+        SMALL_RECT clock = { 70, 0, 78, 1 };
+        SMALL_RECT cpu = { 40, 7, 46, 31 };
+        VERIFY_SUCCEEDED(engine->Invalidate(&clock));
+        VERIFY_SUCCEEDED(engine->Invalidate(&cpu));
+    };
+
+    // Get the first paint's clear out of the way.
+    TestPaint(*engine, [&]() {});
+
+    const size_t frames = 20;
+    size_t rowBytes = 0;
+    size_t boundsBytes = 0;
+    for (size_t i = 0; i < frames; i++)
+    {
+        invalidateUpdate();
+        bytes = 0;
+        TestPaint(*engine, [&]() { paintFrame(engine->GetDirtyArea()); });
+        rowBytes += bytes;
+
+        // The same update again, painting everything within the bounds of the changes.
+        invalidateUpdate();
+        bytes = 0;
+        TestPaint(*engine, [&]() { paintFrame({ engine->GetDirtyRectInChars() }); });
+        boundsBytes += bytes;
+    }
+
+    Log::Comment(NoThrowString().Format(
+        L"Bytes per frame: %zu painting the dirty rows, %zu painting the dirty bounds.",
+        rowBytes / frames,
+        boundsBytes / frames
+    ));
+    VERIFY_IS_LESS_THAN(rowBytes * 2, boundsBytes);
+}
+
+void VtRendererTest::TestShadowSkipsUnchangedCells()
+{
+    wil::unique_hfile hFile = wil::unique_hfile(INVALID_HANDLE_VALUE);
+    std::unique_ptr<Xterm256Engine> engine = std::make_unique<Xterm256Engine>(std::move(hFile), p, SetUpViewport(), g_ColorTable, static_cast<WORD>(COLOR_TABLE_SIZE));
+    auto pfn = std::bind(&VtRendererTest::WriteCallback, this, std::placeholders::_1, std::placeholders::_2);
+    engine->SetTestCallback(pfn);
+
+    // Verify the first paint emits a clear and go home
+    qExpectedInput.push_back("\x1b[2J");
+    TestPaint(*engine, [&]() {});
+
+    qExpectedInput.push_back("\x1b[38;2;1;2;3;48;2;5;6;7m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(0x00030201, 0x00070605, 0, false, false));
+
+    std::wstring line = L"asdfghjkl";
+    const auto paintLine = [&](const short row) {
+        std::vector<Cluster> clusters;
+        for (size_t i = 0; i < line.size(); i++)
+        {
+            clusters.emplace_back(std::wstring_view{ &line.at(i), 1 }, static_cast<size_t>(1));
+        }
+        VERIFY_SUCCEEDED(engine->PaintBufferLine({ clusters.data(), clusters.size() }, { 0, row }, false));
+    };
+
+    TestPaintXterm(*engine, [&]()
+    {
+        Log::Comment(NoThrowString().Format(
+            L"The first time a line is painted, all of it is written."
+        ));
+        qExpectedInput.push_back("\x1b[H");
+        VERIFY_SUCCEEDED(engine->_MoveCursor({ 0, 0 }));
+        qExpectedInput.push_back("asdfghjkl");
+        paintLine(0);
+    });
+
+    TestPaintXterm(*engine, [&]()
+    {
+        Log::Comment(NoThrowString().Format(
+            L"Painting the same line again writes nothing."
+        ));
+        qExpectedInput.push_back(EMPTY_CALLBACK_SENTINEL);
+        paintLine(0);
+        WriteCallback(EMPTY_CALLBACK_SENTINEL, 1);
+    });
+
+    TestPaintXterm(*engine, [&]()
+    {
+        Log::Comment(NoThrowString().Format(
+            L"Changing one character only moves to it and writes it."
+        ));
+        line.at(4) = L'X';
+        qExpectedInput.push_back("\x1b[1;5H");
+        qExpectedInput.push_back("X");
+        paintLine(0);
+    });
+
+    TestPaintXterm(*engine, [&]()
+    {
+        Log::Comment(NoThrowString().Format(
+            L"Changing the colors repaints the whole line."
+        ));
+        qExpectedInput.push_back("\x1b[48;2;7;8;9m");
+        VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(0x00030201, 0x00090807, 0, false, false));
+        qExpectedInput.push_back("\x1b[H");
+        qExpectedInput.push_back("asdfXhjkl");
+        paintLine(0);
+    });
+
+    COORD scrollDelta = { 0, 1 };
+    VERIFY_SUCCEEDED(engine->InvalidateScroll(&scrollDelta));
+    TestPaintXterm(*engine, [&]()
+    {
+        Log::Comment(NoThrowString().Format(
+            L"After scrolling down, the line moved with the terminal's contents, "
+            L"and the new top line is unknown."
+        ));
+        qExpectedInput.push_back("\x1b[H");
+        qExpectedInput.push_back("\x1b[L");
+        VERIFY_SUCCEEDED(engine->ScrollFrame());
+
+        qExpectedInput.push_back(EMPTY_CALLBACK_SENTINEL);
+        paintLine(1);
+        WriteCallback(EMPTY_CALLBACK_SENTINEL, 1);
+
+        qExpectedInput.push_back("asdfXhjkl");
+        paintLine(0);
+    });
+
+    TestPaintXterm(*engine, [&]()
+    {
+        Log::Comment(NoThrowString().Format(
+            L"Text written straight to the terminal means we have to paint everything again."
+        ));
+        qExpectedInput.push_back("foo");
+        VERIFY_SUCCEEDED(engine->WriteTerminalW(L"foo"));
+        qExpectedInput.push_back("\r\n");
+        qExpectedInput.push_back("asdfXhjkl");
+        paintLine(1);
+    });
+}
+
+void VtRendererTest::TestSequenceFormattingThroughput()
+{
+    BEGIN_TEST_METHOD_PROPERTIES()
+        TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+    END_TEST_METHOD_PROPERTIES()
+
+    Viewport view = SetUpViewport();
+    wil::unique_hfile hFile = wil::unique_hfile(INVALID_HANDLE_VALUE);
+    auto engine = std::make_unique<Xterm256Engine>(std::move(hFile), p, view, g_ColorTable, static_cast<WORD>(COLOR_TABLE_SIZE));
+    // No test callback, so the sequences are appended to the engine's buffer,
+    //      the same as when there's a real pipe.
+
+    // Each frame moves to every row and sets the colors and erases some of it,
+    //      the way a full repaint of a colorful screen does.
+    const size_t frames = 1000;
+    size_t sequences = 0;
+    size_t bufferGrowths = 0;
+    bool succeeded = true;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t frame = 0; frame < frames; frame++)
+    {
+        engine->_buffer.clear();
+        const auto capacity = engine->_buffer.capacity();
+
+        for (short row = 0; row < view.Height(); row++)
+        {
+            succeeded &= SUCCEEDED(engine->_CursorPosition({ 0, row }));
+            const int sgr[] = { 38, 2, row, 128, 255 - row, 48, 2, 255, (row * 8) & 0xff, 0 };
+            succeeded &= SUCCEEDED(engine->_SetGraphicsRendition(sgr, ARRAYSIZE(sgr)));
+            succeeded &= SUCCEEDED(engine->_EraseCharacter(static_cast<short>(view.Width() - row)));
+            sequences += 3;
+        }
+
+        // The first frame grows the buffer to fit. After that, no sequence should need to allocate.
+        if (frame > 0 && engine->_buffer.capacity() != capacity)
+        {
+            bufferGrowths++;
+        }
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    VERIFY_IS_TRUE(succeeded);
+
+    const auto ns = PerfTestHelper::Nanoseconds(start, end);
+    Log::Comment(NoThrowString().Format(
+        L"%zu sequences in %zu frames: %lld ns per sequence, %zu buffer reallocations after the first frame.",
+        sequences,
+        frames,
+        ns / static_cast<long long>(sequences),
+        bufferGrowths
+    ));
+    VERIFY_ARE_EQUAL(static_cast<size_t>(0), bufferGrowths);
+}
+
+void VtRendererTest::TestCoalescedGraphicsRendition()
+{
+    // A copy of the table, so we can change it under the engine.
+    COLORREF colorTable[COLOR_TABLE_SIZE];
+    std::copy(std::begin(g_ColorTable), std::end(g_ColorTable), std::begin(colorTable));
+
+    wil::unique_hfile hFile = wil::unique_hfile(INVALID_HANDLE_VALUE);
+    std::unique_ptr<Xterm256Engine> engine = std::make_unique<Xterm256Engine>(std::move(hFile), p, SetUpViewport(), colorTable, static_cast<WORD>(COLOR_TABLE_SIZE));
+    auto pfn = std::bind(&VtRendererTest::WriteCallback, this, std::placeholders::_1, std::placeholders::_2);
+    engine->SetTestCallback(pfn);
+
+    Log::Comment(NoThrowString().Format(
+        L"Boldness, an RGB foreground and a table background are one sequence."
+    ));
+    qExpectedInput.push_back("\x1b[1;38;2;1;2;3;41m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(0x00030201, colorTable[4], 0, true, false));
+
+    qExpectedInput.push_back("\x1b[22;37m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(colorTable[7], colorTable[4], 0, false, false));
+
+    Log::Comment(NoThrowString().Format(
+        L"Going back to the defaults while bold resets and bolds in one sequence."
+    ));
+    qExpectedInput.push_back("\x1b[0;1m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(colorTable[15], colorTable[0], 0, true, false));
+
+    qExpectedInput.push_back("\x1b[22m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(colorTable[15], colorTable[0], 0, false, false));
+
+    Log::Comment(NoThrowString().Format(
+        L"A color that's not in the table is written as RGB."
+    ));
+    qExpectedInput.push_back("\x1b[37;48;2;18;52;86m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(colorTable[7], 0x00563412, 0, false, false));
+
+    qExpectedInput.push_back("\x1b[44m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(colorTable[7], colorTable[1], 0, false, false));
+
+    Log::Comment(NoThrowString().Format(
+        L"Once the table has that color, the cached lookup is thrown out, and the table index is used."
+    ));
+    colorTable[4] = 0x00563412;
+    Log::Comment(NoThrowString().Format(
+        L"The table's only compared once a frame, so that needs a new frame to be noticed."
+    ));
+    VERIFY_SUCCEEDED(engine->StartPaint());
+    qExpectedInput.push_back("\x1b[41m");
+    VERIFY_SUCCEEDED(engine->UpdateDrawingBrushes(colorTable[7], 0x00563412, 0, false, false));
+}
+
+void VtRendererTest::TestRainbowBrushesThroughput()
+{
+    BEGIN_TEST_METHOD_PROPERTIES()
+        TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+    END_TEST_METHOD_PROPERTIES()
+
+    Viewport view = SetUpViewport();
+
+    // Every cell of the screen gets its own foreground from a gradient, the
+    //      background changes every 8 cells, and every 16th cell is bold.
+    const auto measure = [&](VtEngine& engine, const wchar_t* const name) {
+        size_t bytes = 0;
+        size_t writes = 0;
+        engine.SetTestCallback([&](const char* const, size_t const cch) {
+            bytes += cch;
+            writes++;
+            return true;
+        });
+
+        const size_t frames = 100;
+        const size_t cells = static_cast<size_t>(view.Width()) * view.Height();
+        bool succeeded = true;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t frame = 0; frame < frames; frame++)
+        {
+            // Each frame checks the color table once, like a real paint does.
+            succeeded &= SUCCEEDED(engine.StartPaint());
+            for (size_t cell = 0; cell < cells; cell++)
+            {
+                const BYTE step = static_cast<BYTE>((cell % 64) * 4);
+                const COLORREF foreground = RGB(step, 255 - step, step / 2);
+                const COLORREF background = g_ColorTable[1 + (cell / 8) % 6];
+                succeeded &= SUCCEEDED(engine.UpdateDrawingBrushes(foreground, background, 0, (cell % 16) == 0, false));
+            }
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        VERIFY_IS_TRUE(succeeded);
+
+        const size_t changes = frames * cells;
+        const auto ns = PerfTestHelper::Nanoseconds(start, end);
+        Log::Comment(NoThrowString().Format(
+            L"%s: %zu brush changes, %zu bytes per change, %lld ns per change.",
+            name,
+            changes,
+            bytes / changes,
+            ns / static_cast<long long>(changes)
+        ));
+
+        // Every call changes the foreground, and each change is a single sequence.
+        VERIFY_ARE_EQUAL(changes, writes);
+    };
+
+    wil::unique_hfile hFile256 = wil::unique_hfile(INVALID_HANDLE_VALUE);
+    Xterm256Engine engine256(std::move(hFile256), p, view, g_ColorTable, static_cast<WORD>(COLOR_TABLE_SIZE));
+    measure(engine256, L"xterm-256color");
+
+    wil::unique_hfile hFile16 = wil::unique_hfile(INVALID_HANDLE_VALUE);
+    XtermEngine engine16(std::move(hFile16), p, view, g_ColorTable, static_cast<WORD>(COLOR_TABLE_SIZE), false);
+    measure(engine16, L"xterm");
+}
+
+void VtRendererTest::TestPipeWriterMergesFrames()
+{
+    wil::unique_hfile readPipe;
+    wil::unique_hfile writePipe;
+    VERIFY_WIN32_BOOL_SUCCEEDED(CreatePipe(readPipe.put(), writePipe.put(), nullptr, 0));
+
+    const auto readExactly = [&](const size_t cb) {
+        std::string result(cb, '\0');
+        size_t cbRead = 0;
+        while (cbRead < cb)
+        {
+            DWORD dwRead = 0;
+            VERIFY_WIN32_BOOL_SUCCEEDED(ReadFile(readPipe.get(), result.data() + cbRead, static_cast<DWORD>(cb - cbRead), &dwRead, nullptr));
+            cbRead += dwRead;
+        }
+        return result;
+    };
+
+    VtPipeWriter writer(writePipe.get(), nullptr);
+
+    Log::Comment(NoThrowString().Format(
+        L"Frames submitted while the writer is busy (here, not started yet) are merged into one."
+    ));
+    std::string frame;
+    for (int i = 0; i < 3; i++)
+    {
+        frame = "frame" + std::to_string(i);
+        VERIFY_SUCCEEDED(writer.Submit(frame));
+        VERIFY_IS_TRUE(frame.empty());
+    }
+
+    VtPipeWriter::Metrics metrics = writer.GetMetrics();
+    VERIFY_ARE_EQUAL(static_cast<size_t>(3), metrics.framesSubmitted);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(2), metrics.framesMerged);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(0), metrics.framesDropped);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(0), metrics.writes);
+
+    VERIFY_SUCCEEDED(writer.Start());
+    VERIFY_ARE_EQUAL(std::string("frame0frame1frame2"), readExactly(18));
+
+    Log::Comment(NoThrowString().Format(
+        L"Once the writer has caught up, the next frame goes out on its own."
+    ));
+    frame = "frame3";
+    VERIFY_SUCCEEDED(writer.Submit(frame));
+    VERIFY_ARE_EQUAL(std::string("frame3"), readExactly(6));
+
+    // The read can finish before the writer has counted the write.
+    VERIFY_IS_TRUE(writer.WaitForWrites(INFINITE));
+    metrics = writer.GetMetrics();
+    VERIFY_ARE_EQUAL(static_cast<size_t>(4), metrics.framesSubmitted);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(2), metrics.framesMerged);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(2), metrics.writes);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(24), metrics.bytesWritten);
+}
+
+void VtRendererTest::TestPipeWriterBrokenPipe()
+{
+    wil::unique_hfile readPipe;
+    wil::unique_hfile writePipe;
+    VERIFY_WIN32_BOOL_SUCCEEDED(CreatePipe(readPipe.put(), writePipe.put(), nullptr, 0));
+
+    // Signalled by the writer thread when it reports the broken pipe.
+    wil::unique_event pipeBroken;
+    pipeBroken.create();
+    HRESULT hrBroken = S_OK;
+
+    VtPipeWriter writer(writePipe.get(), [&](const HRESULT hr) {
+        hrBroken = hr;
+        pipeBroken.SetEvent();
+    });
+    VERIFY_SUCCEEDED(writer.Start());
+
+    Log::Comment(NoThrowString().Format(
+        L"Closing the other end fails the next write, which is reported right away."
+    ));
+    readPipe.reset();
+
+    std::string frame = "frame";
+    VERIFY_SUCCEEDED(writer.Submit(frame));
+    VERIFY_IS_TRUE(frame.empty());
+
+    pipeBroken.wait();
+    VERIFY_FAILED(hrBroken);
+    VERIFY_IS_TRUE(writer.WaitForWrites(INFINITE));
+
+    Log::Comment(NoThrowString().Format(
+        L"Every frame after that is dropped."
+    ));
+    frame = "frame";
+    VERIFY_ARE_EQUAL(hrBroken, writer.Submit(frame));
+    VERIFY_IS_TRUE(frame.empty());
+
+    const VtPipeWriter::Metrics metrics = writer.GetMetrics();
+    VERIFY_ARE_EQUAL(static_cast<size_t>(2), metrics.framesSubmitted);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(1), metrics.framesDropped);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(1), metrics.writes);
+    VERIFY_ARE_EQUAL(static_cast<size_t>(0), metrics.bytesWritten);
+}
+
+void VtRendererTest::TestPipeWriterStalledTeardown()
+{
+    wil::unique_hfile readPipe;
+    wil::unique_hfile writePipe;
+    VERIFY_WIN32_BOOL_SUCCEEDED(CreatePipe(readPipe.put(), writePipe.put(), nullptr, 1));
+
+    bool reported = false;
+    auto writer = std::make_unique<VtPipeWriter>(writePipe.get(), [&](const HRESULT) {
+        reported = true;
+    });
+    VERIFY_SUCCEEDED(writer->Start());
+
+    Log::Comment(NoThrowString().Format(
+        L"A frame much bigger than the pipe blocks the writer, since nobody reads it."
+    ));
+    std::string frame(1024 * 1024, 'x');
+    VERIFY_SUCCEEDED(writer->Submit(frame));
+    VERIFY_IS_FALSE(writer->WaitForWrites(0));
+
+    Log::Comment(NoThrowString().Format(
+        L"Tearing the writer down gives up on the write instead of waiting for the terminal forever."
+    ));
+    writer.reset();
+
+    // The write was cancelled because we asked for it, so it's not a broken pipe.
+    VERIFY_IS_FALSE(reported);
+}
@@ -6,6 +6,10 @@
 #include "utf8ToWideCharParser.hpp"
 #include <unicode.hpp>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#endif
+
 #ifndef WIL_ENABLE_EXCEPTIONS
 #error WIL exception helpers must be enabled
 #endif
@@ -19,6 +23,44 @@ const byte ContinuationBytePrefix = 0x80;
 
 const byte MostSignificantBitMask = 0x80;
 
+// Routine Description:
+// - Widens the run of ASCII bytes at the start of the range straight into
+// the output. Where the processor allows, 16 bytes are checked and
+// widened at a time.
+// Arguments:
+// - pb - The start of the range.
+// - pbEnd - The end of the range.
+// - pwchOut - Where to write the wide chars. On return, just past the
+// last one written.
+// Return Value:
+// - The first byte that isn't ASCII, or pbEnd.
+static const byte* _WidenAsciiRun(const byte* pb, const byte* const pbEnd, wchar_t*& pwchOut) noexcept
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128();
+    while (pbEnd - pb >= 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb));
+        if (_mm_movemask_epi8(bytes) != 0)
+        {
+            // There's a non-ASCII byte in this block. Finish up one at a time.
+            break;
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pwchOut), _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pwchOut + 8), _mm_unpackhi_epi8(bytes, zero));
+        pb += 16;
+        pwchOut += 16;
+    }
+#endif
+
+    while (pb < pbEnd && !IsBitSet(*pb, NonAsciiBytePrefix))
+    {
+        *pwchOut++ = *pb++;
+    }
+    return pb;
+}
+
 // Routine Description:
 // - Constructs an instance of the parser.
 // Arguments:
@@ -28,8 +70,7 @@ const byte MostSignificantBitMask = 0x80;
 Utf8ToWideCharParser::Utf8ToWideCharParser(const unsigned int codePage) :
     _currentCodePage { codePage },
     _bytesStored { 0 },
-    _currentState { _State::Ready },
-    _convertedWideChars { nullptr }
+    _currentState { _State::Ready }
 {
     std::fill_n(_utf8CodePointPieces, _UTF8_BYTE_SEQUENCE_MAX, 0ui8);
 }
@@ -55,16 +96,19 @@ void Utf8ToWideCharParser::SetCodePage(const unsigned int codePage)
 }
 
 // Routine Description:
-// - Parses the input multi-byte sequence.
+// - Parses the input multi-byte sequence into a newly allocated array.
 // Arguments:
 // - pBytes - The byte sequence to parse.
-// - cchBuffer - The amount of bytes in pBytes. This will contain the
-// number of wide chars contained by converted after this function is
-// run, or 0 if an error occurs (or if pBytes is 0).
+// - cchBuffer - The amount of bytes in pBytes.
+// - cchConsumed - The amount of bytes consumed from pBytes. Bytes that
+// were stored as part of a partial sequence count as consumed.
 // - converted - a valid unique_ptr to store the parsed wide chars
-// in. On error this will contain nullptr instead of an array.
+// in. On error, or if no wide chars were produced, this will contain
+// nullptr instead of an array.
+// - cchConverted - The number of wide chars contained by converted
+// after this function is run, or 0 if an error occurs (or if pBytes is 0).
 // Return Value:
-// - <none>
+// - S_OK on success, otherwise an appropriate failure.
 [[nodiscard]]
 HRESULT Utf8ToWideCharParser::Parse(_In_reads_(cchBuffer) const byte* const pBytes,
                                     _In_ unsigned int const cchBuffer,
@@ -75,6 +119,58 @@ HRESULT Utf8ToWideCharParser::Parse(_In_reads_(cchBuffer) const byte* const pByt
     cchConsumed = 0;
     cchConverted = 0;
 
+    // we can't parse anything if we weren't given any data to parse
+    if (cchBuffer == 0)
+    {
+        return S_OK;
+    }
+
+    try
+    {
+        const size_t cchConvertedMax = GetMaxConvertedLength(cchBuffer);
+        std::unique_ptr<wchar_t[]> convertedWideChars = std::make_unique<wchar_t[]>(cchConvertedMax);
+        const HRESULT hr = Parse(pBytes, cchBuffer, cchConsumed, convertedWideChars.get(), cchConvertedMax, cchConverted);
+        converted.reset(SUCCEEDED(hr) && cchConverted > 0 ? convertedWideChars.release() : nullptr);
+        return hr;
+    }
+    catch (...)
+    {
+        _Reset();
+        converted.reset(nullptr);
+        return wil::ResultFromCaughtException();
+    }
+}
+
+// Routine Description:
+// - Parses the input multi-byte sequence into a buffer provided by the
+// caller. Any partial sequence saved from the last call is completed
+// first. Invalid byte sequences are removed, and a partial sequence at
+// the end of the input is saved for the next call.
+// Arguments:
+// - pBytes - The byte sequence to parse.
+// - cchBuffer - The amount of bytes in pBytes.
+// - cchConsumed - The amount of bytes consumed from pBytes. Bytes that
+// were stored as part of a partial sequence count as consumed.
+// - pwchConverted - The buffer to write the parsed wide chars into.
+// - cchConvertedMax - The size of pwchConverted, in wide chars. This
+// must be at least GetMaxConvertedLength(cchBuffer).
+// - cchConverted - The number of wide chars written to pwchConverted,
+// or 0 if an error occurs (or if pBytes is 0).
+// Return Value:
+// - S_OK on success, otherwise an appropriate failure. A sequence that's
+// well formed but doesn't encode a valid code point (overlong forms,
+// surrogates, values past U+10FFFF) fails the whole parse with E_FAIL.
+[[nodiscard]]
+HRESULT Utf8ToWideCharParser::Parse(_In_reads_(cchBuffer) const byte* const pBytes,
+                                    _In_ unsigned int const cchBuffer,
+                                    _Out_ unsigned int& cchConsumed,
+                                    _Out_writes_to_(cchConvertedMax, cchConverted) wchar_t* const pwchConverted,
+                                    const size_t cchConvertedMax,
+                                    _Out_ unsigned int& cchConverted)
+{
+    cchConsumed = 0;
+    cchConverted = 0;
+
     // we can't parse anything if we weren't given any data to parse
     if (cchBuffer == 0)
     {
@@ -83,54 +179,86 @@ HRESULT Utf8ToWideCharParser::Parse(_In_reads_(cchBuffer) const byte* const pByt
     // we shouldn't be parsing if the current codepage isn't UTF8
     if (_currentCodePage != CP_UTF8)
     {
-        _currentState = _State::Error;
+        _Reset();
+        return E_FAIL;
     }
-    HRESULT hr = S_OK;
-    try
+    RETURN_HR_IF(E_NOT_SUFFICIENT_BUFFER, cchConvertedMax < GetMaxConvertedLength(cchBuffer));
+
+    wchar_t* pwchOut = pwchConverted;
+    bool fSucceeded = true;
+    const byte* pb = pBytes;
+    const byte* const pbEnd = pBytes + cchBuffer;
+
+    if (_bytesStored > 0)
     {
-        bool loop = true;
-        unsigned int wideCharCount = 0;
-        _convertedWideChars.reset(nullptr);
-        while (loop)
+        // Finish off the saved partial sequence first. It can need at most
+        // _UTF8_BYTE_SEQUENCE_MAX more bytes to tell whether it's complete.
+        byte combined[_UTF8_BYTE_SEQUENCE_MAX * 2];
+        const unsigned int cbStored = _bytesStored;
+        const unsigned int cbTaken = std::min(cchBuffer, _UTF8_BYTE_SEQUENCE_MAX);
+        std::copy(_utf8CodePointPieces, _utf8CodePointPieces + cbStored, combined);
+        std::copy(pBytes, pBytes + cbTaken, combined + cbStored);
+        _bytesStored = 0;
+
+        const byte* pbCombined = combined;
+        const byte* const pbCombinedEnd = combined + cbStored + cbTaken;
+        while (fSucceeded && pbCombined < combined + cbStored)
         {
-            switch(_currentState)
-            {
-                case _State::Ready:
-                    wideCharCount = _ParseFullRange(pBytes, cchBuffer);
-                    break;
-                case _State::BeginPartialParse:
-                    wideCharCount = _InvolvedParse(pBytes, cchBuffer);
-                    break;
-                case _State::Error:
-                    hr = E_FAIL;
-                    _Reset();
-                    wideCharCount = 0;
-                    loop = false;
-                    break;
-                case _State::Finished:
-                    _currentState = _State::Ready;
-                    cchConsumed = cchBuffer;
-                    loop = false;
-                    break;
-                case _State::AwaitingMoreBytes:
-                    _currentState = _State::BeginPartialParse;
-                    cchConsumed = cchBuffer;
-                    loop = false;
-                    break;
-                default:
-                    _currentState = _State::Error;
-                    break;
-            }
+            fSucceeded = _ConvertSequence(pbCombined, pbCombinedEnd, pwchOut);
         }
-        converted.swap(_convertedWideChars);
-        cchConverted = wideCharCount;
+
+        // Pick up from wherever that left off in the new bytes. If it
+        // stopped part way through a run of junk continuation bytes, the
+        // main loop skips the rest of the run just the same.
+        pb = (_bytesStored > 0) ? pbEnd : pBytes + (pbCombined - combined - cbStored);
     }
-    catch (...)
+
+    while (fSucceeded && pb < pbEnd)
+    {
+        pb = _WidenAsciiRun(pb, pbEnd, pwchOut);
+        if (pb < pbEnd)
+        {
+            fSucceeded = _ConvertSequence(pb, pbEnd, pwchOut);
+        }
+    }
+
+    // Nothing at all left after removing the invalid sequences is an
+    // error, unless we're just waiting on the rest of a partial sequence.
+    if (!fSucceeded || (pwchOut == pwchConverted && _bytesStored == 0))
     {
         _Reset();
-        hr = wil::ResultFromCaughtException();
+        return E_FAIL;
     }
-    return hr;
+
+    _currentState = (_bytesStored > 0) ? _State::BeginPartialParse : _State::Ready;
+    cchConsumed = cchBuffer;
+    cchConverted = static_cast<unsigned int>(pwchOut - pwchConverted);
+    return S_OK;
+}
+
+// Routine Description:
+// - Determines how large a buffer the caller needs to provide for Parse.
+// No sequence produces more wide chars than it has bytes, but a partial
+// sequence saved from the last call adds its bytes to the input.
+// Arguments:
+// - cchBuffer - The amount of bytes that will be passed to Parse.
+// Return Value:
+// - The maximum number of wide chars that Parse may write.
+size_t Utf8ToWideCharParser::GetMaxConvertedLength(const unsigned int cchBuffer) const noexcept
+{
+    return static_cast<size_t>(cchBuffer) + _bytesStored;
+}
+
+// Routine Description:
+// - Determines if part of a sequence was saved from the last call to Parse,
+// waiting for the rest of it.
+// Arguments:
+// - <none>
+// Return Value:
+// - true if the next call to Parse will start by completing a saved sequence.
+bool Utf8ToWideCharParser::IsPartialSequencePending() const noexcept
+{
+    return _currentState == _State::BeginPartialParse;
 }
 
 // Routine Description:
@@ -174,75 +302,6 @@ bool Utf8ToWideCharParser::_IsAsciiByte(_In_ byte ch)
     return !IsBitSet(ch, NonAsciiBytePrefix);
 }
 
-// Routine Description:
-// - Determines if the sequence starting at pLeadByte is a valid UTF8
-// multi-byte sequence. Note that a single ASCII byte does not count
-// as a valid MULTI-byte sequence.
-// Arguments:
-// - pLeadByte - The start of a possible sequence.
-// - cb - The amount of remaining chars in the array that
-// pLeadByte points to.
-// Return Value:
-// - true if the sequence starting at pLeadByte is a multi-byte
-// sequence and uses all of the remaining chars, false otherwise.
-bool Utf8ToWideCharParser::_IsValidMultiByteSequence(_In_reads_(cb) const byte* const pLeadByte, const unsigned int cb)
-{
-    if (!_IsLeadByte(*pLeadByte))
-    {
-        return false;
-    }
-    const unsigned int sequenceSize = _Utf8SequenceSize(*pLeadByte);
-    if (sequenceSize > cb)
-    {
-        return false;
-    }
-    // i starts at 1 so that we skip the lead byte
-    for (unsigned int i = 1; i < sequenceSize; ++i)
-    {
-        const byte ch = *(pLeadByte + i);
-        if (!_IsContinuationByte(ch))
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
-// Routine Description:
-// - Checks if the sequence starting at pLeadByte is a portion of a
-// single valid multi-byte sequence. A new sequence must not be
-// started within the range provided in order for it to be considered
-// a valid partial sequence.
-// Arguments:
-// - pLeadByte - The start of the possible partial sequence.
-// - cb - The amount of remaining chars in the array that
-// pLeadByte points to.
-// Return Value:
-// - true if the sequence is a single partial multi-byte sequence,
-// false otherwise.
-bool Utf8ToWideCharParser::_IsPartialMultiByteSequence(_In_reads_(cb) const byte* const pLeadByte, const unsigned int cb)
-{
-    if (!_IsLeadByte(*pLeadByte))
-    {
-        return false;
-    }
-    const unsigned int sequenceSize = _Utf8SequenceSize(*pLeadByte);
-    if (sequenceSize <= cb)
-    {
-        return false;
-    }
-    // i starts at 1 so that we skip the lead byte
-    for (unsigned int i = 1; i < cb; ++i)
-    {
-        const byte ch = *(pLeadByte + i);
-        if (!_IsContinuationByte(ch))
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
 // Routine Description:
 // - Determines the number of bytes in the UTF8 multi-byte sequence.
 // Does not perform any verification that ch is a valid lead byte. A
@@ -279,219 +338,89 @@ unsigned int Utf8ToWideCharParser::_Utf8SequenceSize(_In_ byte ch)
 }
 
 // Routine Description:
-// - Attempts to parse pInputChars by themselves in wide chars,
-// without using any saved partial byte sequences. On success,
-// _convertedWideChars will contain the converted wide char sequence
-// and _currentState will be set to _State::Finished. On failure,
-// _currentState will be set to either _State::Error or
-// _State::BeginPartialParse.
+// - Converts the sequence that starts at pb, which must not be ASCII (the
+// caller widens runs of those itself). Sequences that aren't well formed
+// are skipped, the same as a run of continuation bytes or a byte that
+// can't start a sequence. A well formed sequence that runs off the end
+// of the input is saved as a partial sequence for the next call.
 // Arguments:
-// - pInputChars - The byte sequence to convert to wide chars.
-// - cb - The amount of bytes in pInputChars.
+// - pb - The start of the sequence. On return, the start of the next one.
+// - pbEnd - The end of the input.
+// - pwchOut - Where to write the converted wide chars. On return, just
+// past the last one written.
 // Return Value:
-// - The amount of wide chars that are stored in _convertedWideChars,
-// or 0 if pInputChars cannot be successfully converted.
-unsigned int Utf8ToWideCharParser::_ParseFullRange(_In_reads_(cb) const byte* const pInputChars, const unsigned int cb)
+// - false if the sequence is well formed but isn't a valid encoding of a
+// code point, true otherwise.
+bool Utf8ToWideCharParser::_ConvertSequence(_Inout_ const byte*& pb, const byte* const pbEnd, _Inout_ wchar_t*& pwchOut)
 {
-    int bufferSize = MultiByteToWideChar(_currentCodePage,
-                                         MB_ERR_INVALID_CHARS,
-                                         reinterpret_cast<LPCCH>(pInputChars),
-                                         cb,
-                                         nullptr,
-                                         0);
-    if (bufferSize == 0)
+    if (_IsAsciiByte(*pb))
     {
-        DWORD err = GetLastError();
-        LOG_WIN32(err);
-        if (err == ERROR_NO_UNICODE_TRANSLATION)
-        {
-            _currentState = _State::BeginPartialParse;
-        }
-        else
-        {
-            _currentState = _State::Error;
-        }
+        *pwchOut++ = *pb++;
+        return true;
     }
-    else
+
+    if (!_IsLeadByte(*pb))
     {
-        _convertedWideChars = std::make_unique<wchar_t[]>(bufferSize);
-        bufferSize = MultiByteToWideChar(_currentCodePage,
-                                         0,
-                                         reinterpret_cast<LPCCH>(pInputChars),
-                                         cb,
-                                         _convertedWideChars.get(),
-                                         bufferSize);
-        if (bufferSize == 0)
+        // Junk continuation bytes, or a byte that can't appear in UTF8 at all.
+        ++pb;
+        return true;
+    }
+
+    const unsigned int sequenceSize = _Utf8SequenceSize(*pb);
+    const size_t cbRemaining = pbEnd - pb;
+    const size_t cbLimit = std::min<size_t>(sequenceSize, cbRemaining);
+    for (size_t i = 1; i < cbLimit; ++i)
+    {
+        if (!_IsContinuationByte(pb[i]))
         {
-            LOG_LAST_ERROR();
-            _currentState = _State::Error;
+            // Not well formed. Skip the lead byte here, and the continuation
+            // bytes after it as junk.
+            ++pb;
+            return true;
         }
-        _currentState = _State::Finished;
     }
-    return bufferSize;
-}
 
-// Routine Description:
-// - Attempts to parse pInputChars in a more complex manner, taking
-// into account any previously saved partial byte sequences while
-// removing any invalid byte sequences. Will also save a partial byte
-// sequence from the end of the sequence if necessary. If the sequence
-// can be successfully parsed, _currentState will be set to
-// _State::Finished. If more bytes are necessary to form a wide char,
-// then _currentState will be set to
-// _State::AwaitingMoreBytes. Otherwise, _currentState will be set to
-// _State::Error.
-// Arguments:
-// - pInputChars - The byte sequence to convert to wide chars.
-// - cb - The amount of bytes in pInputChars.
-// Return Value:
-// - The amount of wide chars that are stored in _convertedWideChars,
-// or 0 if pInputChars cannot be successfully converted or if the
-// parser requires additional bytes before returning a valid wide
-// char.
-unsigned int Utf8ToWideCharParser::_InvolvedParse(_In_reads_(cb) const byte* const pInputChars, const unsigned int cb)
-{
-    // Do safe math to add up the count and error if it won't fit.
-    unsigned int count;
-    const HRESULT hr = UIntAdd(cb, _bytesStored, &count);
-    if (FAILED(hr))
+    if (sequenceSize > cbRemaining)
     {
-        LOG_HR(hr);
-        _currentState = _State::Error;
-        return 0;
+        // The start of a well formed sequence. Wait for the rest of it.
+        std::copy(pb, pbEnd, _utf8CodePointPieces);
+        _bytesStored = static_cast<unsigned int>(cbRemaining);
+        pb = pbEnd;
+        return true;
     }
 
-    // Allocate space and copy.
-    std::unique_ptr<byte[]> combinedInputBytes = std::make_unique<byte[]>(count);
-    std::copy(_utf8CodePointPieces, _utf8CodePointPieces + _bytesStored, combinedInputBytes.get());
-    std::copy(pInputChars, pInputChars + cb, combinedInputBytes.get() + _bytesStored);
-    _bytesStored = 0;
-    std::pair<std::unique_ptr<byte[]>, unsigned int> validSequence = _RemoveInvalidSequences(combinedInputBytes.get(), count);
-    // the input may have only been a partial sequence so we need to
-    // check that there are actually any bytes that we can convert
-    // right now
-    if (validSequence.second == 0 && _bytesStored > 0)
+    // Rule out overlong forms, surrogates and anything past U+10FFFF, all of
+    // which are given away by the lead byte and the first continuation byte.
+    const byte lead = pb[0];
+    const byte second = pb[1];
+    if (lead < 0xC2 ||
+        (lead == 0xE0 && second < 0xA0) ||
+        (lead == 0xED && second > 0x9F) ||
+        (lead == 0xF0 && second < 0x90) ||
+        (lead == 0xF4 && second > 0x8F) ||
+        lead > 0xF4)
     {
-        _currentState = _State::AwaitingMoreBytes;
-        return 0;
+        return false;
     }
-    int bufferSize = MultiByteToWideChar(_currentCodePage,
-                                         MB_ERR_INVALID_CHARS,
-                                         reinterpret_cast<LPCCH>(validSequence.first.get()),
-                                         validSequence.second,
-                                         nullptr,
-                                         0);
-    if (bufferSize == 0)
+
+    unsigned int codePoint = lead & (0x7F >> sequenceSize);
+    for (unsigned int i = 1; i < sequenceSize; ++i)
     {
-        LOG_LAST_ERROR();
-        _currentState = _State::Error;
+        codePoint = (codePoint << 6) | (pb[i] & ~ContinuationByteMask);
     }
-    else
+    pb += sequenceSize;
+
+    if (codePoint < 0x10000)
     {
-        _convertedWideChars = std::make_unique<wchar_t[]>(bufferSize);
-        bufferSize = MultiByteToWideChar(_currentCodePage,
-                                        0,
-                                        reinterpret_cast<LPCCH>(validSequence.first.get()),
-                                        validSequence.second,
-                                        _convertedWideChars.get(),
-                                        bufferSize);
-        if (bufferSize == 0)
-        {
-            LOG_LAST_ERROR();
-            _currentState = _State::Error;
-        }
-        else if (_bytesStored > 0)
-        {
-            _currentState = _State::AwaitingMoreBytes;
-        }
-        else
-        {
-            _currentState = _State::Finished;
-        }
+        *pwchOut++ = static_cast<wchar_t>(codePoint);
     }
-    return bufferSize;
-}
-
-// Routine Description:
-// - Reads pInputChars byte by byte, removing any invalid UTF8
-// multi-byte sequences.
-// Arguments:
-// - pInputChars - The byte sequence to fix.
-// - cb - The amount of bytes in pInputChars.
-// Return Value:
-// - A std::pair containing the corrected byte sequence and the number
-// of bytes in the sequence.
-std::pair<std::unique_ptr<byte[]>, unsigned int> Utf8ToWideCharParser::_RemoveInvalidSequences(_In_reads_(cb) const byte* const pInputChars, const unsigned int cb)
-{
-    std::unique_ptr<byte[]> validSequence = std::make_unique<byte[]>(cb);
-    unsigned int validSequenceLocation = 0; // index into validSequence
-    unsigned int currentByteInput = 0; // index into pInputChars
-    while (currentByteInput < cb)
+    else
     {
-        if (_IsAsciiByte(pInputChars[currentByteInput]))
-        {
-            validSequence[validSequenceLocation] = pInputChars[currentByteInput];
-            ++validSequenceLocation;
-            ++currentByteInput;
-        }
-        else if (_IsContinuationByte(pInputChars[currentByteInput]))
-        {
-            while (currentByteInput < cb && _IsContinuationByte(pInputChars[currentByteInput]))
-            {
-                ++currentByteInput;
-            }
-        }
-        else if (_IsLeadByte(pInputChars[currentByteInput]))
-        {
-            if (_IsValidMultiByteSequence(&pInputChars[currentByteInput], cb - currentByteInput))
-            {
-                const unsigned int sequenceSize = _Utf8SequenceSize(pInputChars[currentByteInput]);
-                // min is to guard against static analyis possible buffer overflow
-                const unsigned int limit = std::min(sequenceSize, cb - currentByteInput);
-                for (unsigned int i = 0; i < limit; ++i)
-                {
-                    validSequence[validSequenceLocation] = pInputChars[currentByteInput];
-                    ++validSequenceLocation;
-                    ++currentByteInput;
-                }
-            }
-            else if (_IsPartialMultiByteSequence(&pInputChars[currentByteInput], cb - currentByteInput))
-            {
-                _StorePartialSequence(&pInputChars[currentByteInput], cb - currentByteInput);
-                break;
-            }
-            else
-            {
-                ++currentByteInput;
-                while (currentByteInput < cb && _IsContinuationByte(pInputChars[currentByteInput]))
-                {
-                    ++currentByteInput;
-                }
-            }
-        }
-        else
-        {
-            // invalid byte, skip it.
-            ++currentByteInput;
-        }
+        codePoint -= 0x10000;
+        *pwchOut++ = static_cast<wchar_t>(0xD800 + (codePoint >> 10));
+        *pwchOut++ = static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF));
     }
-    return std::make_pair<std::unique_ptr<byte[]>, unsigned int>(std::move(validSequence), std::move(validSequenceLocation));
-}
-
-// Routine Description:
-// - Stores a partial byte sequence for later use. Will overwrite any
-// previously saved sequence. Will only store bytes up to the limit
-// Utf8ToWideCharParser::_UTF8_BYTE_SEQUENCE_MAX.
-// Arguments:
-// - pLeadByte - The beginning of the sequence to save.
-// - cb - The amount of bytes to save.
-// Return Value:
-// - <none>
-void Utf8ToWideCharParser::_StorePartialSequence(_In_reads_(cb) const byte* const pLeadByte, const unsigned int cb)
-{
-    const unsigned int maxLength = std::min(cb, _UTF8_BYTE_SEQUENCE_MAX);
-    std::copy(pLeadByte, pLeadByte + maxLength, _utf8CodePointPieces);
-    _bytesStored = maxLength;
+    return true;
 }
 
 // Routine Description:
@@ -505,5 +434,4 @@ void Utf8ToWideCharParser::_Reset()
 {
     _currentState = _State::Ready;
     _bytesStored = 0;
-    _convertedWideChars.release();
 }
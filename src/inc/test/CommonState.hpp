@@ -251,7 +251,7 @@ private:
         attrs[6].SetTrailing();
 
         CharRow& charRow = pRow->GetCharRow();
-        OverwriteColumns(pwszText, pwszText + length, attrs.cbegin(), charRow.begin());
+        charRow.OverwriteColumns(pwszText, pwszText + length, attrs.cbegin(), 0);
 
         // set some colors
         TextAttribute Attr = TextAttribute(0);
@@ -316,7 +316,7 @@ private:
         attrs[79].SetLeading();
 
         CharRow& charRow = pRow->GetCharRow();
-        OverwriteColumns(pwszText, pwszText + length, attrs.cbegin(), charRow.begin());
+        charRow.OverwriteColumns(pwszText, pwszText + length, attrs.cbegin(), 0);
 
         // everything gets default attributes
         pRow->GetAttrRow().Reset(gci.GetActiveOutputBuffer().GetAttributes());
@@ -0,0 +1,39 @@
+/*++
+
+Copyright (c) Microsoft Corporation
+Licensed under the MIT license.
+
+Module Name:
+- PerfTestHelper.hpp
+
+Abstract:
+- helper functions for the unit tests that time things and log the results.
+  Header only, so any of the unit test projects can include it.
+
+--*/
+
+
+#pragma once
+
+#include <chrono>
+
+
+class PerfTestHelper final
+{
+public:
+
+    // Gets the time between two std::chrono time points, in whole microseconds, for logging.
+    template<typename TimePoint>
+    static long long Microseconds(const TimePoint from, const TimePoint to)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(to - from).count();
+    }
+
+    // Gets the time between two std::chrono time points, in whole nanoseconds, for logging
+    // the cost of a single operation out of many.
+    template<typename TimePoint>
+    static long long Nanoseconds(const TimePoint from, const TimePoint to)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+    }
+};
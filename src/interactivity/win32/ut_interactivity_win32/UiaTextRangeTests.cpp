@@ -87,9 +87,9 @@ class UiaTextRangeTests
         {
             ROW& row = _pTextBuffer->GetRowByOffset(i);
             auto& charRow = row.GetCharRow();
-            for (auto& cell : charRow)
+            for (size_t column = 0; column < charRow.size(); ++column)
             {
-                cell.Char() = L'a';
+                charRow.GlyphAt(column) = L"a";
             }
         }
 
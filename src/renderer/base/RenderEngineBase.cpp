@@ -37,3 +37,16 @@ HRESULT RenderEngineBase::UpdateTitle(const std::wstring& newTitle) noexcept
     }
     return hr;
 }
+
+// Method Description:
+// - Gets the dirty portion of the frame as a list of rectangles, so an engine
+//      can leave the cells between separate changes alone. Engines that only
+//      track a single dirty rectangle don't need to override this.
+// Arguments:
+// - <none>
+// Return Value:
+// - The one dirty rectangle from GetDirtyRectInChars. This is an Inclusive rect.
+std::vector<SMALL_RECT> RenderEngineBase::GetDirtyArea()
+{
+    return { GetDirtyRectInChars() };
+}
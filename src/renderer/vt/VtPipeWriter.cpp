@@ -0,0 +1,235 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#include "precomp.h"
+#include "VtPipeWriter.hpp"
+
+#pragma hdrstop
+
+using namespace Microsoft::Console::Render;
+
+// Routine Description:
+// - Creates a new writer for the given pipe. Nothing is written until Start.
+// Arguments:
+// - hPipe: The pipe to write to. The caller keeps ownership, and must keep it
+//      open until the writer is destroyed.
+// - pfnPipeBroken: Called on the writer thread with the error when a write
+//      fails. Not called while the writer is being destroyed. It mustn't wait
+//      on anything the thread destroying the writer may hold, like the console
+//      lock, or the destructor would never see the writer exit.
+// Return Value:
+// - An instance of a VtPipeWriter.
+VtPipeWriter::VtPipeWriter(const HANDLE hPipe,
+                           std::function<void(const HRESULT)> pfnPipeBroken) noexcept :
+    _hPipe(hPipe),
+    _pfnPipeBroken(std::move(pfnPipeBroken)),
+    _thread{},
+    _pending{},
+    _writing{},
+    _fKeepRunning(true),
+    _fAbandoned(false),
+    _fExited(false),
+    _result(S_OK),
+    _metrics{}
+{
+}
+
+// Method Description:
+// - Stops the writer thread. Anything still waiting is written first, the
+//      same as if the engine had written it to the pipe itself. A terminal
+//      that has stopped reading mustn't hold up teardown though, so if that
+//      takes too long, whatever's left is thrown away and the blocked write is
+//      cancelled.
+VtPipeWriter::~VtPipeWriter()
+{
+    if (_thread.joinable())
+    {
+        std::unique_lock<std::mutex> guard(_lock);
+        _fKeepRunning = false;
+        _stateChanged.notify_all();
+
+        if (!_stateChanged.wait_for(guard, std::chrono::milliseconds(s_msTeardownTimeout), [this]() { return _fExited; }))
+        {
+            _fAbandoned = true;
+            while (!_fExited)
+            {
+                // The only thing the writer can be blocked in is the write, which
+                //      the cancel ends. It may not have started the write yet when
+                //      we cancel though, so keep trying until it notices.
+                guard.unlock();
+                CancelSynchronousIo(_thread.native_handle());
+                guard.lock();
+                _stateChanged.wait_for(guard, std::chrono::milliseconds(10), [this]() { return _fExited; });
+            }
+        }
+
+        guard.unlock();
+        _thread.join();
+    }
+}
+
+// Method Description:
+// - Starts the writer thread.
+// Arguments:
+// - <none>
+// Return Value:
+// - S_OK if we succeeded, else an appropriate HRESULT for failing to create the thread.
+[[nodiscard]]
+HRESULT VtPipeWriter::Start() noexcept
+{
+    try
+    {
+        _thread = std::thread(&VtPipeWriter::_ThreadProc, this);
+    }
+    CATCH_RETURN();
+
+    return S_OK;
+}
+
+// Method Description:
+// - Hands a completed frame to the writer thread. If the writer is idle, the
+//      frame is swapped in whole. If it's still writing, the frame is merged
+//      onto the end of whatever is already waiting.
+// Arguments:
+// - frame: The frame to write. On return it's empty, but may hold the storage
+//      of a previous frame, to be reused for the next one.
+// Return Value:
+// - S_OK, or the error from the write that broke the pipe. Once the pipe is
+//      broken, frames are thrown away.
+[[nodiscard]]
+HRESULT VtPipeWriter::Submit(std::string& frame) noexcept
+{
+    if (frame.empty())
+    {
+        return S_OK;
+    }
+
+    std::unique_lock<std::mutex> guard(_lock);
+
+    // Don't let a terminal that's stopped reading make us buffer forever.
+    _stateChanged.wait(guard, [this]() { return _pending.size() < s_cbMaxPending || FAILED(_result); });
+
+    bool merged = false;
+    if (!_pending.empty() && SUCCEEDED(_result))
+    {
+        try
+        {
+            _pending.append(frame);
+            merged = true;
+        }
+        catch (...)
+        {
+            // We couldn't grow the waiting frame. Wait for the writer to take
+            //      it, then hand this one over whole instead.
+            LOG_CAUGHT_EXCEPTION();
+            _stateChanged.wait(guard, [this]() { return _pending.empty() || FAILED(_result); });
+        }
+    }
+
+    _metrics.framesSubmitted++;
+    if (FAILED(_result))
+    {
+        _metrics.framesDropped++;
+        frame.clear();
+        return _result;
+    }
+
+    if (merged)
+    {
+        _metrics.framesMerged++;
+    }
+    else
+    {
+        _pending.swap(frame);
+    }
+    frame.clear();
+
+    guard.unlock();
+    _stateChanged.notify_all();
+    return S_OK;
+}
+
+// Method Description:
+// - Waits until everything submitted so far has been written, or the pipe has
+//      broken.
+// Arguments:
+// - dwTimeoutMs: How long to wait, in milliseconds.
+// Return Value:
+// - true if there's nothing left to write, false if we timed out.
+bool VtPipeWriter::WaitForWrites(const DWORD dwTimeoutMs) noexcept
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    return _stateChanged.wait_for(guard, std::chrono::milliseconds(dwTimeoutMs), [this]() {
+        return (_pending.empty() && _writing.empty()) || FAILED(_result);
+    });
+}
+
+// Method Description:
+// - Gets the counts of frames and bytes that went through the writer.
+// Arguments:
+// - <none>
+// Return Value:
+// - The metrics.
+VtPipeWriter::Metrics VtPipeWriter::GetMetrics() const
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    return _metrics;
+}
+
+// Method Description:
+// - The writer thread. Waits for a frame, takes it by swapping it with the
+//      buffer it last wrote (which is now empty), and writes it outside the
+//      lock, so the engine can hand over the next frame in the meantime.
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+void VtPipeWriter::_ThreadProc()
+{
+    std::unique_lock<std::mutex> guard(_lock);
+    while (true)
+    {
+        _stateChanged.wait(guard, [this]() { return !_pending.empty() || !_fKeepRunning; });
+        if (_pending.empty() || _fAbandoned)
+        {
+            // We were told to stop, and everything's been written (or we were
+            //      told not to bother).
+            break;
+        }
+
+        _writing.swap(_pending);
+        guard.unlock();
+        // Submit may be waiting for _pending to shrink.
+        _stateChanged.notify_all();
+
+        const bool fSuccess = !!WriteFile(_hPipe, _writing.data(), static_cast<DWORD>(_writing.size()), nullptr, nullptr);
+        const HRESULT hr = fSuccess ? S_OK : HRESULT_FROM_WIN32(GetLastError());
+
+        guard.lock();
+        _metrics.writes++;
+        if (FAILED(hr))
+        {
+            _result = hr;
+            _pending.clear();
+            _writing.clear();
+            _stateChanged.notify_all();
+
+            // Let the owner know now. If the console has gone idle, there may
+            //      not be another frame to report it with.
+            if (_fKeepRunning && _pfnPipeBroken)
+            {
+                guard.unlock();
+                _pfnPipeBroken(hr);
+                guard.lock();
+            }
+            break;
+        }
+        _metrics.bytesWritten += _writing.size();
+        _writing.clear();
+        // WaitForWrites may be waiting for this write to finish.
+        _stateChanged.notify_all();
+    }
+
+    _fExited = true;
+    _stateChanged.notify_all();
+}
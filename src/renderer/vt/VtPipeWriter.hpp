@@ -0,0 +1,89 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+/*
+Module Name:
+- VtPipeWriter.hpp
+
+Abstract:
+- This is the writer thread that takes completed frames of VT output from the
+    VtEngine and writes them to the pipe, so a slow terminal on the other end
+    doesn't stall painting (and the console lock held during it).
+- Frames are handed over by swapping buffers, not copying them. There are
+    three: the one the engine is filling, the one waiting to be written, and
+    the one being written. They keep their capacity, so once they've grown to
+    fit a typical frame, handing one over doesn't allocate.
+- If the writer is still busy when the next frame comes in, that frame is
+    merged onto the end of the one that's waiting, and they go out in a single
+    write. VT output only describes what changed since the previous frame, so
+    frames are never skipped - the terminal needs every one of them.
+- A failed write is reported to the owner straight from the writer thread, so
+    a terminal that disconnects is noticed even if nothing else is painted.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Microsoft::Console::Render
+{
+    class VtPipeWriter final
+    {
+    public:
+        struct Metrics
+        {
+            size_t framesSubmitted;
+            size_t framesMerged; // Frames that went out in the same write as the one before them.
+            size_t framesDropped; // Frames thrown away because the pipe was already broken.
+            size_t writes;
+            size_t bytesWritten;
+        };
+
+        VtPipeWriter(const HANDLE hPipe,
+                     std::function<void(const HRESULT)> pfnPipeBroken) noexcept;
+        ~VtPipeWriter();
+
+        VtPipeWriter(const VtPipeWriter&) = delete;
+        VtPipeWriter& operator=(const VtPipeWriter&) = delete;
+
+        // How long teardown waits for the output that's still queued to reach
+        //      the terminal, both here and in the engine's final frame.
+        static constexpr DWORD s_msTeardownTimeout = 1000;
+
+        [[nodiscard]]
+        HRESULT Start() noexcept;
+
+        [[nodiscard]]
+        HRESULT Submit(std::string& frame) noexcept;
+
+        bool WaitForWrites(const DWORD dwTimeoutMs) noexcept;
+
+        Metrics GetMetrics() const;
+
+    private:
+        void _ThreadProc();
+
+        // If this much is already waiting to be written, Submit waits for the
+        //      writer instead of merging even more onto it.
+        static const size_t s_cbMaxPending = 1024 * 1024;
+
+        const HANDLE _hPipe; // Non-ownership handle, the VtEngine owns the pipe.
+        const std::function<void(const HRESULT)> _pfnPipeBroken;
+        std::thread _thread;
+
+        mutable std::mutex _lock;
+        std::condition_variable _stateChanged;
+        std::string _pending;
+        std::string _writing;
+        bool _fKeepRunning;
+        bool _fAbandoned; // Set once the destructor gives up on draining.
+        bool _fExited;
+        HRESULT _result;
+        Metrics _metrics;
+    };
+}
@@ -87,9 +87,7 @@ HRESULT VtEngine::_EraseLine() noexcept
 [[nodiscard]]
 HRESULT VtEngine::_EraseCharacter(const short chars) noexcept
 {
-    static const std::string format = "\x1b[%dX";
-
-    return _WriteFormattedString(&format, chars);
+    return _WriteCsi('X', chars);
 }
 
 // Method Description:
@@ -101,10 +99,7 @@ HRESULT VtEngine::_EraseCharacter(const short chars) noexcept
 [[nodiscard]]
 HRESULT VtEngine::_CursorForward(const short chars) noexcept
 {
-
-    static const std::string format = "\x1b[%dC";
-
-    return _WriteFormattedString(&format, chars);
+    return _WriteCsi('C', chars);
 }
 
 // Method Description:
@@ -139,9 +134,7 @@ HRESULT VtEngine::_InsertDeleteLine(const short sLines, const bool fInsertLine)
     {
         return _Write(fInsertLine ? "\x1b[L" : "\x1b[M");
     }
-    const std::string format = fInsertLine ? "\x1b[%dL" : "\x1b[%dM";
-
-    return _WriteFormattedString(&format, sLines);
+    return _WriteCsi(fInsertLine ? 'L' : 'M', sLines);
 }
 
 // Method Description:
@@ -181,14 +174,12 @@ HRESULT VtEngine::_InsertLine(const short sLines) noexcept
 [[nodiscard]]
 HRESULT VtEngine::_CursorPosition(const COORD coord) noexcept
 {
-    static const std::string cursorFormat = "\x1b[%d;%dH";
-
     // VT coords start at 1,1
     COORD coordVt = coord;
     coordVt.X++;
     coordVt.Y++;
 
-    return _WriteFormattedString(&cursorFormat, coordVt.Y, coordVt.X);
+    return _WriteCsi('H', coordVt.Y, coordVt.X);
 }
 
 // Method Description:
@@ -204,101 +195,99 @@ HRESULT VtEngine::_CursorHome() noexcept
 }
 
 // Method Description:
-// - Formats and writes a sequence change the boldness of the following text.
+// - Formats and writes a sequence to change the current text attributes to the default.
 // Arguments:
-// - isBold: If true, we'll embolden the text. Otherwise we'll debolden the text.
+// <none>
 // Return Value:
 // - S_OK if we succeeded, else an appropriate HRESULT for failing to allocate or write.
 [[nodiscard]]
-HRESULT VtEngine::_SetGraphicsBoldness(const bool isBold) noexcept
+HRESULT VtEngine::_SetGraphicsDefault() noexcept
 {
-    const std::string fmt = isBold ? "\x1b[1m" : "\x1b[22m";
-    return _Write(fmt);
+    return _Write("\x1b[m");
 }
 
 // Method Description:
-// - Formats and writes a sequence to change the current text attributes to the default.
+// - Formats and writes a single SGR sequence with all of the given parameters,
+//      so changing the boldness and both colors at once is one sequence
+//      instead of three.
 // Arguments:
-// <none>
+// - rgParams: the SGR parameters, in order.
+// - cParams: the number of parameters. At most MAX_SGR_PARAMETERS.
 // Return Value:
 // - S_OK if we succeeded, else an appropriate HRESULT for failing to allocate or write.
 [[nodiscard]]
-HRESULT VtEngine::_SetGraphicsDefault() noexcept
+HRESULT VtEngine::_SetGraphicsRendition(_In_reads_(cParams) const int* const rgParams,
+                                        const size_t cParams) noexcept
 {
-    return _Write("\x1b[m");
+    if (cParams == 0)
+    {
+        return S_OK;
+    }
+    if (cParams == 1 && rgParams[0] == 0)
+    {
+        // Use the short form of a plain reset.
+        return _SetGraphicsDefault();
+    }
+    RETURN_HR_IF(E_INVALIDARG, cParams > MAX_SGR_PARAMETERS);
+
+    char sequence[2 + (MAX_SGR_PARAMETERS * CSI_PARAMETER_LENGTH) + 1];
+    char* it = sequence;
+    *it++ = '\x1b';
+    *it++ = '[';
+    for (size_t i = 0; i < cParams; i++)
+    {
+        if (i > 0)
+        {
+            *it++ = ';';
+        }
+        it = s_AppendInteger(it, rgParams[i]);
+    }
+    *it++ = 'm';
+
+    return _Write({ sequence, static_cast<size_t>(it - sequence) });
 }
 
 // Method Description:
-// - Formats and writes a sequence to change the current text attributes.
+// - Gets the SGR parameter for one of the 16 colors of the Windows color table.
 // Arguments:
-// - wAttr: Windows color table index to emit as a VT sequence
-// - fIsForeground: true if we should emit the foreground sequence, false for background
+// - wAttr: Windows color table index to get the VT parameter for
+// - fIsForeground: true if we should get the foreground parameter, false for background
 // Return Value:
-// - S_OK if we succeeded, else an appropriate HRESULT for failing to allocate or write.
-[[nodiscard]]
-HRESULT VtEngine::_SetGraphicsRendition16Color(const WORD wAttr,
-                                               const bool fIsForeground) noexcept
+// - The SGR parameter.
+int VtEngine::s_16ColorSgrParameter(const WORD wAttr, const bool fIsForeground) noexcept
 {
-    static const std::string fmt = "\x1b[%dm";
-
     // Always check using the foreground flags, because the bg flags constants
     //  are a higher byte
     // Foreground sequences are in [30,37] U [90,97]
     // Background sequences are in [40,47] U [100,107]
     // The "dark" sequences are in the first 7 values, the bright sequences in the second set.
     // Note that text brightness and boldness are different in VT. Boldness is
-    //      handled by _SetGraphicsBoldness. Here, we can emit either bright or
+    //      handled by its own SGR parameters. Here, we can emit either bright or
     //      dark colors. For conhost as a terminal, it can't draw bold
     //      characters, so it displays "bold" as bright, and in fact most
     //      terminals display the bright color when displaying bolded text.
     // By specifying the boldness and brightness seperately, we'll make sure the
     //      terminal has an accurate representation of our buffer.
-    const int vtIndex = 30
-                        + (fIsForeground? 0 : 10)
-                        + ((WI_IsFlagSet(wAttr, FOREGROUND_INTENSITY)) ? 60 : 0)
-                        + (WI_IsFlagSet(wAttr, FOREGROUND_RED) ? 1 : 0)
-                        + (WI_IsFlagSet(wAttr, FOREGROUND_GREEN) ? 2 : 0)
-                        + (WI_IsFlagSet(wAttr, FOREGROUND_BLUE) ? 4 : 0);
-
-    return _WriteFormattedString(&fmt, vtIndex);
+    return 30
+           + (fIsForeground? 0 : 10)
+           + ((WI_IsFlagSet(wAttr, FOREGROUND_INTENSITY)) ? 60 : 0)
+           + (WI_IsFlagSet(wAttr, FOREGROUND_RED) ? 1 : 0)
+           + (WI_IsFlagSet(wAttr, FOREGROUND_GREEN) ? 2 : 0)
+           + (WI_IsFlagSet(wAttr, FOREGROUND_BLUE) ? 4 : 0);
 }
 
 // Method Description:
-// - Formats and writes a sequence to change the current text attributes to an
-//      RGB color.
-// Arguments:
-// - color: The color to emit a VT sequence for
-// - fIsForeground: true if we should emit the foreground sequence, false for background
-// Return Value:
-// - S_OK if we succeeded, else an appropriate HRESULT for failing to allocate or write.
-[[nodiscard]]
-HRESULT VtEngine::_SetGraphicsRenditionRGBColor(const COLORREF color,
-                                                const bool fIsForeground) noexcept
-{
-    const std::string fmt = fIsForeground ?
-        "\x1b[38;2;%d;%d;%dm" :
-        "\x1b[48;2;%d;%d;%dm";
-
-    DWORD const r = GetRValue(color);
-    DWORD const g = GetGValue(color);
-    DWORD const b = GetBValue(color);
-
-    return _WriteFormattedString(&fmt, r, g, b);
-}
-
-// Method Description:
-// - Formats and writes a sequence to change the current text attributes to the
-//      default foreground or background. Does not affect the boldness of text.
+// - Formats and writes a sequence to change the current text attributes.
 // Arguments:
+// - wAttr: Windows color table index to emit as a VT sequence
 // - fIsForeground: true if we should emit the foreground sequence, false for background
 // Return Value:
 // - S_OK if we succeeded, else an appropriate HRESULT for failing to allocate or write.
 [[nodiscard]]
-HRESULT VtEngine::_SetGraphicsRenditionDefaultColor(const bool fIsForeground) noexcept
+HRESULT VtEngine::_SetGraphicsRendition16Color(const WORD wAttr,
+                                               const bool fIsForeground) noexcept
 {
-    const std::string fmt = fIsForeground ? ("\x1b[39m") : ("\x1b[49m");
-
-    return _Write(fmt);
+    return _WriteCsi('m', s_16ColorSgrParameter(wAttr, fIsForeground));
 }
 
 // Method Description:
@@ -311,13 +300,12 @@ HRESULT VtEngine::_SetGraphicsRenditionDefaultColor(const bool fIsForeground) no
 [[nodiscard]]
 HRESULT VtEngine::_ResizeWindow(const short sWidth, const short sHeight) noexcept
 {
-    static const std::string resizeFormat = "\x1b[8;%d;%dt";
     if (sWidth < 0 || sHeight < 0)
     {
         return E_INVALIDARG;
     }
 
-    return _WriteFormattedString(&resizeFormat, sHeight, sWidth);
+    return _WriteCsi('t', 8, sHeight, sWidth);
 }
 
 // Method Description:
@@ -21,7 +21,9 @@ XtermEngine::XtermEngine(_In_ wil::unique_hfile hPipe,
     _fUseAsciiOnly(fUseAsciiOnly),
     _previousLineWrapped(false),
     _usingUnderLine(false),
-    _needToDisableCursor(false)
+    _needToDisableCursor(false),
+    _shadow{},
+    _shadowSize{ 0, 0 }
 {
     // Set out initial cursor position to -1, -1. This will force our initial
     //      paint to manually move the cursor to 0, 0, not just ignore it.
@@ -53,6 +55,7 @@ HRESULT XtermEngine::StartPaint() noexcept
         //      the screen on the first paint, just to make sure that the
         //      terminal's state is consistent with what we'll be rendering.
         RETURN_IF_FAILED(_ClearScreen());
+        _ShadowForget();
         _clearedAllThisFrame = true;
         _firstPaint = false;
     }
@@ -67,6 +70,7 @@ HRESULT XtermEngine::StartPaint() noexcept
             // Unfortunately, not always setting _resized is not a good enough
             // solution, see that work item for a description why.
             RETURN_IF_FAILED(_ClearScreen());
+            _ShadowForget();
             _clearedAllThisFrame = true;
         }
     }
@@ -325,6 +329,16 @@ HRESULT XtermEngine::ScrollFrame() noexcept
         }
     }
 
+    if (SUCCEEDED(hr))
+    {
+        // Keep our shadow of the terminal's screen lined up with it.
+        _ShadowScroll(dy);
+    }
+    else
+    {
+        _ShadowForget();
+    }
+
     return hr;
 }
 
@@ -377,6 +391,10 @@ HRESULT XtermEngine::InvalidateScroll(const COORD* const pcoordDelta) noexcept
 // - Draws one line of the buffer to the screen. Writes the characters to the
 //      pipe, encoded in UTF-8 or ASCII only, depending on the VtIoMode.
 //      (See descriptions of both implementations for details.)
+// - Cells that already hold the same glyph, in the same colors, on the
+//      terminal (according to our shadow of its screen) aren't written again.
+//      Only the runs of cells that changed are painted, each after a cursor
+//      move to the start of the run.
 // Arguments:
 // - clusters - text and column counts for each piece of text.
 // - coord - character coordinate target to render within viewport
@@ -390,9 +408,219 @@ HRESULT XtermEngine::PaintBufferLine(std::basic_string_view<Cluster> const clust
                                      const COORD coord,
                                      const bool /*trimLeft*/) noexcept
 {
-    return _fUseAsciiOnly ?
+    try
+    {
+        _ShadowResize();
+    }
+    CATCH_RETURN();
+
+    if (coord.Y < _virtualTop || coord.Y >= _shadowSize.Y || coord.X < 0)
+    {
+        return _PaintClusters(clusters, coord);
+    }
+
+    const ShadowCell* const row = _shadow.data() + (coord.Y * _shadowSize.X);
+
+    // Find the runs of clusters that changed. Unchanged gaps up to
+    //      SHADOW_GAP_LENGTH wide are painted along with the run around them,
+    //      because a cursor move over them would cost about as much.
+    size_t runBegin = 0;
+    size_t runEnd = 0;
+    short runColumn = 0;
+    short runEndColumn = 0;
+    bool inRun = false;
+
+    short column = coord.X;
+    for (size_t i = 0; i < clusters.size(); i++)
+    {
+        const auto& cluster = clusters.at(i);
+        const short columns = static_cast<short>(cluster.GetColumns());
+
+        bool changed = (column + columns > _shadowSize.X);
+        if (!changed)
+        {
+            auto expected = _MakeShadowCell(cluster, static_cast<BYTE>(columns));
+            changed = !s_ShadowCellsMatch(row[column], expected);
+            expected.columns = 0;
+            for (short trail = 1; trail < columns && !changed; trail++)
+            {
+                changed = !s_ShadowCellsMatch(row[column + trail], expected);
+            }
+        }
+
+        if (changed)
+        {
+            if (inRun && (column - runEndColumn) > SHADOW_GAP_LENGTH)
+            {
+                RETURN_IF_FAILED(_PaintClusters(clusters.substr(runBegin, runEnd - runBegin), { runColumn, coord.Y }));
+                inRun = false;
+            }
+
+            if (!inRun)
+            {
+                runBegin = i;
+                runColumn = column;
+                inRun = true;
+            }
+            runEnd = i + 1;
+            runEndColumn = static_cast<short>(column + columns);
+        }
+
+        column += columns;
+    }
+
+    if (inRun)
+    {
+        RETURN_IF_FAILED(_PaintClusters(clusters.substr(runBegin, runEnd - runBegin), { runColumn, coord.Y }));
+    }
+
+    return S_OK;
+}
+
+// Routine Description:
+// - Writes some clusters to the pipe at the given position, and records them
+//      in the shadow of the terminal's screen.
+// Arguments:
+// - clusters - text and column counts for each piece of text.
+// - coord - character coordinate target to render within viewport
+// Return Value:
+// - S_OK or suitable HRESULT error from writing pipe.
+[[nodiscard]]
+HRESULT XtermEngine::_PaintClusters(std::basic_string_view<Cluster> const clusters,
+                                    const COORD coord) noexcept
+{
+    const HRESULT hr = _fUseAsciiOnly ?
         VtEngine::_PaintAsciiBufferLine(clusters, coord) :
         VtEngine::_PaintUtf8BufferLine(clusters, coord);
+
+    if (FAILED(hr))
+    {
+        // We don't know how much of the line made it to the terminal.
+        _ShadowForget();
+        return hr;
+    }
+
+    if (coord.Y < _virtualTop || coord.Y >= _shadowSize.Y || coord.X < 0)
+    {
+        return hr;
+    }
+
+    ShadowCell* const row = _shadow.data() + (coord.Y * _shadowSize.X);
+    short column = coord.X;
+    for (const auto& cluster : clusters)
+    {
+        const short columns = static_cast<short>(cluster.GetColumns());
+        auto cell = _MakeShadowCell(cluster, static_cast<BYTE>(columns));
+        for (short i = 0; i < columns && column + i < _shadowSize.X; i++)
+        {
+            row[column + i] = cell;
+            cell.columns = 0;
+        }
+        column += columns;
+    }
+
+    return hr;
+}
+
+// Routine Description:
+// - Builds the shadow cell for a cluster painted with the current brushes.
+// Arguments:
+// - cluster - the text to be painted.
+// - columns - the number of columns it takes up.
+// Return Value:
+// - The cell. If the glyph is too long to remember, the cell is unknown, so it
+//      never matches and is always repainted.
+XtermEngine::ShadowCell XtermEngine::_MakeShadowCell(const Cluster& cluster, const BYTE columns) const noexcept
+{
+    ShadowCell cell{};
+    const auto text = cluster.GetText();
+    if (text.size() <= ARRAYSIZE(cell.chars))
+    {
+        std::copy(text.cbegin(), text.cend(), cell.chars);
+        cell.cch = static_cast<BYTE>(text.size());
+    }
+    cell.columns = columns;
+    cell.colorForeground = _LastFG;
+    cell.colorBackground = _LastBG;
+    cell.isBold = _lastWasBold;
+    cell.isUnderlined = _usingUnderLine;
+    return cell;
+}
+
+// Routine Description:
+// - Determines if the terminal already shows the expected cell.
+// Arguments:
+// - actual - the shadow of what the terminal shows.
+// - expected - the cell we're about to paint.
+// Return Value:
+// - true if the cells match, and actual isn't unknown.
+bool XtermEngine::s_ShadowCellsMatch(const ShadowCell& actual, const ShadowCell& expected) noexcept
+{
+    return actual.cch != 0 &&
+           actual.cch == expected.cch &&
+           std::equal(actual.chars, actual.chars + actual.cch, expected.chars) &&
+           actual.columns == expected.columns &&
+           actual.colorForeground == expected.colorForeground &&
+           actual.colorBackground == expected.colorBackground &&
+           actual.isBold == expected.isBold &&
+           actual.isUnderlined == expected.isUnderlined;
+}
+
+// Routine Description:
+// - Makes sure the shadow is the size of the viewport. If the viewport changed
+//      size, the terminal has reflowed its contents, so the whole shadow is
+//      reset to unknown.
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+void XtermEngine::_ShadowResize()
+{
+    const COORD size = _lastViewport.Dimensions();
+    if (size.X != _shadowSize.X || size.Y != _shadowSize.Y)
+    {
+        _shadow.assign(static_cast<size_t>(size.X) * size.Y, ShadowCell{});
+        _shadowSize = size;
+    }
+}
+
+// Routine Description:
+// - Marks every cell of the shadow unknown, so it's all painted again. Used
+//      whenever the terminal's screen was changed by something other than
+//      PaintBufferLine.
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+void XtermEngine::_ShadowForget() noexcept
+{
+    std::fill(_shadow.begin(), _shadow.end(), ShadowCell{});
+}
+
+// Routine Description:
+// - Moves the rows of the shadow along with the terminal's screen after we
+//      scrolled it. The rows scrolled in are unknown.
+// Arguments:
+// - dy - the number of rows the contents moved. Negative is up.
+// Return Value:
+// - <none>
+void XtermEngine::_ShadowScroll(const short dy) noexcept
+{
+    const size_t distance = static_cast<size_t>(abs(dy)) * _shadowSize.X;
+    if (distance >= _shadow.size())
+    {
+        _ShadowForget();
+    }
+    else if (dy < 0)
+    {
+        std::move(_shadow.begin() + distance, _shadow.end(), _shadow.begin());
+        std::fill(_shadow.end() - distance, _shadow.end(), ShadowCell{});
+    }
+    else if (dy > 0)
+    {
+        std::move_backward(_shadow.begin(), _shadow.end() - distance, _shadow.end());
+        std::fill(_shadow.begin(), _shadow.begin() + distance, ShadowCell{});
+    }
 }
 
 // Method Description:
@@ -405,6 +633,10 @@ HRESULT XtermEngine::PaintBufferLine(std::basic_string_view<Cluster> const clust
 [[nodiscard]]
 HRESULT XtermEngine::WriteTerminalW(const std::wstring& wstr) noexcept
 {
+    // This text goes straight to the terminal, so our shadow of its screen
+    //      can't be trusted anymore.
+    _ShadowForget();
+
     return _fUseAsciiOnly ?
         VtEngine::_WriteTerminalAscii(wstr) :
         VtEngine::_WriteTerminalUtf8(wstr);
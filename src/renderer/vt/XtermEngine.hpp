@@ -61,6 +61,18 @@ namespace Microsoft::Console::Render
         HRESULT WriteTerminalW(_In_ const std::wstring& str) noexcept override;
 
     protected:
+        // What we last sent the terminal for one cell of the viewport.
+        struct ShadowCell
+        {
+            wchar_t chars[2]; // The glyph, if it fits.
+            BYTE cch; // 0 if we don't know what the terminal has in this cell.
+            BYTE columns; // 0 for the right half of a wide glyph.
+            COLORREF colorForeground;
+            COLORREF colorBackground;
+            bool isBold;
+            bool isUnderlined;
+        };
+
         const COLORREF* const _ColorTable;
         const WORD _cColorTable;
         const bool _fUseAsciiOnly;
@@ -68,9 +80,27 @@ namespace Microsoft::Console::Render
         bool _usingUnderLine;
         bool _needToDisableCursor;
 
+        // A cursor forward is at least this long, so it's no cheaper than
+        //      repainting a gap of unchanged cells this wide.
+        static const short SHADOW_GAP_LENGTH = 4;
+
+        // A copy of the terminal's screen, one ShadowCell per cell of _lastViewport, row by row.
+        std::vector<ShadowCell> _shadow;
+        COORD _shadowSize;
+
         [[nodiscard]]
         HRESULT _MoveCursor(const COORD coord) noexcept override;
 
+        [[nodiscard]]
+        HRESULT _PaintClusters(std::basic_string_view<Cluster> const clusters,
+                               const COORD coord) noexcept;
+
+        ShadowCell _MakeShadowCell(const Cluster& cluster, const BYTE columns) const noexcept;
+        static bool s_ShadowCellsMatch(const ShadowCell& actual, const ShadowCell& expected) noexcept;
+        void _ShadowResize();
+        void _ShadowForget() noexcept;
+        void _ShadowScroll(const short dy) noexcept;
+
         [[nodiscard]]
         HRESULT _UpdateUnderline(const WORD wLegacyAttrs) noexcept;
 
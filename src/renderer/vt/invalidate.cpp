@@ -121,6 +121,8 @@ HRESULT VtEngine::InvalidateCircling(_Out_ bool* const pForcePaint) noexcept
 // - Notifies us that we're about to be torn down. This gives us a last chance
 //      to force a repaint before the buffer contents are lost. The VT renderer
 //      needs to be able to render all text before it's lost, so we return true.
+// - Frames are written on the pipe writer thread, so we also wait for the ones
+//      already handed to it, and ask _Flush to wait for the final one.
 // Arguments:
 // - Recieves a bool indicating if we should force the repaint.
 // Return Value:
@@ -129,6 +131,12 @@ HRESULT VtEngine::InvalidateCircling(_Out_ bool* const pForcePaint) noexcept
 HRESULT VtEngine::PrepareForTeardown(_Out_ bool* const pForcePaint) noexcept
 {
     *pForcePaint = true;
+
+    _tearingDown = true;
+    if (_writer && !_pipeBroken)
+    {
+        LOG_HR_IF(HRESULT_FROM_WIN32(ERROR_TIMEOUT), !_writer->WaitForWrites(VtPipeWriter::s_msTeardownTimeout));
+    }
     return S_OK;
 }
 
@@ -157,9 +165,41 @@ HRESULT VtEngine::_InvalidCombine(const Viewport invalid) noexcept
     // Ensure invalid areas remain within bounds of window.
     RETURN_IF_FAILED(_InvalidRestrict());
 
+    try
+    {
+        _InvalidRowsCombine(invalid);
+    }
+    CATCH_RETURN();
+
     return S_OK;
 }
 
+// Routine Description:
+// - Helper to add the given rectangle to the dirty span of each row it covers.
+//      Rows between separate changes stay clean, so they aren't sent again.
+// Expects EXCLUSIVE rectangles.
+// Arguments:
+// - invalid - A viewport containing the character region that should be
+//      repainted on the next frame
+// Return Value:
+// - <none>
+void VtEngine::_InvalidRowsCombine(const Viewport invalid)
+{
+    const auto view = _lastViewport.ToOrigin();
+    _invalidRows.resize(view.Height(), Viewport::Empty());
+
+    SMALL_RECT trimmed = invalid.ToExclusive();
+    if (view.TrimToViewport(&trimmed))
+    {
+        const auto width = gsl::narrow_cast<SHORT>(trimmed.Right - trimmed.Left);
+        for (auto row = trimmed.Top; row < trimmed.Bottom; row++)
+        {
+            const auto span = Viewport::FromDimensions({ trimmed.Left, row }, { width, 1 });
+            _invalidRows.at(row) = Viewport::Union(_invalidRows.at(row), span);
+        }
+    }
+}
+
 // Routine Description:
 // - Helper to adjust the invalid region by the given offset such as when a
 //      scroll operation occurs.
@@ -182,6 +222,21 @@ HRESULT VtEngine::_InvalidOffset(const COORD* const pCoord) noexcept
 
             // Ensure invalid areas remain within bounds of window.
             RETURN_IF_FAILED(_InvalidRestrict());
+
+            // Do the same for each row. Walk against the direction of the scroll,
+            // so every row is moved before the row it moves onto is updated.
+            const auto rows = _invalidRows.size();
+            const auto dy = pCoord->Y;
+            for (size_t i = 0; i < rows; i++)
+            {
+                const auto row = dy > 0 ? rows - 1 - i : i;
+                const auto from = static_cast<ptrdiff_t>(row) - dy;
+                if (from >= 0 && from < static_cast<ptrdiff_t>(rows))
+                {
+                    const auto moved = Viewport::Offset(_invalidRows.at(static_cast<size_t>(from)), *pCoord);
+                    _invalidRows.at(row) = Viewport::Union(_invalidRows.at(row), moved);
+                }
+            }
         }
         CATCH_RETURN();
     }
@@ -27,6 +27,45 @@ SMALL_RECT VtEngine::GetDirtyRectInChars()
     return dirty;
 }
 
+// Routine Description:
+// - Gets the dirty portion of the frame as one rectangle per run of rows whose
+//      dirty spans match. A change at the top of the screen and another at the
+//      bottom don't drag all the rows between them into the frame.
+// Arguments:
+// - <none>
+// Return Value:
+// - The character areas of the current dirty portions of the frame, top to
+//      bottom. These are Inclusive rects.
+std::vector<SMALL_RECT> VtEngine::GetDirtyArea()
+{
+    std::vector<SMALL_RECT> area;
+    const auto view = _lastViewport.ToOrigin();
+    const auto rows = gsl::narrow<short>(_invalidRows.size());
+    for (short row = std::max<short>(_virtualTop, 0); row < rows; row++)
+    {
+        // Scrolling can move a span past the edge of the viewport.
+        SMALL_RECT span = _invalidRows.at(row).ToExclusive();
+        if (!_invalidRows.at(row).IsValid() || !view.TrimToViewport(&span))
+        {
+            continue;
+        }
+
+        // Rows right below each other with the same span share a rectangle.
+        if (!area.empty() &&
+            area.back().Bottom == row - 1 &&
+            area.back().Left == span.Left &&
+            area.back().Right == span.Right - 1)
+        {
+            area.back().Bottom = row;
+        }
+        else
+        {
+            area.push_back(Viewport::FromExclusive(span).ToInclusive());
+        }
+    }
+    return area;
+}
+
 // Routine Description:
 // - Uses the currently selected font to determine how wide the given character will be when renderered.
 // - NOTE: Only supports determining half-width/full-width status for CJK-type languages (e.g. is it 1 character wide or 2. a.k.a. is it a rectangle or square.)
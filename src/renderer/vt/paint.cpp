@@ -21,6 +21,10 @@ using namespace Microsoft::Console::Types;
 [[nodiscard]]
 HRESULT VtEngine::StartPaint() noexcept
 {
+    // The color table can change between frames, so check it again the next
+    //      time we need to look a color up in it.
+    _colorCacheChecked = false;
+
     if (_pipeBroken)
     {
         return S_FALSE;
@@ -53,6 +57,7 @@ HRESULT VtEngine::EndPaint() noexcept
     _trace.TraceEndPaint();
 
     _invalidRect = Viewport::Empty();
+    std::fill(_invalidRows.begin(), _invalidRows.end(), Viewport::Empty());
     _fInvalidRectUsed = false;
     _scrollDelta = {0};
     _clearedAllThisFrame = false;
@@ -181,6 +186,8 @@ HRESULT VtEngine::PaintSelection(const SMALL_RECT /*rect*/) noexcept
 // Routine Description:
 // - Write a VT sequence to change the current colors of text. Writes true RGB
 //      color sequences.
+//   Everything that changed (boldness, foreground, background) is written as
+//      a single SGR sequence.
 // Arguments:
 // - colorForeground: The RGB Color to use to paint the foreground text.
 // - colorBackground: The RGB Color to use to paint the background of the text.
@@ -198,67 +205,71 @@ HRESULT VtEngine::_RgbUpdateDrawingBrushes(const COLORREF colorForeground,
     const bool fgIsDefault = colorForeground == _colorProvider.GetDefaultForeground();
     const bool bgIsDefault = colorBackground == _colorProvider.GetDefaultBackground();
 
+    int sgr[MAX_SGR_PARAMETERS];
+    size_t cSgr = 0;
+
     // If both the FG and BG should be the defaults, emit a SGR reset.
     if ((fgChanged || bgChanged) && fgIsDefault && bgIsDefault)
     {
         // SGR Reset will also clear out the boldness of the text.
-        RETURN_IF_FAILED(_SetGraphicsDefault());
-        _LastFG = colorForeground;
-        _LastBG = colorBackground;
-        _lastWasBold = false;
+        sgr[cSgr++] = 0;
 
         // I'm not sure this is possible currently, but if the text is bold, but
         //      default colors, make sure we bold it.
         if (isBold)
         {
-            RETURN_IF_FAILED(_SetGraphicsBoldness(isBold));
-            _lastWasBold = isBold;
+            sgr[cSgr++] = 1;
         }
     }
     else
     {
         if (_lastWasBold != isBold)
         {
-            RETURN_IF_FAILED(_SetGraphicsBoldness(isBold));
-            _lastWasBold = isBold;
+            sgr[cSgr++] = isBold ? 1 : 22;
         }
 
-        WORD wFoundColor = 0;
-        if (fgChanged)
+        if ((fgChanged && !fgIsDefault) || (bgChanged && !bgIsDefault))
         {
-            if (fgIsDefault)
+            RETURN_IF_FAILED(_ColorCacheValidate(ColorTable, cColorTable));
+        }
+
+        const auto appendColor = [&](const COLORREF color, const bool isDefault, const bool fIsForeground) noexcept {
+            WORD wFoundColor = 0;
+            if (isDefault)
             {
-                RETURN_IF_FAILED(_SetGraphicsRenditionDefaultColor(true));
+                sgr[cSgr++] = fIsForeground ? 39 : 49;
             }
-            else if (::FindTableIndex(colorForeground, ColorTable, cColorTable, &wFoundColor))
+            else if (_ColorCacheLookup(color, ColorTable, cColorTable, false, &wFoundColor))
             {
-                RETURN_IF_FAILED(_SetGraphicsRendition16Color(wFoundColor, true));
+                sgr[cSgr++] = s_16ColorSgrParameter(wFoundColor, fIsForeground);
             }
             else
             {
-                RETURN_IF_FAILED(_SetGraphicsRenditionRGBColor(colorForeground, true));
+                sgr[cSgr++] = fIsForeground ? 38 : 48;
+                sgr[cSgr++] = 2;
+                sgr[cSgr++] = GetRValue(color);
+                sgr[cSgr++] = GetGValue(color);
+                sgr[cSgr++] = GetBValue(color);
             }
-            _LastFG = colorForeground;
+        };
+
+        if (fgChanged)
+        {
+            appendColor(colorForeground, fgIsDefault, true);
         }
 
         if (bgChanged)
         {
-            if (bgIsDefault)
-            {
-                RETURN_IF_FAILED(_SetGraphicsRenditionDefaultColor(false));
-            }
-            else if (::FindTableIndex(colorBackground, ColorTable, cColorTable, &wFoundColor))
-            {
-                RETURN_IF_FAILED(_SetGraphicsRendition16Color(wFoundColor, false));
-            }
-            else
-            {
-                RETURN_IF_FAILED(_SetGraphicsRenditionRGBColor(colorBackground, false));
-            }
-            _LastBG = colorBackground;
+            appendColor(colorBackground, bgIsDefault, false);
         }
     }
 
+    RETURN_IF_FAILED(_SetGraphicsRendition(sgr, cSgr));
+
+    _LastFG = colorForeground;
+    _LastBG = colorBackground;
+    _lastWasBold = isBold;
+
     return S_OK;
 }
 
@@ -266,6 +277,8 @@ HRESULT VtEngine::_RgbUpdateDrawingBrushes(const COLORREF colorForeground,
 // - Write a VT sequence to change the current colors of text. It will try to
 //      find the colors in the color table that are nearest to the input colors,
 //       and write those indicies to the pipe.
+//   Everything that changed (boldness, foreground, background) is written as
+//      a single SGR sequence.
 // Arguments:
 // - colorForeground: The RGB Color to use to paint the foreground text.
 // - colorBackground: The RGB Color to use to paint the background of the text.
@@ -280,57 +293,151 @@ HRESULT VtEngine::_16ColorUpdateDrawingBrushes(const COLORREF colorForeground,
                                                _In_reads_(cColorTable) const COLORREF* const ColorTable,
                                                const WORD cColorTable) noexcept
 {
-
     const bool fgChanged = colorForeground != _LastFG;
     const bool bgChanged = colorBackground != _LastBG;
     const bool fgIsDefault = colorForeground == _colorProvider.GetDefaultForeground();
     const bool bgIsDefault = colorBackground == _colorProvider.GetDefaultBackground();
 
+    int sgr[MAX_SGR_PARAMETERS];
+    size_t cSgr = 0;
+
     // If both the FG and BG should be the defaults, emit a SGR reset.
     if ((fgChanged || bgChanged) && fgIsDefault && bgIsDefault)
     {
         // SGR Reset will also clear out the boldness of the text.
-        RETURN_IF_FAILED(_SetGraphicsDefault());
-        _LastFG = colorForeground;
-        _LastBG = colorBackground;
-        _lastWasBold = false;
+        sgr[cSgr++] = 0;
+
         // I'm not sure this is possible currently, but if the text is bold, but
         //      default colors, make sure we bold it.
         if (isBold)
         {
-            RETURN_IF_FAILED(_SetGraphicsBoldness(isBold));
-            _lastWasBold = isBold;
+            sgr[cSgr++] = 1;
         }
     }
     else
     {
         if (_lastWasBold != isBold)
         {
-            RETURN_IF_FAILED(_SetGraphicsBoldness(isBold));
-            _lastWasBold = isBold;
+            sgr[cSgr++] = isBold ? 1 : 22;
         }
 
-        if (fgChanged)
+        if (fgChanged || bgChanged)
         {
-            const WORD wNearestFg = ::FindNearestTableIndex(colorForeground, ColorTable, cColorTable);
-            RETURN_IF_FAILED(_SetGraphicsRendition16Color(wNearestFg, true));
+            RETURN_IF_FAILED(_ColorCacheValidate(ColorTable, cColorTable));
+        }
 
-            _LastFG = colorForeground;
+        WORD wNearest = 0;
+        if (fgChanged)
+        {
+            _ColorCacheLookup(colorForeground, ColorTable, cColorTable, true, &wNearest);
+            sgr[cSgr++] = s_16ColorSgrParameter(wNearest, true);
         }
 
         if (bgChanged)
         {
-            const WORD wNearestBg = ::FindNearestTableIndex(colorBackground, ColorTable, cColorTable);
-            RETURN_IF_FAILED(_SetGraphicsRendition16Color(wNearestBg, false));
-
-            _LastBG = colorBackground;
+            _ColorCacheLookup(colorBackground, ColorTable, cColorTable, true, &wNearest);
+            sgr[cSgr++] = s_16ColorSgrParameter(wNearest, false);
         }
+    }
+
+    RETURN_IF_FAILED(_SetGraphicsRendition(sgr, cSgr));
+
+    _LastFG = colorForeground;
+    _LastBG = colorBackground;
+    _lastWasBold = isBold;
+
+    return S_OK;
+}
+
+// Routine Description:
+// - Empties the color cache.
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+void VtEngine::_ColorCacheFlush() noexcept
+{
+    for (auto& entry : _colorCache)
+    {
+        entry = { INVALID_COLOR, 0, false, false };
+    }
+}
 
+// Routine Description:
+// - Makes sure the color cache was filled from the given color table. The
+//      table can be changed in place (eg by SetConsoleScreenBufferInfoEx), so
+//      this compares its contents, not just the pointer. If it changed, the
+//      cache is flushed.
+//   The table can't change in the middle of a frame, so it's only compared
+//      the first time this is called after StartPaint.
+// Arguments:
+// - ColorTable: The color table we're about to look colors up in.
+// - cColorTable: size of the color table.
+// Return Value:
+// - S_OK, or E_OUTOFMEMORY if we couldn't copy the table.
+[[nodiscard]]
+HRESULT VtEngine::_ColorCacheValidate(_In_reads_(cColorTable) const COLORREF* const ColorTable,
+                                      const WORD cColorTable) noexcept
+{
+    if (_colorCacheChecked)
+    {
+        return S_OK;
     }
 
+    if (_colorCacheTable.size() != cColorTable ||
+        !std::equal(_colorCacheTable.cbegin(), _colorCacheTable.cend(), ColorTable))
+    {
+        _ColorCacheFlush();
+        try
+        {
+            _colorCacheTable.assign(ColorTable, ColorTable + cColorTable);
+        }
+        CATCH_RETURN();
+    }
+    _colorCacheChecked = true;
     return S_OK;
 }
 
+// Routine Description:
+// - Finds a color in the color table, using the color cache when it can.
+//      _ColorCacheValidate must have been called with the same table first.
+// Arguments:
+// - color: The color to look for.
+// - ColorTable: The color table to look in.
+// - cColorTable: size of the color table.
+// - needNearest: If true, and the color isn't in the table, find the nearest
+//      entry instead.
+// - pIndex: Receives the index of the color in the table. If the color isn't
+//      in the table, this is the nearest entry if needNearest is set, else 0.
+// Return Value:
+// - true if the color is exactly in the table.
+bool VtEngine::_ColorCacheLookup(const COLORREF color,
+                                 _In_reads_(cColorTable) const COLORREF* const ColorTable,
+                                 const WORD cColorTable,
+                                 const bool needNearest,
+                                 _Out_ WORD* const pIndex) noexcept
+{
+    // Fibonacci hashing spreads out the nearby colors of gradients.
+    ColorCacheEntry& entry = _colorCache[((color * 2654435761u) >> 16) % COLOR_CACHE_SIZE];
+
+    if (color == INVALID_COLOR ||
+        entry.color != color ||
+        (needNearest && !entry.isExact && !entry.hasNearest))
+    {
+        entry.color = color;
+        entry.isExact = ::FindTableIndex(color, ColorTable, cColorTable, &entry.index);
+        entry.hasNearest = entry.isExact;
+        if (needNearest && !entry.isExact)
+        {
+            entry.index = ::FindNearestTableIndex(color, ColorTable, cColorTable);
+            entry.hasNearest = true;
+        }
+    }
+
+    *pIndex = entry.index;
+    return entry.isExact;
+}
+
 // Routine Description:
 // - Draws one line of the buffer to the screen. Writes the characters to the
 //      pipe. If the characters are outside the ASCII range (0-0x7f), then
@@ -6,10 +6,6 @@
 #include "../../inc/conattrs.hpp"
 #include "../../types/inc/convert.hpp"
 
-// For _vcprintf
-#include <conio.h>
-#include <stdarg.h>
-
 #pragma hdrstop
 
 using namespace Microsoft::Console;
@@ -30,12 +26,17 @@ VtEngine::VtEngine(_In_ wil::unique_hfile pipe,
                    const Viewport initialViewport) :
     RenderEngineBase(),
     _hFile(std::move(pipe)),
+    _writer{},
     _colorProvider(colorProvider),
     _LastFG(INVALID_COLOR),
     _LastBG(INVALID_COLOR),
     _lastWasBold(false),
+    _colorCache{},
+    _colorCacheTable{},
+    _colorCacheChecked(false),
     _lastViewport(initialViewport),
     _invalidRect(Viewport::Empty()),
+    _invalidRows{},
     _fInvalidRectUsed(false),
     _lastRealCursor({0}),
     _lastText({0}),
@@ -51,11 +52,14 @@ VtEngine::VtEngine(_In_ wil::unique_hfile pipe,
     _skipCursor(false),
     _pipeBroken(false),
     _exitResult{ S_OK },
+    _tearingDown{ false },
     _terminalOwner{ nullptr },
     _newBottomLine{ false },
     _deferredCursorPos{ INVALID_COORDS },
     _trace {}
 {
+    _ColorCacheFlush();
+
 #ifndef UNIT_TESTING
     // When unit testing, we can instantiate a VtEngine without a pipe.
     THROW_HR_IF(E_HANDLE, _hFile.get() == INVALID_HANDLE_VALUE);
@@ -63,6 +67,12 @@ VtEngine::VtEngine(_In_ wil::unique_hfile pipe,
     // member is only defined when UNIT_TESTING is.
     _usingTestCallback = false;
 #endif
+
+    if (_hFile.get() != INVALID_HANDLE_VALUE)
+    {
+        _writer = std::make_unique<VtPipeWriter>(_hFile.get(), [this](const HRESULT hr) { _PipeBroken(hr); });
+        THROW_IF_FAILED(_writer->Start());
+    }
 }
 
 // Method Description:
@@ -94,6 +104,14 @@ HRESULT VtEngine::_Write(std::string_view const str) noexcept
     CATCH_RETURN();
 }
 
+// Method Description:
+// - Hands the frame we've built up to the pipe writer thread. If the pipe has
+//      broken, we stop writing. The writer has already told the terminal owner
+//      about it, see _PipeBroken.
+// Arguments:
+// - <none>
+// Return Value:
+// - S_OK or suitable HRESULT error from writing pipe.
 [[nodiscard]]
 HRESULT VtEngine::_Flush() noexcept
 {
@@ -107,23 +125,64 @@ HRESULT VtEngine::_Flush() noexcept
 
     if (!_pipeBroken)
     {
-        bool fSuccess = !!WriteFile(_hFile.get(), _buffer.data(), static_cast<DWORD>(_buffer.size()), nullptr, nullptr);
-        _buffer.clear();
-        if (!fSuccess)
+        const size_t cbFrame = _buffer.size();
+        const HRESULT hr = _writer->Submit(_buffer);
+        const VtPipeWriter::Metrics metrics = _writer->GetMetrics();
+        _trace.TraceFlush(cbFrame, metrics.framesMerged, metrics.framesDropped);
+        if (FAILED(hr))
         {
-            _exitResult = HRESULT_FROM_WIN32(GetLastError());
+            _exitResult = hr;
             _pipeBroken = true;
-            if (_terminalOwner)
-            {
-                _terminalOwner->CloseOutput();
-            }
-            return _exitResult;
+            return hr;
+        }
+
+        // This is the last frame we'll get to write. Make sure it's actually
+        //      out before the process goes away.
+        if (_tearingDown)
+        {
+            LOG_HR_IF(HRESULT_FROM_WIN32(ERROR_TIMEOUT), !_writer->WaitForWrites(VtPipeWriter::s_msTeardownTimeout));
         }
     }
 
     return S_OK;
 }
 
+// Method Description:
+// - Called on the pipe writer thread when a write fails. Stops painting, and
+//      tells the terminal owner the output is gone right away, rather than
+//      waiting for a frame that may never come if the console is idle.
+// - The owner is told from the thread pool. Closing the output takes the
+//      console lock, and the thread holding it may be destroying this engine,
+//      waiting for the writer thread to stop. The owner lives as long as the
+//      console does, so it's still there when the callback runs.
+// Arguments:
+// - hr: The error from the failed write.
+// Return Value:
+// - <none>
+void VtEngine::_PipeBroken(const HRESULT hr) noexcept
+{
+    _exitResult = hr;
+    _pipeBroken = true;
+    if (_terminalOwner && !TrySubmitThreadpoolCallback(s_CloseOutputCallback, _terminalOwner, nullptr))
+    {
+        // We'd rather risk the wait than never tell the owner at all.
+        LOG_LAST_ERROR();
+        _terminalOwner->CloseOutput();
+    }
+}
+
+// Routine Description:
+// - Thread pool callback that closes the output of the terminal owner it's
+//      given. See _PipeBroken.
+// Arguments:
+// - context: The ITerminalOwner.
+// Return Value:
+// - <none>
+void CALLBACK VtEngine::s_CloseOutputCallback(PTP_CALLBACK_INSTANCE, void* const context) noexcept
+{
+    static_cast<Microsoft::Console::ITerminalOwner*>(context)->CloseOutput();
+}
+
 // Method Description:
 // - Wrapper for ITerminalOutputConnection. See _Write.
 [[nodiscard]]
@@ -178,39 +237,36 @@ HRESULT VtEngine::_WriteTerminalAscii(const std::wstring& wstr) noexcept
 }
 
 // Method Description:
-// - Helper for calling _Write with a string for formatting a sequence. Used
-//      extensively by VtSequences.cpp
+// - Writes the decimal digits of an integer. Used by _WriteCsi to format the
+//      parameters of a sequence.
 // Arguments:
-// - pFormat: the pointer to the string to write to the pipe.
-// - ...: a va_list of args to format the string with.
+// - it: where to write the digits. Must have room for a sign and 10 digits.
+// - value: the integer to write.
 // Return Value:
-// - S_OK, E_INVALIDARG for a invalid format string, or suitable HRESULT error
-//      from writing pipe.
-[[nodiscard]]
-HRESULT VtEngine::_WriteFormattedString(const std::string* const pFormat, ...) noexcept
+// - A pointer just past the last digit written.
+char* VtEngine::s_AppendInteger(_Out_writes_(CSI_PARAMETER_LENGTH) char* it, const int value) noexcept
 {
+    unsigned int magnitude = static_cast<unsigned int>(value);
+    if (value < 0)
+    {
+        *it++ = '-';
+        magnitude = 0u - magnitude;
+    }
 
-    HRESULT hr = E_FAIL;
-    va_list argList;
-    va_start(argList, pFormat);
-
-    int cchNeeded = _scprintf(pFormat->c_str(), argList);
-    // -1 is the _scprintf error case https://msdn.microsoft.com/en-us/library/t32cf9tb.aspx
-    if (cchNeeded > -1)
+    // Generate the digits backwards, then copy them out in order.
+    char digits[10];
+    size_t cDigits = 0;
+    do
     {
-        wistd::unique_ptr<char[]> psz = wil::make_unique_nothrow<char[]>(cchNeeded + 1);
-        RETURN_IF_NULL_ALLOC(psz);
+        digits[cDigits++] = static_cast<char>('0' + (magnitude % 10));
+        magnitude /= 10;
+    } while (magnitude != 0);
 
-        int cchWritten = _vsnprintf_s(psz.get(), cchNeeded + 1, cchNeeded, pFormat->c_str(), argList);
-        hr = _Write({ psz.get(), gsl::narrow<size_t>(cchWritten) });
-    }
-    else
+    while (cDigits > 0)
     {
-        hr = E_INVALIDARG;
+        *it++ = digits[--cDigits];
     }
-
-    va_end(argList);
-    return hr;
+    return it;
 }
 
 // Method Description:
@@ -197,6 +197,24 @@ void RenderTracing::TraceEndPaint() const
     #endif UNIT_TESTING
 }
 
+void RenderTracing::TraceFlush(const size_t cbFrame,
+                               const size_t framesMerged,
+                               const size_t framesDropped) const
+{
+    #ifndef UNIT_TESTING
+    TraceLoggingWrite(g_hConsoleVtRendererTraceProvider,
+                      "VtEngine_TraceFlush",
+                      TraceLoggingUInt64(cbFrame),
+                      TraceLoggingUInt64(framesMerged),
+                      TraceLoggingUInt64(framesDropped),
+                      TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE));
+    #else
+    UNREFERENCED_PARAMETER(cbFrame);
+    UNREFERENCED_PARAMETER(framesMerged);
+    UNREFERENCED_PARAMETER(framesDropped);
+    #endif UNIT_TESTING
+}
+
 
 void RenderTracing::TraceLastText(const COORD lastTextPos) const
 {
@@ -39,5 +39,8 @@ namespace Microsoft::Console::VirtualTerminal
                              const COORD scrollDelta,
                              const bool cursorMoved) const;
         void TraceEndPaint() const;
+        void TraceFlush(const size_t cbFrame,
+                        const size_t framesMerged,
+                        const size_t framesDropped) const;
     };
 }
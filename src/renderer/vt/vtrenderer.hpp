@@ -21,8 +21,11 @@ Author(s):
 #include "../../inc/ITerminalOwner.hpp"
 #include "../../types/inc/Viewport.hpp"
 #include "tracing.hpp"
+#include "VtPipeWriter.hpp"
+#include <atomic>
 #include <string>
 #include <functional>
+#include <type_traits>
 
 namespace Microsoft::Console::Render
 {
@@ -103,6 +106,7 @@ namespace Microsoft::Console::Render
                                 const int iDpi) noexcept override;
 
         SMALL_RECT GetDirtyRectInChars() override;
+        std::vector<SMALL_RECT> GetDirtyArea() override;
         [[nodiscard]]
         HRESULT GetFontSize(_Out_ COORD* const pFontSize) noexcept override;
         [[nodiscard]]
@@ -127,6 +131,7 @@ namespace Microsoft::Console::Render
     protected:
         wil::unique_hfile _hFile;
         std::string _buffer;
+        std::unique_ptr<VtPipeWriter> _writer; // Must come after _hFile, so it's stopped before the pipe closes.
 
         const Microsoft::Console::IDefaultColorProvider& _colorProvider;
 
@@ -134,8 +139,27 @@ namespace Microsoft::Console::Render
         COLORREF _LastBG;
         bool _lastWasBold;
 
+        // A direct-mapped cache of color table lookups, so a color we've
+        //      already seen costs a probe instead of a scan of the table (and
+        //      the nearest color math). It's flushed whenever the color table
+        //      no longer matches _colorCacheTable, the copy it was filled from.
+        //      That's checked at most once a frame, see _colorCacheChecked.
+        struct ColorCacheEntry
+        {
+            COLORREF color; // INVALID_COLOR if the entry is empty.
+            WORD index;
+            bool isExact; // index is an exact match for color.
+            bool hasNearest; // index is the nearest match for color, if it's not exact.
+        };
+        static const size_t COLOR_CACHE_SIZE = 64;
+        ColorCacheEntry _colorCache[COLOR_CACHE_SIZE];
+        std::vector<COLORREF> _colorCacheTable;
+        bool _colorCacheChecked; // The table was compared to _colorCacheTable this frame.
+
         Microsoft::Console::Types::Viewport _lastViewport;
         Microsoft::Console::Types::Viewport _invalidRect;
+        // The dirty span of each row of the viewport, or Empty. _invalidRect is the bounds of all of them.
+        std::vector<Microsoft::Console::Types::Viewport> _invalidRows;
 
         bool _fInvalidRectUsed;
         COORD _lastRealCursor;
@@ -156,22 +180,69 @@ namespace Microsoft::Console::Render
         bool _newBottomLine;
         COORD _deferredCursorPos;
 
-        bool _pipeBroken;
-        HRESULT _exitResult;
+        std::atomic<bool> _pipeBroken; // Set from the pipe writer thread.
+        std::atomic<HRESULT> _exitResult; // Set from the pipe writer thread.
+        bool _tearingDown;
+
         Microsoft::Console::ITerminalOwner* _terminalOwner;
 
         Microsoft::Console::VirtualTerminal::RenderTracing _trace;
 
         [[nodiscard]]
         HRESULT _Write(std::string_view const str) noexcept;
-        [[nodiscard]]
-        HRESULT _WriteFormattedString(const std::string* const pFormat, ...) noexcept;
+        // A CSI parameter is at most a sign and 10 digits, plus its separator.
+        static const size_t CSI_PARAMETER_LENGTH = 12;
+
+        // Method Description:
+        // - Formats a CSI sequence (ESC [ n;m;... X) with the given numeric
+        //      parameters into a buffer on the stack, and writes it. Used
+        //      extensively by VtSequences.cpp. The size of the sequence is
+        //      known at compile time, so this never allocates.
+        // Arguments:
+        // - finalChar: the character that ends the sequence.
+        // - params: the numeric parameters of the sequence, in order.
+        // Return Value:
+        // - S_OK or suitable HRESULT error from writing pipe.
+        template<typename... Args>
+        [[nodiscard]]
+        HRESULT _WriteCsi(const char finalChar, const Args... params) noexcept
+        {
+            static_assert((std::is_integral_v<Args> && ...), "CSI parameters must be integers");
+
+            char sequence[2 + (sizeof...(Args) * CSI_PARAMETER_LENGTH) + 1];
+            char* it = sequence;
+            *it++ = '\x1b';
+            *it++ = '[';
+            ((it = s_AppendInteger(it, static_cast<int>(params)), *it++ = ';'), ...);
+            if constexpr (sizeof...(Args) > 0)
+            {
+                // Drop the separator after the last parameter.
+                it--;
+            }
+            *it++ = finalChar;
+
+            return _Write({ sequence, static_cast<size_t>(it - sequence) });
+        }
+        static char* s_AppendInteger(_Out_writes_(CSI_PARAMETER_LENGTH) char* it, const int value) noexcept;
+
+        void _ColorCacheFlush() noexcept;
+        [[nodiscard]]
+        HRESULT _ColorCacheValidate(_In_reads_(cColorTable) const COLORREF* const ColorTable,
+                                    const WORD cColorTable) noexcept;
+        bool _ColorCacheLookup(const COLORREF color,
+                               _In_reads_(cColorTable) const COLORREF* const ColorTable,
+                               const WORD cColorTable,
+                               const bool needNearest,
+                               _Out_ WORD* const pIndex) noexcept;
         [[nodiscard]]
         HRESULT _Flush() noexcept;
+        void _PipeBroken(const HRESULT hr) noexcept;
+        static void CALLBACK s_CloseOutputCallback(PTP_CALLBACK_INSTANCE, void* const context) noexcept;
 
         void _OrRect(_Inout_ SMALL_RECT* const pRectExisting, const SMALL_RECT* const pRectToOr) const;
         [[nodiscard]]
         HRESULT _InvalidCombine(const Microsoft::Console::Types::Viewport invalid) noexcept;
+        void _InvalidRowsCombine(const Microsoft::Console::Types::Viewport invalid);
         [[nodiscard]]
         HRESULT _InvalidOffset(const COORD* const ppt) noexcept;
         [[nodiscard]]
@@ -206,17 +277,15 @@ namespace Microsoft::Console::Render
         HRESULT _ClearScreen() noexcept;
         [[nodiscard]]
         HRESULT _ChangeTitle(const std::string& title) noexcept;
+        // Boldness, and an RGB foreground and background, each with 5 parameters.
+        static const size_t MAX_SGR_PARAMETERS = 11;
         [[nodiscard]]
-        HRESULT _SetGraphicsRendition16Color(const WORD wAttr,
-                                            const bool fIsForeground) noexcept;
+        HRESULT _SetGraphicsRendition(_In_reads_(cParams) const int* const rgParams,
+                                      const size_t cParams) noexcept;
+        static int s_16ColorSgrParameter(const WORD wAttr, const bool fIsForeground) noexcept;
         [[nodiscard]]
-        HRESULT _SetGraphicsRenditionRGBColor(const COLORREF color,
+        HRESULT _SetGraphicsRendition16Color(const WORD wAttr,
                                             const bool fIsForeground) noexcept;
-        [[nodiscard]]
-        HRESULT _SetGraphicsRenditionDefaultColor(const bool fIsForeground) noexcept;
-
-        [[nodiscard]]
-        HRESULT _SetGraphicsBoldness(const bool isBold) noexcept;
 
         [[nodiscard]]
         HRESULT _SetGraphicsDefault() noexcept;
@@ -0,0 +1,197 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+/*
+Module Name:
+- ActionBatch.hpp
+
+Abstract:
+- This is a compact record of all the actions the StateMachine decoded from a
+    single call to ProcessString. Engines that opt in to batched dispatch get
+    the whole batch handed to them at the end of the string, instead of one
+    virtual call per action.
+- Parameters and OSC strings are copied into arenas owned by the batch. The
+    batch is cleared, but not freed, after every dispatch, so once it has grown
+    to fit the typical write no further allocations are made.
+- Print runs are NOT copied. They point into the string being processed, and
+    are only valid until ProcessString returns.
+*/
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace Microsoft::Console::VirtualTerminal
+{
+    class ActionBatch final
+    {
+    public:
+        enum class ActionType : unsigned char
+        {
+            Execute,
+            ExecuteFromEscape,
+            Print,
+            PrintString,
+            EscDispatch,
+            CsiDispatch,
+            OscDispatch,
+            Ss3Dispatch
+        };
+
+        struct Action
+        {
+            ActionType type;
+            wchar_t wch;
+            wchar_t wchIntermediate;
+            unsigned short cIntermediate;
+            unsigned short usParam; // The OSC param, for OscDispatch.
+            unsigned short cData; // Number of params, for CsiDispatch and Ss3Dispatch.
+            size_t iData; // Offset of the params or OSC string in their arena.
+            const wchar_t* pwchRun; // The print run, for PrintString.
+            size_t cchRun; // Length of the print run or OSC string.
+        };
+
+        ActionBatch() = default;
+
+        void Clear() noexcept
+        {
+            _actions.clear();
+            _params.clear();
+            _strings.clear();
+        }
+
+        bool Empty() const noexcept
+        {
+            return _actions.empty();
+        }
+
+        size_t Size() const noexcept
+        {
+            return _actions.size();
+        }
+
+        std::vector<Action>::const_iterator begin() const noexcept
+        {
+            return _actions.cbegin();
+        }
+
+        std::vector<Action>::const_iterator end() const noexcept
+        {
+            return _actions.cend();
+        }
+
+        const unsigned short* GetParams(const Action& action) const noexcept
+        {
+            return _params.data() + action.iData;
+        }
+
+        std::wstring_view GetString(const Action& action) const noexcept
+        {
+            // An empty string may not have anything stored for it at all, but
+            //   it still has to come back as a (non-null) string.
+            if (action.cchRun == 0)
+            {
+                return { L"", 0 };
+            }
+            return { _strings.data() + action.iData, action.cchRun };
+        }
+
+        void AddExecute(const wchar_t wch)
+        {
+            _AddSimple(ActionType::Execute, wch);
+        }
+
+        void AddExecuteFromEscape(const wchar_t wch)
+        {
+            _AddSimple(ActionType::ExecuteFromEscape, wch);
+        }
+
+        void AddPrint(const wchar_t wch)
+        {
+            _AddSimple(ActionType::Print, wch);
+        }
+
+        void AddPrintString(const wchar_t* const rgwch, const size_t cch)
+        {
+            if (cch == 0)
+            {
+                return;
+            }
+
+            Action action{};
+            action.type = ActionType::PrintString;
+            action.pwchRun = rgwch;
+            action.cchRun = cch;
+            _actions.push_back(action);
+        }
+
+        void AddEscDispatch(const wchar_t wch,
+                            const unsigned short cIntermediate,
+                            const wchar_t wchIntermediate)
+        {
+            Action action{};
+            action.type = ActionType::EscDispatch;
+            action.wch = wch;
+            action.cIntermediate = cIntermediate;
+            action.wchIntermediate = wchIntermediate;
+            _actions.push_back(action);
+        }
+
+        void AddCsiDispatch(const wchar_t wch,
+                            const unsigned short cIntermediate,
+                            const wchar_t wchIntermediate,
+                            _In_reads_(cParams) const unsigned short* const rgusParams,
+                            const unsigned short cParams)
+        {
+            Action action{};
+            action.type = ActionType::CsiDispatch;
+            action.wch = wch;
+            action.cIntermediate = cIntermediate;
+            action.wchIntermediate = wchIntermediate;
+            action.iData = _params.size();
+            action.cData = cParams;
+            _params.insert(_params.end(), rgusParams, rgusParams + cParams);
+            _actions.push_back(action);
+        }
+
+        void AddOscDispatch(const wchar_t wch,
+                            const unsigned short sOscParam,
+                            const std::wstring_view oscString)
+        {
+            Action action{};
+            action.type = ActionType::OscDispatch;
+            action.wch = wch;
+            action.usParam = sOscParam;
+            action.iData = _strings.size();
+            action.cchRun = oscString.size();
+            _strings.insert(_strings.end(), oscString.cbegin(), oscString.cend());
+            _actions.push_back(action);
+        }
+
+        void AddSs3Dispatch(const wchar_t wch,
+                            _In_reads_(cParams) const unsigned short* const rgusParams,
+                            const unsigned short cParams)
+        {
+            Action action{};
+            action.type = ActionType::Ss3Dispatch;
+            action.wch = wch;
+            action.iData = _params.size();
+            action.cData = cParams;
+            _params.insert(_params.end(), rgusParams, rgusParams + cParams);
+            _actions.push_back(action);
+        }
+
+    private:
+        void _AddSimple(const ActionType type, const wchar_t wch)
+        {
+            Action action{};
+            action.type = type;
+            action.wch = wch;
+            _actions.push_back(action);
+        }
+
+        std::vector<Action> _actions;
+        std::vector<unsigned short> _params;
+        std::vector<wchar_t> _strings;
+    };
+}
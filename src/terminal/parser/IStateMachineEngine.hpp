@@ -12,6 +12,9 @@ Abstract:
     the existing VT parsing.
 */
 #pragma once
+
+#include "ActionBatch.hpp"
+
 namespace Microsoft::Console::VirtualTerminal
 {
     class IStateMachineEngine
@@ -44,8 +47,7 @@ namespace Microsoft::Console::VirtualTerminal
 
         virtual bool ActionOscDispatch(const wchar_t wch,
                                         const unsigned short sOscParam,
-                                        _Inout_updates_(cchOscString) wchar_t* const pwchOscStringBuffer,
-                                        const unsigned short cchOscString) = 0;
+                                        const std::wstring_view oscString) = 0;
 
         virtual bool ActionSs3Dispatch(const wchar_t wch,
                                         _In_reads_(cParams) const unsigned short* const rgusParams,
@@ -54,6 +56,12 @@ namespace Microsoft::Console::VirtualTerminal
         virtual bool FlushAtEndOfString() const = 0;
         virtual bool DispatchControlCharsFromEscape() const = 0;
 
+        // Engines that return true here will have the actions decoded from a
+        //      whole string handed to ActionDispatchBatch at the end of that
+        //      string, instead of receiving each action as it's decoded.
+        virtual bool DispatchActionsInBatches() const = 0;
+        virtual bool ActionDispatchBatch(ActionBatch& batch) = 0;
+
     };
 
     inline IStateMachineEngine::~IStateMachineEngine() {}
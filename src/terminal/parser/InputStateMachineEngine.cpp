@@ -462,14 +462,12 @@ bool InputStateMachineEngine::ActionIgnore()
 // Arguments:
 // - wch - Character to dispatch. This will be a BEL or ST char.
 // - sOscParam - identifier of the OSC action to perform
-// - pwchOscStringBuffer - OSC string we've collected. NOT null terminated.
-// - cchOscString - length of pwchOscStringBuffer
+// - oscString - OSC string we've collected. NOT null terminated.
 // Return Value:
 // - true if we handled the dsipatch.
 bool InputStateMachineEngine::ActionOscDispatch(const wchar_t /*wch*/,
                                                 const unsigned short /*sOscParam*/,
-                                                _Inout_updates_(_Param_(4)) wchar_t* const /*pwchOscStringBuffer*/,
-                                                const unsigned short /*cchOscString*/)
+                                                const std::wstring_view /*oscString*/)
 {
     return false;
 }
@@ -890,6 +888,28 @@ bool InputStateMachineEngine::DispatchControlCharsFromEscape() const
     return true;
 }
 
+// Routine Description:
+// - Returns true if the state machine should hand us all the actions from a
+//      string at once. Input sequences are flushed at the end of every string,
+//      and have to be translated as they're decoded, so we never batch.
+// Return Value:
+// - False.
+bool InputStateMachineEngine::DispatchActionsInBatches() const
+{
+    return false;
+}
+
+// Routine Description:
+// - Batches are never requested by this engine - see DispatchActionsInBatches.
+// Arguments:
+// - batch - unused
+// Return Value:
+// - false.
+bool InputStateMachineEngine::ActionDispatchBatch(ActionBatch& /*batch*/)
+{
+    return false;
+}
+
 // Method Description:
 // - Retrieves the type of window manipulation operation from the parameter pool
 //      stored during Param actions.
@@ -57,8 +57,7 @@ namespace Microsoft::Console::VirtualTerminal
 
         bool ActionOscDispatch(const wchar_t wch,
                             const unsigned short sOscParam,
-                            _Inout_updates_(cchOscString) wchar_t* const pwchOscStringBuffer,
-                            const unsigned short cchOscString) override;
+                            const std::wstring_view oscString) override;
 
         bool ActionSs3Dispatch(const wchar_t wch,
                             _In_reads_(cParams) const unsigned short* const rgusParams,
@@ -66,6 +65,9 @@ namespace Microsoft::Console::VirtualTerminal
 
         bool FlushAtEndOfString() const override;
         bool DispatchControlCharsFromEscape() const override;
+        bool DispatchActionsInBatches() const override;
+
+        bool ActionDispatchBatch(ActionBatch& batch) override;
 
     private:
 
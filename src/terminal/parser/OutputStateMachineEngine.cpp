@@ -15,7 +15,8 @@ OutputStateMachineEngine::OutputStateMachineEngine(ITermDispatch* const pDispatc
     _dispatch(pDispatch),
     _pfnFlushToTerminal(nullptr),
     _pTtyConnection(nullptr),
-    _lastPrintedChar(AsciiChars::NUL)
+    _lastPrintedChar(AsciiChars::NUL),
+    _fDispatchInBatches(false)
 {
 }
 
@@ -274,8 +275,7 @@ bool OutputStateMachineEngine::ActionCsiDispatch(const wchar_t wch,
     SHORT sClearType = 0;
     unsigned int uiFunction = 0;
     DispatchTypes::EraseType eraseType = DispatchTypes::EraseType::ToEnd;
-    DispatchTypes::GraphicsOptions rgGraphicsOptions[StateMachine::s_cParamsMax];
-    size_t cOptions = StateMachine::s_cParamsMax;
+    size_t cOptions = 0;
     DispatchTypes::AnsiStatusType deviceStatusType = (DispatchTypes::AnsiStatusType)-1; // there is no default status type.
     unsigned int repeatCount = 0;
     // This is all the args after the first arg, and the count of args not including the first one.
@@ -312,7 +312,11 @@ bool OutputStateMachineEngine::ActionCsiDispatch(const wchar_t wch,
             fSuccess = _GetEraseOperation(rgusParams, cParams, &eraseType);
             break;
         case VTActionCodes::SGR_SetGraphicsRendition:
-            fSuccess = _GetGraphicsOptions(rgusParams, cParams, rgGraphicsOptions, &cOptions);
+            // There's no fixed limit on the number of params, so size the options to fit.
+            //      The storage is reused, so this only allocates for the longest list seen so far.
+            _graphicsOptions.resize(std::max<size_t>(cParams, 1));
+            cOptions = _graphicsOptions.size();
+            fSuccess = _GetGraphicsOptions(rgusParams, cParams, _graphicsOptions.data(), &cOptions);
             break;
         case VTActionCodes::DSR_DeviceStatusReport:
             fSuccess = _GetDeviceStatusOperation(rgusParams, cParams, &deviceStatusType);
@@ -414,7 +418,7 @@ bool OutputStateMachineEngine::ActionCsiDispatch(const wchar_t wch,
                 TermTelemetry::Instance().Log(TermTelemetry::Codes::EL);
                 break;
             case VTActionCodes::SGR_SetGraphicsRendition:
-                fSuccess = _dispatch->SetGraphicsRendition(rgGraphicsOptions, cOptions);
+                fSuccess = _dispatch->SetGraphicsRendition(_graphicsOptions.data(), cOptions);
                 TermTelemetry::Instance().Log(TermTelemetry::Codes::SGR);
                 break;
             case VTActionCodes::DSR_DeviceStatusReport:
@@ -534,14 +538,15 @@ bool OutputStateMachineEngine::_IntermediateQuestionMarkDispatch(const wchar_t w
 {
     bool fSuccess = false;
 
-    DispatchTypes::PrivateModeParams rgPrivateModeParams[StateMachine::s_cParamsMax];
-    size_t cOptions = StateMachine::s_cParamsMax;
+    size_t cOptions = 0;
     // Ensure that there was the right number of params
     switch (wchAction)
     {
         case VTActionCodes::DECSET_PrivateModeSet:
         case VTActionCodes::DECRST_PrivateModeReset:
-            fSuccess = _GetPrivateModeParams(rgusParams, cParams, rgPrivateModeParams, &cOptions);
+            _privateModeParams.resize(cParams);
+            cOptions = _privateModeParams.size();
+            fSuccess = _GetPrivateModeParams(rgusParams, cParams, _privateModeParams.data(), &cOptions);
             break;
 
         default:
@@ -554,12 +559,12 @@ bool OutputStateMachineEngine::_IntermediateQuestionMarkDispatch(const wchar_t w
         switch(wchAction)
         {
         case VTActionCodes::DECSET_PrivateModeSet:
-            fSuccess = _dispatch->SetPrivateModes(rgPrivateModeParams, cOptions);
+            fSuccess = _dispatch->SetPrivateModes(_privateModeParams.data(), cOptions);
             //TODO: MSFT:6367459 Add specific logging for each of the DECSET/DECRST codes
             TermTelemetry::Instance().Log(TermTelemetry::Codes::DECSET);
             break;
         case VTActionCodes::DECRST_PrivateModeReset:
-            fSuccess = _dispatch->ResetPrivateModes(rgPrivateModeParams, cOptions);
+            fSuccess = _dispatch->ResetPrivateModes(_privateModeParams.data(), cOptions);
             TermTelemetry::Instance().Log(TermTelemetry::Codes::DECRST);
             break;
         default:
@@ -672,18 +677,16 @@ bool OutputStateMachineEngine::ActionIgnore()
 // Arguments:
 // - wch - Character to dispatch. This will be a BEL or ST char.
 // - sOscParam - identifier of the OSC action to perform
-// - pwchOscStringBuffer - OSC string we've collected. NOT null terminated.
-// - cchOscString - length of pwchOscStringBuffer
+// - oscString - OSC string we've collected. NOT null terminated. This may be
+//      any length, up to the state machine's cap.
 // Return Value:
 // - true if we handled the dsipatch.
 bool OutputStateMachineEngine::ActionOscDispatch(const wchar_t /*wch*/,
                                                  const unsigned short sOscParam,
-                                                 _Inout_updates_(cchOscString) wchar_t* const pwchOscStringBuffer,
-                                                 const unsigned short cchOscString)
+                                                 const std::wstring_view oscString)
 {
     bool fSuccess = false;
-    wchar_t* pwchTitle = nullptr;
-    unsigned short sCchTitleLength = 0;
+    std::wstring_view title;
     size_t tableIndex = 0;
     DWORD dwColor = 0;
 
@@ -692,13 +695,13 @@ bool OutputStateMachineEngine::ActionOscDispatch(const wchar_t /*wch*/,
     case OscActionCodes::SetIconAndWindowTitle:
     case OscActionCodes::SetWindowIcon:
     case OscActionCodes::SetWindowTitle:
-        fSuccess = _GetOscTitle(pwchOscStringBuffer, cchOscString, &pwchTitle, &sCchTitleLength);
+        fSuccess = _GetOscTitle(oscString, &title);
         break;
     case OscActionCodes::SetColor:
-        fSuccess = _GetOscSetColorTable(pwchOscStringBuffer, cchOscString, &tableIndex, &dwColor);
+        fSuccess = _GetOscSetColorTable(oscString.data(), oscString.size(), &tableIndex, &dwColor);
         break;
     case OscActionCodes::SetCursorColor:
-        fSuccess = _GetOscSetCursorColor(pwchOscStringBuffer, cchOscString, &dwColor);
+        fSuccess = _GetOscSetCursorColor(oscString.data(), oscString.size(), &dwColor);
         break;
     case OscActionCodes::ResetCursorColor:
         // the console uses 0xffffffff as an "invalid color" value
@@ -717,7 +720,7 @@ bool OutputStateMachineEngine::ActionOscDispatch(const wchar_t /*wch*/,
         case OscActionCodes::SetIconAndWindowTitle:
         case OscActionCodes::SetWindowIcon:
         case OscActionCodes::SetWindowTitle:
-            fSuccess = _dispatch->SetWindowTitle({ pwchTitle, sCchTitleLength });
+            fSuccess = _dispatch->SetWindowTitle(title);
             TermTelemetry::Instance().Log(TermTelemetry::Codes::OSCWT);
             break;
         case OscActionCodes::SetColor:
@@ -773,7 +776,7 @@ bool OutputStateMachineEngine::ActionSs3Dispatch(const wchar_t /*wch*/,
 // Routine Description:
 // - Retrieves the listed graphics options to be applied in order to the "font style" of the next characters inserted into the buffer.
 // Arguments:
-// - rgGraphicsOptions - Pointer to array space (expected 16 max, the max number of params this can generate) that will be filled with valid options from the GraphicsOptions enum
+// - rgGraphicsOptions - Pointer to array space (at least cParams long, or 1 if there are no params) that will be filled with valid options from the GraphicsOptions enum
 // - pcOptions - Pointer to the length of rgGraphicsOptions on the way in, and the count of the array used on the way out.
 // Return Value:
 // - True if we successfully retrieved an array of valid graphics options from the parameters we've stored. False otherwise.
@@ -1088,7 +1091,7 @@ bool OutputStateMachineEngine::_GetDeviceStatusOperation(_In_reads_(cParams) con
 // Routine Description:
 // - Retrieves the listed private mode params be set/reset by DECSET/DECRST
 // Arguments:
-// - rPrivateModeParams - Pointer to array space (expected 16 max, the max number of params this can generate) that will be filled with valid params from the PrivateModeParams enum
+// - rPrivateModeParams - Pointer to array space (at least cParams long) that will be filled with valid params from the PrivateModeParams enum
 // - pcParams - Pointer to the length of rPrivateModeParams on the way in, and the count of the array used on the way out.
 // Return Value:
 // - True if we successfully retrieved an array of private mode params from the parameters we've stored. False otherwise.
@@ -1159,22 +1162,19 @@ bool OutputStateMachineEngine::_VerifyDeviceAttributesParams(_In_reads_(cParams)
 }
 
 // Routine Description:
-// - Null terminates, then returns, the string that we've collected as part of the OSC string.
+// - Returns the string that we've collected as part of the OSC string.
 // Arguments:
-// - ppwchTitle - a pointer to point to the Osc String to use as a title.
-// - pcchTitleLength - a pointer place the length of ppwchTitle into.
+// - oscString - The OSC string we've collected.
+// - pTitle - Receives a view of the Osc String to use as a title.
 // Return Value:
-// - True if there was a title to output. (a title with length=0 is still valid)
+// - True. There's always a title to output. (a title with length=0 is still valid)
 _Success_(return)
-bool OutputStateMachineEngine::_GetOscTitle(_Inout_updates_(cchOscString) wchar_t* const pwchOscStringBuffer,
-                                            const unsigned short cchOscString,
-                                            _Outptr_result_buffer_(*pcchTitle) wchar_t** const ppwchTitle,
-                                            _Out_ unsigned short * pcchTitle) const
+bool OutputStateMachineEngine::_GetOscTitle(const std::wstring_view oscString,
+                                            _Out_ std::wstring_view* const pTitle) const
 {
-    *ppwchTitle = pwchOscStringBuffer;
-    *pcchTitle = cchOscString;
+    *pTitle = oscString;
 
-    return pwchOscStringBuffer != nullptr;
+    return true;
 }
 
 // Routine Description:
@@ -1301,6 +1301,75 @@ bool OutputStateMachineEngine::DispatchControlCharsFromEscape() const
     return false;
 }
 
+// Routine Description:
+// - Returns true if the state machine should hand us all the actions from a
+//      string at once, through ActionDispatchBatch.
+//   When we're passing unknown sequences through to another terminal, we need
+//      to be called while the state machine is still looking at the sequence,
+//      so batching is never used while we have a terminal connection.
+// Return Value:
+// - True iff the state machine should dispatch actions to us in batches.
+bool OutputStateMachineEngine::DispatchActionsInBatches() const
+{
+    return _fDispatchInBatches && _pfnFlushToTerminal == nullptr;
+}
+
+// Routine Description:
+// - Dispatches every action decoded from a single string, in order.
+//   Calls to our own Action* methods can't be overridden (this class is final),
+//      so each of them is a direct call rather than a trip through the vtable.
+// Arguments:
+// - batch - The actions decoded by the state machine.
+// Return Value:
+// - true iff every sequence in the batch was dispatched successfully.
+bool OutputStateMachineEngine::ActionDispatchBatch(ActionBatch& batch)
+{
+    bool fAllSucceeded = true;
+    for (const auto& action : batch)
+    {
+        bool fSuccess = true;
+        switch (action.type)
+        {
+        case ActionBatch::ActionType::Execute:
+            ActionExecute(action.wch);
+            break;
+        case ActionBatch::ActionType::ExecuteFromEscape:
+            ActionExecuteFromEscape(action.wch);
+            break;
+        case ActionBatch::ActionType::Print:
+            ActionPrint(action.wch);
+            break;
+        case ActionBatch::ActionType::PrintString:
+            ActionPrintString(action.pwchRun, action.cchRun);
+            break;
+        case ActionBatch::ActionType::EscDispatch:
+            fSuccess = ActionEscDispatch(action.wch, action.cIntermediate, action.wchIntermediate);
+            break;
+        case ActionBatch::ActionType::CsiDispatch:
+            fSuccess = ActionCsiDispatch(action.wch,
+                                         action.cIntermediate,
+                                         action.wchIntermediate,
+                                         batch.GetParams(action),
+                                         action.cData);
+            break;
+        case ActionBatch::ActionType::OscDispatch:
+            fSuccess = ActionOscDispatch(action.wch, action.usParam, batch.GetString(action));
+            break;
+        case ActionBatch::ActionType::Ss3Dispatch:
+            fSuccess = ActionSs3Dispatch(action.wch, batch.GetParams(action), action.cData);
+            break;
+        }
+
+        if (!fSuccess)
+        {
+            // Suppress it and log telemetry on failed cases, same as the state machine would have.
+            TermTelemetry::Instance().LogFailed(action.wch);
+            fAllSucceeded = false;
+        }
+    }
+    return fAllSucceeded;
+}
+
 // Routine Description:
 // - Converts a hex character to it's equivalent integer value.
 // Arguments:
@@ -1667,6 +1736,19 @@ void OutputStateMachineEngine::SetTerminalConnection(ITerminalOutputConnection*
     this->_pfnFlushToTerminal = pfnFlushToTerminal;
 }
 
+// Method Description:
+// - Opts us in to (or out of) receiving the actions from each string in a
+//      single batch. Only callers that don't need to observe state machine
+//      side effects between individual sequences should turn this on.
+// Arguments:
+// - fDispatchInBatches: true to receive actions in batches.
+// Return Value:
+// - <none>
+void OutputStateMachineEngine::SetDispatchInBatches(const bool fDispatchInBatches) noexcept
+{
+    _fDispatchInBatches = fDispatchInBatches;
+}
+
 
 // Routine Description:
 // - Retrieves a number of times to repeat the last graphical character
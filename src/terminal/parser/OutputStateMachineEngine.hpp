@@ -17,7 +17,7 @@ Abstract:
 
 namespace Microsoft::Console::VirtualTerminal
 {
-    class OutputStateMachineEngine : public IStateMachineEngine
+    class OutputStateMachineEngine final : public IStateMachineEngine
     {
     public:
         OutputStateMachineEngine(ITermDispatch* const pDispatch);
@@ -49,8 +49,7 @@ namespace Microsoft::Console::VirtualTerminal
 
         bool ActionOscDispatch(const wchar_t wch,
                                const unsigned short sOscParam,
-                               _Inout_updates_(cchOscString) wchar_t* const pwchOscStringBuffer,
-                               const unsigned short cchOscString) override;
+                               const std::wstring_view oscString) override;
 
         bool ActionSs3Dispatch(const wchar_t wch,
                                _In_reads_(cParams) const unsigned short* const rgusParams,
@@ -58,6 +57,11 @@ namespace Microsoft::Console::VirtualTerminal
 
         bool FlushAtEndOfString() const override;
         bool DispatchControlCharsFromEscape() const override;
+        bool DispatchActionsInBatches() const override;
+
+        bool ActionDispatchBatch(ActionBatch& batch) override;
+
+        void SetDispatchInBatches(const bool fDispatchInBatches) noexcept;
 
         void SetTerminalConnection(Microsoft::Console::ITerminalOutputConnection* const pTtyConnection,
                                    std::function<bool()> pfnFlushToTerminal);
@@ -70,6 +74,11 @@ namespace Microsoft::Console::VirtualTerminal
         Microsoft::Console::ITerminalOutputConnection* _pTtyConnection;
         std::function<bool()> _pfnFlushToTerminal;
         wchar_t _lastPrintedChar;
+        bool _fDispatchInBatches;
+
+        // Reused between sequences, so that long SGR and DECSET lists don't allocate every time.
+        std::vector<DispatchTypes::GraphicsOptions> _graphicsOptions;
+        std::vector<DispatchTypes::PrivateModeParams> _privateModeParams;
 
         bool _IntermediateQuestionMarkDispatch(const wchar_t wchAction,
                                                _In_reads_(cParams) const unsigned short* const rgusParams,
@@ -210,10 +219,8 @@ namespace Microsoft::Console::VirtualTerminal
                                   _Out_ SHORT* const psBottomMargin) const;
 
         _Success_(return)
-        bool _GetOscTitle(_Inout_updates_(cchOscString) wchar_t* const pwchOscStringBuffer,
-                          const unsigned short cchOscString,
-                          _Outptr_result_buffer_(*pcchTitle) wchar_t** const ppwchTitle,
-                          _Out_ unsigned short * pcchTitle) const;
+        bool _GetOscTitle(const std::wstring_view oscString,
+                          _Out_ std::wstring_view* const pTitle) const;
 
         static const SHORT s_sDefaultTabDistance = 1;
         _Success_(return)
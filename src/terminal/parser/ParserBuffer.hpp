@@ -0,0 +1,147 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+/*
+Module Name:
+- ParserBuffer.hpp
+
+Abstract:
+- This is the storage the StateMachine collects CSI parameters and OSC strings
+    into. The first InlineCapacity elements live inside the buffer itself, so
+    typical sequences never touch the heap.
+- Longer sequences spill into a heap arena that's kept for the lifetime of the
+    buffer. Clearing the buffer doesn't release the arena, so once it has grown
+    to fit the longest sequence seen, later sequences don't allocate either.
+- Growth stops at a hard cap. Elements past the cap are dropped, the same way
+    the old fixed arrays dropped anything past their end.
+*/
+#pragma once
+
+#include <vector>
+
+namespace Microsoft::Console::VirtualTerminal
+{
+    template<typename T, size_t InlineCapacity>
+    class ParserBuffer final
+    {
+    public:
+        ParserBuffer(const size_t cMax) noexcept :
+            _data(_inline),
+            _size(0),
+            _capacity(InlineCapacity),
+            _cMax(cMax)
+        {
+        }
+
+        // _data may point at _inline, so these can't be copied member-wise.
+        ParserBuffer(const ParserBuffer&) = delete;
+        ParserBuffer& operator=(const ParserBuffer&) = delete;
+
+        // Routine Description:
+        // - Appends an element, growing into the heap arena if needed.
+        // Arguments:
+        // - value - The element to append.
+        // Return Value:
+        // - false if the buffer is already at its hard cap (or the arena couldn't grow),
+        //      in which case the element was dropped.
+        bool push_back(const T value) noexcept
+        {
+            if ((_size >= _capacity || _size >= _cMax) && !_Grow())
+            {
+                return false;
+            }
+
+            _data[_size] = value;
+            _size++;
+            return true;
+        }
+
+        void clear() noexcept
+        {
+            _size = 0;
+        }
+
+        bool empty() const noexcept
+        {
+            return _size == 0;
+        }
+
+        size_t size() const noexcept
+        {
+            return _size;
+        }
+
+        T* data() noexcept
+        {
+            return _data;
+        }
+
+        const T* data() const noexcept
+        {
+            return _data;
+        }
+
+        T& back() noexcept
+        {
+            return _data[_size - 1];
+        }
+
+        size_t max_size() const noexcept
+        {
+            return _cMax;
+        }
+
+        // Routine Description:
+        // - Changes the hard cap. If the buffer already holds more than the new
+        //      cap, the extra elements are dropped.
+        // Arguments:
+        // - cMax - The new maximum number of elements.
+        // Return Value:
+        // - <none>
+        void set_max_size(const size_t cMax) noexcept
+        {
+            _cMax = cMax;
+            if (_size > _cMax)
+            {
+                _size = _cMax;
+            }
+        }
+
+    private:
+        bool _Grow() noexcept
+        {
+            if (_size >= _cMax)
+            {
+                return false;
+            }
+
+            const size_t cNewCapacity = std::min(std::max(_capacity * 2, InlineCapacity), _cMax);
+            try
+            {
+                // If we've already spilled, resize moves the existing contents for us.
+                _arena.resize(cNewCapacity);
+            }
+            catch (...)
+            {
+                LOG_CAUGHT_EXCEPTION();
+                return false;
+            }
+
+            if (_data == _inline)
+            {
+                std::copy(_inline, _inline + _size, _arena.begin());
+            }
+
+            _data = _arena.data();
+            _capacity = _arena.size();
+            return true;
+        }
+
+        T _inline[InlineCapacity];
+        std::vector<T> _arena;
+        T* _data;
+        size_t _size;
+        size_t _capacity;
+        size_t _cMax;
+    };
+}
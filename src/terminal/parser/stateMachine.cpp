@@ -6,6 +6,11 @@
 #include "stateMachine.hpp"
 
 #include "ascii.hpp"
+#include "../../inc/unicode.hpp"
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#endif
 
 using namespace Microsoft::Console::VirtualTerminal;
 
@@ -14,24 +19,40 @@ StateMachine::StateMachine(IStateMachineEngine* const pEngine) :
     _pEngine(THROW_IF_NULL_ALLOC(pEngine)),
     _state(VTStates::Ground),
     _trace(Microsoft::Console::VirtualTerminal::ParserTracing()),
-    _cParams(0),
-    _pusActiveParam(nullptr),
+    _params(s_cParamsDefaultMax),
+    _fParamsOverflowed(false),
     _cIntermediate(0),
     _wchIntermediate(UNICODE_NULL),
     _pwchCurr(nullptr),
     _iParamAccumulatePos(0),
-    // pwchOscStringBuffer Initialized below
     _pwchSequenceStart(nullptr),
-    // rgusParams Initialized below
-    _sOscNextChar(0),
+    _oscString(s_cchOscStringDefaultMax),
     _sOscParam(0),
-    _currRunLength(0)
+    _currRunLength(0),
+    _fBatching(false),
+    _utf8Sequence(s_cchOscStringDefaultMax),
+    _rgbUtf8Partial{},
+    _cbUtf8Partial(0)
 {
-    ZeroMemory(_pwchOscStringBuffer, sizeof(_pwchOscStringBuffer));
-    ZeroMemory(_rgusParams, sizeof(_rgusParams));
     _ActionClear();
 }
 
+// Routine Description:
+// - Sets the hard caps on how many parameters, and how long an OSC string,
+//      we'll collect for a single sequence. Anything past these is dropped.
+// Arguments:
+// - cParamsMax - Maximum number of CSI/SS3 parameters. Engines receive the
+//      count as an unsigned short, so this is clamped to fit.
+// - cchOscStringMax - Maximum length of an OSC string, in characters.
+// Return Value:
+// - <none>
+void StateMachine::SetSequenceLimits(const size_t cParamsMax, const size_t cchOscStringMax) noexcept
+{
+    _params.set_max_size(std::clamp<size_t>(cParamsMax, 1, USHRT_MAX));
+    _oscString.set_max_size(cchOscStringMax);
+    _utf8Sequence.set_max_size(cchOscStringMax);
+}
+
 const IStateMachineEngine& StateMachine::Engine() const noexcept
 {
     return *_pEngine;
@@ -54,6 +75,133 @@ bool StateMachine::s_IsActionableFromGround(const wchar_t wch)
     return (wch <= AsciiChars::US) || s_IsC1Csi(wch) || s_IsDelete(wch);
 }
 
+#if defined(_M_IX86) || defined(_M_X64)
+// Routine Description:
+// - Checks once whether the processor and OS support AVX2, so the ground state
+//   scanner knows whether it can use 32-byte wide blocks.
+// Arguments:
+// - <none>
+// Return Value:
+// - True if AVX2 instructions can be used. False otherwise.
+static bool _IsAvx2Supported() noexcept
+{
+    int rgCpuInfo[4];
+    __cpuid(rgCpuInfo, 0);
+    if (rgCpuInfo[0] < 7)
+    {
+        return false;
+    }
+
+    // The OS needs to have enabled OSXSAVE and the AVX state in XCR0 for us to
+    // be able to touch the ymm registers at all.
+    __cpuid(rgCpuInfo, 1);
+    const bool fOsxsave = (rgCpuInfo[2] & (1 << 27)) != 0;
+    const bool fAvx = (rgCpuInfo[2] & (1 << 28)) != 0;
+    if (!fOsxsave || !fAvx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+
+    __cpuidex(rgCpuInfo, 7, 0);
+    return (rgCpuInfo[1] & (1 << 5)) != 0;
+}
+
+// Routine Description:
+// - AVX2 block scanner for s_FindActionableFromGround. Checks 32 characters per
+//   iteration, and stops at the first block containing an actionable character.
+// Arguments:
+// - pwchStart - First character to check.
+// - pwchEnd - One past the last character to check.
+// Return Value:
+// - Pointer to the first block that contains an actionable character, or to the
+//   remaining tail of fewer than 32 characters.
+static const wchar_t* _SkipPrintableBlocksAvx2(const wchar_t* pwchStart, const wchar_t* const pwchEnd) noexcept
+{
+    const __m256i vUS = _mm256_set1_epi16(AsciiChars::US);
+    const __m256i vDEL = _mm256_set1_epi16(AsciiChars::DEL);
+    const __m256i vCSI = _mm256_set1_epi16(L'\x9b');
+    const __m256i vZero = _mm256_setzero_si256();
+
+    while (pwchEnd - pwchStart >= 32)
+    {
+        const __m256i vLo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pwchStart));
+        const __m256i vHi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pwchStart + 16));
+
+        // (wch - US) saturates to zero for everything in the C0 range.
+        const __m256i vMatchLo = _mm256_or_si256(_mm256_cmpeq_epi16(_mm256_subs_epu16(vLo, vUS), vZero),
+                                                 _mm256_or_si256(_mm256_cmpeq_epi16(vLo, vDEL), _mm256_cmpeq_epi16(vLo, vCSI)));
+        const __m256i vMatchHi = _mm256_or_si256(_mm256_cmpeq_epi16(_mm256_subs_epu16(vHi, vUS), vZero),
+                                                 _mm256_or_si256(_mm256_cmpeq_epi16(vHi, vDEL), _mm256_cmpeq_epi16(vHi, vCSI)));
+
+        if (!_mm256_testz_si256(_mm256_or_si256(vMatchLo, vMatchHi), _mm256_or_si256(vMatchLo, vMatchHi)))
+        {
+            break;
+        }
+        pwchStart += 32;
+    }
+
+    return pwchStart;
+}
+#endif
+
+// Routine Description:
+// - Finds the next character in the given range that would be actionable from
+//   the ground state (see s_IsActionableFromGround). Everything before it is a
+//   printable run that can be handed to the engine in one piece.
+//   On x86/x64 this checks 16 (SSE2) or 32 (AVX2) characters at a time, and
+//   only falls back to the per-character check for the final partial block.
+// Arguments:
+// - pwchStart - First character to check.
+// - pwchEnd - One past the last character to check.
+// Return Value:
+// - Pointer to the first actionable character, or pwchEnd if there isn't one.
+const wchar_t* StateMachine::s_FindActionableFromGround(const wchar_t* const pwchStart, const wchar_t* const pwchEnd) noexcept
+{
+    const wchar_t* pwch = pwchStart;
+
+#if defined(_M_IX86) || defined(_M_X64)
+    static const bool s_fAvx2Supported = _IsAvx2Supported();
+    if (s_fAvx2Supported)
+    {
+        pwch = _SkipPrintableBlocksAvx2(pwch, pwchEnd);
+    }
+
+    const __m128i vUS = _mm_set1_epi16(AsciiChars::US);
+    const __m128i vDEL = _mm_set1_epi16(AsciiChars::DEL);
+    const __m128i vCSI = _mm_set1_epi16(L'\x9b');
+    const __m128i vZero = _mm_setzero_si128();
+
+    while (pwchEnd - pwch >= 16)
+    {
+        const __m128i vLo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pwch));
+        const __m128i vHi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pwch + 8));
+
+        // (wch - US) saturates to zero for everything in the C0 range.
+        const __m128i vMatchLo = _mm_or_si128(_mm_cmpeq_epi16(_mm_subs_epu16(vLo, vUS), vZero),
+                                              _mm_or_si128(_mm_cmpeq_epi16(vLo, vDEL), _mm_cmpeq_epi16(vLo, vCSI)));
+        const __m128i vMatchHi = _mm_or_si128(_mm_cmpeq_epi16(_mm_subs_epu16(vHi, vUS), vZero),
+                                              _mm_or_si128(_mm_cmpeq_epi16(vHi, vDEL), _mm_cmpeq_epi16(vHi, vCSI)));
+
+        // Two mask bits per wchar_t - the low 16 bits are the first half of the block.
+        const unsigned long ulMask = static_cast<unsigned long>(_mm_movemask_epi8(vMatchLo)) |
+                                     (static_cast<unsigned long>(_mm_movemask_epi8(vMatchHi)) << 16);
+        if (ulMask != 0)
+        {
+            unsigned long ulIndex;
+            _BitScanForward(&ulIndex, ulMask);
+            return pwch + (ulIndex / 2);
+        }
+        pwch += 16;
+    }
+#endif
+
+    while (pwch < pwchEnd && !s_IsActionableFromGround(*pwch))
+    {
+        pwch++;
+    }
+    return pwch;
+}
+
 // Routine Description:
 // - Determines if a character belongs to the C0 escape range.
 //   This is character sequences less than a space character (null, backspace, new line, etc.)
@@ -62,7 +210,7 @@ bool StateMachine::s_IsActionableFromGround(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsC0Code(const wchar_t wch)
+constexpr bool StateMachine::s_IsC0Code(const wchar_t wch) noexcept
 {
     return (wch >= AsciiChars::NUL && wch <= AsciiChars::ETB) ||
            wch == AsciiChars::EM ||
@@ -88,7 +236,7 @@ bool StateMachine::s_IsC0Code(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsC1Csi(const wchar_t wch)
+constexpr bool StateMachine::s_IsC1Csi(const wchar_t wch) noexcept
 {
     return wch == L'\x9b';
 }
@@ -102,7 +250,7 @@ bool StateMachine::s_IsC1Csi(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsIntermediate(const wchar_t wch)
+constexpr bool StateMachine::s_IsIntermediate(const wchar_t wch) noexcept
 {
     return wch >= L' ' && wch <= L'/'; // 0x20 - 0x2F
 }
@@ -113,7 +261,7 @@ bool StateMachine::s_IsIntermediate(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsDelete(const wchar_t wch)
+constexpr bool StateMachine::s_IsDelete(const wchar_t wch) noexcept
 {
     return wch == AsciiChars::DEL;
 }
@@ -125,7 +273,7 @@ bool StateMachine::s_IsDelete(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsEscape(const wchar_t wch)
+constexpr bool StateMachine::s_IsEscape(const wchar_t wch) noexcept
 {
     return wch == AsciiChars::ESC;
 }
@@ -137,7 +285,7 @@ bool StateMachine::s_IsEscape(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsCsiIndicator(const wchar_t wch)
+constexpr bool StateMachine::s_IsCsiIndicator(const wchar_t wch) noexcept
 {
     return wch == L'['; // 0x5B
 }
@@ -150,7 +298,7 @@ bool StateMachine::s_IsCsiIndicator(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsCsiDelimiter(const wchar_t wch)
+constexpr bool StateMachine::s_IsCsiDelimiter(const wchar_t wch) noexcept
 {
     return wch == L';'; // 0x3B
 }
@@ -162,7 +310,7 @@ bool StateMachine::s_IsCsiDelimiter(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsCsiParamValue(const wchar_t wch)
+constexpr bool StateMachine::s_IsCsiParamValue(const wchar_t wch) noexcept
 {
     return wch >= L'0' && wch <= L'9'; // 0x30 - 0x39
 }
@@ -174,7 +322,7 @@ bool StateMachine::s_IsCsiParamValue(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsCsiPrivateMarker(const wchar_t wch)
+constexpr bool StateMachine::s_IsCsiPrivateMarker(const wchar_t wch) noexcept
 {
     return wch == L'<' || wch == L'=' || wch == L'>' || wch == L'?'; // 0x3C - 0x3F
 }
@@ -185,7 +333,7 @@ bool StateMachine::s_IsCsiPrivateMarker(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsCsiInvalid(const wchar_t wch)
+constexpr bool StateMachine::s_IsCsiInvalid(const wchar_t wch) noexcept
 {
     return wch == L':'; // 0x3A
 }
@@ -199,11 +347,84 @@ bool StateMachine::s_IsCsiInvalid(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsSs3Indicator(const wchar_t wch)
+constexpr bool StateMachine::s_IsSs3Indicator(const wchar_t wch) noexcept
 {
     return wch == L'O'; // 0x4F
 }
 
+// Routine Description:
+// - Decodes the UTF-8 encoded character at the start of a byte range.
+//   Ill-formed input decodes to U+FFFD, one replacement for each maximal
+//      subpart of a character, the same way MultiByteToWideChar does.
+// Arguments:
+// - pb - Start of the bytes to decode.
+// - pbEnd - End of the bytes we have.
+// - ch - Receives the decoded code point.
+// Return Value:
+// - The number of bytes consumed, or 0 if the range ends part way through
+//      an otherwise valid character.
+size_t StateMachine::s_DecodeUtf8(const unsigned char* const pb, const unsigned char* const pbEnd, char32_t& ch) noexcept
+{
+    const unsigned char bLead = pb[0];
+    if (bLead < 0x80)
+    {
+        ch = bLead;
+        return 1;
+    }
+
+    size_t cbChar;
+    char32_t value;
+    // The first continuation byte is further restricted for some lead bytes, to
+    //      rule out overlong encodings, surrogates and values past U+10FFFF.
+    unsigned char bMin = 0x80;
+    unsigned char bMax = 0xBF;
+    if (bLead >= 0xC2 && bLead <= 0xDF)
+    {
+        cbChar = 2;
+        value = bLead & 0x1F;
+    }
+    else if (bLead >= 0xE0 && bLead <= 0xEF)
+    {
+        cbChar = 3;
+        value = bLead & 0x0F;
+        bMin = (bLead == 0xE0) ? 0xA0 : bMin;
+        bMax = (bLead == 0xED) ? 0x9F : bMax;
+    }
+    else if (bLead >= 0xF0 && bLead <= 0xF4)
+    {
+        cbChar = 4;
+        value = bLead & 0x07;
+        bMin = (bLead == 0xF0) ? 0x90 : bMin;
+        bMax = (bLead == 0xF4) ? 0x8F : bMax;
+    }
+    else
+    {
+        ch = UNICODE_REPLACEMENT;
+        return 1;
+    }
+
+    for (size_t i = 1; i < cbChar; i++)
+    {
+        if (pb + i >= pbEnd)
+        {
+            return 0;
+        }
+
+        const unsigned char b = pb[i];
+        if (b < bMin || b > bMax)
+        {
+            ch = UNICODE_REPLACEMENT;
+            return i;
+        }
+        bMin = 0x80;
+        bMax = 0xBF;
+        value = (value << 6) | (b & 0x3F);
+    }
+
+    ch = value;
+    return cbChar;
+}
+
 // Routine Description:
 // - Determines if a character is a "Single Shift Select" indicator.
 //   This immediately follows an escape and signifies a varying length control string.
@@ -211,7 +432,7 @@ bool StateMachine::s_IsSs3Indicator(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsOscIndicator(const wchar_t wch)
+constexpr bool StateMachine::s_IsOscIndicator(const wchar_t wch) noexcept
 {
     return wch == L']'; // 0x5D
 }
@@ -224,7 +445,7 @@ bool StateMachine::s_IsOscIndicator(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsOscDelimiter(const wchar_t wch)
+constexpr bool StateMachine::s_IsOscDelimiter(const wchar_t wch) noexcept
 {
     return wch == L';'; // 0x3B
 }
@@ -237,7 +458,7 @@ bool StateMachine::s_IsOscDelimiter(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsOscParamValue(const wchar_t wch)
+constexpr bool StateMachine::s_IsOscParamValue(const wchar_t wch) noexcept
 {
     return s_IsNumber(wch); // 0x30 - 0x39
 }
@@ -248,7 +469,7 @@ bool StateMachine::s_IsOscParamValue(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsOscTerminationInitiator(const wchar_t wch)
+constexpr bool StateMachine::s_IsOscTerminationInitiator(const wchar_t wch) noexcept
 {
     return wch == AsciiChars::ESC;
 }
@@ -259,7 +480,7 @@ bool StateMachine::s_IsOscTerminationInitiator(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsOscInvalid(const wchar_t wch)
+constexpr bool StateMachine::s_IsOscInvalid(const wchar_t wch) noexcept
 {
     return wch <= L'\x17' ||
            wch == L'\x19' ||
@@ -273,7 +494,7 @@ bool StateMachine::s_IsOscInvalid(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsOscTerminator(const wchar_t wch)
+constexpr bool StateMachine::s_IsOscTerminator(const wchar_t wch) noexcept
 {
     return wch == L'\x7' || wch == L'\x9C'; // Bell character or C1 terminator
 }
@@ -284,7 +505,7 @@ bool StateMachine::s_IsOscTerminator(const wchar_t wch)
 // - wch - Character to check.
 // Return Value:
 // - True if it is. False if it isn't.
-bool StateMachine::s_IsNumber(const wchar_t wch)
+constexpr bool StateMachine::s_IsNumber(const wchar_t wch) noexcept
 {
     return wch >= L'0' && wch <= L'9'; // 0x30 - 0x39
 }
@@ -298,8 +519,14 @@ bool StateMachine::s_IsNumber(const wchar_t wch)
 void StateMachine::_ActionExecute(const wchar_t wch)
 {
     _trace.TraceOnExecute(wch);
-    _pEngine->ActionExecute(wch);
-
+    if (_fBatching)
+    {
+        _batch.AddExecute(wch);
+    }
+    else
+    {
+        _pEngine->ActionExecute(wch);
+    }
 }
 
 // Routine Description:
@@ -313,8 +540,14 @@ void StateMachine::_ActionExecute(const wchar_t wch)
 void StateMachine::_ActionExecuteFromEscape(const wchar_t wch)
 {
     _trace.TraceOnExecuteFromEscape(wch);
-    _pEngine->ActionExecuteFromEscape(wch);
-
+    if (_fBatching)
+    {
+        _batch.AddExecuteFromEscape(wch);
+    }
+    else
+    {
+        _pEngine->ActionExecuteFromEscape(wch);
+    }
 }
 
 // Routine Description:
@@ -326,7 +559,34 @@ void StateMachine::_ActionExecuteFromEscape(const wchar_t wch)
 void StateMachine::_ActionPrint(const wchar_t wch)
 {
     _trace.TraceOnAction(L"Print");
-    _pEngine->ActionPrint(wch);
+    if (_fBatching)
+    {
+        _batch.AddPrint(wch);
+    }
+    else
+    {
+        _pEngine->ActionPrint(wch);
+    }
+}
+
+// Routine Description:
+// - Triggers the PrintString action to indicate that the listener should render the run of characters given.
+// Arguments:
+// - rgwch - Run of characters to dispatch. In batching mode, this must remain valid until the batch is dispatched.
+// - cch - Count of characters in the run.
+// Return Value:
+// - <none>
+void StateMachine::_ActionPrintString(const wchar_t* const rgwch, const size_t cch)
+{
+    if (_fBatching)
+    {
+        _batch.AddPrintString(rgwch, cch);
+    }
+    else
+    {
+        _pEngine->ActionPrintString(rgwch, cch);
+    }
+    _trace.DispatchPrintRunTrace(rgwch, cch);
 }
 
 
@@ -341,6 +601,12 @@ void StateMachine::_ActionEscDispatch(const wchar_t wch)
 {
     _trace.TraceOnAction(L"EscDispatch");
 
+    if (_fBatching)
+    {
+        _batch.AddEscDispatch(wch, _cIntermediate, _wchIntermediate);
+        return;
+    }
+
     bool fSuccess = _pEngine->ActionEscDispatch(wch, _cIntermediate, _wchIntermediate);
 
     // Trace the result.
@@ -364,7 +630,13 @@ void StateMachine::_ActionCsiDispatch(const wchar_t wch)
 {
     _trace.TraceOnAction(L"CsiDispatch");
 
-    bool fSuccess = _pEngine->ActionCsiDispatch(wch, _cIntermediate, _wchIntermediate, _rgusParams, _cParams);
+    if (_fBatching)
+    {
+        _batch.AddCsiDispatch(wch, _cIntermediate, _wchIntermediate, _params.data(), static_cast<unsigned short>(_params.size()));
+        return;
+    }
+
+    bool fSuccess = _pEngine->ActionCsiDispatch(wch, _cIntermediate, _wchIntermediate, _params.data(), static_cast<unsigned short>(_params.size()));
 
     // Trace the result.
     _trace.DispatchSequenceTrace(fSuccess);
@@ -406,15 +678,14 @@ void StateMachine::_ActionParam(const wchar_t wch)
 {
     _trace.TraceOnAction(L"Param");
 
-    // Verify both the count and that the pointer didn't run off the end of the
-    //      array. If we're past the end, this param is just ignored.
-    if (_cParams <= s_cParamsMax && _pusActiveParam < &_rgusParams[s_cParamsMax])
+    // If we've already run past the cap on params, this param is just ignored.
+    if (!_fParamsOverflowed)
     {
         // If we're adding a character to the first parameter,
         //      then we now have one parameter.
-        if (_iParamAccumulatePos == 0 && _cParams == 0)
+        if (_params.empty())
         {
-            _cParams++;
+            _params.push_back(0);
         }
 
         // On a delimiter, increase the number of params we've seen.
@@ -422,25 +693,21 @@ void StateMachine::_ActionParam(const wchar_t wch)
         //      eg "\x1b[0;;m" should be three "0" params
         if (wch == L';')
         {
-            // Move to next param.
-            //      If we're on the last param (_cParams == s_cParamsMax),
-            //      then _pusActiveParam will now be past the end of _rgusParams,
-            //      and any future params will be ignored.
-            _pusActiveParam++;
-
             // clear out the accumulator count to prepare for the next one
             _iParamAccumulatePos = 0;
 
-            // Don't increment the _cParams to be greater than s_cParamsMax.
-            //      We're using _pusActiveParam to make sure we don't fill too
-            //      many params.
-            if (_cParams < s_cParamsMax)
+            // Move to next param.
+            //      If we're already at the cap, then this param and any
+            //      future ones will be ignored.
+            if (!_params.push_back(0))
             {
-                _cParams++;
+                _fParamsOverflowed = true;
             }
         }
         else
         {
+            unsigned short& usActiveParam = _params.back();
+
             // don't bother accumulating if we're storing more than 4 digits (since we're putting it into a short)
             if (_iParamAccumulatePos < 5)
             {
@@ -448,22 +715,22 @@ void StateMachine::_ActionParam(const wchar_t wch)
                 unsigned short const usDigit = wch - L'0'; // convert character into value
 
                 // multiply existing values by 10 to make space in the 1s digit
-                *_pusActiveParam *= 10;
+                usActiveParam *= 10;
 
                 // mark that we've now stored another digit.
                 _iParamAccumulatePos++;
 
                 // store the digit in the 1s place.
-                *_pusActiveParam += usDigit;
+                usActiveParam += usDigit;
 
-                if (*_pusActiveParam > SHORT_MAX)
+                if (usActiveParam > SHORT_MAX)
                 {
-                    *_pusActiveParam = SHORT_MAX;
+                    usActiveParam = SHORT_MAX;
                 }
             }
             else
             {
-                *_pusActiveParam = SHORT_MAX;
+                usActiveParam = SHORT_MAX;
             }
         }
     }
@@ -483,17 +750,13 @@ void StateMachine::_ActionClear()
     _wchIntermediate = 0;
     _cIntermediate = 0;
 
-    for (unsigned short i = 0; i < s_cParamsMax; i++)
-    {
-        _rgusParams[i] = 0;
-    }
-
-    _cParams = 0;
+    // Params are zeroed as they're added, so there's no need to clear the old values.
+    _params.clear();
+    _fParamsOverflowed = false;
     _iParamAccumulatePos = 0;
-    _pusActiveParam = _rgusParams; // set pointer back to beginning of array
 
     _sOscParam = 0;
-    _sOscNextChar = 0;
+    _oscString.clear();
 
     _pEngine->ActionClear();
 
@@ -557,14 +820,8 @@ void StateMachine::_ActionOscPut(const wchar_t wch)
 {
     _trace.TraceOnAction(L"OscPut");
 
-    // if we're past the end, this param is just ignored.
-    // need to leave one char for \0 at end
-    if (_sOscNextChar < s_cOscStringMaxLength - 1)
-    {
-        _pwchOscStringBuffer[_sOscNextChar] = wch;
-        _sOscNextChar++;
-        //we'll place the null at the end of the string when we send the actual action.
-    }
+    // If we're already at the cap, this char is just ignored.
+    _oscString.push_back(wch);
 }
 
 // Routine Description:
@@ -578,7 +835,13 @@ void StateMachine::_ActionOscDispatch(const wchar_t wch)
 {
     _trace.TraceOnAction(L"OscDispatch");
 
-    bool fSuccess = _pEngine->ActionOscDispatch(wch, _sOscParam, _pwchOscStringBuffer, _sOscNextChar);
+    if (_fBatching)
+    {
+        _batch.AddOscDispatch(wch, _sOscParam, { _oscString.data(), _oscString.size() });
+        return;
+    }
+
+    bool fSuccess = _pEngine->ActionOscDispatch(wch, _sOscParam, { _oscString.data(), _oscString.size() });
 
     // Trace the result.
     _trace.DispatchSequenceTrace(fSuccess);
@@ -601,7 +864,13 @@ void StateMachine::_ActionSs3Dispatch(const wchar_t wch)
 {
     _trace.TraceOnAction(L"Ss3Dispatch");
 
-    bool fSuccess = _pEngine->ActionSs3Dispatch(wch, _rgusParams, _cParams);
+    if (_fBatching)
+    {
+        _batch.AddSs3Dispatch(wch, _params.data(), static_cast<unsigned short>(_params.size()));
+        return;
+    }
+
+    bool fSuccess = _pEngine->ActionSs3Dispatch(wch, _params.data(), static_cast<unsigned short>(_params.size()));
 
     // Trace the result.
     _trace.DispatchSequenceTrace(fSuccess);
@@ -613,6 +882,51 @@ void StateMachine::_ActionSs3Dispatch(const wchar_t wch)
     }
 }
 
+// Routine Description:
+// - Hands all of the actions recorded while processing a string to the engine
+//      in one call, then clears the batch for the next string.
+//   Failed dispatches within the batch are the engine's to log.
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+void StateMachine::_DispatchBatch()
+{
+    if (!_batch.Empty())
+    {
+        _pEngine->ActionDispatchBatch(_batch);
+    }
+    _batch.Clear();
+}
+
+// Routine Description:
+// - Feeds a character that isn't part of a print run to the state machine on
+//      behalf of ProcessUtf8, recording it as part of the current sequence so
+//      that FlushToTerminal has UTF-16 text to pass through.
+//   Engines that dispatch in batches never pass anything through, so we don't
+//      bother recording for them.
+// Arguments:
+// - wch - Character to process.
+// Return Value:
+// - <none>
+void StateMachine::_ProcessUtf8SequenceChar(const wchar_t wch)
+{
+    if (!_fBatching)
+    {
+        if (_state == VTStates::Ground)
+        {
+            _utf8Sequence.clear();
+        }
+
+        // If the sequence is longer than the cap, only its start gets recorded.
+        _utf8Sequence.push_back(wch);
+        _pwchSequenceStart = _utf8Sequence.data();
+        _pwchCurr = _pwchSequenceStart + _utf8Sequence.size() - 1;
+    }
+
+    ProcessCharacter(wch);
+}
+
 // Routine Description:
 // - Moves the state machine into the Ground state.
 //   This state is entered:
@@ -790,456 +1104,455 @@ void StateMachine::_EnterSs3Param()
 }
 
 // Routine Description:
-// - Processes a character event into an Action that occurs while in the Ground state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Handle a C1 Control Sequence Introducer
-//   3. Print all other characters
+// - Sorts a character into the class that decides which transition it causes.
+//   This is only evaluated at compile time, to build s_charClasses - at runtime,
+//   characters are classified with a single table lookup.
 // Arguments:
-// - wch - Character that triggered the event
+// - wch - Character to classify.
 // Return Value:
-// - <none>
-void StateMachine::_EventGround(const wchar_t wch)
+// - The class of the character.
+constexpr StateMachine::CharClasses StateMachine::s_ClassifyChar(const wchar_t wch) noexcept
 {
-    _trace.TraceOnEvent(L"Ground");
-    if (s_IsC0Code(wch) || s_IsDelete(wch))
-    {
-        _ActionExecute(wch);
-    }
-    else if (s_IsC1Csi(wch))
+    if (wch == AsciiChars::BEL)
     {
-        _EnterCsiEntry();
+        return CharClasses::Bell;
     }
-    else
+    else if (wch == AsciiChars::CAN || wch == AsciiChars::SUB)
     {
-        _ActionPrint(wch);
+        return CharClasses::CancelOrSubstitute;
     }
-}
-
-// Routine Description:
-// - Processes a character event into an Action that occurs while in the Escape state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Collect Intermediate characters
-//   4. Enter Control Sequence state
-//   5. Dispatch an Escape action.
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventEscape(const wchar_t wch)
-{
-    _trace.TraceOnEvent(L"Escape");
-    if (s_IsC0Code(wch))
+    else if (s_IsEscape(wch))
     {
-        if (_pEngine->DispatchControlCharsFromEscape())
-        {
-            _ActionExecuteFromEscape(wch);
-            _EnterGround();
-        }
-        else
-        {
-            _ActionExecute(wch);
-        }
+        return CharClasses::Escape;
     }
-    else if (s_IsDelete(wch))
+    else if (s_IsC0Code(wch))
     {
-        _ActionIgnore();
+        return CharClasses::C0;
     }
     else if (s_IsIntermediate(wch))
     {
-        _ActionCollect(wch);
-        _EnterEscapeIntermediate();
-    }
-    else if (s_IsCsiIndicator(wch))
-    {
-        _EnterCsiEntry();
+        return CharClasses::Intermediate;
     }
-    else if (s_IsOscIndicator(wch))
-    {
-        _EnterOscParam();
-    }
-    else if (s_IsSs3Indicator(wch))
+    else if (s_IsNumber(wch))
     {
-        _EnterSs3Entry();
+        return CharClasses::Digit;
     }
-    else
+    else if (s_IsCsiInvalid(wch))
     {
-        _ActionEscDispatch(wch);
-        _EnterGround();
+        return CharClasses::Colon;
     }
-}
-
-// Routine Description:
-// - Processes a character event into an Action that occurs while in the EscapeIntermediate state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Collect Intermediate characters
-//   4. Dispatch an Escape action.
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventEscapeIntermediate(const wchar_t wch)
-{
-    _trace.TraceOnEvent(L"EscapeIntermediate");
-    if (s_IsC0Code(wch))
+    else if (s_IsCsiDelimiter(wch))
     {
-        _ActionExecute(wch);
+        return CharClasses::Semicolon;
     }
-    else if (s_IsIntermediate(wch))
+    else if (s_IsCsiPrivateMarker(wch))
     {
-        _ActionCollect(wch);
+        return CharClasses::PrivateMarker;
     }
-    else if (s_IsDelete(wch))
+    else if (s_IsCsiIndicator(wch))
     {
-        _ActionIgnore();
+        return CharClasses::CsiIndicator;
     }
-    else
+    else if (s_IsOscIndicator(wch))
     {
-        _ActionEscDispatch(wch);
-        _EnterGround();
+        return CharClasses::OscIndicator;
     }
-}
-
-// Routine Description:
-// - Processes a character event into an Action that occurs while in the CsiEntry state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Collect Intermediate characters
-//   4. Begin to ignore all remaining parameters when an invalid character is detected (CsiIgnore)
-//   5. Store parameter data
-//   6. Collect Control Sequence Private markers
-//   7. Dispatch a control sequence with parameters for action
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventCsiEntry(const wchar_t wch)
-{
-    _trace.TraceOnEvent(L"CsiEntry");
-    if (s_IsC0Code(wch))
+    else if (s_IsSs3Indicator(wch))
     {
-        _ActionExecute(wch);
+        return CharClasses::Ss3Indicator;
     }
     else if (s_IsDelete(wch))
     {
-        _ActionIgnore();
-    }
-    else if (s_IsIntermediate(wch))
-    {
-        _ActionCollect(wch);
-        _EnterCsiIntermediate();
-    }
-    else if (s_IsCsiInvalid(wch))
-    {
-        _EnterCsiIgnore();
-    }
-    else if (s_IsCsiParamValue(wch) || s_IsCsiDelimiter(wch))
-    {
-        _ActionParam(wch);
-        _EnterCsiParam();
+        return CharClasses::Delete;
     }
-    else if (s_IsCsiPrivateMarker(wch))
+    else if (s_IsC1Csi(wch))
     {
-        _ActionCollect(wch);
-        _EnterCsiParam();
+        return CharClasses::C1Csi;
     }
-    else
+    else if (s_IsOscTerminator(wch))
     {
-        _ActionCsiDispatch(wch);
-        _EnterGround();
+        return CharClasses::C1StringTerminator;
     }
+    return CharClasses::Other;
 }
 
 // Routine Description:
-// - Processes a character event into an Action that occurs while in the CsiIntermediate state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Collect Intermediate characters
-//   4. Begin to ignore all remaining parameters when an invalid character is detected (CsiIgnore)
-//   5. Dispatch a control sequence with parameters for action
+// - Decides what a character of the given class does in the given state.
+//   These are the rules from the state diagram at http://vt100.net/emu/dec_ansi_parser.
+//   This is only evaluated at compile time, to build s_transitions.
 // Arguments:
-// - wch - Character that triggered the event
+// - state - The state the character arrives in.
+// - charClass - The class of the character.
 // Return Value:
-// - <none>
-void StateMachine::_EventCsiIntermediate(const wchar_t wch)
+// - The action to take, and the state to enter afterwards (if any).
+constexpr StateMachine::Transition StateMachine::s_ComputeTransition(const VTStates state, const CharClasses charClass) noexcept
 {
-    _trace.TraceOnEvent(L"CsiIntermediate");
-    if (s_IsC0Code(wch))
-    {
-        _ActionExecute(wch);
-    }
-    else if (s_IsIntermediate(wch))
-    {
-        _ActionCollect(wch);
-    }
-    else if (s_IsDelete(wch))
-    {
-        _ActionIgnore();
-    }
-    else if (s_IsCsiParamValue(wch) || s_IsCsiInvalid(wch) || s_IsCsiDelimiter(wch) || s_IsCsiPrivateMarker(wch))
+    const Transition stay = { Actions::None, false, state };
+
+    // Process "from anywhere" events first.
+    if (charClass == CharClasses::CancelOrSubstitute)
     {
-        _EnterCsiIgnore();
+        return { Actions::Execute, true, VTStates::Ground };
     }
-    else
+    else if (charClass == CharClasses::Escape)
     {
-        _ActionCsiDispatch(wch);
-        _EnterGround();
+        // Don't go to escape from the OSC string state - ESC can be used to
+        //      terminate OSC strings.
+        return { Actions::None, true, state == VTStates::OscString ? VTStates::OscTermination : VTStates::Escape };
     }
-}
 
-// Routine Description:
-// - Processes a character event into an Action that occurs while in the CsiIgnore state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Collect Intermediate characters
-//   4. Begin to ignore all remaining parameters when an invalid character is detected (CsiIgnore)
-//   5. Return to Ground
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventCsiIgnore(const wchar_t wch)
-{
-    _trace.TraceOnEvent(L"CsiIgnore");
-    if (s_IsC0Code(wch))
+    // C0 controls (including BEL, outside of OSC sequences) are executed in place everywhere but the OSC states.
+    const bool fControl = charClass == CharClasses::C0 || charClass == CharClasses::Bell;
+    const bool fParam = charClass == CharClasses::Digit || charClass == CharClasses::Semicolon;
+
+    switch (state)
     {
-        _ActionExecute(wch);
-    }
-    else if (s_IsDelete(wch))
-    {
-        _ActionIgnore();
-    }
-    else if (s_IsIntermediate(wch))
-    {
-        _ActionIgnore();
-    }
-    else if (s_IsCsiParamValue(wch) || s_IsCsiInvalid(wch) || s_IsCsiDelimiter(wch) || s_IsCsiPrivateMarker(wch))
-    {
-        _ActionIgnore();
-    }
-    else
-    {
-        _EnterGround();
-    }
-}
+    case VTStates::Ground:
+        if (fControl || charClass == CharClasses::Delete)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::C1Csi)
+        {
+            return { Actions::None, true, VTStates::CsiEntry };
+        }
+        return { Actions::Print, false, state };
 
-// Routine Description:
-// - Processes a character event into an Action that occurs while in the CsiParam state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Collect Intermediate characters
-//   4. Begin to ignore all remaining parameters when an invalid character is detected (CsiIgnore)
-//   5. Store parameter data
-//   6. Dispatch a control sequence with parameters for action
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventCsiParam(const wchar_t wch)
-{
-    _trace.TraceOnEvent(L"CsiParam");
-    if (s_IsC0Code(wch))
-    {
-        _ActionExecute(wch);
-    }
-    else if (s_IsDelete(wch))
-    {
-        _ActionIgnore();
-    }
-    else if (s_IsCsiParamValue(wch) || s_IsCsiDelimiter(wch))
-    {
-        _ActionParam(wch);
-    }
-    else if (s_IsIntermediate(wch))
-    {
-        _ActionCollect(wch);
-        _EnterCsiIntermediate();
-    }
-    else if (s_IsCsiInvalid(wch) || s_IsCsiPrivateMarker(wch))
-    {
-        _EnterCsiIgnore();
-    }
-    else
-    {
-        _ActionCsiDispatch(wch);
-        _EnterGround();
+    case VTStates::Escape:
+        if (fControl)
+        {
+            return { Actions::ExecuteFromEscape, true, VTStates::Ground };
+        }
+        else if (charClass == CharClasses::Delete)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        else if (charClass == CharClasses::Intermediate)
+        {
+            return { Actions::Collect, true, VTStates::EscapeIntermediate };
+        }
+        else if (charClass == CharClasses::CsiIndicator)
+        {
+            return { Actions::None, true, VTStates::CsiEntry };
+        }
+        else if (charClass == CharClasses::OscIndicator)
+        {
+            return { Actions::None, true, VTStates::OscParam };
+        }
+        else if (charClass == CharClasses::Ss3Indicator)
+        {
+            return { Actions::None, true, VTStates::Ss3Entry };
+        }
+        return { Actions::EscDispatch, true, VTStates::Ground };
+
+    case VTStates::EscapeIntermediate:
+        if (fControl)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::Intermediate)
+        {
+            return { Actions::Collect, false, state };
+        }
+        else if (charClass == CharClasses::Delete)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        return { Actions::EscDispatch, true, VTStates::Ground };
+
+    case VTStates::CsiEntry:
+        if (fControl)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::Delete)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        else if (charClass == CharClasses::Intermediate)
+        {
+            return { Actions::Collect, true, VTStates::CsiIntermediate };
+        }
+        else if (charClass == CharClasses::Colon)
+        {
+            return { Actions::None, true, VTStates::CsiIgnore };
+        }
+        else if (fParam)
+        {
+            return { Actions::Param, true, VTStates::CsiParam };
+        }
+        else if (charClass == CharClasses::PrivateMarker)
+        {
+            return { Actions::Collect, true, VTStates::CsiParam };
+        }
+        return { Actions::CsiDispatch, true, VTStates::Ground };
+
+    case VTStates::CsiIntermediate:
+        if (fControl)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::Intermediate)
+        {
+            return { Actions::Collect, false, state };
+        }
+        else if (charClass == CharClasses::Delete)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        else if (fParam || charClass == CharClasses::Colon || charClass == CharClasses::PrivateMarker)
+        {
+            return { Actions::None, true, VTStates::CsiIgnore };
+        }
+        return { Actions::CsiDispatch, true, VTStates::Ground };
+
+    case VTStates::CsiIgnore:
+        if (fControl)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::Delete ||
+                 charClass == CharClasses::Intermediate ||
+                 fParam ||
+                 charClass == CharClasses::Colon ||
+                 charClass == CharClasses::PrivateMarker)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        return { Actions::None, true, VTStates::Ground };
+
+    case VTStates::CsiParam:
+        if (fControl)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::Delete)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        else if (fParam)
+        {
+            return { Actions::Param, false, state };
+        }
+        else if (charClass == CharClasses::Intermediate)
+        {
+            return { Actions::Collect, true, VTStates::CsiIntermediate };
+        }
+        else if (charClass == CharClasses::Colon || charClass == CharClasses::PrivateMarker)
+        {
+            return { Actions::None, true, VTStates::CsiIgnore };
+        }
+        return { Actions::CsiDispatch, true, VTStates::Ground };
+
+    case VTStates::OscParam:
+        if (charClass == CharClasses::Bell || charClass == CharClasses::C1StringTerminator)
+        {
+            return { Actions::None, true, VTStates::Ground };
+        }
+        else if (charClass == CharClasses::Digit)
+        {
+            return { Actions::OscParam, false, state };
+        }
+        else if (charClass == CharClasses::Semicolon)
+        {
+            return { Actions::None, true, VTStates::OscString };
+        }
+        return { Actions::Ignore, false, state };
+
+    case VTStates::OscString:
+        if (charClass == CharClasses::Bell || charClass == CharClasses::C1StringTerminator)
+        {
+            return { Actions::OscDispatch, true, VTStates::Ground };
+        }
+        else if (charClass == CharClasses::C0)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        // add this character to our OSC string
+        return { Actions::OscPut, false, state };
+
+    case VTStates::OscTermination:
+        return { Actions::OscDispatch, true, VTStates::Ground };
+
+    case VTStates::Ss3Entry:
+        if (fControl)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::Delete)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        else if (charClass == CharClasses::Colon)
+        {
+            // It's safe for us to go into the CSI ignore here, because both SS3 and
+            //      CSI sequences ignore characters the same way.
+            return { Actions::None, true, VTStates::CsiIgnore };
+        }
+        else if (fParam)
+        {
+            return { Actions::Param, true, VTStates::Ss3Param };
+        }
+        return { Actions::Ss3Dispatch, true, VTStates::Ground };
+
+    case VTStates::Ss3Param:
+        if (fControl)
+        {
+            return { Actions::Execute, false, state };
+        }
+        else if (charClass == CharClasses::Delete)
+        {
+            return { Actions::Ignore, false, state };
+        }
+        else if (fParam)
+        {
+            return { Actions::Param, false, state };
+        }
+        else if (charClass == CharClasses::Colon || charClass == CharClasses::PrivateMarker)
+        {
+            return { Actions::None, true, VTStates::CsiIgnore };
+        }
+        return { Actions::Ss3Dispatch, true, VTStates::Ground };
+
+    default:
+        return stay;
     }
 }
 
-// Routine Description:
-// - Processes a character event into an Action that occurs while in the OscParam state.
-//   Events in this state will:
-//   1. Collect numeric values into an Osc Param
-//   2. Move to the OscString state on a delimiter
-//   3. Ignore everything else.
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventOscParam(const wchar_t wch)
+constexpr std::array<StateMachine::CharClasses, StateMachine::s_wchFirstOther> StateMachine::s_BuildCharClassTable() noexcept
 {
-    _trace.TraceOnEvent(L"OscParam");
-    if (s_IsOscTerminator(wch))
-    {
-        _EnterGround();
-    }
-    else if (s_IsOscParamValue(wch))
-    {
-        _ActionOscParam(wch);
-    }
-    else if (s_IsOscDelimiter(wch))
+    std::array<CharClasses, s_wchFirstOther> table{};
+    for (size_t i = 0; i < table.size(); i++)
     {
-        _EnterOscString();
-    }
-    else
-    {
-        _ActionIgnore();
+        table[i] = s_ClassifyChar(static_cast<wchar_t>(i));
     }
+    return table;
 }
 
-// Routine Description:
-// - Processes a character event into a Action that occurs while in the OscParam state.
-//   Events in this state will:
-//   1. Trigger the OSC action associated with the param on an OscTerminator
-//   2. If we see a ESC, enter the OscTermination state. We'll wait for one
-//      more character before we dispatch the string.
-//   3. Ignore OscInvalid characters.
-//   4. Collect everything else into the OscString
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventOscString(const wchar_t wch)
+constexpr std::array<std::array<StateMachine::Transition, StateMachine::s_cCharClasses>, StateMachine::s_cStates> StateMachine::s_BuildTransitionTable() noexcept
 {
-    _trace.TraceOnEvent(L"OscString");
-    if (s_IsOscTerminator(wch))
-    {
-        _ActionOscDispatch(wch);
-        _EnterGround();
-    }
-    else if (s_IsOscTerminationInitiator(wch))
-    {
-        _EnterOscTermination();
-    }
-    else if (s_IsOscInvalid(wch))
-    {
-        _ActionIgnore();
-    }
-    else
+    std::array<std::array<Transition, s_cCharClasses>, s_cStates> table{};
+    for (size_t state = 0; state < s_cStates; state++)
     {
-        // add this character to our OSC string
-        _ActionOscPut(wch);
+        for (size_t charClass = 0; charClass < s_cCharClasses; charClass++)
+        {
+            table[state][charClass] = s_ComputeTransition(static_cast<VTStates>(state), static_cast<CharClasses>(charClass));
+        }
     }
+    return table;
 }
 
-// Routine Description:
-// - Handle the two-character termination of a OSC sequence.
-//   Events in this state will:
-//   1. Trigger the OSC action associated with the param on an OscTerminator
-// Arguments:
-// - wch - Character that triggered the event
-// Return Value:
-// - <none>
-void StateMachine::_EventOscTermination(const wchar_t wch)
-{
-    _trace.TraceOnEvent(L"OscTermination");
-
-    _ActionOscDispatch(wch);
-    _EnterGround();
-}
+// Both initializers are constant expressions, so these tables are built by the compiler - nothing here runs at startup.
+const std::array<StateMachine::CharClasses, StateMachine::s_wchFirstOther> StateMachine::s_charClasses = s_BuildCharClassTable();
+const std::array<std::array<StateMachine::Transition, StateMachine::s_cCharClasses>, StateMachine::s_cStates> StateMachine::s_transitions = s_BuildTransitionTable();
 
 // Routine Description:
-// - Processes a character event into an Action that occurs while in the Ss3Entry state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Begin to ignore all remaining parameters when an invalid character is detected (CsiIgnore)
-//   4. Store parameter data
-//   5. Dispatch a control sequence with parameters for action
-//  SS3 sequences are structurally the same as CSI sequences, just with a
-//      different initiation. It's safe to reuse CSI's functions for
-//      determining if a character is a parameter, delimiter, or invalid.
+// - Moves the state machine into the given state, running that state's entry actions.
 // Arguments:
-// - wch - Character that triggered the event
+// - state - The state to enter.
 // Return Value:
 // - <none>
-void StateMachine::_EventSs3Entry(const wchar_t wch)
-{
-    _trace.TraceOnEvent(L"Ss3Entry");
-    if (s_IsC0Code(wch))
-    {
-        _ActionExecute(wch);
-    }
-    else if (s_IsDelete(wch))
-    {
-        _ActionIgnore();
-    }
-    else if (s_IsCsiInvalid(wch))
-    {
-        // It's safe for us to go into the CSI ignore here, because both SS3 and
-        //      CSI sequences ignore characters the same way.
-        _EnterCsiIgnore();
-    }
-    else if (s_IsCsiParamValue(wch) || s_IsCsiDelimiter(wch))
-    {
-        _ActionParam(wch);
-        _EnterSs3Param();
-    }
-    else
-    {
-        _ActionSs3Dispatch(wch);
-        _EnterGround();
+void StateMachine::_EnterState(const VTStates state)
+{
+    switch (state)
+    {
+    case VTStates::Ground:
+        return _EnterGround();
+    case VTStates::Escape:
+        return _EnterEscape();
+    case VTStates::EscapeIntermediate:
+        return _EnterEscapeIntermediate();
+    case VTStates::CsiEntry:
+        return _EnterCsiEntry();
+    case VTStates::CsiIntermediate:
+        return _EnterCsiIntermediate();
+    case VTStates::CsiIgnore:
+        return _EnterCsiIgnore();
+    case VTStates::CsiParam:
+        return _EnterCsiParam();
+    case VTStates::OscParam:
+        return _EnterOscParam();
+    case VTStates::OscString:
+        return _EnterOscString();
+    case VTStates::OscTermination:
+        return _EnterOscTermination();
+    case VTStates::Ss3Entry:
+        return _EnterSs3Entry();
+    case VTStates::Ss3Param:
+        return _EnterSs3Param();
+    default:
+        return;
     }
 }
 
 // Routine Description:
-// - Processes a character event into an Action that occurs while in the CsiParam state.
-//   Events in this state will:
-//   1. Execute C0 control characters
-//   2. Ignore Delete characters
-//   3. Begin to ignore all remaining parameters when an invalid character is detected (CsiIgnore)
-//   4. Store parameter data
-//   5. Dispatch a control sequence with parameters for action
+// - Performs the action for a transition from the table, then enters the
+//      transition's new state, if it has one.
 // Arguments:
-// - wch - Character that triggered the event
+// - transition - The transition caused by wch.
+// - wch - The character that caused the transition.
 // Return Value:
 // - <none>
-void StateMachine::_EventSs3Param(const wchar_t wch)
+void StateMachine::_ExecuteTransition(const Transition transition, const wchar_t wch)
 {
-    _trace.TraceOnEvent(L"Ss3Param");
-    if (s_IsC0Code(wch))
+    switch (transition.action)
     {
+    case Actions::None:
+        break;
+    case Actions::Execute:
         _ActionExecute(wch);
-    }
-    else if (s_IsDelete(wch))
-    {
+        break;
+    case Actions::ExecuteFromEscape:
+        if (!_pEngine->DispatchControlCharsFromEscape())
+        {
+            // Execute the control char, but stay in the escape state.
+            return _ActionExecute(wch);
+        }
+        _ActionExecuteFromEscape(wch);
+        break;
+    case Actions::Print:
+        _ActionPrint(wch);
+        break;
+    case Actions::Ignore:
         _ActionIgnore();
-    }
-    else if (s_IsCsiParamValue(wch) || s_IsCsiDelimiter(wch))
-    {
+        break;
+    case Actions::Collect:
+        _ActionCollect(wch);
+        break;
+    case Actions::Param:
         _ActionParam(wch);
+        break;
+    case Actions::EscDispatch:
+        _ActionEscDispatch(wch);
+        break;
+    case Actions::CsiDispatch:
+        _ActionCsiDispatch(wch);
+        break;
+    case Actions::OscParam:
+        _ActionOscParam(wch);
+        break;
+    case Actions::OscPut:
+        _ActionOscPut(wch);
+        break;
+    case Actions::OscDispatch:
+        _ActionOscDispatch(wch);
+        break;
+    case Actions::Ss3Dispatch:
+        _ActionSs3Dispatch(wch);
+        break;
     }
-    else if (s_IsCsiInvalid(wch) || s_IsCsiPrivateMarker(wch))
-    {
-        _EnterCsiIgnore();
-    }
-    else
+
+    if (transition.fEnterState)
     {
-        _ActionSs3Dispatch(wch);
-        _EnterGround();
+        _EnterState(transition.state);
     }
 }
 
 // Routine Description:
 // - Entry to the state machine. Takes characters one by one and processes them according to the state machine rules.
+//   Every character is classified with one table lookup (everything from U+00A0
+//      up is printable, so needs no lookup at all), and the class and current
+//      state index straight into the precomputed transition table.
 // Arguments:
 // - wch - New character to operate upon
 // Return Value:
@@ -1248,53 +1561,10 @@ void StateMachine::ProcessCharacter(const wchar_t wch)
 {
     _trace.TraceCharInput(wch);
 
-    // Process "from anywhere" events first.
-    if (wch == AsciiChars::CAN ||
-        wch == AsciiChars::SUB)
-    {
-        _ActionExecute(wch);
-        _EnterGround();
-    }
-    else if (s_IsEscape(wch) && _state != VTStates::OscString)
-    {
-        // Don't go to escape from the OSC string state - ESC can be used to
-        //      terminate OSC strings.
-        _EnterEscape();
-    }
-    else
-    {
-        // Then pass to the current state as an event
-        switch (_state)
-        {
-        case VTStates::Ground:
-            return _EventGround(wch);
-        case VTStates::Escape:
-            return _EventEscape(wch);
-        case VTStates::EscapeIntermediate:
-            return _EventEscapeIntermediate(wch);
-        case VTStates::CsiEntry:
-            return _EventCsiEntry(wch);
-        case VTStates::CsiIntermediate:
-            return _EventCsiIntermediate(wch);
-        case VTStates::CsiIgnore:
-            return _EventCsiIgnore(wch);
-        case VTStates::CsiParam:
-            return _EventCsiParam(wch);
-        case VTStates::OscParam:
-            return _EventOscParam(wch);
-        case VTStates::OscString:
-            return _EventOscString(wch);
-        case VTStates::OscTermination:
-            return _EventOscTermination(wch);
-        case VTStates::Ss3Entry:
-            return _EventSs3Entry(wch);
-        case VTStates::Ss3Param:
-            return _EventSs3Param(wch);
-        default:
-            return;
-        }
-    }
+    const CharClasses charClass = wch < s_wchFirstOther ? s_charClasses[wch] : CharClasses::Other;
+    _ExecuteTransition(s_transitions[static_cast<size_t>(_state)][static_cast<size_t>(charClass)], wch);
 }
+
 // Method Description:
 // - Pass the current string we're processing through to the engine. It may eat
 //      the string, it may write it straight to the input unmodified, it might
@@ -1333,102 +1603,288 @@ void StateMachine::ProcessString(const wchar_t* const rgwch, const size_t cch)
     _pwchCurr = rgwch;
     _pwchSequenceStart = rgwch;
     _currRunLength = 0;
-
-    // This should be static, because if one string starts a sequence, and the next finishes it,
-    //   we want the partial sequence state to persist.
-    static bool s_fProcessIndividually = false;
-
-    for(size_t cchCharsRemaining = cch; cchCharsRemaining > 0; cchCharsRemaining--)
-    {
-        if (s_fProcessIndividually)
+    _utf8Sequence.clear();
+
+    const wchar_t* const pwchEnd = rgwch + cch;
+
+    // Engines that take their actions in batches get everything from this string in a single
+    //   call once we're done parsing it, rather than one virtual call per action. Engines that
+    //   need to flush partial sequences have to see them as they happen, so they can't batch.
+    _fBatching = _pEngine->DispatchActionsInBatches() && !_pEngine->FlushAtEndOfString();
+    _batch.Clear();
+    auto endBatching = wil::scope_exit([&]() noexcept {
+        _fBatching = false;
+        _batch.Clear();
+    });
+
+    while (_pwchCurr < pwchEnd)
+    {
+        // The partial sequence state lives entirely in _state (and the collected params), so if one
+        //   string starts a sequence and the next finishes it, we pick up right where we left off -
+        //   regardless of whether the sequence was started by ProcessString or ProcessCharacter.
+        if (_state != VTStates::Ground)
         {
-            // If we're processing characters individually, send it to the state machine.
+            // If we're in the middle of a sequence, send characters to the state machine individually.
             ProcessCharacter(*_pwchCurr);
             _pwchCurr++;
             if (_state == VTStates::Ground)  // Then check if we're back at ground. If we are, the next character (pwchCurr)
             {                                //   is the start of the next run of characters that might be printable.
-                s_fProcessIndividually = false;
                 _pwchSequenceStart = _pwchCurr;
                 _currRunLength = 0;
             }
         }
         else
         {
-            if (s_IsActionableFromGround(*_pwchCurr))  // If the current char is the start of an escape sequence, or should be executed in ground state...
+            // Skip over the whole printable run at once, and add it to the current run to be printed.
+            const wchar_t* const pwchActionable = s_FindActionableFromGround(_pwchCurr, pwchEnd);
+            _currRunLength += pwchActionable - _pwchCurr;
+            _pwchCurr = pwchActionable;
+
+            if (_pwchCurr < pwchEnd)  // If we stopped on the start of an escape sequence, or a char that should be executed in ground state...
             {
-                FAIL_FAST_IF(!(_pwchSequenceStart + _currRunLength <= rgwch + cch));
-                _pEngine->ActionPrintString(_pwchSequenceStart, _currRunLength); // ... print all the chars leading up to it as part of the run...
-                _trace.DispatchPrintRunTrace(_pwchSequenceStart, _currRunLength);
-                s_fProcessIndividually = true; // begin processing future characters individually...
+                FAIL_FAST_IF(!(_pwchSequenceStart + _currRunLength <= pwchEnd));
+                _ActionPrintString(_pwchSequenceStart, _currRunLength); // ... print all the chars leading up to it as part of the run...
                 _currRunLength = 0;
                 _pwchSequenceStart = _pwchCurr;
                 ProcessCharacter(*_pwchCurr); // ... Then process the character individually.
                 if (_state == VTStates::Ground)  // If the character took us right back to ground, start another run after it.
                 {
-                    s_fProcessIndividually = false;
                     _pwchSequenceStart = _pwchCurr + 1;
                     _currRunLength = 0;
                 }
+                _pwchCurr++;
             }
-            else
-            {
-                _currRunLength++; // Otherwise, add this char to the current run to be printed.
-            }
-            _pwchCurr++;
         }
     }
 
     // If we're at the end of the string and have remaining un-printed characters,
-    if (!s_fProcessIndividually && _currRunLength > 0)
+    if (_state == VTStates::Ground && _currRunLength > 0)
     {
         // print the rest of the characters in the string
-        _pEngine->ActionPrintString(_pwchSequenceStart, _currRunLength);
-        _trace.DispatchPrintRunTrace(_pwchSequenceStart, _currRunLength);
+        _ActionPrintString(_pwchSequenceStart, _currRunLength);
+    }
 
+    if (_fBatching)
+    {
+        _fBatching = false;
+        _DispatchBatch();
     }
-    else if (s_fProcessIndividually)
+
+    if (_state != VTStates::Ground)
     {
         if (_pEngine->FlushAtEndOfString())
         {
-            // Reset our state, and put all but the last char in again.
-            ResetState();
-            // Chars to flush are [pwchSequenceStart, pwchCurr)
-            const wchar_t* pwch = _pwchSequenceStart;
-            for (; pwch < _pwchCurr-1; pwch++)
+            _FlushPartialSequence();
+        }
+    }
+}
+
+// Routine Description:
+// - For engines that FlushAtEndOfString, finishes off the partial sequence a
+//     string ended in, by re-parsing it and dispatching it at its last character.
+//     The sequence is [_pwchSequenceStart, _pwchCurr).
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+void StateMachine::_FlushPartialSequence()
+{
+    // Reset our state, and put all but the last char in again.
+    ResetState();
+    // Chars to flush are [pwchSequenceStart, pwchCurr)
+    const wchar_t* pwch = _pwchSequenceStart;
+    for (; pwch < _pwchCurr-1; pwch++)
+    {
+        ProcessCharacter(*pwch);
+    }
+    // Manually execute the last char [pwchCurr]
+    switch (_state)
+    {
+    case VTStates::Ground:
+        return _ActionExecute(*pwch);
+    case VTStates::Escape:
+    case VTStates::EscapeIntermediate:
+        return _ActionEscDispatch(*pwch);
+    case VTStates::CsiEntry:
+    case VTStates::CsiIntermediate:
+    case VTStates::CsiIgnore:
+    case VTStates::CsiParam:
+        return _ActionCsiDispatch(*pwch);
+    case VTStates::OscParam:
+    case VTStates::OscString:
+    case VTStates::OscTermination:
+        return _ActionOscDispatch(*pwch);
+    case VTStates::Ss3Entry:
+    case VTStates::Ss3Param:
+        return _ActionSs3Dispatch(*pwch);
+    default:
+        return;
+    }
+}
+
+void StateMachine::ProcessString(const std::wstring& wstr)
+{
+    return ProcessString(wstr.c_str(), wstr.length());
+}
+
+// Routine Description:
+// - Entry point for UTF-8 encoded output. This works just like ProcessString,
+//     except that escape sequences are parsed straight off the bytes, and only
+//     the printable runs are transcoded to UTF-16 - into a buffer that's reused
+//     from call to call - so callers that receive UTF-8 don't have to convert
+//     all of it up front.
+//   A character split across two calls is held on to until the rest of it
+//     arrives. Ill-formed bytes are replaced with U+FFFD.
+// Arguments:
+// - rgch - Array of UTF-8 encoded bytes to operate upon
+// - cb - Count of bytes in array
+// Return Value:
+// - <none>
+void StateMachine::ProcessUtf8(const char* const rgch, const size_t cb)
+{
+    // Like ProcessString, a sequence left over from the last call only gets its text from this one recorded.
+    _utf8Sequence.clear();
+
+    _fBatching = _pEngine->DispatchActionsInBatches() && !_pEngine->FlushAtEndOfString();
+    _batch.Clear();
+    auto endBatching = wil::scope_exit([&]() noexcept {
+        _fBatching = false;
+        _batch.Clear();
+    });
+
+    // A write never transcodes to more UTF-16 units than it has bytes, plus
+    //   one for a character that was started at the end of the last write.
+    if (_utf8Text.size() < cb + 1)
+    {
+        _utf8Text.resize(cb + 1);
+    }
+    wchar_t* pwchRun = _utf8Text.data();
+    wchar_t* pwchRunEnd = pwchRun;
+
+    // Batched print runs have to stay valid until the batch is dispatched, so
+    //   the buffer is only reused once a run has been printed for real.
+    const auto printRun = [&]() {
+        if (pwchRunEnd > pwchRun)
+        {
+            _ActionPrintString(pwchRun, pwchRunEnd - pwchRun);
+            pwchRun = _fBatching ? pwchRunEnd : _utf8Text.data();
+            pwchRunEnd = pwchRun;
+        }
+    };
+
+    const auto processChar = [&](const char32_t ch) {
+        wchar_t rgwch[2];
+        size_t cwch = 1;
+        if (ch < 0x10000)
+        {
+            rgwch[0] = static_cast<wchar_t>(ch);
+        }
+        else
+        {
+            rgwch[0] = static_cast<wchar_t>(0xD800 + ((ch - 0x10000) >> 10));
+            rgwch[1] = static_cast<wchar_t>(0xDC00 + ((ch - 0x10000) & 0x3FF));
+            cwch = 2;
+        }
+
+        for (size_t i = 0; i < cwch; i++)
+        {
+            if (_state == VTStates::Ground && !s_IsActionableFromGround(rgwch[i]))
             {
-                ProcessCharacter(*pwch);
+                *pwchRunEnd++ = rgwch[i];
             }
-            // Manually execute the last char [pwchCurr]
-            switch (_state)
+            else
             {
-            case VTStates::Ground:
-                return _ActionExecute(*pwch);
-            case VTStates::Escape:
-            case VTStates::EscapeIntermediate:
-                return _ActionEscDispatch(*pwch);
-            case VTStates::CsiEntry:
-            case VTStates::CsiIntermediate:
-            case VTStates::CsiIgnore:
-            case VTStates::CsiParam:
-                return _ActionCsiDispatch(*pwch);
-            case VTStates::OscParam:
-            case VTStates::OscString:
-            case VTStates::OscTermination:
-                return _ActionOscDispatch(*pwch);
-            case VTStates::Ss3Entry:
-            case VTStates::Ss3Param:
-                return _ActionSs3Dispatch(*pwch);
-            default:
-                return;
+                printRun();
+                _ProcessUtf8SequenceChar(rgwch[i]);
             }
+        }
+    };
+
+    const unsigned char* pb = reinterpret_cast<const unsigned char*>(rgch);
+    const unsigned char* const pbEnd = pb + cb;
 
+    if (_cbUtf8Partial > 0)
+    {
+        // Top up the character that was cut off last time with whatever continuation bytes we've got...
+        while (_cbUtf8Partial < ARRAYSIZE(_rgbUtf8Partial) && pb < pbEnd && (*pb & 0xC0) == 0x80)
+        {
+            _rgbUtf8Partial[_cbUtf8Partial++] = *pb++;
+        }
+
+        // ... and decode it like any other.
+        const unsigned char* pbPartial = _rgbUtf8Partial;
+        const unsigned char* const pbPartialEnd = _rgbUtf8Partial + _cbUtf8Partial;
+        _cbUtf8Partial = 0;
+        while (pbPartial < pbPartialEnd)
+        {
+            char32_t ch;
+            size_t cbChar = s_DecodeUtf8(pbPartial, pbPartialEnd, ch);
+            if (cbChar == 0)
+            {
+                if (pb == pbEnd)
+                {
+                    // Still not all there. Keep waiting for the rest of it.
+                    _cbUtf8Partial = pbPartialEnd - pbPartial;
+                    std::memmove(_rgbUtf8Partial, pbPartial, _cbUtf8Partial);
+                    break;
+                }
+
+                // The next byte can't continue it, so the character was truncated.
+                ch = UNICODE_REPLACEMENT;
+                cbChar = pbPartialEnd - pbPartial;
+            }
+            processChar(ch);
+            pbPartial += cbChar;
         }
     }
-}
 
-void StateMachine::ProcessString(const std::wstring& wstr)
-{
-    return ProcessString(wstr.c_str(), wstr.length());
+    while (pb < pbEnd)
+    {
+        if (_state == VTStates::Ground)
+        {
+            // Printable ASCII is by far the most common output, so copy it across without decoding it.
+            while (pb < pbEnd && *pb >= AsciiChars::SPC && *pb < AsciiChars::DEL)
+            {
+                *pwchRunEnd++ = *pb++;
+            }
+
+            if (pb == pbEnd)
+            {
+                break;
+            }
+        }
+
+        char32_t ch;
+        const size_t cbChar = s_DecodeUtf8(pb, pbEnd, ch);
+        if (cbChar == 0)
+        {
+            // The write ends part way through a character. Hold on to what we've got until the next one.
+            _cbUtf8Partial = pbEnd - pb;
+            std::copy(pb, pbEnd, _rgbUtf8Partial);
+            break;
+        }
+        processChar(ch);
+        pb += cbChar;
+    }
+
+    // Print whatever run we were in the middle of when the bytes ran out.
+    printRun();
+
+    if (_fBatching)
+    {
+        _fBatching = false;
+        _DispatchBatch();
+    }
+
+    if (_state != VTStates::Ground && !_utf8Sequence.empty())
+    {
+        if (_pEngine->FlushAtEndOfString())
+        {
+            _pwchSequenceStart = _utf8Sequence.data();
+            _pwchCurr = _pwchSequenceStart + _utf8Sequence.size();
+            _FlushPartialSequence();
+        }
+    }
 }
 
 // Routine Description:
@@ -15,9 +15,12 @@ Abstract:
 #pragma once
 
 #include "IStateMachineEngine.hpp"
+#include "ParserBuffer.hpp"
 #include "telemetry.hpp"
 #include "tracing.hpp"
+#include <array>
 #include <memory>
+#include <vector>
 
 namespace Microsoft::Console::VirtualTerminal
 {
@@ -34,44 +37,132 @@ namespace Microsoft::Console::VirtualTerminal
         void ProcessCharacter(const wchar_t wch);
         void ProcessString(const wchar_t* const rgwch, const size_t cch);
         void ProcessString(const std::wstring& wstr);
+        void ProcessUtf8(const char* const rgch, const size_t cb);
 
         void ResetState();
 
         bool FlushToTerminal();
 
+        void SetSequenceLimits(const size_t cParamsMax, const size_t cchOscStringMax) noexcept;
+
         const IStateMachineEngine& Engine() const noexcept;
         IStateMachineEngine& Engine() noexcept;
 
         static const short s_cIntermediateMax = 1;
-        static const short s_cParamsMax = 16;
-        static const short s_cOscStringMaxLength = 256;
+
+        // Params and OSC strings up to these lengths are stored inline, without touching the heap.
+        static const size_t s_cParamsInline = 16;
+        static const size_t s_cchOscStringInline = 256;
+
+        // Anything past these (configurable) caps is dropped.
+        static const size_t s_cParamsDefaultMax = 1024;
+        static const size_t s_cchOscStringDefaultMax = 256 * 1024;
 
     private:
+        enum class VTStates
+        {
+            Ground,
+            Escape,
+            EscapeIntermediate,
+            CsiEntry,
+            CsiIntermediate,
+            CsiIgnore,
+            CsiParam,
+            OscParam,
+            OscString,
+            OscTermination,
+            Ss3Entry,
+            Ss3Param
+        };
+        static const size_t s_cStates = static_cast<size_t>(VTStates::Ss3Param) + 1;
+
+        // Every character is sorted into one of these classes before it's fed
+        //      to the transition table. Characters in the same class cause the
+        //      same transition from every state.
+        enum class CharClasses : unsigned char
+        {
+            C0, // Any C0 control not listed separately below.
+            Bell,
+            CancelOrSubstitute,
+            Escape,
+            Intermediate,
+            Digit,
+            Colon,
+            Semicolon,
+            PrivateMarker,
+            CsiIndicator,
+            OscIndicator,
+            Ss3Indicator,
+            Delete,
+            C1Csi,
+            C1StringTerminator,
+            Other
+        };
+        static const size_t s_cCharClasses = static_cast<size_t>(CharClasses::Other) + 1;
+
+        // Only the characters below this need a lookup to be classified. Everything from here up is CharClasses::Other.
+        static const wchar_t s_wchFirstOther = L'\xA0';
+
+        enum class Actions : unsigned char
+        {
+            None,
+            Execute,
+            ExecuteFromEscape, // Falls back to a plain Execute, staying in Escape, if the engine doesn't want it.
+            Print,
+            Ignore,
+            Collect,
+            Param,
+            EscDispatch,
+            CsiDispatch,
+            OscParam,
+            OscPut,
+            OscDispatch,
+            Ss3Dispatch
+        };
+
+        struct Transition
+        {
+            Actions action;
+            bool fEnterState;
+            VTStates state; // The state to enter after the action, if fEnterState is set.
+        };
+
+        static constexpr CharClasses s_ClassifyChar(const wchar_t wch) noexcept;
+        static constexpr Transition s_ComputeTransition(const VTStates state, const CharClasses charClass) noexcept;
+        static constexpr std::array<CharClasses, s_wchFirstOther> s_BuildCharClassTable() noexcept;
+        static constexpr std::array<std::array<Transition, s_cCharClasses>, s_cStates> s_BuildTransitionTable() noexcept;
+
+        static const std::array<CharClasses, s_wchFirstOther> s_charClasses;
+        static const std::array<std::array<Transition, s_cCharClasses>, s_cStates> s_transitions;
+
         static bool s_IsActionableFromGround(const wchar_t wch);
-        static bool s_IsC0Code(const wchar_t wch);
-        static bool s_IsC1Csi(const wchar_t wch);
-        static bool s_IsIntermediate(const wchar_t wch);
-        static bool s_IsDelete(const wchar_t wch);
-        static bool s_IsEscape(const wchar_t wch);
-        static bool s_IsCsiIndicator(const wchar_t wch);
-        static bool s_IsCsiDelimiter(const wchar_t wch);
-        static bool s_IsCsiParamValue(const wchar_t wch);
-        static bool s_IsCsiPrivateMarker(const wchar_t wch);
-        static bool s_IsCsiInvalid(const wchar_t wch);
-        static bool s_IsOscIndicator(const wchar_t wch);
-        static bool s_IsOscDelimiter(const wchar_t wch);
-        static bool s_IsOscParamValue(const wchar_t wch);
-        static bool s_IsOscInvalid(const wchar_t wch);
-        static bool s_IsOscTerminator(const wchar_t wch);
-        static bool s_IsOscTerminationInitiator(const wchar_t wch);
+        static const wchar_t* s_FindActionableFromGround(const wchar_t* const pwchStart, const wchar_t* const pwchEnd) noexcept;
+        static constexpr bool s_IsC0Code(const wchar_t wch) noexcept;
+        static constexpr bool s_IsC1Csi(const wchar_t wch) noexcept;
+        static constexpr bool s_IsIntermediate(const wchar_t wch) noexcept;
+        static constexpr bool s_IsDelete(const wchar_t wch) noexcept;
+        static constexpr bool s_IsEscape(const wchar_t wch) noexcept;
+        static constexpr bool s_IsCsiIndicator(const wchar_t wch) noexcept;
+        static constexpr bool s_IsCsiDelimiter(const wchar_t wch) noexcept;
+        static constexpr bool s_IsCsiParamValue(const wchar_t wch) noexcept;
+        static constexpr bool s_IsCsiPrivateMarker(const wchar_t wch) noexcept;
+        static constexpr bool s_IsCsiInvalid(const wchar_t wch) noexcept;
+        static constexpr bool s_IsOscIndicator(const wchar_t wch) noexcept;
+        static constexpr bool s_IsOscDelimiter(const wchar_t wch) noexcept;
+        static constexpr bool s_IsOscParamValue(const wchar_t wch) noexcept;
+        static constexpr bool s_IsOscInvalid(const wchar_t wch) noexcept;
+        static constexpr bool s_IsOscTerminator(const wchar_t wch) noexcept;
+        static constexpr bool s_IsOscTerminationInitiator(const wchar_t wch) noexcept;
         static bool s_IsDesignateCharsetIndicator(const wchar_t wch);
         static bool s_IsCharsetCode(const wchar_t wch);
-        static bool s_IsNumber(const wchar_t wch);
-        static bool s_IsSs3Indicator(const wchar_t wch);
+        static constexpr bool s_IsNumber(const wchar_t wch) noexcept;
+        static constexpr bool s_IsSs3Indicator(const wchar_t wch) noexcept;
+        static size_t s_DecodeUtf8(const unsigned char* const pb, const unsigned char* const pbEnd, char32_t& ch) noexcept;
 
         void _ActionExecute(const wchar_t wch);
         void _ActionExecuteFromEscape(const wchar_t wch);
         void _ActionPrint(const wchar_t wch);
+        void _ActionPrintString(const wchar_t* const rgwch, const size_t cch);
         void _ActionEscDispatch(const wchar_t wch);
         void _ActionCollect(const wchar_t wch);
         void _ActionParam(const wchar_t wch);
@@ -84,6 +175,10 @@ namespace Microsoft::Console::VirtualTerminal
         void _ActionClear();
         void _ActionIgnore();
 
+        void _DispatchBatch();
+        void _FlushPartialSequence();
+        void _ProcessUtf8SequenceChar(const wchar_t wch);
+
         void _EnterGround();
         void _EnterEscape();
         void _EnterEscapeIntermediate();
@@ -97,34 +192,8 @@ namespace Microsoft::Console::VirtualTerminal
         void _EnterSs3Entry();
         void _EnterSs3Param();
 
-        void _EventGround(const wchar_t wch);
-        void _EventEscape(const wchar_t wch);
-        void _EventEscapeIntermediate(const wchar_t wch);
-        void _EventCsiEntry(const wchar_t wch);
-        void _EventCsiIntermediate(const wchar_t wch);
-        void _EventCsiIgnore(const wchar_t wch);
-        void _EventCsiParam(const wchar_t wch);
-        void _EventOscParam(const wchar_t wch);
-        void _EventOscString(const wchar_t wch);
-        void _EventOscTermination(const wchar_t wch);
-        void _EventSs3Entry(const wchar_t wch);
-        void _EventSs3Param(const wchar_t wch);
-
-        enum class VTStates
-        {
-            Ground,
-            Escape,
-            EscapeIntermediate,
-            CsiEntry,
-            CsiIntermediate,
-            CsiIgnore,
-            CsiParam,
-            OscParam,
-            OscString,
-            OscTermination,
-            Ss3Entry,
-            Ss3Param
-        };
+        void _EnterState(const VTStates state);
+        void _ExecuteTransition(const Transition transition, const wchar_t wch);
 
         Microsoft::Console::VirtualTerminal::ParserTracing _trace;
 
@@ -135,14 +204,12 @@ namespace Microsoft::Console::VirtualTerminal
         wchar_t _wchIntermediate;
         unsigned short _cIntermediate;
 
-        unsigned short _rgusParams[s_cParamsMax];
-        unsigned short _cParams;
-        unsigned short* _pusActiveParam;
+        ParserBuffer<unsigned short, s_cParamsInline> _params;
+        bool _fParamsOverflowed;
         unsigned short _iParamAccumulatePos;
 
         unsigned short _sOscParam;
-        unsigned short _sOscNextChar;
-        wchar_t _pwchOscStringBuffer[s_cOscStringMaxLength];
+        ParserBuffer<wchar_t, s_cchOscStringInline> _oscString;
 
         // These members track out state in the parsing of a single string.
         // FlushToTerminal uses these, so that an engine can force a string
@@ -151,5 +218,19 @@ namespace Microsoft::Console::VirtualTerminal
         const wchar_t* _pwchSequenceStart;
         size_t _currRunLength;
 
+        // While processing a string for an engine that dispatches in batches,
+        //      actions are recorded here instead of being dispatched immediately.
+        ActionBatch _batch;
+        bool _fBatching;
+
+        // ProcessUtf8 transcodes print runs into this buffer. It's kept from call
+        //      to call, so it only grows until it fits the largest write we've seen.
+        std::vector<wchar_t> _utf8Text;
+        // There's no UTF-16 string to point _pwchSequenceStart into when we're
+        //      fed UTF-8, so the text of the current sequence is recorded here instead.
+        ParserBuffer<wchar_t, s_cchOscStringInline> _utf8Sequence;
+        // The start of a UTF-8 character that was cut off at the end of the last ProcessUtf8.
+        unsigned char _rgbUtf8Partial[4];
+        size_t _cbUtf8Partial;
     };
 }
@@ -3,7 +3,10 @@
 
 #include "precomp.h"
 #include <wextestclass.h>
+#include <chrono>
+#include <random>
 #include "../../inc/consoletaeftemplates.hpp"
+#include "../../inc/test/PerfTestHelper.hpp"
 
 #include "stateMachine.hpp"
 #include "OutputStateMachineEngine.hpp"
@@ -397,14 +400,68 @@ class Microsoft::Console::VirtualTerminal::OutputEngineTest final
         mach.ProcessCharacter(L'0');
         VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::OscParam);
         mach.ProcessCharacter(L';');
-        for (int i = 0; i < MAX_PATH; i++) // The buffer is only 256 long, so any longer value should work :P
+        const size_t cchLong = mach.s_cchOscStringInline * 8; // Well past the inline storage, so it has to spill.
+        for (size_t i = 0; i < cchLong; i++)
         {
             mach.ProcessCharacter(L's');
             VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::OscString);
         }
-        VERIFY_ARE_EQUAL(mach._sOscNextChar, mach.s_cOscStringMaxLength - 1);
+        VERIFY_ARE_EQUAL(mach._oscString.size(), cchLong);
         mach.ProcessCharacter(AsciiChars::BEL);
         VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::Ground);
+
+        Log::Comment(L"Make sure anything past the configured cap is dropped.");
+        const size_t cchMax = 32;
+        mach.SetSequenceLimits(mach.s_cParamsDefaultMax, cchMax);
+        mach.ProcessCharacter(AsciiChars::ESC);
+        mach.ProcessCharacter(L']');
+        mach.ProcessCharacter(L'0');
+        mach.ProcessCharacter(L';');
+        for (int i = 0; i < MAX_PATH; i++)
+        {
+            mach.ProcessCharacter(L's');
+            VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::OscString);
+        }
+        VERIFY_ARE_EQUAL(mach._oscString.size(), cchMax);
+        mach.ProcessCharacter(AsciiChars::BEL);
+        VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::Ground);
+    }
+
+    TEST_METHOD(TestLongCsiParams)
+    {
+        StateMachine mach(new OutputStateMachineEngine(new DummyDispatch));
+
+        mach.ProcessCharacter(AsciiChars::ESC);
+        mach.ProcessCharacter(L'[');
+        VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::CsiEntry);
+
+        const size_t cParams = mach.s_cParamsInline * 4;
+        for (size_t i = 0; i < cParams; i++)
+        {
+            if (i > 0)
+            {
+                mach.ProcessCharacter(L';');
+            }
+            mach.ProcessCharacter(L'0' + static_cast<wchar_t>(i % 10));
+            VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::CsiParam);
+        }
+        VERIFY_ARE_EQUAL(mach._params.size(), cParams);
+        for (size_t i = 0; i < cParams; i++)
+        {
+            VERIFY_ARE_EQUAL(mach._params.data()[i], static_cast<unsigned short>(i % 10));
+        }
+        mach.ProcessCharacter(L'm');
+        VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::Ground);
+
+        Log::Comment(L"Make sure params past the configured cap are ignored.");
+        const size_t cParamsMax = 4;
+        mach.SetSequenceLimits(cParamsMax, mach.s_cchOscStringDefaultMax);
+        mach.ProcessString(L"\x1b[1;2;3;4;5;6");
+        VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::CsiParam);
+        VERIFY_ARE_EQUAL(mach._params.size(), cParamsMax);
+        VERIFY_ARE_EQUAL(mach._params.data()[cParamsMax - 1], static_cast<unsigned short>(4));
+        mach.ProcessCharacter(L'm');
+        VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::Ground);
     }
 
     TEST_METHOD(NormalTestOscParam)
@@ -544,6 +601,136 @@ class Microsoft::Console::VirtualTerminal::OutputEngineTest final
         mach.ProcessCharacter(L'J');
         VERIFY_ARE_EQUAL(mach._state, StateMachine::VTStates::Ground);
     }
+
+    // The hand-written per-state event handlers that the transition table
+    //      replaced, transcribed as-is. The table is checked against these for
+    //      every character in every state.
+    static StateMachine::Transition s_ReferenceTransition(const StateMachine::VTStates state, const wchar_t wch)
+    {
+        using Actions = StateMachine::Actions;
+        using VTStates = StateMachine::VTStates;
+
+        const bool fC0 = wch <= L'\x17' || wch == L'\x19' || (wch >= L'\x1c' && wch <= L'\x1f');
+        const bool fDelete = wch == L'\x7f';
+        const bool fIntermediate = wch >= L' ' && wch <= L'/';
+        const bool fParamValue = wch >= L'0' && wch <= L'9';
+        const bool fDelimiter = wch == L';';
+        const bool fInvalid = wch == L':';
+        const bool fPrivateMarker = wch >= L'<' && wch <= L'?';
+        const bool fOscTerminator = wch == L'\x07' || wch == L'\x9c';
+
+        if (wch == AsciiChars::CAN || wch == AsciiChars::SUB)
+        {
+            return { Actions::Execute, true, VTStates::Ground };
+        }
+        else if (wch == AsciiChars::ESC && state != VTStates::OscString)
+        {
+            return { Actions::None, true, VTStates::Escape };
+        }
+
+        switch (state)
+        {
+        case VTStates::Ground:
+            if (fC0 || fDelete) return { Actions::Execute, false, state };
+            if (wch == L'\x9b') return { Actions::None, true, VTStates::CsiEntry };
+            return { Actions::Print, false, state };
+        case VTStates::Escape:
+            if (fC0) return { Actions::ExecuteFromEscape, true, VTStates::Ground };
+            if (fDelete) return { Actions::Ignore, false, state };
+            if (fIntermediate) return { Actions::Collect, true, VTStates::EscapeIntermediate };
+            if (wch == L'[') return { Actions::None, true, VTStates::CsiEntry };
+            if (wch == L']') return { Actions::None, true, VTStates::OscParam };
+            if (wch == L'O') return { Actions::None, true, VTStates::Ss3Entry };
+            return { Actions::EscDispatch, true, VTStates::Ground };
+        case VTStates::EscapeIntermediate:
+            if (fC0) return { Actions::Execute, false, state };
+            if (fIntermediate) return { Actions::Collect, false, state };
+            if (fDelete) return { Actions::Ignore, false, state };
+            return { Actions::EscDispatch, true, VTStates::Ground };
+        case VTStates::CsiEntry:
+            if (fC0) return { Actions::Execute, false, state };
+            if (fDelete) return { Actions::Ignore, false, state };
+            if (fIntermediate) return { Actions::Collect, true, VTStates::CsiIntermediate };
+            if (fInvalid) return { Actions::None, true, VTStates::CsiIgnore };
+            if (fParamValue || fDelimiter) return { Actions::Param, true, VTStates::CsiParam };
+            if (fPrivateMarker) return { Actions::Collect, true, VTStates::CsiParam };
+            return { Actions::CsiDispatch, true, VTStates::Ground };
+        case VTStates::CsiIntermediate:
+            if (fC0) return { Actions::Execute, false, state };
+            if (fIntermediate) return { Actions::Collect, false, state };
+            if (fDelete) return { Actions::Ignore, false, state };
+            if (fParamValue || fInvalid || fDelimiter || fPrivateMarker) return { Actions::None, true, VTStates::CsiIgnore };
+            return { Actions::CsiDispatch, true, VTStates::Ground };
+        case VTStates::CsiIgnore:
+            if (fC0) return { Actions::Execute, false, state };
+            if (fDelete || fIntermediate || fParamValue || fInvalid || fDelimiter || fPrivateMarker) return { Actions::Ignore, false, state };
+            return { Actions::None, true, VTStates::Ground };
+        case VTStates::CsiParam:
+            if (fC0) return { Actions::Execute, false, state };
+            if (fDelete) return { Actions::Ignore, false, state };
+            if (fParamValue || fDelimiter) return { Actions::Param, false, state };
+            if (fIntermediate) return { Actions::Collect, true, VTStates::CsiIntermediate };
+            if (fInvalid || fPrivateMarker) return { Actions::None, true, VTStates::CsiIgnore };
+            return { Actions::CsiDispatch, true, VTStates::Ground };
+        case VTStates::OscParam:
+            if (fOscTerminator) return { Actions::None, true, VTStates::Ground };
+            if (fParamValue) return { Actions::OscParam, false, state };
+            if (fDelimiter) return { Actions::None, true, VTStates::OscString };
+            return { Actions::Ignore, false, state };
+        case VTStates::OscString:
+            if (fOscTerminator) return { Actions::OscDispatch, true, VTStates::Ground };
+            if (wch == AsciiChars::ESC) return { Actions::None, true, VTStates::OscTermination };
+            if (fC0) return { Actions::Ignore, false, state };
+            return { Actions::OscPut, false, state };
+        case VTStates::OscTermination:
+            return { Actions::OscDispatch, true, VTStates::Ground };
+        case VTStates::Ss3Entry:
+            if (fC0) return { Actions::Execute, false, state };
+            if (fDelete) return { Actions::Ignore, false, state };
+            if (fInvalid) return { Actions::None, true, VTStates::CsiIgnore };
+            if (fParamValue || fDelimiter) return { Actions::Param, true, VTStates::Ss3Param };
+            return { Actions::Ss3Dispatch, true, VTStates::Ground };
+        case VTStates::Ss3Param:
+            if (fC0) return { Actions::Execute, false, state };
+            if (fDelete) return { Actions::Ignore, false, state };
+            if (fParamValue || fDelimiter) return { Actions::Param, false, state };
+            if (fInvalid || fPrivateMarker) return { Actions::None, true, VTStates::CsiIgnore };
+            return { Actions::Ss3Dispatch, true, VTStates::Ground };
+        default:
+            return { Actions::None, false, state };
+        }
+    }
+
+    TEST_METHOD(TestTransitionTableMatchesReference)
+    {
+        size_t cMismatches = 0;
+        for (size_t iState = 0; iState < StateMachine::s_cStates; iState++)
+        {
+            const auto state = static_cast<StateMachine::VTStates>(iState);
+            for (unsigned int ui = 0; ui <= std::numeric_limits<wchar_t>::max(); ui++)
+            {
+                const wchar_t wch = static_cast<wchar_t>(ui);
+                const auto charClass = wch < StateMachine::s_wchFirstOther ? StateMachine::s_charClasses[wch] : StateMachine::CharClasses::Other;
+                const auto actual = StateMachine::s_transitions[iState][static_cast<size_t>(charClass)];
+                const auto expected = s_ReferenceTransition(state, wch);
+
+                if (actual.action != expected.action ||
+                    actual.fEnterState != expected.fEnterState ||
+                    (expected.fEnterState && actual.state != expected.state))
+                {
+                    Log::Error(NoThrowString().Format(L"State %zu, char 0x%04x: expected action %d -> %d, got action %d -> %d",
+                                                      iState,
+                                                      ui,
+                                                      static_cast<int>(expected.action),
+                                                      expected.fEnterState ? static_cast<int>(expected.state) : -1,
+                                                      static_cast<int>(actual.action),
+                                                      actual.fEnterState ? static_cast<int>(actual.state) : -1));
+                    cMismatches++;
+                }
+            }
+        }
+        VERIFY_ARE_EQUAL(static_cast<size_t>(0), cMismatches);
+    }
 };
 
 class StatefulDispatch final : public TermDispatch
@@ -854,6 +1041,95 @@ public:
     size_t _cOptions;
 };
 
+class PrintRunDispatch final : public TermDispatch
+{
+public:
+    virtual void Execute(const wchar_t wchControl) override
+    {
+        _executed.push_back(wchControl);
+    }
+
+    virtual void Print(const wchar_t wchPrintable) override
+    {
+        _printed.push_back(wchPrintable);
+    }
+
+    virtual void PrintString(const wchar_t* const rgwch, const size_t cch) override
+    {
+        _printed.append(rgwch, cch);
+        _cPrintRuns++;
+    }
+
+    bool SetGraphicsRendition(_In_reads_(cOptions) const DispatchTypes::GraphicsOptions* const /*rgOptions*/, const size_t /*cOptions*/) override
+    {
+        return true;
+    }
+
+    void ClearState()
+    {
+        _printed.clear();
+        _executed.clear();
+        _cPrintRuns = 0;
+    }
+
+    std::wstring _printed;
+    std::wstring _executed;
+    size_t _cPrintRuns = 0;
+};
+
+class SessionRecordingDispatch final : public TermDispatch
+{
+public:
+    virtual void Execute(const wchar_t wchControl) override
+    {
+        _log.append(L"X");
+        _log.push_back(wchControl);
+    }
+
+    virtual void Print(const wchar_t wchPrintable) override
+    {
+        _log.push_back(wchPrintable);
+    }
+
+    virtual void PrintString(const wchar_t* const rgwch, const size_t cch) override
+    {
+        _log.append(rgwch, cch);
+    }
+
+    bool CursorPosition(_In_ unsigned int const uiLine, _In_ unsigned int const uiColumn) override
+    {
+        _log.append(L"[CUP:" + std::to_wstring(uiLine) + L"," + std::to_wstring(uiColumn) + L"]");
+        return true;
+    }
+
+    bool EraseInDisplay(const DispatchTypes::EraseType eraseType) override
+    {
+        _log.append(L"[ED:" + std::to_wstring(static_cast<unsigned int>(eraseType)) + L"]");
+        return true;
+    }
+
+    bool SetGraphicsRendition(_In_reads_(cOptions) const DispatchTypes::GraphicsOptions* const rgOptions, const size_t cOptions) override
+    {
+        _log.append(L"[SGR:");
+        for (size_t i = 0; i < cOptions; i++)
+        {
+            _log.append(std::to_wstring(static_cast<unsigned int>(rgOptions[i])) + L";");
+        }
+        _log.append(L"]");
+        return true;
+    }
+
+    bool SetWindowTitle(std::wstring_view title) override
+    {
+        _log.append(L"[TITLE:");
+        _log.append(title);
+        _log.append(L"]");
+        return true;
+    }
+
+    std::wstring _log;
+};
+
 class StateMachineExternalTest final
 {
     TEST_CLASS(StateMachineExternalTest);
@@ -1647,4 +1923,360 @@ class StateMachineExternalTest final
         pDispatch->ClearState();
 
     }
+
+    TEST_METHOD(TestGroundPrintRuns)
+    {
+        PrintRunDispatch* pDispatch = new PrintRunDispatch;
+        VERIFY_IS_NOT_NULL(pDispatch);
+        StateMachine mach(new OutputStateMachineEngine(pDispatch));
+
+        // Every character that is actionable from the ground state. These
+        //      must end a print run no matter where they land in a block.
+        const std::wstring actionable{ L'\x0', L'\x7', L'\x8', L'\x18', L'\x1f', L'\x7f', L'\x9b' };
+
+        // A mix of ASCII, the C1 range and some CJK, none of which end a run.
+        //      (No intermediates, so that a C1 CSI is always dispatched by the character after it.)
+        const std::wstring printable{ L"a~\x80\x9a\x9c\xa0\xff\x4e2d\xffff" };
+
+        Log::Comment(L"Place each actionable character at every offset of a string that spans several scan blocks.");
+        for (const auto wchActionable : actionable)
+        {
+            for (size_t offset = 0; offset < 69; offset++)
+            {
+                std::wstring str;
+                for (size_t i = 0; i < 70; i++)
+                {
+                    str.push_back(i == offset ? wchActionable : printable[i % printable.size()]);
+                }
+
+                pDispatch->ClearState();
+                mach.ProcessString(str);
+                mach.ResetState();
+
+                std::wstring expected = str.substr(0, offset);
+                if (wchActionable == L'\x9b')
+                {
+                    // C1 CSI enters a control sequence. The next printable character dispatches it.
+                    expected += str.substr(offset + 2);
+                }
+                else
+                {
+                    expected += str.substr(offset + 1);
+                }
+
+                if (wchActionable != L'\x9b')
+                {
+                    VERIFY_ARE_EQUAL(std::wstring(1, wchActionable), pDispatch->_executed);
+                }
+                VERIFY_ARE_EQUAL(expected, pDispatch->_printed);
+            }
+        }
+
+        Log::Comment(L"A string with nothing actionable should go to the engine as a single run.");
+        pDispatch->ClearState();
+        const std::wstring longRun(1000, L'x');
+        mach.ProcessString(longRun);
+        VERIFY_ARE_EQUAL(longRun, pDispatch->_printed);
+        VERIFY_ARE_EQUAL(static_cast<size_t>(1), pDispatch->_cPrintRuns);
+    }
+
+    static std::wstring _GenerateSessionStream(std::mt19937& engine, const size_t cchMinimum)
+    {
+        static const wchar_t* const s_rgwszFragments[] = {
+            L"Hello World ",
+            L"\x65e5\x672c\x8a9e ",
+            L"\r\n",
+            L"\x1b[1;31m",
+            L"\x1b[0m",
+            L"\x1b[38;5;208m",
+            L"\x1b[2J",
+            L"\x1b[12;40H",
+            L"\x9b" L"5;5H",
+            L"\x1b]0;session title\x07",
+            L"\x1b]2;another title\x1b\\",
+            L"\x1b[?25l",
+            L"\x1b(B",
+            L"\x7f",
+            L"\t",
+        };
+
+        std::uniform_int_distribution<size_t> pick(0, ARRAYSIZE(s_rgwszFragments) - 1);
+        std::wstring stream;
+        while (stream.size() < cchMinimum)
+        {
+            stream.append(s_rgwszFragments[pick(engine)]);
+        }
+        return stream;
+    }
+
+    TEST_METHOD(TestMultipleSessionsOnSeparateThreads)
+    {
+        const size_t cSessions = 8;
+        const size_t cchStream = 64 * 1024;
+
+        std::vector<std::wstring> streams;
+        std::vector<std::wstring> expected;
+        std::mt19937 engine(1337);
+        for (size_t i = 0; i < cSessions; i++)
+        {
+            streams.push_back(_GenerateSessionStream(engine, cchStream));
+        }
+
+        Log::Comment(L"Parse every stream serially and in one piece to get the expected dispatch results.");
+        for (const auto& stream : streams)
+        {
+            SessionRecordingDispatch* pDispatch = new SessionRecordingDispatch;
+            StateMachine mach(new OutputStateMachineEngine(pDispatch));
+            mach.ProcessString(stream);
+            expected.push_back(pDispatch->_log);
+        }
+
+        Log::Comment(L"Parse every stream on its own thread, split at random points, all at the same time.");
+        std::vector<std::wstring> actual(cSessions);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < cSessions; i++)
+        {
+            threads.emplace_back([&, i]() {
+                SessionRecordingDispatch* pDispatch = new SessionRecordingDispatch;
+                StateMachine mach(new OutputStateMachineEngine(pDispatch));
+
+                std::mt19937 splitEngine(static_cast<unsigned int>(i));
+                std::uniform_int_distribution<size_t> chunk(1, 97);
+
+                const auto& stream = streams.at(i);
+                size_t pos = 0;
+                while (pos < stream.size())
+                {
+                    const size_t cch = std::min(chunk(splitEngine), stream.size() - pos);
+                    mach.ProcessString(stream.data() + pos, cch);
+                    pos += cch;
+                }
+                actual.at(i) = pDispatch->_log;
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (size_t i = 0; i < cSessions; i++)
+        {
+            VERIFY_ARE_EQUAL(expected.at(i), actual.at(i), NoThrowString().Format(L"Session %zu", i));
+        }
+    }
+
+    TEST_METHOD(TestEmptyTitleDispatches)
+    {
+        SessionRecordingDispatch* pDispatch = new SessionRecordingDispatch;
+        StateMachine mach(new OutputStateMachineEngine(pDispatch));
+
+        Log::Comment(L"An empty title is still a title, whether the sequence arrives in one string...");
+        mach.ProcessString(L"\x1b]0;\x07");
+        VERIFY_ARE_EQUAL(L"[TITLE:]", pDispatch->_log);
+        pDispatch->_log.clear();
+
+        mach.ProcessString(L"abc\x1b]2;\x1b\\def");
+        VERIFY_ARE_EQUAL(L"abc[TITLE:]def", pDispatch->_log);
+        pDispatch->_log.clear();
+
+        Log::Comment(L"...or a character at a time.");
+        for (const auto wch : std::wstring_view{ L"\x1b]0;\x07" })
+        {
+            mach.ProcessCharacter(wch);
+        }
+        VERIFY_ARE_EQUAL(L"[TITLE:]", pDispatch->_log);
+    }
+
+    TEST_METHOD(TestLongSequencesDispatchIntact)
+    {
+        SessionRecordingDispatch* pDispatch = new SessionRecordingDispatch;
+        StateMachine mach(new OutputStateMachineEngine(pDispatch));
+
+        Log::Comment(L"A title well past the old 256 character limit should arrive in one piece.");
+        const std::wstring title(4000, L't');
+        mach.ProcessString(L"\x1b]0;" + title + L"\x07");
+        VERIFY_ARE_EQUAL(L"[TITLE:" + title + L"]", pDispatch->_log);
+        pDispatch->_log.clear();
+
+        Log::Comment(L"So should an SGR with more than the old 16 params.");
+        std::wstring sgr = L"\x1b[";
+        std::wstring expected = L"[SGR:";
+        for (size_t i = 0; i < 40; i++)
+        {
+            const unsigned int option = (i % 2) ? 1 : 31;
+            sgr += std::to_wstring(option) + L";";
+            expected += std::to_wstring(option) + L";";
+        }
+        sgr += L"0m";
+        expected += L"0;]";
+        mach.ProcessString(sgr);
+        VERIFY_ARE_EQUAL(expected, pDispatch->_log);
+    }
+
+    TEST_METHOD(TestBatchedDispatch)
+    {
+        std::mt19937 engine(4242);
+        const std::wstring stream = _GenerateSessionStream(engine, 64 * 1024);
+
+        Log::Comment(L"Parse the stream with every action dispatched as it's decoded.");
+        SessionRecordingDispatch* pExpectedDispatch = new SessionRecordingDispatch;
+        StateMachine expectedMach(new OutputStateMachineEngine(pExpectedDispatch));
+
+        Log::Comment(L"Parse the same stream, split the same way, with the actions from each string dispatched in a batch.");
+        SessionRecordingDispatch* pBatchedDispatch = new SessionRecordingDispatch;
+        OutputStateMachineEngine* pBatchedEngine = new OutputStateMachineEngine(pBatchedDispatch);
+        pBatchedEngine->SetDispatchInBatches(true);
+        VERIFY_IS_TRUE(pBatchedEngine->DispatchActionsInBatches());
+        StateMachine batchedMach(pBatchedEngine);
+
+        std::mt19937 splitEngine(7);
+        std::uniform_int_distribution<size_t> chunk(1, 397);
+        size_t pos = 0;
+        while (pos < stream.size())
+        {
+            const size_t cch = std::min(chunk(splitEngine), stream.size() - pos);
+            expectedMach.ProcessString(stream.data() + pos, cch);
+            batchedMach.ProcessString(stream.data() + pos, cch);
+            pos += cch;
+
+            // Nothing may be held back once ProcessString returns - the print runs in a batch point into the caller's string.
+            VERIFY_ARE_EQUAL(pExpectedDispatch->_log, pBatchedDispatch->_log);
+        }
+
+        Log::Comment(L"A single ProcessCharacter outside of ProcessString is still dispatched right away.");
+        batchedMach.ProcessCharacter(L'\r');
+        expectedMach.ProcessCharacter(L'\r');
+        VERIFY_ARE_EQUAL(pExpectedDispatch->_log, pBatchedDispatch->_log);
+
+        Log::Comment(L"Batching is never used while unknown sequences are being passed through to a terminal.");
+        pBatchedEngine->SetTerminalConnection(nullptr, []() { return true; });
+        VERIFY_IS_FALSE(pBatchedEngine->DispatchActionsInBatches());
+    }
+
+    TEST_METHOD(TestProcessUtf8)
+    {
+        std::mt19937 engine(2019);
+        std::wstring stream = _GenerateSessionStream(engine, 64 * 1024);
+        stream.append(L"\xd83d\xde00 \x1b]0;\xe9t\xe9 \xd83d\xde00\x07");
+
+        const int cb = WideCharToMultiByte(CP_UTF8, 0, stream.data(), static_cast<int>(stream.size()), nullptr, 0, nullptr, nullptr);
+        VERIFY_IS_GREATER_THAN(cb, 0);
+        std::string utf8(cb, '\0');
+        WideCharToMultiByte(CP_UTF8, 0, stream.data(), static_cast<int>(stream.size()), utf8.data(), cb, nullptr, nullptr);
+
+        SessionRecordingDispatch* pExpectedDispatch = new SessionRecordingDispatch;
+        StateMachine expectedMach(new OutputStateMachineEngine(pExpectedDispatch));
+        expectedMach.ProcessString(stream);
+
+        for (const bool fBatched : { false, true })
+        {
+            Log::Comment(NoThrowString().Format(L"Feed the UTF-8 encoding of the stream, split at random bytes (batched: %d).", fBatched));
+            SessionRecordingDispatch* pDispatch = new SessionRecordingDispatch;
+            OutputStateMachineEngine* pEngine = new OutputStateMachineEngine(pDispatch);
+            pEngine->SetDispatchInBatches(fBatched);
+            StateMachine mach(pEngine);
+
+            std::mt19937 splitEngine(11);
+            std::uniform_int_distribution<size_t> chunk(1, 61);
+            size_t pos = 0;
+            while (pos < utf8.size())
+            {
+                const size_t cbChunk = std::min(chunk(splitEngine), utf8.size() - pos);
+                mach.ProcessUtf8(utf8.data() + pos, cbChunk);
+                pos += cbChunk;
+            }
+
+            VERIFY_ARE_EQUAL(pExpectedDispatch->_log, pDispatch->_log);
+        }
+
+        Log::Comment(L"Ill-formed bytes become U+FFFD, and an encoded C1 CSI still starts a sequence.");
+        SessionRecordingDispatch* pDispatch = new SessionRecordingDispatch;
+        StateMachine mach(new OutputStateMachineEngine(pDispatch));
+        const std::string bytes = "\xE2\x82" "A\xC0\xAF\xC2\x9B" "2J\xF0\x9F";
+        mach.ProcessUtf8(bytes.data(), bytes.size());
+        VERIFY_ARE_EQUAL(std::wstring(L"\xfffd" L"A\xfffd\xfffd[ED:2]"), pDispatch->_log);
+
+        Log::Comment(L"The cut off character is finished by the next write.");
+        const std::string rest = "\x98\x80";
+        mach.ProcessUtf8(rest.data(), rest.size());
+        VERIFY_ARE_EQUAL(std::wstring(L"\xfffd" L"A\xfffd\xfffd[ED:2]\xd83d\xde00"), pDispatch->_log);
+    }
+
+    void _MeasurePrintThroughput(StateMachine& mach, const std::wstring& corpus, const wchar_t* const pwszName)
+    {
+        const size_t cIterations = 50;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < cIterations; i++)
+        {
+            mach.ProcessString(corpus);
+        }
+        const auto delta = PerfTestHelper::Microseconds(start, std::chrono::steady_clock::now());
+
+        const double cbProcessed = static_cast<double>(corpus.size() * sizeof(wchar_t) * cIterations);
+        Log::Comment(NoThrowString().Format(L"%s: %zu bytes x %zu took %lld us. %.1f MB/s",
+                                            pwszName,
+                                            corpus.size() * sizeof(wchar_t),
+                                            cIterations,
+                                            delta,
+                                            delta > 0 ? cbProcessed / delta : 0.0));
+    }
+
+    TEST_METHOD(TestProcessStringThroughput)
+    {
+        BEGIN_TEST_METHOD_PROPERTIES()
+            TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+        END_TEST_METHOD_PROPERTIES()
+
+        PrintRunDispatch* pDispatch = new PrintRunDispatch;
+        VERIFY_IS_NOT_NULL(pDispatch);
+        StateMachine mach(new OutputStateMachineEngine(pDispatch));
+
+        // Roughly a megabyte of each kind of output.
+        const size_t cchCorpus = 512 * 1024;
+
+        std::wstring buildLog;
+        while (buildLog.size() < cchCorpus)
+        {
+            buildLog += L"  OutputStateMachineEngine.cpp(1042): note: see reference to function template instantiation being compiled\r\n";
+        }
+
+        std::wstring coloredLog;
+        while (coloredLog.size() < cchCorpus)
+        {
+            coloredLog += L"\x1b[1;32m   Compiling\x1b[0m parser v0.1.0 (\x1b[4mC:\\src\\terminal\\parser\x1b[24m)\r\n";
+        }
+
+        std::wstring cjk;
+        while (cjk.size() < cchCorpus)
+        {
+            cjk += L"\x65e5\x672c\x8a9e\x306e\x30c6\x30ad\x30b9\x30c8\x3002\x4e2d\x6587\x6587\x672c\xd55c\xad6d\xc5b4\r\n";
+        }
+
+        _MeasurePrintThroughput(mach, buildLog, L"Plain text");
+        _MeasurePrintThroughput(mach, coloredLog, L"SGR colored text");
+        _MeasurePrintThroughput(mach, cjk, L"CJK text");
+    }
+
+    TEST_METHOD(TestSequenceDenseThroughput)
+    {
+        BEGIN_TEST_METHOD_PROPERTIES()
+            TEST_METHOD_PROPERTY(L"IsPerfTest", L"true")
+        END_TEST_METHOD_PROPERTIES()
+
+        // Nearly every character here goes through the transition table one at a time,
+        //      rather than being skipped over as part of a print run.
+        PrintRunDispatch* pDispatch = new PrintRunDispatch;
+        VERIFY_IS_NOT_NULL(pDispatch);
+        StateMachine mach(new OutputStateMachineEngine(pDispatch));
+
+        std::wstring tui;
+        while (tui.size() < 512 * 1024)
+        {
+            tui += L"\x1b[12;40H\x1b[38;5;123;48;5;17m#\x1b[0m\x1b[K\x1b[?25l\x1b]0;title\x07\x1bM\x1b(B";
+        }
+
+        _MeasurePrintThroughput(mach, tui, L"Sequence-dense TUI output");
+    }
 };
@@ -47,38 +47,53 @@ std::wstring_view Utf16Parser::ParseNext(std::wstring_view wstr)
 }
 
 // Routine Description:
-// - formats a utf16 encoded wstring and splits the codepoints into individual collections.
+// - splits a utf16 encoded wstring into its codepoints, lazily.
 // - will drop badly formatted leading/trailing char sequences.
 // - does not validate utf16 input beyond proper leading/trailing char sequences.
 // Arguments:
-// - wstr - the string to parse
+// - wstr - the string to parse. It must outlive the range returned.
 // Return Value:
-// - a vector of utf16 codepoints. glyphs that require surrogate pairs will be grouped
-// together in a vector and codepoints that use only one wchar will be in a vector by themselves.
-std::vector<std::vector<wchar_t>> Utf16Parser::Parse(std::wstring_view wstr)
+// - a range of views into wstr, one per codepoint. glyphs that require surrogate pairs
+// are a view of both wchars, and codepoints that use only one wchar are a view of just that one.
+Utf16Parser::GlyphRange Utf16Parser::Parse(std::wstring_view wstr) noexcept
 {
-    std::vector<std::vector<wchar_t>> result;
-    std::vector<wchar_t> sequence;
-    for (const auto wch : wstr)
+    return GlyphRange{ wstr };
+}
+
+// Routine Description:
+// - moves the iterator on to the next codepoint in the string, skipping any
+// unpaired leading or trailing surrogates along the way.
+// Arguments:
+// - <none>
+// Return Value:
+// - <none>
+void Utf16Parser::GlyphIterator::_Advance() noexcept
+{
+    _glyph = {};
+    while (!_remaining.empty())
     {
+        const wchar_t wch = _remaining.front();
+        size_t length = 0;
         if (IsLeadingSurrogate(wch))
         {
-            sequence.clear();
-            sequence.push_back(wch);
-        }
-        else if (IsTrailingSurrogate(wch))
-        {
-            if (!sequence.empty())
+            if (_remaining.size() > 1 && IsTrailingSurrogate(_remaining[1]))
             {
-                sequence.push_back(wch);
-                result.push_back(sequence);
-                sequence.clear();
+                length = 2;
             }
         }
-        else
+        else if (!IsTrailingSurrogate(wch))
         {
-            result.push_back({ wch });
+            length = 1;
         }
+
+        if (length > 0)
+        {
+            _glyph = _remaining.substr(0, length);
+            _remaining.remove_prefix(length);
+            return;
+        }
+
+        // An unpaired surrogate. Drop it.
+        _remaining.remove_prefix(1);
     }
-    return result;
 }
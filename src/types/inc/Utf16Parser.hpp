@@ -17,6 +17,8 @@ Author(s):
 #include <vector>
 #include <optional>
 #include <bitset>
+#include <iterator>
+#include <string_view>
 
 
 class Utf16Parser final
@@ -28,7 +30,10 @@ private:
     static constexpr std::bitset<IndicatorBitCount> TrailingSurrogateMask = { 55 }; // 110 111 indicates a trailing surrogate
 
 public:
-    static std::vector<std::vector<wchar_t>> Parse(std::wstring_view wstr);
+    class GlyphIterator;
+    class GlyphRange;
+
+    static GlyphRange Parse(std::wstring_view wstr) noexcept;
     static std::wstring_view ParseNext(std::wstring_view wstr);
 
     // Routine Description:
@@ -57,3 +62,87 @@ public:
         return (possBits ^ TrailingSurrogateMask).none();
     }
 };
+
+// Walks a utf16 string one codepoint at a time, yielding views into the
+// string itself, so nothing is copied or allocated. A codepoint is either
+// a single wchar or a surrogate pair. Unpaired surrogates are skipped.
+class Utf16Parser::GlyphIterator final
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::wstring_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::wstring_view*;
+    using reference = const std::wstring_view&;
+
+    // Constructs an iterator pointing at the first codepoint of wstr, or
+    // the end iterator if wstr is empty (or holds only unpaired surrogates).
+    explicit GlyphIterator(std::wstring_view wstr = {}) noexcept :
+        _remaining{ wstr },
+        _glyph{}
+    {
+        _Advance();
+    }
+
+    reference operator*() const noexcept
+    {
+        return _glyph;
+    }
+
+    pointer operator->() const noexcept
+    {
+        return &_glyph;
+    }
+
+    GlyphIterator& operator++() noexcept
+    {
+        _Advance();
+        return *this;
+    }
+
+    GlyphIterator operator++(int) noexcept
+    {
+        GlyphIterator temp{ *this };
+        _Advance();
+        return temp;
+    }
+
+    bool operator==(const GlyphIterator& other) const noexcept
+    {
+        // Every end iterator compares equal, regardless of the string it walked.
+        return _glyph.empty() ? other._glyph.empty() : _glyph.data() == other._glyph.data();
+    }
+
+    bool operator!=(const GlyphIterator& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    void _Advance() noexcept;
+
+    std::wstring_view _remaining;
+    std::wstring_view _glyph;
+};
+
+class Utf16Parser::GlyphRange final
+{
+public:
+    explicit GlyphRange(std::wstring_view wstr) noexcept :
+        _wstr{ wstr }
+    {
+    }
+
+    GlyphIterator begin() const noexcept
+    {
+        return GlyphIterator{ _wstr };
+    }
+
+    GlyphIterator end() const noexcept
+    {
+        return GlyphIterator{};
+    }
+
+private:
+    std::wstring_view _wstr;
+};